@@ -624,8 +624,8 @@ function(SETUP_BLENDER_SORTED_LIBS)
 		bf_nodes
 		bf_rna
 		bf_imbuf
-		bf_blenlib
 		bf_depsgraph
+		bf_blenlib
 		bf_intern_ghost
 		bf_intern_string
 		bf_avi
@@ -191,6 +191,9 @@ extern "C" {
 	/** Get the peak memory usage in bytes, including mmap allocations. */
 	extern size_t (*MEM_get_peak_memory)(void) ATTR_WARN_UNUSED_RESULT;
 
+	/** Move the block to another allocation domain, see #MEM_domain_thread_set. */
+	extern void (*MEM_set_block_domain)(void *vmemh, int domain);
+
 #ifdef __GNUC__
 #define MEM_SAFE_FREE(v) do { \
 	typeof(&(v)) _v = &(v); \
@@ -209,6 +212,42 @@ extern "C" {
 } while (0)
 #endif
 
+/**
+ * Allocation domains, to tell which subsystem uses how much memory.
+ *
+ * Blocks are accounted to the domain set for the allocating thread,
+ * until they are freed or moved with #MEM_set_block_domain.
+ * Per domain usage is accurate to a few hundred KB per thread.
+ */
+typedef enum eMemDomain {
+	MEM_DOMAIN_DEFAULT = 0,
+	MEM_DOMAIN_MOVIECACHE,
+	MEM_DOMAIN_BVH,
+	MEM_DOMAIN_UNDO,
+	MEM_DOMAIN_MODIFIER_CACHE,
+	MEM_DOMAIN_TOT,
+} eMemDomain;
+
+/**
+ * Called once when a domain goes over its budget, from the allocating thread.
+ * Should only flag the owner to free memory at a safe point.
+ */
+typedef void (*MEM_DomainBudgetFunc)(int domain, size_t mem_in_use, void *userdata);
+
+/** Set the domain of following allocations in the calling thread, returns the previous one. */
+int MEM_domain_thread_set(int domain);
+int MEM_domain_thread_get(void);
+const char *MEM_domain_name(int domain);
+size_t MEM_domain_get_memory_in_use(int domain);
+size_t MEM_domain_get_peak_memory(int domain);
+void MEM_domain_reset_peak_memory(int domain);
+/** Soft limit for the domain, zero to disable. */
+void MEM_domain_set_budget(int domain, size_t budget);
+size_t MEM_domain_get_budget(int domain);
+bool MEM_domain_is_over_budget(int domain);
+void MEM_domain_budget_callback_add(int domain, MEM_DomainBudgetFunc func, void *userdata);
+void MEM_domain_budget_callback_remove(int domain, MEM_DomainBudgetFunc func, void *userdata);
+
 /* overhead for lockfree allocator (use to avoid slop-space) */
 #define MEM_SIZE_OVERHEAD sizeof(size_t)
 #define MEM_SIZE_OPTIMAL(size) ((size) - MEM_SIZE_OVERHEAD)
@@ -220,6 +259,11 @@ extern const char *(*MEM_name_ptr)(void *vmemh);
 /* Switch allocator to slower but fully guarded mode. */
 void MEM_use_guarded_allocator(void);
 
+/* Switch allocator to size classes with per-thread caches and statistics,
+ * faster for many small allocations from multiple threads.
+ * Like the guarded allocator, this must happen before any allocation. */
+void MEM_use_tcache_allocator(void);
+
 #ifdef __cplusplus
 /* alloc funcs for C++ only */
 #define MEM_CXX_CLASS_ALLOC_FUNCS(_id)                                        \
@@ -61,6 +61,7 @@ size_t (*MEM_get_mapped_memory_in_use)(void) = MEM_lockfree_get_mapped_memory_in
 unsigned int (*MEM_get_memory_blocks_in_use)(void) = MEM_lockfree_get_memory_blocks_in_use;
 void (*MEM_reset_peak_memory)(void) = MEM_lockfree_reset_peak_memory;
 size_t (*MEM_get_peak_memory)(void) = MEM_lockfree_get_peak_memory;
+void (*MEM_set_block_domain)(void *vmemh, int domain) = MEM_lockfree_set_block_domain;
 
 #ifndef NDEBUG
 const char *(*MEM_name_ptr)(void *vmemh) = MEM_lockfree_name_ptr;
@@ -127,8 +128,44 @@ void MEM_use_guarded_allocator(void)
 	MEM_get_memory_blocks_in_use = MEM_guarded_get_memory_blocks_in_use;
 	MEM_reset_peak_memory = MEM_guarded_reset_peak_memory;
 	MEM_get_peak_memory = MEM_guarded_get_peak_memory;
+	MEM_set_block_domain = MEM_guarded_set_block_domain;
 
 #ifndef NDEBUG
 	MEM_name_ptr = MEM_guarded_name_ptr;
 #endif
 }
+
+void MEM_use_tcache_allocator(void)
+{
+	MEM_tcache_init();
+
+	MEM_allocN_len = MEM_tcache_allocN_len;
+	MEM_freeN = MEM_tcache_freeN;
+	MEM_dupallocN = MEM_tcache_dupallocN;
+	MEM_reallocN_id = MEM_tcache_reallocN_id;
+	MEM_recallocN_id = MEM_tcache_recallocN_id;
+	MEM_callocN = MEM_tcache_callocN;
+	MEM_calloc_arrayN = MEM_tcache_calloc_arrayN;
+	MEM_mallocN = MEM_tcache_mallocN;
+	MEM_malloc_arrayN = MEM_tcache_malloc_arrayN;
+	MEM_mallocN_aligned = MEM_tcache_mallocN_aligned;
+	MEM_mapallocN = MEM_tcache_mapallocN;
+	MEM_printmemlist_pydict = MEM_tcache_printmemlist_pydict;
+	MEM_printmemlist = MEM_tcache_printmemlist;
+	MEM_callbackmemlist = MEM_tcache_callbackmemlist;
+	MEM_printmemlist_stats = MEM_tcache_printmemlist_stats;
+	MEM_set_error_callback = MEM_tcache_set_error_callback;
+	MEM_consistency_check = MEM_tcache_consistency_check;
+	MEM_set_lock_callback = MEM_tcache_set_lock_callback;
+	MEM_set_memory_debug = MEM_tcache_set_memory_debug;
+	MEM_get_memory_in_use = MEM_tcache_get_memory_in_use;
+	MEM_get_mapped_memory_in_use = MEM_tcache_get_mapped_memory_in_use;
+	MEM_get_memory_blocks_in_use = MEM_tcache_get_memory_blocks_in_use;
+	MEM_reset_peak_memory = MEM_tcache_reset_peak_memory;
+	MEM_get_peak_memory = MEM_tcache_get_peak_memory;
+	MEM_set_block_domain = MEM_tcache_set_block_domain;
+
+#ifndef NDEBUG
+	MEM_name_ptr = MEM_tcache_name_ptr;
+#endif
+}
@@ -0,0 +1,358 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file guardedalloc/intern/mallocn_domain.c
+ *  \ingroup MEM
+ *
+ * Memory accounting per allocation domain, shared by all allocator implementations.
+ *
+ * Every thread accumulates the changes to each domain in its own counters,
+ * which are added to the shared (atomic) counters once they grow past
+ * #DOMAIN_FLUSH_BYTES. Peak memory and budgets are checked at that point,
+ * so they are accurate to that amount per thread. Queries of the memory
+ * in use sum up the counters of all threads.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "MEM_guardedalloc.h"
+
+/* to ensure strict conversions */
+#include "../../source/blender/blenlib/BLI_strict_flags.h"
+
+#include "atomic_ops.h"
+#include "mallocn_intern.h"
+
+#define DOMAIN_FLUSH_BYTES ((ptrdiff_t)256 * 1024)
+#define DOMAIN_CALLBACKS_MAX 8
+
+typedef struct DomainThread {
+	struct DomainThread *next, *prev;
+	/* Not yet added to the shared counters, negative when freeing more than allocating. */
+	ptrdiff_t delta[MEM_DOMAIN_TOT];
+} DomainThread;
+
+typedef struct DomainCallback {
+	MEM_DomainBudgetFunc func;
+	void *userdata;
+} DomainCallback;
+
+typedef struct Domain {
+	size_t mem_in_use;
+	size_t peak_mem;
+	size_t budget;
+	uint32_t is_over_budget;
+
+	DomainCallback callbacks[DOMAIN_CALLBACKS_MAX];
+	int callbacks_len;
+} Domain;
+
+static struct {
+	Domain domains[MEM_DOMAIN_TOT];
+
+	/* Protects the list of threads and the callbacks. */
+	pthread_mutex_t lock;
+	DomainThread *threads;
+
+	pthread_once_t init_once;
+	pthread_key_t thread_key;
+} mem_domain = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.init_once = PTHREAD_ONCE_INIT,
+};
+
+static const char *domain_names[MEM_DOMAIN_TOT] = {
+	"Default",
+	"Movie Cache",
+	"BVH Trees",
+	"Undo",
+	"Modifier Cache",
+};
+
+static MEM_THREAD_LOCAL DomainThread *domain_thread = NULL;
+static MEM_THREAD_LOCAL int domain_thread_current = MEM_DOMAIN_DEFAULT;
+
+/* -------------------------------------------------------------------- */
+/** \name Thread Counters
+ * \{ */
+
+static void domain_flush(DomainThread *thread, unsigned int domain_index);
+
+static void domain_thread_exit(void *thread_v)
+{
+	DomainThread *thread = thread_v;
+	unsigned int i;
+
+	for (i = 0; i < MEM_DOMAIN_TOT; i++) {
+		domain_flush(thread, i);
+	}
+
+	pthread_mutex_lock(&mem_domain.lock);
+	if (thread->prev) {
+		thread->prev->next = thread->next;
+	}
+	else {
+		mem_domain.threads = thread->next;
+	}
+	if (thread->next) {
+		thread->next->prev = thread->prev;
+	}
+	pthread_mutex_unlock(&mem_domain.lock);
+
+	domain_thread = NULL;
+	free(thread);
+}
+
+static void domain_init(void)
+{
+	pthread_key_create(&mem_domain.thread_key, domain_thread_exit);
+}
+
+static DomainThread *domain_thread_create(void)
+{
+	DomainThread *thread = calloc(1, sizeof(*thread));
+
+	if (UNLIKELY(thread == NULL)) {
+		abort();
+	}
+
+	pthread_once(&mem_domain.init_once, domain_init);
+
+	pthread_mutex_lock(&mem_domain.lock);
+	thread->next = mem_domain.threads;
+	if (thread->next) {
+		thread->next->prev = thread;
+	}
+	mem_domain.threads = thread;
+	pthread_mutex_unlock(&mem_domain.lock);
+
+	/* Only to get notified when the thread finishes. */
+	pthread_setspecific(mem_domain.thread_key, thread);
+	domain_thread = thread;
+
+	return thread;
+}
+
+MEM_INLINE DomainThread *domain_thread_get(void)
+{
+	DomainThread *thread = domain_thread;
+	if (UNLIKELY(thread == NULL)) {
+		thread = domain_thread_create();
+	}
+	return thread;
+}
+
+static void domain_budget_notify(unsigned int domain_index, size_t mem_in_use)
+{
+	Domain *domain = &mem_domain.domains[domain_index];
+	DomainCallback callbacks[DOMAIN_CALLBACKS_MAX];
+	int i, callbacks_len;
+
+	/* Call without the lock held, so callbacks can query the memory usage. */
+	pthread_mutex_lock(&mem_domain.lock);
+	callbacks_len = domain->callbacks_len;
+	memcpy(callbacks, domain->callbacks, sizeof(*callbacks) * (size_t)callbacks_len);
+	pthread_mutex_unlock(&mem_domain.lock);
+
+	for (i = 0; i < callbacks_len; i++) {
+		callbacks[i].func((int)domain_index, mem_in_use, callbacks[i].userdata);
+	}
+}
+
+/* Add the counter of \a thread to the shared one, checking the peak and budget. */
+static void domain_flush(DomainThread *thread, unsigned int domain_index)
+{
+	Domain *domain = &mem_domain.domains[domain_index];
+	const ptrdiff_t delta = thread->delta[domain_index];
+	size_t mem_in_use;
+
+	if (delta == 0) {
+		return;
+	}
+	thread->delta[domain_index] = 0;
+
+	/* Wraps around for negative values. */
+	mem_in_use = atomic_add_and_fetch_z(&domain->mem_in_use, (size_t)delta);
+
+	if (delta > 0) {
+		atomic_fetch_and_update_max_z(&domain->peak_mem, mem_in_use);
+	}
+
+	if (domain->budget != 0) {
+		if (mem_in_use > domain->budget) {
+			/* Only notify once when going over the budget. */
+			if (atomic_cas_uint32(&domain->is_over_budget, 0, 1) == 0) {
+				domain_budget_notify(domain_index, mem_in_use);
+			}
+		}
+		else if (domain->is_over_budget) {
+			atomic_cas_uint32(&domain->is_over_budget, 1, 0);
+		}
+	}
+}
+
+int mem_domain_thread_current(void)
+{
+	return domain_thread_current;
+}
+
+void mem_domain_add(int domain_index, size_t len)
+{
+	DomainThread *thread = domain_thread_get();
+	ptrdiff_t *delta = &thread->delta[domain_index];
+
+	*delta += (ptrdiff_t)len;
+	if (UNLIKELY(*delta >= DOMAIN_FLUSH_BYTES)) {
+		domain_flush(thread, (unsigned int)domain_index);
+	}
+}
+
+void mem_domain_sub(int domain_index, size_t len)
+{
+	DomainThread *thread = domain_thread_get();
+	ptrdiff_t *delta = &thread->delta[domain_index];
+
+	*delta -= (ptrdiff_t)len;
+	if (UNLIKELY(*delta <= -DOMAIN_FLUSH_BYTES)) {
+		domain_flush(thread, (unsigned int)domain_index);
+	}
+}
+
+void mem_domain_print_stats(void)
+{
+	int i;
+
+	printf("\nmemory per domain:\n");
+	for (i = 0; i < MEM_DOMAIN_TOT; i++) {
+		const size_t budget = MEM_domain_get_budget(i);
+		printf("  %-16s %10.3f MB, peak %10.3f MB",
+		       domain_names[i],
+		       (double)MEM_domain_get_memory_in_use(i) / (double)(1024 * 1024),
+		       (double)MEM_domain_get_peak_memory(i) / (double)(1024 * 1024));
+		if (budget) {
+			printf(", budget %10.3f MB", (double)budget / (double)(1024 * 1024));
+		}
+		printf("\n");
+	}
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Public API
+ * \{ */
+
+int MEM_domain_thread_set(int domain)
+{
+	const int domain_prev = domain_thread_current;
+	assert(domain >= 0 && domain < MEM_DOMAIN_TOT);
+	domain_thread_current = domain;
+	return domain_prev;
+}
+
+int MEM_domain_thread_get(void)
+{
+	return domain_thread_current;
+}
+
+const char *MEM_domain_name(int domain)
+{
+	return domain_names[domain];
+}
+
+size_t MEM_domain_get_memory_in_use(int domain)
+{
+	size_t mem_in_use;
+	DomainThread *thread;
+
+	pthread_mutex_lock(&mem_domain.lock);
+	mem_in_use = mem_domain.domains[domain].mem_in_use;
+	for (thread = mem_domain.threads; thread; thread = thread->next) {
+		mem_in_use += (size_t)thread->delta[domain];
+	}
+	pthread_mutex_unlock(&mem_domain.lock);
+
+	atomic_fetch_and_update_max_z(&mem_domain.domains[domain].peak_mem, mem_in_use);
+
+	return mem_in_use;
+}
+
+size_t MEM_domain_get_peak_memory(int domain)
+{
+	return mem_domain.domains[domain].peak_mem;
+}
+
+void MEM_domain_reset_peak_memory(int domain)
+{
+	mem_domain.domains[domain].peak_mem = MEM_domain_get_memory_in_use(domain);
+}
+
+void MEM_domain_set_budget(int domain, size_t budget)
+{
+	mem_domain.domains[domain].budget = budget;
+	if (budget == 0) {
+		mem_domain.domains[domain].is_over_budget = 0;
+	}
+}
+
+size_t MEM_domain_get_budget(int domain)
+{
+	return mem_domain.domains[domain].budget;
+}
+
+bool MEM_domain_is_over_budget(int domain)
+{
+	const size_t budget = mem_domain.domains[domain].budget;
+	return (budget != 0) && (MEM_domain_get_memory_in_use(domain) > budget);
+}
+
+void MEM_domain_budget_callback_add(int domain, MEM_DomainBudgetFunc func, void *userdata)
+{
+	Domain *d = &mem_domain.domains[domain];
+
+	pthread_mutex_lock(&mem_domain.lock);
+	assert(d->callbacks_len < DOMAIN_CALLBACKS_MAX);
+	if (d->callbacks_len < DOMAIN_CALLBACKS_MAX) {
+		d->callbacks[d->callbacks_len].func = func;
+		d->callbacks[d->callbacks_len].userdata = userdata;
+		d->callbacks_len++;
+	}
+	pthread_mutex_unlock(&mem_domain.lock);
+}
+
+void MEM_domain_budget_callback_remove(int domain, MEM_DomainBudgetFunc func, void *userdata)
+{
+	Domain *d = &mem_domain.domains[domain];
+	int i;
+
+	pthread_mutex_lock(&mem_domain.lock);
+	for (i = 0; i < d->callbacks_len; i++) {
+		if (d->callbacks[i].func == func && d->callbacks[i].userdata == userdata) {
+			d->callbacks[i] = d->callbacks[--d->callbacks_len];
+			break;
+		}
+	}
+	pthread_mutex_unlock(&mem_domain.lock);
+}
+
+/** \} */
@@ -114,7 +114,8 @@ typedef struct MemHead {
 	const char *name;
 	const char *nextname;
 	int tag2;
-	short mmap;  /* if true, memory was mmapped */
+	char mmap;  /* if true, memory was mmapped */
+	char domain;  /* allocation domain, see eMemDomain */
 	short alignment;  /* if non-zero aligned alloc was used
 	                   * and alignment is stored here.
 	                   */
@@ -391,6 +392,8 @@ void *MEM_guarded_reallocN_id(void *vmemh, size_t len, const char *str)
 		}
 
 		if (newp) {
+			MEM_guarded_set_block_domain(newp, memh->domain);
+
 			if (len < memh->len) {
 				/* shrink */
 				memcpy(newp, vmemh, len);
@@ -426,6 +429,8 @@ void *MEM_guarded_recallocN_id(void *vmemh, size_t len, const char *str)
 		}
 
 		if (newp) {
+			MEM_guarded_set_block_domain(newp, memh->domain);
+
 			if (len < memh->len) {
 				/* shrink */
 				memcpy(newp, vmemh, len);
@@ -491,6 +496,7 @@ static void make_memhead_header(MemHead *memh, size_t len, const char *str)
 	memh->nextname = NULL;
 	memh->len = len;
 	memh->mmap = 0;
+	memh->domain = (char)mem_domain_thread_current();
 	memh->alignment = 0;
 	memh->tag2 = MEMTAG2;
 
@@ -507,6 +513,7 @@ static void make_memhead_header(MemHead *memh, size_t len, const char *str)
 
 	atomic_add_and_fetch_u(&totblock, 1);
 	atomic_add_and_fetch_z(&mem_in_use, len);
+	mem_domain_add(memh->domain, len);
 
 	mem_lock_thread();
 	addtail(membase, &memh->next);
@@ -788,6 +795,8 @@ void MEM_guarded_printmemlist_stats(void)
 	
 	mem_unlock_thread();
 
+	mem_domain_print_stats();
+
 #ifdef HAVE_MALLOC_STATS
 	printf("System Statistics:\n");
 	malloc_stats();
@@ -1039,6 +1048,7 @@ static void rem_memblock(MemHead *memh)
 
 	atomic_sub_and_fetch_u(&totblock, 1);
 	atomic_sub_and_fetch_z(&mem_in_use, memh->len);
+	mem_domain_sub(memh->domain, memh->len);
 
 #ifdef DEBUG_MEMDUPLINAME
 	if (memh->need_free_name)
@@ -1166,6 +1176,18 @@ static const char *check_memlist(MemHead *memh)
 	return(name);
 }
 
+void MEM_guarded_set_block_domain(void *vmemh, int domain)
+{
+	MemHead *memh = vmemh;
+	memh--;
+
+	if (memh->domain != domain) {
+		mem_domain_sub(memh->domain, memh->len);
+		mem_domain_add(domain, memh->len);
+		memh->domain = (char)domain;
+	}
+}
+
 size_t MEM_guarded_get_peak_memory(void)
 {
 	size_t _peak_mem;
@@ -109,6 +109,29 @@ size_t malloc_usable_size(void *ptr);
 
 #define IS_POW2(a) (((a) & ((a) - 1)) == 0)
 
+#if defined(_MSC_VER)
+#  define MEM_THREAD_LOCAL __declspec(thread)
+#else
+#  define MEM_THREAD_LOCAL __thread
+#endif
+
+/* The lock-free and thread caching allocators keep the allocation domain
+ * in the upper bits of MemHead.len, on 32 bit there is no room for it and
+ * all their blocks are accounted to the default domain. */
+#if defined(__LP64__) || defined(_WIN64)
+#  define MEMHEAD_DOMAIN_SHIFT 56
+#  define MEMHEAD_DOMAIN_MASK ((size_t)0xff << MEMHEAD_DOMAIN_SHIFT)
+#  define MEMHEAD_LEN_DOMAIN(len) ((int)((len) >> MEMHEAD_DOMAIN_SHIFT))
+#  define MEMHEAD_LEN_SET_DOMAIN(len, domain) \
+	(((len) & ~MEMHEAD_DOMAIN_MASK) | ((size_t)(domain) << MEMHEAD_DOMAIN_SHIFT))
+#  define MEMHEAD_DOMAIN_CURRENT() mem_domain_thread_current()
+#else
+#  define MEMHEAD_DOMAIN_MASK ((size_t)0)
+#  define MEMHEAD_LEN_DOMAIN(len) MEM_DOMAIN_DEFAULT
+#  define MEMHEAD_LEN_SET_DOMAIN(len, domain) (len)
+#  define MEMHEAD_DOMAIN_CURRENT() MEM_DOMAIN_DEFAULT
+#endif
+
 /* Extra padding which needs to be applied on MemHead to make it aligned. */
 #define MEMHEAD_ALIGN_PADDING(alignment) ((size_t)alignment - (sizeof(MemHeadAligned) % (size_t)alignment))
 
@@ -120,6 +143,20 @@ size_t malloc_usable_size(void *ptr);
 void *aligned_malloc(size_t size, size_t alignment);
 void aligned_free(void *ptr);
 
+/* Allocation domain accounting, see mallocn_domain.c */
+int mem_domain_thread_current(void);
+void mem_domain_add(int domain, size_t len);
+void mem_domain_sub(int domain, size_t len);
+void mem_domain_print_stats(void);
+
+/* Account a new block of \a len bytes to the current domain, returns \a len_flags with the domain set. */
+MEM_INLINE size_t memhead_len_with_domain(size_t len_flags, size_t len)
+{
+	const int domain = MEMHEAD_DOMAIN_CURRENT();
+	mem_domain_add(domain, len);
+	return MEMHEAD_LEN_SET_DOMAIN(len_flags, domain);
+}
+
 /* Prototypes for counted allocator functions */
 size_t MEM_lockfree_allocN_len(const void *vmemh) ATTR_WARN_UNUSED_RESULT;
 void MEM_lockfree_freeN(void *vmemh);
@@ -145,10 +182,42 @@ size_t MEM_lockfree_get_mapped_memory_in_use(void);
 unsigned int MEM_lockfree_get_memory_blocks_in_use(void);
 void MEM_lockfree_reset_peak_memory(void);
 size_t MEM_lockfree_get_peak_memory(void) ATTR_WARN_UNUSED_RESULT;
+void MEM_lockfree_set_block_domain(void *vmemh, int domain);
 #ifndef NDEBUG
 const char *MEM_lockfree_name_ptr(void *vmemh);
 #endif
 
+/* Prototypes for thread caching allocator functions */
+void MEM_tcache_init(void);
+size_t MEM_tcache_allocN_len(const void *vmemh) ATTR_WARN_UNUSED_RESULT;
+void MEM_tcache_freeN(void *vmemh);
+void *MEM_tcache_dupallocN(const void *vmemh) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+void *MEM_tcache_reallocN_id(void *vmemh, size_t len, const char *UNUSED(str))  ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_ALLOC_SIZE(2);
+void *MEM_tcache_recallocN_id(void *vmemh, size_t len, const char *UNUSED(str))  ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_ALLOC_SIZE(2);
+void *MEM_tcache_callocN(size_t len, const char *UNUSED(str))  ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_ALLOC_SIZE(1) ATTR_NONNULL(2);
+void *MEM_tcache_calloc_arrayN(size_t len, size_t size, const char *UNUSED(str))  ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_ALLOC_SIZE(1,2) ATTR_NONNULL(3);
+void *MEM_tcache_mallocN(size_t len, const char *UNUSED(str)) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_ALLOC_SIZE(1) ATTR_NONNULL(2);
+void *MEM_tcache_malloc_arrayN(size_t len, size_t size, const char *UNUSED(str)) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_ALLOC_SIZE(1,2) ATTR_NONNULL(3);
+void *MEM_tcache_mallocN_aligned(size_t len, size_t alignment, const char *UNUSED(str)) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_ALLOC_SIZE(1) ATTR_NONNULL(3);
+void *MEM_tcache_mapallocN(size_t len, const char *UNUSED(str)) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_ALLOC_SIZE(1) ATTR_NONNULL(2);
+void MEM_tcache_printmemlist_pydict(void);
+void MEM_tcache_printmemlist(void);
+void MEM_tcache_callbackmemlist(void (*func)(void *));
+void MEM_tcache_printmemlist_stats(void);
+void MEM_tcache_set_error_callback(void (*func)(const char *));
+bool MEM_tcache_consistency_check(void);
+void MEM_tcache_set_lock_callback(void (*lock)(void), void (*unlock)(void));
+void MEM_tcache_set_memory_debug(void);
+size_t MEM_tcache_get_memory_in_use(void);
+size_t MEM_tcache_get_mapped_memory_in_use(void);
+unsigned int MEM_tcache_get_memory_blocks_in_use(void);
+void MEM_tcache_reset_peak_memory(void);
+size_t MEM_tcache_get_peak_memory(void) ATTR_WARN_UNUSED_RESULT;
+void MEM_tcache_set_block_domain(void *vmemh, int domain);
+#ifndef NDEBUG
+const char *MEM_tcache_name_ptr(void *vmemh);
+#endif
+
 /* Prototypes for fully guarded allocator functions */
 size_t MEM_guarded_allocN_len(const void *vmemh) ATTR_WARN_UNUSED_RESULT;
 void MEM_guarded_freeN(void *vmemh);
@@ -174,6 +243,7 @@ size_t MEM_guarded_get_mapped_memory_in_use(void);
 unsigned int MEM_guarded_get_memory_blocks_in_use(void);
 void MEM_guarded_reset_peak_memory(void);
 size_t MEM_guarded_get_peak_memory(void) ATTR_WARN_UNUSED_RESULT;
+void MEM_guarded_set_block_domain(void *vmemh, int domain);
 #ifndef NDEBUG
 const char *MEM_guarded_name_ptr(void *vmemh);
 #endif
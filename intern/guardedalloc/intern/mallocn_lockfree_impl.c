@@ -117,7 +117,7 @@ static void mem_unlock_thread(void)
 size_t MEM_lockfree_allocN_len(const void *vmemh)
 {
 	if (vmemh) {
-		return MEMHEAD_FROM_PTR(vmemh)->len & ~((size_t) (MEMHEAD_MMAP_FLAG | MEMHEAD_ALIGN_FLAG));
+		return MEMHEAD_FROM_PTR(vmemh)->len & ~((size_t) (MEMHEAD_MMAP_FLAG | MEMHEAD_ALIGN_FLAG) | MEMHEAD_DOMAIN_MASK);
 	}
 	else {
 		return 0;
@@ -139,6 +139,7 @@ void MEM_lockfree_freeN(void *vmemh)
 
 	atomic_sub_and_fetch_u(&totblock, 1);
 	atomic_sub_and_fetch_z(&mem_in_use, len);
+	mem_domain_sub(MEMHEAD_LEN_DOMAIN(memh->len), len);
 
 	if (MEMHEAD_IS_MMAP(memh)) {
 		atomic_sub_and_fetch_z(&mmap_in_use, len);
@@ -210,6 +211,8 @@ void *MEM_lockfree_reallocN_id(void *vmemh, size_t len, const char *str)
 		}
 
 		if (newp) {
+			MEM_lockfree_set_block_domain(newp, MEMHEAD_LEN_DOMAIN(memh->len));
+
 			if (len < old_len) {
 				/* shrink */
 				memcpy(newp, vmemh, len);
@@ -249,6 +252,8 @@ void *MEM_lockfree_recallocN_id(void *vmemh, size_t len, const char *str)
 		}
 
 		if (newp) {
+			MEM_lockfree_set_block_domain(newp, MEMHEAD_LEN_DOMAIN(memh->len));
+
 			if (len < old_len) {
 				/* shrink */
 				memcpy(newp, vmemh, len);
@@ -282,7 +287,7 @@ void *MEM_lockfree_callocN(size_t len, const char *str)
 	memh = (MemHead *)calloc(1, len + sizeof(MemHead));
 
 	if (LIKELY(memh)) {
-		memh->len = len;
+		memh->len = memhead_len_with_domain(len, len);
 		atomic_add_and_fetch_u(&totblock, 1);
 		atomic_add_and_fetch_z(&mem_in_use, len);
 		update_maximum(&peak_mem, mem_in_use);
@@ -322,7 +327,7 @@ void *MEM_lockfree_mallocN(size_t len, const char *str)
 			memset(memh + 1, 255, len);
 		}
 
-		memh->len = len;
+		memh->len = memhead_len_with_domain(len, len);
 		atomic_add_and_fetch_u(&totblock, 1);
 		atomic_add_and_fetch_z(&mem_in_use, len);
 		update_maximum(&peak_mem, mem_in_use);
@@ -385,7 +390,7 @@ void *MEM_lockfree_mallocN_aligned(size_t len, size_t alignment, const char *str
 			memset(memh + 1, 255, len);
 		}
 
-		memh->len = len | (size_t) MEMHEAD_ALIGN_FLAG;
+		memh->len = memhead_len_with_domain(len | (size_t) MEMHEAD_ALIGN_FLAG, len);
 		memh->alignment = (short) alignment;
 		atomic_add_and_fetch_u(&totblock, 1);
 		atomic_add_and_fetch_z(&mem_in_use, len);
@@ -421,7 +426,7 @@ void *MEM_lockfree_mapallocN(size_t len, const char *str)
 #endif
 
 	if (memh != (MemHead *)-1) {
-		memh->len = len | (size_t) MEMHEAD_MMAP_FLAG;
+		memh->len = memhead_len_with_domain(len | (size_t) MEMHEAD_MMAP_FLAG, len);
 		atomic_add_and_fetch_u(&totblock, 1);
 		atomic_add_and_fetch_z(&mem_in_use, len);
 		atomic_add_and_fetch_z(&mmap_in_use, len);
@@ -457,6 +462,7 @@ void MEM_lockfree_printmemlist_stats(void)
 	       (double)mem_in_use / (double)(1024 * 1024));
 	printf("peak memory len: %.3f MB\n",
 	       (double)peak_mem / (double)(1024 * 1024));
+	mem_domain_print_stats();
 	printf("\nFor more detailed per-block statistics run Blender with memory debugging command line argument.\n");
 
 #ifdef HAVE_MALLOC_STATS
@@ -512,6 +518,24 @@ size_t MEM_lockfree_get_peak_memory(void)
 	return peak_mem;
 }
 
+void MEM_lockfree_set_block_domain(void *vmemh, int domain)
+{
+#ifdef MEMHEAD_DOMAIN_SHIFT
+	MemHead *memh = MEMHEAD_FROM_PTR(vmemh);
+	const int domain_prev = MEMHEAD_LEN_DOMAIN(memh->len);
+
+	if (domain != domain_prev) {
+		const size_t len = MEM_lockfree_allocN_len(vmemh);
+		mem_domain_sub(domain_prev, len);
+		mem_domain_add(domain, len);
+		memh->len = MEMHEAD_LEN_SET_DOMAIN(memh->len, domain);
+	}
+#else
+	(void) vmemh;  /* Ignored. */
+	(void) domain;  /* Ignored. */
+#endif
+}
+
 #ifndef NDEBUG
 const char *MEM_lockfree_name_ptr(void *vmemh)
 {
@@ -0,0 +1,875 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file guardedalloc/intern/mallocn_tcache_impl.c
+ *  \ingroup MEM
+ *
+ * Size-class allocator with per-thread caches.
+ *
+ * Small blocks are carved out of larger slabs and sorted into size classes,
+ * every thread keeps its own free list for each class, only going to the
+ * shared (locked) lists to take or return blocks in batches.
+ *
+ * Memory counters are kept per thread too and only summed up when queried,
+ * so the peak memory is only as accurate as the moments it gets sampled at.
+ *
+ * Blocks above the largest size class use the system allocator,
+ * with the same header as the lock-free allocator.
+ * Slabs are never given back to the system.
+ */
+
+#include <stdlib.h>
+#include <string.h> /* memcpy */
+#include <stdarg.h>
+#include <sys/types.h>
+#include <pthread.h>
+
+#include "MEM_guardedalloc.h"
+
+/* to ensure strict conversions */
+#include "../../source/blender/blenlib/BLI_strict_flags.h"
+
+#include "atomic_ops.h"
+#include "mallocn_intern.h"
+
+typedef struct MemHead {
+	/* Length of allocated memory block. */
+	size_t len;
+} MemHead;
+
+typedef struct MemHeadAligned {
+	short alignment;
+	size_t len;
+} MemHeadAligned;
+
+enum {
+	MEMHEAD_MMAP_FLAG = 1,
+	MEMHEAD_ALIGN_FLAG = 2,
+};
+
+#define MEMHEAD_FROM_PTR(ptr) (((MemHead*) ptr) - 1)
+#define PTR_FROM_MEMHEAD(memhead) (memhead + 1)
+#define MEMHEAD_ALIGNED_FROM_PTR(ptr) (((MemHeadAligned*) ptr) - 1)
+#define MEMHEAD_IS_MMAP(memhead) ((memhead)->len & (size_t) MEMHEAD_MMAP_FLAG)
+#define MEMHEAD_IS_ALIGNED(memhead) ((memhead)->len & (size_t) MEMHEAD_ALIGN_FLAG)
+
+/* Size classes are multiples of this, so the data after the MemHead
+ * has the same alignment as the lock-free allocator gives. */
+#define SIZE_CLASS_STEP 16
+/* Largest block (including its MemHead) served from the size classes. */
+#define SIZE_CLASS_MAX 4096
+#define SIZE_CLASS_MAX_LEN ((size_t)SIZE_CLASS_MAX - sizeof(MemHead))
+/* Size of the chunks that size class blocks are carved from. */
+#define SLAB_SIZE ((size_t)256 * 1024)
+/* Amount of memory a thread moves between its cache and the shared lists at once. */
+#define BATCH_BYTES (16 * 1024)
+
+/* 16 byte steps up to 256, then four classes for every power of two. */
+static const unsigned int size_class_sizes[] = {
+	16, 32, 48, 64, 80, 96, 112, 128, 144, 160, 176, 192, 208, 224, 240, 256,
+	320, 384, 448, 512,
+	640, 768, 896, 1024,
+	1280, 1536, 1792, 2048,
+	2560, 3072, 3584, 4096,
+};
+#define NUM_SIZE_CLASSES (sizeof(size_class_sizes) / sizeof(*size_class_sizes))
+
+/* Free block, linked through the space of its MemHead. */
+typedef struct FreeBlock {
+	struct FreeBlock *next;
+} FreeBlock;
+
+typedef struct FreeList {
+	FreeBlock *first;
+	unsigned int count;
+} FreeList;
+
+typedef struct ThreadCache {
+	struct ThreadCache *next, *prev;
+	FreeList lists[NUM_SIZE_CLASSES];
+
+	/* Only written by the owning thread, blocks freed by another thread than
+	 * the one which allocated them make these wrap around, the sum of all
+	 * caches is still correct. */
+	size_t mem_in_use, mmap_in_use;
+	unsigned int totblock;
+} ThreadCache;
+
+typedef struct SharedFreeList {
+	pthread_mutex_t lock;
+	FreeList list;
+} SharedFreeList;
+
+static struct {
+	/* Protects the list of caches and the counters of finished threads. */
+	pthread_mutex_t lock;
+	ThreadCache *caches;
+	size_t mem_in_use, mmap_in_use;
+	unsigned int totblock;
+
+	size_t peak_mem;
+	size_t slab_mem;
+
+	SharedFreeList lists[NUM_SIZE_CLASSES];
+
+	/* Size class for every multiple of SIZE_CLASS_STEP. */
+	unsigned char size_class_lookup[SIZE_CLASS_MAX / SIZE_CLASS_STEP + 1];
+	unsigned int batch_size[NUM_SIZE_CLASSES];
+
+	pthread_key_t cache_key;
+} tcache;
+
+static MEM_THREAD_LOCAL ThreadCache *thread_cache = NULL;
+
+static bool malloc_debug_memset = false;
+
+static void (*error_callback)(const char *) = NULL;
+static void (*thread_lock_callback)(void) = NULL;
+static void (*thread_unlock_callback)(void) = NULL;
+
+#ifdef __GNUC__
+__attribute__ ((format(printf, 1, 2)))
+#endif
+static void print_error(const char *str, ...)
+{
+	char buf[512];
+	va_list ap;
+
+	va_start(ap, str);
+	vsnprintf(buf, sizeof(buf), str, ap);
+	va_end(ap);
+	buf[sizeof(buf) - 1] = '\0';
+
+	if (error_callback) {
+		error_callback(buf);
+	}
+}
+
+#if defined(WIN32)
+static void mem_lock_thread(void)
+{
+	if (thread_lock_callback)
+		thread_lock_callback();
+}
+
+static void mem_unlock_thread(void)
+{
+	if (thread_unlock_callback)
+		thread_unlock_callback();
+}
+#endif
+
+/* -------------------------------------------------------------------- */
+/** \name Thread Caches
+ * \{ */
+
+static void free_list_splice_shared(FreeList *list, unsigned int index, unsigned int count);
+
+static void thread_cache_exit(void *cache_v)
+{
+	ThreadCache *cache = cache_v;
+	unsigned int index;
+
+	for (index = 0; index < NUM_SIZE_CLASSES; index++) {
+		if (cache->lists[index].count) {
+			free_list_splice_shared(&cache->lists[index], index, cache->lists[index].count);
+		}
+	}
+
+	pthread_mutex_lock(&tcache.lock);
+	tcache.mem_in_use += cache->mem_in_use;
+	tcache.mmap_in_use += cache->mmap_in_use;
+	tcache.totblock += cache->totblock;
+	if (cache->prev) {
+		cache->prev->next = cache->next;
+	}
+	else {
+		tcache.caches = cache->next;
+	}
+	if (cache->next) {
+		cache->next->prev = cache->prev;
+	}
+	pthread_mutex_unlock(&tcache.lock);
+
+	thread_cache = NULL;
+	free(cache);
+}
+
+static ThreadCache *thread_cache_create(void)
+{
+	ThreadCache *cache = calloc(1, sizeof(*cache));
+
+	if (UNLIKELY(cache == NULL)) {
+		print_error("Could not allocate thread cache for memory allocator\n");
+		abort();
+	}
+
+	pthread_mutex_lock(&tcache.lock);
+	cache->next = tcache.caches;
+	if (cache->next) {
+		cache->next->prev = cache;
+	}
+	tcache.caches = cache;
+	pthread_mutex_unlock(&tcache.lock);
+
+	/* Only to get notified when the thread finishes. */
+	pthread_setspecific(tcache.cache_key, cache);
+	thread_cache = cache;
+
+	return cache;
+}
+
+MEM_INLINE ThreadCache *thread_cache_get(void)
+{
+	ThreadCache *cache = thread_cache;
+	if (UNLIKELY(cache == NULL)) {
+		cache = thread_cache_create();
+	}
+	return cache;
+}
+
+/* Sum of the counters of all threads, also sampling the peak memory. */
+static void thread_cache_totals(size_t *r_mem_in_use, size_t *r_mmap_in_use, unsigned int *r_totblock)
+{
+	size_t mem_in_use, mmap_in_use;
+	unsigned int totblock;
+	ThreadCache *cache;
+
+	pthread_mutex_lock(&tcache.lock);
+	mem_in_use = tcache.mem_in_use;
+	mmap_in_use = tcache.mmap_in_use;
+	totblock = tcache.totblock;
+	for (cache = tcache.caches; cache; cache = cache->next) {
+		mem_in_use += cache->mem_in_use;
+		mmap_in_use += cache->mmap_in_use;
+		totblock += cache->totblock;
+	}
+	if (mem_in_use > tcache.peak_mem) {
+		tcache.peak_mem = mem_in_use;
+	}
+	pthread_mutex_unlock(&tcache.lock);
+
+	if (r_mem_in_use) *r_mem_in_use = mem_in_use;
+	if (r_mmap_in_use) *r_mmap_in_use = mmap_in_use;
+	if (r_totblock) *r_totblock = totblock;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Size Classes
+ * \{ */
+
+MEM_INLINE unsigned int size_class_index(size_t len)
+{
+	return tcache.size_class_lookup[(len + sizeof(MemHead) + (SIZE_CLASS_STEP - 1)) / SIZE_CLASS_STEP];
+}
+
+/* Move the first \a count blocks of \a list to the shared list of the class. */
+static void free_list_splice_shared(FreeList *list, unsigned int index, unsigned int count)
+{
+	SharedFreeList *shared = &tcache.lists[index];
+	FreeBlock *first = list->first, *last = first;
+	unsigned int i;
+
+	for (i = 1; i < count; i++) {
+		last = last->next;
+	}
+	list->first = last->next;
+	list->count -= count;
+
+	pthread_mutex_lock(&shared->lock);
+	last->next = shared->list.first;
+	shared->list.first = first;
+	shared->list.count += count;
+	pthread_mutex_unlock(&shared->lock);
+}
+
+/* Fill the empty \a list with a batch of blocks, from the shared list or a new slab. */
+static bool free_list_refill(FreeList *list, unsigned int index)
+{
+	SharedFreeList *shared = &tcache.lists[index];
+	const unsigned int batch = tcache.batch_size[index];
+	const size_t size = size_class_sizes[index];
+	FreeBlock *first, *last;
+	unsigned int count = 1;
+	char *slab;
+	size_t i, slab_count;
+
+	pthread_mutex_lock(&shared->lock);
+	if (shared->list.first) {
+		first = last = shared->list.first;
+		while (count < batch && last->next) {
+			last = last->next;
+			count++;
+		}
+		shared->list.first = last->next;
+		shared->list.count -= count;
+		pthread_mutex_unlock(&shared->lock);
+
+		last->next = NULL;
+		list->first = first;
+		list->count = count;
+		return true;
+	}
+	pthread_mutex_unlock(&shared->lock);
+
+	slab = malloc(SLAB_SIZE);
+	if (UNLIKELY(slab == NULL)) {
+		return false;
+	}
+	atomic_add_and_fetch_z(&tcache.slab_mem, SLAB_SIZE);
+
+	/* Link all blocks of the slab, the first batch goes into the cache, the rest is shared. */
+	slab_count = SLAB_SIZE / size;
+	for (i = 0; i < slab_count - 1; i++) {
+		((FreeBlock *)(slab + i * size))->next = (FreeBlock *)(slab + (i + 1) * size);
+	}
+	((FreeBlock *)(slab + i * size))->next = NULL;
+
+	list->first = (FreeBlock *)slab;
+	list->count = (unsigned int)slab_count;
+	if (slab_count > batch) {
+		free_list_splice_shared(list, index, (unsigned int)slab_count - batch);
+	}
+	return true;
+}
+
+MEM_INLINE MemHead *small_alloc(ThreadCache *cache, size_t len)
+{
+	const unsigned int index = size_class_index(len);
+	FreeList *list = &cache->lists[index];
+	FreeBlock *block;
+
+	if (UNLIKELY(list->first == NULL)) {
+		if (!free_list_refill(list, index)) {
+			return NULL;
+		}
+	}
+
+	block = list->first;
+	list->first = block->next;
+	list->count--;
+
+	return (MemHead *)block;
+}
+
+MEM_INLINE void small_free(ThreadCache *cache, MemHead *memh, size_t len)
+{
+	const unsigned int index = size_class_index(len);
+	FreeList *list = &cache->lists[index];
+	FreeBlock *block = (FreeBlock *)memh;
+
+	block->next = list->first;
+	list->first = block;
+	list->count++;
+
+	/* Keep one batch for the following allocations, share the rest. */
+	if (UNLIKELY(list->count >= tcache.batch_size[index] * 2)) {
+		free_list_splice_shared(list, index, tcache.batch_size[index]);
+	}
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Allocator API
+ * \{ */
+
+void MEM_tcache_init(void)
+{
+	unsigned int index = 0, i;
+
+	if (tcache.batch_size[0] != 0) {
+		/* Already initialized. */
+		return;
+	}
+
+	for (i = 0; i <= SIZE_CLASS_MAX / SIZE_CLASS_STEP; i++) {
+		while (size_class_sizes[index] < i * SIZE_CLASS_STEP) {
+			index++;
+		}
+		tcache.size_class_lookup[i] = (unsigned char)index;
+	}
+
+	for (index = 0; index < NUM_SIZE_CLASSES; index++) {
+		unsigned int batch = BATCH_BYTES / size_class_sizes[index];
+		tcache.batch_size[index] = batch < 4 ? 4 : (batch > 256 ? 256 : batch);
+	}
+
+	pthread_mutex_init(&tcache.lock, NULL);
+	for (index = 0; index < NUM_SIZE_CLASSES; index++) {
+		pthread_mutex_init(&tcache.lists[index].lock, NULL);
+	}
+	pthread_key_create(&tcache.cache_key, thread_cache_exit);
+}
+
+size_t MEM_tcache_allocN_len(const void *vmemh)
+{
+	if (vmemh) {
+		return MEMHEAD_FROM_PTR(vmemh)->len & ~((size_t) (MEMHEAD_MMAP_FLAG | MEMHEAD_ALIGN_FLAG) | MEMHEAD_DOMAIN_MASK);
+	}
+	else {
+		return 0;
+	}
+}
+
+void MEM_tcache_freeN(void *vmemh)
+{
+	MemHead *memh = MEMHEAD_FROM_PTR(vmemh);
+	size_t len = MEM_tcache_allocN_len(vmemh);
+	ThreadCache *cache;
+
+	if (vmemh == NULL) {
+		print_error("Attempt to free NULL pointer\n");
+#ifdef WITH_ASSERT_ABORT
+		abort();
+#endif
+		return;
+	}
+
+	cache = thread_cache_get();
+	cache->totblock--;
+	cache->mem_in_use -= len;
+	mem_domain_sub(MEMHEAD_LEN_DOMAIN(memh->len), len);
+
+	if (MEMHEAD_IS_MMAP(memh)) {
+		cache->mmap_in_use -= len;
+#if defined(WIN32)
+		/* our windows mmap implementation is not thread safe */
+		mem_lock_thread();
+#endif
+		if (munmap(memh, len + sizeof(MemHead)))
+			printf("Couldn't unmap memory\n");
+#if defined(WIN32)
+		mem_unlock_thread();
+#endif
+	}
+	else {
+		if (UNLIKELY(malloc_debug_memset && len)) {
+			memset(memh + 1, 255, len);
+		}
+		if (UNLIKELY(MEMHEAD_IS_ALIGNED(memh))) {
+			MemHeadAligned *memh_aligned = MEMHEAD_ALIGNED_FROM_PTR(vmemh);
+			aligned_free(MEMHEAD_REAL_PTR(memh_aligned));
+		}
+		else if (LIKELY(len <= SIZE_CLASS_MAX_LEN)) {
+			small_free(cache, memh, len);
+		}
+		else {
+			free(memh);
+		}
+	}
+}
+
+void *MEM_tcache_dupallocN(const void *vmemh)
+{
+	void *newp = NULL;
+	if (vmemh) {
+		MemHead *memh = MEMHEAD_FROM_PTR(vmemh);
+		const size_t prev_size = MEM_tcache_allocN_len(vmemh);
+		if (UNLIKELY(MEMHEAD_IS_MMAP(memh))) {
+			newp = MEM_tcache_mapallocN(prev_size, "dupli_mapalloc");
+		}
+		else if (UNLIKELY(MEMHEAD_IS_ALIGNED(memh))) {
+			MemHeadAligned *memh_aligned = MEMHEAD_ALIGNED_FROM_PTR(vmemh);
+			newp = MEM_tcache_mallocN_aligned(
+				prev_size,
+				(size_t)memh_aligned->alignment,
+				"dupli_malloc");
+		}
+		else {
+			newp = MEM_tcache_mallocN(prev_size, "dupli_malloc");
+		}
+		memcpy(newp, vmemh, prev_size);
+	}
+	return newp;
+}
+
+void *MEM_tcache_reallocN_id(void *vmemh, size_t len, const char *str)
+{
+	void *newp = NULL;
+
+	if (vmemh) {
+		MemHead *memh = MEMHEAD_FROM_PTR(vmemh);
+		size_t old_len = MEM_tcache_allocN_len(vmemh);
+
+		if (LIKELY(!MEMHEAD_IS_ALIGNED(memh))) {
+			newp = MEM_tcache_mallocN(len, "realloc");
+		}
+		else {
+			MemHeadAligned *memh_aligned = MEMHEAD_ALIGNED_FROM_PTR(vmemh);
+			newp = MEM_tcache_mallocN_aligned(
+			        len,
+			        (size_t)memh_aligned->alignment,
+			        "realloc");
+		}
+
+		if (newp) {
+			MEM_tcache_set_block_domain(newp, MEMHEAD_LEN_DOMAIN(memh->len));
+
+			if (len < old_len) {
+				/* shrink */
+				memcpy(newp, vmemh, len);
+			}
+			else {
+				/* grow (or remain same size) */
+				memcpy(newp, vmemh, old_len);
+			}
+		}
+
+		MEM_tcache_freeN(vmemh);
+	}
+	else {
+		newp = MEM_tcache_mallocN(len, str);
+	}
+
+	return newp;
+}
+
+void *MEM_tcache_recallocN_id(void *vmemh, size_t len, const char *str)
+{
+	void *newp = NULL;
+
+	if (vmemh) {
+		MemHead *memh = MEMHEAD_FROM_PTR(vmemh);
+		size_t old_len = MEM_tcache_allocN_len(vmemh);
+
+		if (LIKELY(!MEMHEAD_IS_ALIGNED(memh))) {
+			newp = MEM_tcache_mallocN(len, "recalloc");
+		}
+		else {
+			MemHeadAligned *memh_aligned = MEMHEAD_ALIGNED_FROM_PTR(vmemh);
+			newp = MEM_tcache_mallocN_aligned(
+			        len,
+			        (size_t)memh_aligned->alignment,
+			        "recalloc");
+		}
+
+		if (newp) {
+			MEM_tcache_set_block_domain(newp, MEMHEAD_LEN_DOMAIN(memh->len));
+
+			if (len < old_len) {
+				/* shrink */
+				memcpy(newp, vmemh, len);
+			}
+			else {
+				memcpy(newp, vmemh, old_len);
+
+				if (len > old_len) {
+					/* grow */
+					/* zero new bytes */
+					memset(((char *)newp) + old_len, 0, len - old_len);
+				}
+			}
+		}
+
+		MEM_tcache_freeN(vmemh);
+	}
+	else {
+		newp = MEM_tcache_callocN(len, str);
+	}
+
+	return newp;
+}
+
+void *MEM_tcache_callocN(size_t len, const char *str)
+{
+	ThreadCache *cache = thread_cache_get();
+	MemHead *memh;
+
+	len = SIZET_ALIGN_4(len);
+
+	if (LIKELY(len <= SIZE_CLASS_MAX_LEN)) {
+		memh = small_alloc(cache, len);
+		if (LIKELY(memh)) {
+			memset(memh + 1, 0, len);
+		}
+	}
+	else {
+		memh = (MemHead *)calloc(1, len + sizeof(MemHead));
+	}
+
+	if (LIKELY(memh)) {
+		memh->len = memhead_len_with_domain(len, len);
+		cache->totblock++;
+		cache->mem_in_use += len;
+
+		return PTR_FROM_MEMHEAD(memh);
+	}
+	print_error("Calloc returns null: len=" SIZET_FORMAT " in %s, total %u\n",
+	            SIZET_ARG(len), str, (unsigned int) MEM_tcache_get_memory_in_use());
+	return NULL;
+}
+
+void *MEM_tcache_calloc_arrayN(size_t len, size_t size, const char *str)
+{
+	size_t total_size;
+	if (UNLIKELY(!MEM_size_safe_multiply(len, size, &total_size))) {
+		print_error("Calloc array aborted due to integer overflow: "
+		            "len=" SIZET_FORMAT "x" SIZET_FORMAT " in %s, total %u\n",
+		            SIZET_ARG(len), SIZET_ARG(size), str,
+		            (unsigned int) MEM_tcache_get_memory_in_use());
+		abort();
+		return NULL;
+	}
+
+	return MEM_tcache_callocN(total_size, str);
+}
+
+void *MEM_tcache_mallocN(size_t len, const char *str)
+{
+	ThreadCache *cache = thread_cache_get();
+	MemHead *memh;
+
+	len = SIZET_ALIGN_4(len);
+
+	if (LIKELY(len <= SIZE_CLASS_MAX_LEN)) {
+		memh = small_alloc(cache, len);
+	}
+	else {
+		memh = (MemHead *)malloc(len + sizeof(MemHead));
+	}
+
+	if (LIKELY(memh)) {
+		if (UNLIKELY(malloc_debug_memset && len)) {
+			memset(memh + 1, 255, len);
+		}
+
+		memh->len = memhead_len_with_domain(len, len);
+		cache->totblock++;
+		cache->mem_in_use += len;
+
+		return PTR_FROM_MEMHEAD(memh);
+	}
+	print_error("Malloc returns null: len=" SIZET_FORMAT " in %s, total %u\n",
+	            SIZET_ARG(len), str, (unsigned int) MEM_tcache_get_memory_in_use());
+	return NULL;
+}
+
+void *MEM_tcache_malloc_arrayN(size_t len, size_t size, const char *str)
+{
+	size_t total_size;
+	if (UNLIKELY(!MEM_size_safe_multiply(len, size, &total_size))) {
+		print_error("Malloc array aborted due to integer overflow: "
+		            "len=" SIZET_FORMAT "x" SIZET_FORMAT " in %s, total %u\n",
+		            SIZET_ARG(len), SIZET_ARG(size), str,
+		            (unsigned int) MEM_tcache_get_memory_in_use());
+		abort();
+		return NULL;
+	}
+
+	return MEM_tcache_mallocN(total_size, str);
+}
+
+void *MEM_tcache_mallocN_aligned(size_t len, size_t alignment, const char *str)
+{
+	MemHeadAligned *memh;
+
+	/* Aligned blocks don't use the size classes, see MEM_lockfree_mallocN_aligned. */
+	size_t extra_padding = MEMHEAD_ALIGN_PADDING(alignment);
+
+	assert(alignment < 1024);
+	assert(IS_POW2(alignment));
+
+	len = SIZET_ALIGN_4(len);
+
+	memh = (MemHeadAligned *)aligned_malloc(
+		len + extra_padding + sizeof(MemHeadAligned), alignment);
+
+	if (LIKELY(memh)) {
+		ThreadCache *cache = thread_cache_get();
+
+		memh = (MemHeadAligned *)((char *)memh + extra_padding);
+
+		if (UNLIKELY(malloc_debug_memset && len)) {
+			memset(memh + 1, 255, len);
+		}
+
+		memh->len = memhead_len_with_domain(len | (size_t) MEMHEAD_ALIGN_FLAG, len);
+		memh->alignment = (short) alignment;
+		cache->totblock++;
+		cache->mem_in_use += len;
+
+		return PTR_FROM_MEMHEAD(memh);
+	}
+	print_error("Malloc returns null: len=" SIZET_FORMAT " in %s, total %u\n",
+	            SIZET_ARG(len), str, (unsigned int) MEM_tcache_get_memory_in_use());
+	return NULL;
+}
+
+void *MEM_tcache_mapallocN(size_t len, const char *str)
+{
+	MemHead *memh;
+
+	/* on 64 bit, simply use calloc instead, as mmap does not support
+	 * allocating > 4 GB on Windows. the only reason mapalloc exists
+	 * is to get around address space limitations in 32 bit OSes. */
+	if (sizeof(void *) >= 8)
+		return MEM_tcache_callocN(len, str);
+
+	len = SIZET_ALIGN_4(len);
+
+#if defined(WIN32)
+	/* our windows mmap implementation is not thread safe */
+	mem_lock_thread();
+#endif
+	memh = mmap(NULL, len + sizeof(MemHead),
+	            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
+#if defined(WIN32)
+	mem_unlock_thread();
+#endif
+
+	if (memh != (MemHead *)-1) {
+		ThreadCache *cache = thread_cache_get();
+
+		memh->len = memhead_len_with_domain(len | (size_t) MEMHEAD_MMAP_FLAG, len);
+		cache->totblock++;
+		cache->mem_in_use += len;
+		cache->mmap_in_use += len;
+
+		return PTR_FROM_MEMHEAD(memh);
+	}
+	print_error("Mapalloc returns null, fallback to regular malloc: "
+	            "len=" SIZET_FORMAT " in %s\n",
+	            SIZET_ARG(len), str);
+	return MEM_tcache_callocN(len, str);
+}
+
+void MEM_tcache_printmemlist_pydict(void)
+{
+}
+
+void MEM_tcache_printmemlist(void)
+{
+}
+
+/* unused */
+void MEM_tcache_callbackmemlist(void (*func)(void *))
+{
+	(void) func;  /* Ignored. */
+}
+
+void MEM_tcache_printmemlist_stats(void)
+{
+	size_t mem_in_use;
+	thread_cache_totals(&mem_in_use, NULL, NULL);
+
+	printf("\ntotal memory len: %.3f MB\n",
+	       (double)mem_in_use / (double)(1024 * 1024));
+	printf("peak memory len: %.3f MB\n",
+	       (double)tcache.peak_mem / (double)(1024 * 1024));
+	printf("size class slabs: %.3f MB\n",
+	       (double)tcache.slab_mem / (double)(1024 * 1024));
+	mem_domain_print_stats();
+	printf("\nFor more detailed per-block statistics run Blender with memory debugging command line argument.\n");
+
+#ifdef HAVE_MALLOC_STATS
+	printf("System Statistics:\n");
+	malloc_stats();
+#endif
+}
+
+void MEM_tcache_set_error_callback(void (*func)(const char *))
+{
+	error_callback = func;
+}
+
+bool MEM_tcache_consistency_check(void)
+{
+	return true;
+}
+
+void MEM_tcache_set_lock_callback(void (*lock)(void), void (*unlock)(void))
+{
+	thread_lock_callback = lock;
+	thread_unlock_callback = unlock;
+}
+
+void MEM_tcache_set_memory_debug(void)
+{
+	malloc_debug_memset = true;
+}
+
+size_t MEM_tcache_get_memory_in_use(void)
+{
+	size_t mem_in_use;
+	thread_cache_totals(&mem_in_use, NULL, NULL);
+	return mem_in_use;
+}
+
+size_t MEM_tcache_get_mapped_memory_in_use(void)
+{
+	size_t mmap_in_use;
+	thread_cache_totals(NULL, &mmap_in_use, NULL);
+	return mmap_in_use;
+}
+
+unsigned int MEM_tcache_get_memory_blocks_in_use(void)
+{
+	unsigned int totblock;
+	thread_cache_totals(NULL, NULL, &totblock);
+	return totblock;
+}
+
+void MEM_tcache_reset_peak_memory(void)
+{
+	size_t mem_in_use;
+	thread_cache_totals(&mem_in_use, NULL, NULL);
+	tcache.peak_mem = mem_in_use;
+}
+
+size_t MEM_tcache_get_peak_memory(void)
+{
+	thread_cache_totals(NULL, NULL, NULL);
+	return tcache.peak_mem;
+}
+
+void MEM_tcache_set_block_domain(void *vmemh, int domain)
+{
+#ifdef MEMHEAD_DOMAIN_SHIFT
+	MemHead *memh = MEMHEAD_FROM_PTR(vmemh);
+	const int domain_prev = MEMHEAD_LEN_DOMAIN(memh->len);
+
+	if (domain != domain_prev) {
+		const size_t len = MEM_tcache_allocN_len(vmemh);
+		mem_domain_sub(domain_prev, len);
+		mem_domain_add(domain, len);
+		memh->len = MEMHEAD_LEN_SET_DOMAIN(memh->len, domain);
+	}
+#else
+	(void) vmemh;  /* Ignored. */
+	(void) domain;  /* Ignored. */
+#endif
+}
+
+#ifndef NDEBUG
+const char *MEM_tcache_name_ptr(void *vmemh)
+{
+	if (vmemh) {
+		return "unknown block name ptr";
+	}
+	else {
+		return "MEM_tcache_name_ptr(NULL)";
+	}
+}
+#endif  /* NDEBUG */
+
+/** \} */
@@ -184,7 +184,10 @@ public:
 	}
 
 	void enforce_limits() {
-		size_t max = MEM_CacheLimiter_get_maximum();
+		enforce_limits(MEM_CacheLimiter_get_maximum());
+	}
+
+	void enforce_limits(size_t max) {
 		bool is_disabled = MEM_CacheLimiter_is_disabled();
 		size_t mem_in_use, cur_size;
 
@@ -95,6 +95,16 @@ MEM_CacheLimiterHandleC *MEM_CacheLimiter_insert(MEM_CacheLimiterC *This, void *
 
 void MEM_CacheLimiter_enforce_limits(MEM_CacheLimiterC *This);
 
+/**
+ * Free objects until the memory used by the cache is below \a max,
+ * instead of the global maximum.
+ *
+ * \param This "This" pointer
+ * \param max  Maximum memory in bytes, zero for no limit
+ */
+
+void MEM_CacheLimiter_enforce_limits_ex(MEM_CacheLimiterC *This, size_t max);
+
 /**
  * Unmanage object previously inserted object.
  * Does _not_ delete managed object!
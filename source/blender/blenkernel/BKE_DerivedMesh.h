@@ -740,6 +740,7 @@ bool editbmesh_modifier_is_enabled(struct Scene *scene, struct ModifierData *md,
 void makeDerivedMesh(
         struct Scene *scene, struct Object *ob, struct BMEditMesh *em,
         CustomDataMask dataMask, const bool build_shapekey_layers);
+void mesh_free_modifier_stack_cache(struct Object *ob);
 
 void weight_to_rgb(float r_rgb[3], const float weight);
 /** Update the weight MCOL preview layer.
@@ -144,6 +144,7 @@ enum {
 	G_DEBUG_GPU =       (1 << 16), /* gpu debug */
 	G_DEBUG_IO = (1 << 17),   /* IO Debugging (for Collada, ...)*/
 	G_DEBUG_GPU_SHADERS = (1 << 18),   /* GLSL shaders */
+	G_DEBUG_DEPSGRAPH_NO_INCREMENTAL = (1 << 19),  /* always rebuild the whole depsgraph */
 };
 
 #define G_DEBUG_ALL  (G_DEBUG | G_DEBUG_FFMPEG | G_DEBUG_PYTHON | G_DEBUG_EVENTS | G_DEBUG_WM | G_DEBUG_JOBS | \
@@ -194,6 +195,11 @@ enum {
 /* On write, restore paths after editing them (G_FILE_RELATIVE_REMAP) */
 #define G_FILE_SAVE_COPY         (1 << 27)
 #define G_FILE_GLSL_NO_ENV_LIGHTING (1 << 28)
+/* With G_FILE_COMPRESS, compress independent frames in parallel, see BLEND_FRAMES_MAGIC */
+#define G_FILE_COMPRESS_FRAMES   (1 << 29)
+/* Write key blocks which move few elements as sparse (index, coordinate) pairs,
+ * see KEYBLOCK_SPARSE. Older versions can't read these key blocks. */
+#define G_FILE_SPARSE_KEYS       (1 << 30)
 
 #define G_FILE_FLAGS_RUNTIME (G_FILE_NO_UI | G_FILE_RELATIVE_REMAP | G_FILE_SAVE_COPY)
 
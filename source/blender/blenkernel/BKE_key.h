@@ -91,6 +91,17 @@ void BKE_keyblock_free_per_block_weights(struct Key *key, float **per_keyblock_w
 void BKE_key_evaluate_relative(const int start, int end, const int tot, char *basispoin, struct Key *key, struct KeyBlock *actkb,
                                float **per_keyblock_weights, const int mode);
 
+/* sparse key blocks, see KEYBLOCK_SPARSE */
+typedef struct KeyBlockSparseElem {
+	int index;
+	float co[3];
+} KeyBlockSparseElem;
+
+struct KeyBlockSparseElem *BKE_keyblock_sparse_pack(const struct Key *key, const struct KeyBlock *kb, int *r_totsparse);
+void    BKE_keyblock_sparse_unpack(struct Key *key, struct KeyBlock *kb);
+void    BKE_keyblock_sparse_free(struct KeyBlock *kb);
+void    BKE_key_sparse_free(struct Key *key);
+
 /* conversion functions */
 /* Note: 'update_from' versions do not (re)allocate mem in kb, while 'convert_from' do. */
 void    BKE_keyblock_update_from_lattice(struct Lattice *lt, struct KeyBlock *kb);
@@ -70,10 +70,14 @@ void curve_deform_vector(struct Scene *scene, struct Object *cuOb, struct Object
 void lattice_deform_verts(struct Object *laOb, struct Object *target,
                           struct DerivedMesh *dm, float (*vertexCos)[3],
                           int numVerts, const char *vgroup, float influence);
+
+struct ArmatureDeformCache;
 void armature_deform_verts(struct Object *armOb, struct Object *target,
                            struct DerivedMesh *dm, float (*vertexCos)[3],
                            float (*defMats)[3][3], int numVerts, int deformflag,
-                           float (*prevCos)[3], const char *defgrp_name);
+                           float (*prevCos)[3], const char *defgrp_name,
+                           struct ArmatureDeformCache **cache);
+void armature_deform_cache_free(struct ArmatureDeformCache *cache);
 
 float (*BKE_lattice_vertexcos_get(struct Object *ob, int *r_numVerts))[3];
 void    BKE_lattice_vertexcos_apply(struct Object *ob, float (*vertexCos)[3]);
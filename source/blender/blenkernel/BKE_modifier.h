@@ -103,6 +103,17 @@ typedef enum {
 	/* For modifiers that use CD_PREVIEW_MCOL for preview. */
 	eModifierTypeFlag_UsesPreview = (1 << 9),
 	eModifierTypeFlag_AcceptsLattice = (1 << 10),
+
+	/* For modifiers whose result depends on more than their settings, the mesh and
+	 * the IDs they link to, e.g. on the object transform, shape keys or particles.
+	 * Their result is never reused from the modifier stack cache.
+	 */
+	eModifierTypeFlag_UsesImplicitInputs = (1 << 11),
+
+	/* For modifiers which evaluate in parallel on their own, used to balance the
+	 * evaluation of objects across threads.
+	 */
+	eModifierTypeFlag_UsesThreads = (1 << 12),
 } ModifierTypeFlag;
 
 /* IMPORTANT! Keep ObjectWalkFunc and IDWalkFunc signatures compatible. */
@@ -355,6 +366,7 @@ void          modifier_copyData_generic(const struct ModifierData *md, struct Mo
 void          modifier_copyData(struct ModifierData *md, struct ModifierData *target);
 void          modifier_copyData_ex(struct ModifierData *md, struct ModifierData *target, const int flag);
 bool          modifier_dependsOnTime(struct ModifierData *md);
+bool          modifier_isStatic(struct Object *ob, struct ModifierData *md);
 bool          modifier_supportsMapping(struct ModifierData *md);
 bool          modifier_supportsCage(struct Scene *scene, struct ModifierData *md);
 bool          modifier_couldBeCage(struct Scene *scene, struct ModifierData *md);
@@ -393,6 +405,7 @@ bool          modifiers_usesArmature(struct Object *ob, struct bArmature *arm);
 bool          modifiers_isCorrectableDeformed(struct Scene *scene, struct Object *ob);
 void          modifier_freeTemporaryData(struct ModifierData *md);
 bool          modifiers_isPreview(struct Object *ob);
+float         modifiers_getThreadedFraction(struct Scene *scene, struct Object *ob);
 
 typedef struct CDMaskLink {
 	struct CDMaskLink *next;
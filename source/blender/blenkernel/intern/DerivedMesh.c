@@ -42,10 +42,13 @@
 #include "DNA_meshdata_types.h"
 #include "DNA_object_types.h"
 #include "DNA_scene_types.h"
+#include "DNA_sdna_types.h"
+#include "DNA_genfile.h"
 
 #include "BLI_array.h"
 #include "BLI_blenlib.h"
 #include "BLI_bitmap.h"
+#include "BLI_ghash.h"
 #include "BLI_math.h"
 #include "BLI_utildefines.h"
 #include "BLI_linklist.h"
@@ -869,6 +872,7 @@ void DM_to_meshkey(DerivedMesh *dm, Mesh *me, KeyBlock *kb)
 		return;
 	}
 
+	BKE_keyblock_sparse_free(kb);
 	if (kb->data) MEM_freeN(kb->data);
 	kb->data = MEM_malloc_arrayN(me->key->elemsize, me->totvert, "kb->data");
 	kb->totelem = totvert;
@@ -1652,6 +1656,7 @@ static void shapekey_layers_to_keyblocks(DerivedMesh *dm, Mesh *me, int actshape
 			kb->uid = layer->uid;
 		}
 
+		BKE_keyblock_sparse_free(kb);
 		if (kb->data)
 			MEM_freeN(kb->data);
 
@@ -1675,6 +1680,7 @@ static void shapekey_layers_to_keyblocks(DerivedMesh *dm, Mesh *me, int actshape
 
 	for (kb = me->key->block.first; kb; kb = kb->next) {
 		if (kb->totelem != dm->numVertData) {
+			BKE_keyblock_sparse_free(kb);
 			if (kb->data)
 				MEM_freeN(kb->data);
 
@@ -1744,6 +1750,283 @@ static void dm_ensure_display_normals(DerivedMesh *dm)
 	}
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Modifier Stack Cache
+ *
+ * Keeps a copy of the result of the longest leading part of the modifier stack made of
+ * static modifiers (see #modifier_isStatic), so when only modifiers further down the stack
+ * change, like an animated modifier after an expensive subdivision, evaluation restarts there.
+ *
+ * The copies are allocated in #MEM_DOMAIN_MODIFIER_CACHE, results are only kept while that
+ * domain is within its budget, and nothing is cached when the budget is zero.
+ * \{ */
+
+/* Evaluation state the cached result depends on, besides the modifiers. */
+typedef struct ModifierStackCacheKey {
+	Scene *scene;
+	Mesh *mesh;
+	CustomDataMask data_mask;
+	int app_flags;
+	int need_mapping, build_shapekey_layers;
+	/* Scene simplification limits subdivision levels, -1 when disabled. */
+	int simplify_subsurf;
+	int object_mode, object_totcol;
+	/* Modifiers refer to vertex groups by name. */
+	unsigned int defbase_hash;
+} ModifierStackCacheKey;
+
+typedef struct ModifierStackCache {
+	ModifierStackCacheKey key;
+
+	/* Number of modifiers (including virtual ones) the result was computed with. */
+	int modifiers_num;
+	/* Settings of these modifiers and the data masks they were evaluated with. */
+	char *settings;
+	size_t settings_len;
+
+	/* Evaluation state after the last cached modifier. */
+	DerivedMesh *dm, *orcodm, *clothorcodm;
+	CustomDataMask append_mask;
+	/* Coordinates after the leading deforming modifiers, NULL when there are none. */
+	float (*deform_cos)[3];
+} ModifierStackCache;
+
+static void stack_cache_key_init(
+        ModifierStackCacheKey *key, Scene *scene, Object *ob, CustomDataMask data_mask,
+        ModifierApplyFlag app_flags, const bool need_mapping, const bool build_shapekey_layers)
+{
+	bDeformGroup *dg;
+
+	/* Compared with memcmp, including padding. */
+	memset(key, 0, sizeof(*key));
+
+	key->scene = scene;
+	key->mesh = ob->data;
+	key->data_mask = data_mask;
+	key->app_flags = (int)app_flags;
+	key->need_mapping = need_mapping;
+	key->build_shapekey_layers = build_shapekey_layers;
+	key->simplify_subsurf = (scene->r.mode & R_SIMPLIFY) ? scene->r.simplify_subsurf : -1;
+	key->object_mode = ob->mode;
+	key->object_totcol = ob->totcol;
+
+	for (dg = ob->defbase.first; dg; dg = dg->next) {
+		key->defbase_hash = key->defbase_hash * 37 + BLI_ghashutil_strhash_p(dg->name);
+	}
+}
+
+/**
+ * Write the members of the DNA struct \a struct_nr at \a data which aren't pointers to
+ * \a r_settings (when not NULL), skipping the first \a skip_members. Pointers are left out
+ * since runtime and bind data can change behind an unchanged pointer. Returns the size written.
+ */
+static size_t stack_cache_struct_settings_get(
+        const SDNA *sdna, const int struct_nr, const int skip_members, const char *data, char *r_settings)
+{
+	const short *sp = sdna->structs[struct_nr];
+	const int members_num = sp[1];
+	size_t len = 0;
+	int i;
+
+	for (i = 0, sp += 2; i < members_num; i++, sp += 2) {
+		const char *name = sdna->names[sp[1]];
+		const int array_len = (name[strlen(name) - 1] == ']') ? DNA_elem_array_size(name) : 1;
+		const bool is_pointer = (name[0] == '*' || (name[0] == '(' && name[1] == '*'));
+		const size_t elem_len = is_pointer ? (size_t)sdna->pointerlen : (size_t)sdna->typelens[sp[0]];
+
+		if (i >= skip_members && !is_pointer) {
+			const int member_struct_nr = DNA_struct_find_nr(sdna, sdna->types[sp[0]]);
+			int a;
+
+			if (member_struct_nr != -1) {
+				/* Nested structs may hold pointers too. */
+				for (a = 0; a < array_len; a++) {
+					len += stack_cache_struct_settings_get(
+					        sdna, member_struct_nr, 0, data + elem_len * a, r_settings ? r_settings + len : NULL);
+				}
+			}
+			else {
+				if (r_settings) {
+					memcpy(r_settings + len, data, elem_len * array_len);
+				}
+				len += elem_len * array_len;
+			}
+		}
+
+		data += elem_len * array_len;
+	}
+
+	return len;
+}
+
+/**
+ * Write the settings of \a modifiers_num modifiers starting at \a md, with the data masks
+ * they are evaluated with, to \a r_settings (when not NULL). Returns the size of the settings.
+ */
+static size_t stack_cache_settings_get(
+        ModifierData *md, CDMaskLink *curr, const int modifiers_num, char *r_settings)
+{
+	const SDNA *sdna = DNA_sdna_current_get();
+	size_t len = 0;
+	int i;
+
+	for (i = 0; i < modifiers_num; i++, md = md->next, curr = curr->next) {
+		const ModifierTypeInfo *mti = modifierType_getInfo(md->type);
+		const int header[2] = {md->type, md->mode};
+		/* The mask of the next modifier decides which layers are created for it. */
+		const CustomDataMask masks[2] = {curr->mask, curr->next ? curr->next->mask : 0};
+		const int struct_nr = DNA_struct_find_nr(sdna, mti->structName);
+
+		BLI_assert(struct_nr != -1);
+
+		if (r_settings) {
+			memcpy(r_settings + len, header, sizeof(header));
+			memcpy(r_settings + len + sizeof(header), masks, sizeof(masks));
+		}
+		len += sizeof(header) + sizeof(masks);
+
+		/* Skip the common modifier data (list links, name, scene and error),
+		 * always the first member. */
+		len += stack_cache_struct_settings_get(
+		        sdna, struct_nr, 1, (const char *)md, r_settings ? r_settings + len : NULL);
+	}
+
+	return len;
+}
+
+/**
+ * Find the modifier to cache the result of: the last constructive one before
+ * the first enabled modifier which isn't static.
+ *
+ * \return the number of modifiers before the first enabled one which isn't static.
+ */
+static int stack_cache_point_find(
+        Scene *scene, Object *ob, ModifierData *md, const int required_mode,
+        ModifierData **r_md, int *r_md_num)
+{
+	int num = 0;
+
+	*r_md = NULL;
+	*r_md_num = 0;
+
+	for (; md; md = md->next, num++) {
+		const ModifierTypeInfo *mti = modifierType_getInfo(md->type);
+
+		if (!modifier_isEnabled(scene, md, required_mode)) {
+			continue;
+		}
+
+		if (!modifier_isStatic(ob, md)) {
+			return num;
+		}
+
+		if (mti->type != eModifierTypeType_OnlyDeform) {
+			*r_md = md;
+			*r_md_num = num + 1;
+		}
+	}
+
+	/* Nothing to cache when the whole stack is static,
+	 * it only gets evaluated again when its result changes. */
+	*r_md = NULL;
+	*r_md_num = 0;
+
+	return num;
+}
+
+static bool stack_cache_is_valid(
+        const ModifierStackCache *cache, const ModifierStackCacheKey *key,
+        ModifierData *firstmd, CDMaskLink *datamasks, const int static_num)
+{
+	char *settings;
+	bool is_valid;
+
+	if ((cache->modifiers_num > static_num) ||
+	    (memcmp(&cache->key, key, sizeof(*key)) != 0) ||
+	    (stack_cache_settings_get(firstmd, datamasks, cache->modifiers_num, NULL) != cache->settings_len))
+	{
+		return false;
+	}
+
+	settings = MEM_mallocN(cache->settings_len, __func__);
+	stack_cache_settings_get(firstmd, datamasks, cache->modifiers_num, settings);
+	is_valid = (memcmp(settings, cache->settings, cache->settings_len) == 0);
+	MEM_freeN(settings);
+
+	return is_valid;
+}
+
+static void stack_cache_store(
+        Object *ob, const ModifierStackCacheKey *key, ModifierData *firstmd, CDMaskLink *datamasks,
+        const int modifiers_num, DerivedMesh *dm, DerivedMesh *orcodm, DerivedMesh *clothorcodm,
+        CustomDataMask append_mask, DerivedMesh *deformdm)
+{
+	ModifierStackCache *cache;
+	ModifierData *md;
+	int i, domain_prev;
+
+	/* Errors would get lost for modifiers skipped when using the cache. */
+	for (md = firstmd, i = 0; i < modifiers_num; md = md->next, i++) {
+		if (md->error) {
+			return;
+		}
+	}
+
+	mesh_free_modifier_stack_cache(ob);
+
+	domain_prev = MEM_domain_thread_set(MEM_DOMAIN_MODIFIER_CACHE);
+
+	cache = MEM_callocN(sizeof(*cache), "ModifierStackCache");
+	cache->key = *key;
+	cache->modifiers_num = modifiers_num;
+	cache->settings_len = stack_cache_settings_get(firstmd, datamasks, modifiers_num, NULL);
+	cache->settings = MEM_mallocN(cache->settings_len, "ModifierStackCache settings");
+	stack_cache_settings_get(firstmd, datamasks, modifiers_num, cache->settings);
+
+	cache->dm = CDDM_copy(dm);
+	cache->orcodm = orcodm ? CDDM_copy(orcodm) : NULL;
+	cache->clothorcodm = clothorcodm ? CDDM_copy(clothorcodm) : NULL;
+	cache->append_mask = append_mask;
+
+	if (deformdm) {
+		cache->deform_cos = MEM_malloc_arrayN(
+		        (size_t)deformdm->getNumVerts(deformdm), sizeof(*cache->deform_cos), "ModifierStackCache cos");
+		deformdm->getVertCos(deformdm, cache->deform_cos);
+	}
+
+	MEM_domain_thread_set(domain_prev);
+
+	ob->modifier_stack_cache = cache;
+
+	if (MEM_domain_is_over_budget(MEM_DOMAIN_MODIFIER_CACHE)) {
+		mesh_free_modifier_stack_cache(ob);
+	}
+}
+
+void mesh_free_modifier_stack_cache(Object *ob)
+{
+	ModifierStackCache *cache = ob->modifier_stack_cache;
+
+	if (cache == NULL) {
+		return;
+	}
+
+	cache->dm->release(cache->dm);
+	if (cache->orcodm) {
+		cache->orcodm->release(cache->orcodm);
+	}
+	if (cache->clothorcodm) {
+		cache->clothorcodm->release(cache->clothorcodm);
+	}
+	MEM_SAFE_FREE(cache->deform_cos);
+	MEM_freeN(cache->settings);
+	MEM_freeN(cache);
+
+	ob->modifier_stack_cache = NULL;
+}
+
+/** \} */
+
 /**
  * new value for useDeform -1  (hack for the gameengine):
  *
@@ -1796,6 +2079,15 @@ static void mesh_calc_modifiers(
 	ModifierApplyFlag app_flags = useRenderParams ? MOD_APPLY_RENDER : 0;
 	ModifierApplyFlag deform_app_flags = app_flags;
 
+	/* Restart from the cached result of the static modifiers, see #ModifierStackCache. */
+	const bool use_stack_cache = (useCache && r_deform && !useRenderParams && (useDeform > 0) && (index == -1) &&
+	                              !inputVertexCos && !sculpt_mode && !do_init_wmcol &&
+	                              (MEM_domain_get_budget(MEM_DOMAIN_MODIFIER_CACHE) != 0));
+	ModifierStackCache *stack_cache = NULL;
+	ModifierStackCacheKey stack_cache_key;
+	ModifierData *stack_cache_md = NULL;
+	int stack_cache_md_num = 0;
+	bool has_leading_deform = false;
 
 	if (useCache)
 		app_flags |= MOD_APPLY_USECACHE;
@@ -1841,12 +2133,39 @@ static void mesh_calc_modifiers(
 	}
 	*r_final = NULL;
 
+	/* Sculpting changes the mesh in place without tagging it, a cache kept meanwhile
+	 * would be outdated once the object leaves sculpt mode. */
+	if (sculpt_mode && ob->modifier_stack_cache) {
+		mesh_free_modifier_stack_cache(ob);
+	}
+
+	if (use_stack_cache) {
+		const int static_num = stack_cache_point_find(
+		        scene, ob, firstmd, required_mode, &stack_cache_md, &stack_cache_md_num);
+
+		stack_cache_key_init(&stack_cache_key, scene, ob, dataMask, app_flags, need_mapping, build_shapekey_layers);
+
+		if (ob->modifier_stack_cache) {
+			if (((me->id.recalc & ID_RECALC_ALL) == 0) &&
+			    stack_cache_is_valid(ob->modifier_stack_cache, &stack_cache_key, firstmd, datamasks, static_num))
+			{
+				stack_cache = ob->modifier_stack_cache;
+				if (stack_cache_md_num <= stack_cache->modifiers_num) {
+					stack_cache_md = NULL;
+				}
+			}
+			else {
+				mesh_free_modifier_stack_cache(ob);
+			}
+		}
+	}
+
 	if (useDeform) {
 		if (inputVertexCos)
 			deformedVerts = inputVertexCos;
 
-		/* Apply all leading deforming modifiers */
-		for (; md; md = md->next, curr = curr->next) {
+		/* Apply all leading deforming modifiers, unless they are part of the cached result. */
+		for (; md && !stack_cache; md = md->next, curr = curr->next) {
 			const ModifierTypeInfo *mti = modifierType_getInfo(md->type);
 
 			md->scene = scene;
@@ -1887,7 +2206,12 @@ static void mesh_calc_modifiers(
 			if (deformedVerts) {
 				CDDM_apply_vert_coords(*r_deform, deformedVerts);
 			}
+			else if (stack_cache && stack_cache->deform_cos) {
+				CDDM_apply_vert_coords(*r_deform, stack_cache->deform_cos);
+			}
 		}
+
+		has_leading_deform = (deformedVerts || (stack_cache && stack_cache->deform_cos));
 	}
 	else {
 		/* default behavior for meshes */
@@ -1905,6 +2229,23 @@ static void mesh_calc_modifiers(
 	orcodm = NULL;
 	clothorcodm = NULL;
 
+	if (stack_cache) {
+		int i;
+
+		for (i = 0; i < stack_cache->modifiers_num; i++) {
+			md = md->next;
+			curr = curr->next;
+		}
+
+		dm = CDDM_copy(stack_cache->dm);
+		orcodm = stack_cache->orcodm ? CDDM_copy(stack_cache->orcodm) : NULL;
+		clothorcodm = stack_cache->clothorcodm ? CDDM_copy(stack_cache->clothorcodm) : NULL;
+		append_mask = stack_cache->append_mask;
+
+		/* Gets freed when caching the result of more modifiers below. */
+		stack_cache = NULL;
+	}
+
 	for (; md; md = md->next, curr = curr->next) {
 		const ModifierTypeInfo *mti = modifierType_getInfo(md->type);
 
@@ -2147,6 +2488,12 @@ static void mesh_calc_modifiers(
 			}
 
 			dm->deformedOnly = false;
+
+			if ((md == stack_cache_md) && (deformedVerts == NULL)) {
+				stack_cache_store(
+				        ob, &stack_cache_key, firstmd, datamasks, stack_cache_md_num,
+				        dm, orcodm, clothorcodm, append_mask, has_leading_deform ? *r_deform : NULL);
+			}
 		}
 
 		isPrevDeform = (mti->type == eModifierTypeType_OnlyDeform);
@@ -721,6 +721,7 @@ void b_bone_spline_setup(bPoseChannel *pchan, int rest, Mat4 result_array[MAX_BB
 /* ************ Armature Deform ******************* */
 
 typedef struct bPoseChanDeform {
+	bPoseChannel *pchan;
 	Mat4     *b_bone_mats;
 	DualQuat *dual_quat;
 	DualQuat *b_bone_dual_quats;
@@ -956,9 +957,11 @@ static void armature_bbone_defmats_cb(void *userdata, Link *iter, int index)
 {
 	ArmatureBBoneDefmatsData *data = userdata;
 	bPoseChannel *pchan = (bPoseChannel *)iter;
+	bPoseChanDeform *pdef_info = &data->pdef_info_array[index];
+
+	pdef_info->pchan = pchan;
 
 	if (!(pchan->bone->flag & BONE_NO_DEFORM)) {
-		bPoseChanDeform *pdef_info = &data->pdef_info_array[index];
 		const bool use_quaternion = data->use_quaternion;
 
 		if (pchan->bone->segments > 1) {
@@ -972,18 +975,395 @@ static void armature_bbone_defmats_cb(void *userdata, Link *iter, int index)
 	}
 }
 
+/* Minimal number of vertices deformed by a single thread. */
+#define ARMATURE_DEFORM_VERTS_PER_THREAD 1024
+
+/* Deform weights of all vertices, flattened so the vertex loop doesn't have to
+ * map vertex groups to pose channels: bone weights of vertex i are stored at
+ * [offset[i], offset[i + 1]) of pdef_index and weight. */
+typedef struct ArmatureDeformWeights {
+	int *offset;
+	int *pdef_index;
+	float *weight;
+	/* Weight of the overall armature vertex group, NULL when there is none. */
+	float *armature_weight;
+} ArmatureDeformWeights;
+
+/* What the deform weights are gathered from. */
+typedef struct ArmatureDeformWeightsSource {
+	const MDeformVert *dverts;
+	int totvert;
+	int numVerts;
+	/* Vertex group index to pose channel index, -1 for groups without a deforming bone,
+	 * NULL to not use the vertex groups. */
+	int *defnr_to_pdef_index;
+	int defbase_tot;
+	/* Index of the overall armature vertex group, -1 when there is none. */
+	int armature_def_nr;
+	bool invert_vgroup;
+} ArmatureDeformWeightsSource;
+
+/* Deform weights kept between evaluations, they only depend on the vertex groups of the
+ * target and the pose channels of the armature and not on the pose itself. */
+typedef struct ArmatureDeformCache {
+	ArmatureDeformWeightsSource source;
+	ArmatureDeformWeights weights;
+} ArmatureDeformCache;
+
+typedef struct ArmatureDeformWeightsData {
+	ArmatureDeformWeights *weights;
+	const ArmatureDeformWeightsSource *source;
+} ArmatureDeformWeightsData;
+
+BLI_INLINE const MDeformVert *armature_deform_weights_dvert(const ArmatureDeformWeightsSource *source, const int i)
+{
+	return (i < source->totvert) ? &source->dverts[i] : NULL;
+}
+
+/* Count the weights of deforming bones, gather the weight of the overall group. */
+static void armature_deform_weights_count_cb(
+        void *__restrict userdata,
+        const int i,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	ArmatureDeformWeightsData *data = userdata;
+	const ArmatureDeformWeightsSource *source = data->source;
+	ArmatureDeformWeights *weights = data->weights;
+	const MDeformVert *dvert = armature_deform_weights_dvert(source, i);
+
+	if (weights->armature_weight) {
+		float armature_weight = 1.0f;  /* default to 1 if not in the overall def group */
+
+		if (dvert) {
+			armature_weight = defvert_find_weight(dvert, source->armature_def_nr);
+			if (source->invert_vgroup) {
+				armature_weight = 1.0f - armature_weight;
+			}
+		}
+		weights->armature_weight[i] = armature_weight;
+	}
+
+	if (weights->offset) {
+		int len = 0;
+
+		if (dvert) {
+			const MDeformWeight *dw = dvert->dw;
+			unsigned int j;
+
+			for (j = dvert->totweight; j != 0; j--, dw++) {
+				const int index = dw->def_nr;
+				if (index >= 0 && index < source->defbase_tot && source->defnr_to_pdef_index[index] != -1) {
+					len++;
+				}
+			}
+		}
+		weights->offset[i + 1] = len;
+	}
+}
+
+static void armature_deform_weights_fill_cb(
+        void *__restrict userdata,
+        const int i,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	ArmatureDeformWeightsData *data = userdata;
+	const ArmatureDeformWeightsSource *source = data->source;
+	ArmatureDeformWeights *weights = data->weights;
+	const MDeformVert *dvert = armature_deform_weights_dvert(source, i);
+	int *pdef_index = &weights->pdef_index[weights->offset[i]];
+	float *weight = &weights->weight[weights->offset[i]];
+
+	if (dvert) {
+		const MDeformWeight *dw = dvert->dw;
+		unsigned int j;
+
+		for (j = dvert->totweight; j != 0; j--, dw++) {
+			const int index = dw->def_nr;
+			if (index >= 0 && index < source->defbase_tot && source->defnr_to_pdef_index[index] != -1) {
+				*pdef_index++ = source->defnr_to_pdef_index[index];
+				*weight++ = dw->weight;
+			}
+		}
+	}
+}
+
+/**
+ * Gather the bone weights of all vertices from the deform groups.
+ */
+static void armature_deform_weights_build(ArmatureDeformWeights *weights, const ArmatureDeformWeightsSource *source)
+{
+	ArmatureDeformWeightsData data = {.weights = weights, .source = source};
+	const int numVerts = source->numVerts;
+	ParallelRangeSettings settings;
+
+	memset(weights, 0, sizeof(*weights));
+
+	if (source->dverts == NULL || (source->defnr_to_pdef_index == NULL && source->armature_def_nr == -1)) {
+		return;
+	}
+
+	if (source->defnr_to_pdef_index) {
+		weights->offset = MEM_mallocN(sizeof(*weights->offset) * (size_t)(numVerts + 1), "armature weights offset");
+		weights->offset[0] = 0;
+	}
+	if (source->armature_def_nr != -1) {
+		weights->armature_weight = MEM_mallocN(sizeof(*weights->armature_weight) * (size_t)numVerts,
+		                                       "armature group weights");
+	}
+
+	BLI_parallel_range_settings_defaults(&settings);
+	settings.min_iter_per_thread = ARMATURE_DEFORM_VERTS_PER_THREAD;
+	BLI_task_parallel_range(0, numVerts, &data, armature_deform_weights_count_cb, &settings);
+
+	if (weights->offset) {
+		int i;
+
+		for (i = 0; i < numVerts; i++) {
+			weights->offset[i + 1] += weights->offset[i];
+		}
+		weights->pdef_index = MEM_mallocN(sizeof(*weights->pdef_index) * (size_t)max_ii(weights->offset[numVerts], 1),
+		                                  "armature weights index");
+		weights->weight = MEM_mallocN(sizeof(*weights->weight) * (size_t)max_ii(weights->offset[numVerts], 1),
+		                              "armature weights");
+
+		BLI_task_parallel_range(0, numVerts, &data, armature_deform_weights_fill_cb, &settings);
+	}
+}
+
+static void armature_deform_weights_free(ArmatureDeformWeights *weights)
+{
+	MEM_SAFE_FREE(weights->offset);
+	MEM_SAFE_FREE(weights->pdef_index);
+	MEM_SAFE_FREE(weights->weight);
+	MEM_SAFE_FREE(weights->armature_weight);
+}
+
+static bool armature_deform_weights_source_equals(const ArmatureDeformWeightsSource *a,
+                                                  const ArmatureDeformWeightsSource *b)
+{
+	if (a->dverts != b->dverts ||
+	    a->totvert != b->totvert ||
+	    a->numVerts != b->numVerts ||
+	    a->defbase_tot != b->defbase_tot ||
+	    a->armature_def_nr != b->armature_def_nr ||
+	    a->invert_vgroup != b->invert_vgroup)
+	{
+		return false;
+	}
+	if ((a->defnr_to_pdef_index == NULL) != (b->defnr_to_pdef_index == NULL)) {
+		return false;
+	}
+	if (a->defnr_to_pdef_index &&
+	    memcmp(a->defnr_to_pdef_index, b->defnr_to_pdef_index, sizeof(int) * (size_t)a->defbase_tot) != 0)
+	{
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Get the deform weights of \a source from \a cache, gathering them again when the source
+ * or the vertex group weights changed.
+ *
+ * \param is_data_changed: Weights of the vertex groups might have changed.
+ */
+static const ArmatureDeformWeights *armature_deform_cache_ensure(
+        ArmatureDeformCache **cache, const ArmatureDeformWeightsSource *source, const bool is_data_changed)
+{
+	if (*cache != NULL) {
+		if (!is_data_changed && armature_deform_weights_source_equals(&(*cache)->source, source)) {
+			return &(*cache)->weights;
+		}
+		armature_deform_cache_free(*cache);
+	}
+
+	*cache = MEM_mallocN(sizeof(**cache), "ArmatureDeformCache");
+	(*cache)->source = *source;
+	if (source->defnr_to_pdef_index) {
+		(*cache)->source.defnr_to_pdef_index = MEM_dupallocN(source->defnr_to_pdef_index);
+	}
+	armature_deform_weights_build(&(*cache)->weights, &(*cache)->source);
+
+	return &(*cache)->weights;
+}
+
+void armature_deform_cache_free(ArmatureDeformCache *cache)
+{
+	armature_deform_weights_free(&cache->weights);
+	MEM_SAFE_FREE(cache->source.defnr_to_pdef_index);
+	MEM_freeN(cache);
+}
+
+typedef struct ArmatureDeformVertsData {
+	float (*vertexCos)[3];
+	float (*defMats)[3][3];
+	float (*prevCos)[3];
+	const ArmatureDeformWeights *weights;
+	bPoseChanDeform *pdef_info_array;
+	int totchan;
+	float (*premat)[4];
+	float (*postmat)[4];
+	bool use_envelope;
+	bool use_quaternion;
+} ArmatureDeformVertsData;
+
+static void armature_deform_envelope(
+        const ArmatureDeformVertsData *data, float vec[3], DualQuat *dq, float mat[3][3], const float co[3],
+        float *contrib)
+{
+	bPoseChanDeform *pdef_info = data->pdef_info_array;
+	int i;
+
+	for (i = 0; i < data->totchan; i++, pdef_info++) {
+		if (!(pdef_info->pchan->bone->flag & BONE_NO_DEFORM))
+			*contrib += dist_bone_deform(pdef_info->pchan, pdef_info, vec, dq, mat, co);
+	}
+}
+
+static void armature_deform_vert_cb(
+        void *__restrict userdata,
+        const int i,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	const ArmatureDeformVertsData *data = userdata;
+	const ArmatureDeformWeights *weights = data->weights;
+	float (*defMats)[3][3] = data->defMats;
+	const bool use_quaternion = data->use_quaternion;
+	DualQuat sumdq, *dq = NULL;
+	float *co, dco[3];
+	float sumvec[3], summat[3][3];
+	float *vec = NULL, (*smat)[3] = NULL;
+	float contrib = 0.0f;
+	float armature_weight = 1.0f; /* default to 1 if no overall def group */
+	float prevco_weight = 1.0f;   /* weight for optional cached vertexcos */
+
+	if (use_quaternion) {
+		memset(&sumdq, 0, sizeof(DualQuat));
+		dq = &sumdq;
+	}
+	else {
+		sumvec[0] = sumvec[1] = sumvec[2] = 0.0f;
+		vec = sumvec;
+
+		if (defMats) {
+			zero_m3(summat);
+			smat = summat;
+		}
+	}
+
+	if (weights->armature_weight) {
+		armature_weight = weights->armature_weight[i];
+
+		/* hackish: the blending factor can be used for blending with prevCos too */
+		if (data->prevCos) {
+			prevco_weight = armature_weight;
+			armature_weight = 1.0f;
+		}
+	}
+
+	/* check if there's any  point in calculating for this vert */
+	if (armature_weight == 0.0f)
+		return;
+
+	/* get the coord we work on */
+	co = data->prevCos ? data->prevCos[i] : data->vertexCos[i];
+
+	/* Apply the object's matrix */
+	mul_m4_v3(data->premat, co);
+
+	if (weights->offset && weights->offset[i] != weights->offset[i + 1]) { /* use weight groups ? */
+		const int *pdef_index = &weights->pdef_index[weights->offset[i]];
+		const float *bone_weight = &weights->weight[weights->offset[i]];
+		const int len = weights->offset[i + 1] - weights->offset[i];
+		int j;
+
+		for (j = 0; j < len; j++) {
+			bPoseChanDeform *pdef_info = &data->pdef_info_array[pdef_index[j]];
+			bPoseChannel *pchan = pdef_info->pchan;
+			Bone *bone = pchan->bone;
+			float weight = bone_weight[j];
+
+			if (bone && bone->flag & BONE_MULT_VG_ENV) {
+				weight *= distfactor_to_bone(co, bone->arm_head, bone->arm_tail,
+				                             bone->rad_head, bone->rad_tail, bone->dist);
+			}
+			pchan_bone_deform(pchan, pdef_info, weight, vec, dq, smat, co, &contrib);
+		}
+	}
+	/* if there are no vertexgroups or not groups with bones
+	 * (like for softbody groups) */
+	else if (data->use_envelope) {
+		armature_deform_envelope(data, vec, dq, smat, co, &contrib);
+	}
+
+	/* actually should be EPSILON? weight values and contrib can be like 10e-39 small */
+	if (contrib > 0.0001f) {
+		if (use_quaternion) {
+			normalize_dq(dq, contrib);
+
+			if (armature_weight != 1.0f) {
+				copy_v3_v3(dco, co);
+				mul_v3m3_dq(dco, (defMats) ? summat : NULL, dq);
+				sub_v3_v3(dco, co);
+				mul_v3_fl(dco, armature_weight);
+				add_v3_v3(co, dco);
+			}
+			else
+				mul_v3m3_dq(co, (defMats) ? summat : NULL, dq);
+
+			smat = summat;
+		}
+		else {
+			mul_v3_fl(vec, armature_weight / contrib);
+			add_v3_v3v3(co, vec, co);
+		}
+
+		if (defMats) {
+			float pre[3][3], post[3][3], tmpmat[3][3];
+
+			copy_m3_m4(pre, data->premat);
+			copy_m3_m4(post, data->postmat);
+			copy_m3_m3(tmpmat, defMats[i]);
+
+			if (!use_quaternion) /* quaternion already is scale corrected */
+				mul_m3_fl(smat, armature_weight / contrib);
+
+			mul_m3_series(defMats[i], post, smat, pre, tmpmat);
+		}
+	}
+
+	/* always, check above code */
+	mul_m4_v3(data->postmat, co);
+
+	/* interpolate with previous modifier position using weight group */
+	if (data->prevCos) {
+		float mw = 1.0f - prevco_weight;
+		float *vco = data->vertexCos[i];
+		vco[0] = prevco_weight * vco[0] + mw * co[0];
+		vco[1] = prevco_weight * vco[1] + mw * co[1];
+		vco[2] = prevco_weight * vco[2] + mw * co[2];
+	}
+}
+
+/**
+ * \param cache: Optional, keeps the vertex weights gathered from the deform groups between evaluations.
+ * They are gathered again when the vertex groups or pose channels change or the target data is tagged for update.
+ */
 void armature_deform_verts(Object *armOb, Object *target, DerivedMesh *dm, float (*vertexCos)[3],
                            float (*defMats)[3][3], int numVerts, int deformflag,
-                           float (*prevCos)[3], const char *defgrp_name)
+                           float (*prevCos)[3], const char *defgrp_name, ArmatureDeformCache **cache)
 {
 	bPoseChanDeform *pdef_info_array;
 	bPoseChanDeform *pdef_info = NULL;
 	bArmature *arm = armOb->data;
-	bPoseChannel *pchan, **defnrToPC = NULL;
+	bPoseChannel *pchan;
 	int *defnrToPCIndex = NULL;
-	MDeformVert *dverts = NULL;
+	MDeformVert *dverts = NULL, *orig_dverts = NULL;
 	bDeformGroup *dg;
 	DualQuat *dualquats = NULL;
+	ArmatureDeformWeightsSource weights_source;
+	ArmatureDeformWeights local_weights;
+	const ArmatureDeformWeights *weights;
 	float obinv[4][4], premat[4][4], postmat[4][4];
 	const bool use_envelope   = (deformflag & ARM_DEF_ENVELOPE) != 0;
 	const bool use_quaternion = (deformflag & ARM_DEF_QUATERNION) != 0;
@@ -1033,32 +1413,35 @@ void armature_deform_verts(Object *armOb, Object *target, DerivedMesh *dm, float
 
 		if (target->type == OB_MESH) {
 			Mesh *me = target->data;
-			dverts = me->dvert;
-			if (dverts)
+			orig_dverts = me->dvert;
+			if (orig_dverts)
 				target_totvert = me->totvert;
 		}
 		else {
 			Lattice *lt = target->data;
-			dverts = lt->dvert;
-			if (dverts)
+			orig_dverts = lt->dvert;
+			if (orig_dverts)
 				target_totvert = lt->pntsu * lt->pntsv * lt->pntsw;
 		}
+
+		/* if we have a DerivedMesh, only use dverts if it has them */
+		if (dm) {
+			dverts = dm->getVertDataArray(dm, CD_MDEFORMVERT);
+			if (dverts != orig_dverts)
+				target_totvert = (dverts) ? dm->getNumVerts(dm) : 0;
+		}
+		else {
+			dverts = orig_dverts;
+		}
 	}
 
 	/* get a vertex-deform-index to posechannel array */
 	if (deformflag & ARM_DEF_VGROUP) {
 		if (ELEM(target->type, OB_MESH, OB_LATTICE)) {
-			/* if we have a DerivedMesh, only use dverts if it has them */
-			if (dm) {
-				use_dverts = (dm->getVertDataArray(dm, CD_MDEFORMVERT) != NULL);
-			}
-			else if (dverts) {
-				use_dverts = true;
-			}
+			use_dverts = (dverts != NULL);
 
 			if (use_dverts) {
-				defnrToPC = MEM_callocN(sizeof(*defnrToPC) * defbase_tot, "defnrToBone");
-				defnrToPCIndex = MEM_callocN(sizeof(*defnrToPCIndex) * defbase_tot, "defnrToIndex");
+				defnrToPCIndex = MEM_mallocN(sizeof(*defnrToPCIndex) * max_ii(defbase_tot, 1), "defnrToIndex");
 				/* TODO(sergey): Some considerations here:
 				 *
 				 * - Make it more generic function, maybe even keep together with chanhash.
@@ -1071,15 +1454,13 @@ void armature_deform_verts(Object *armOb, Object *target, DerivedMesh *dm, float
 					BLI_ghash_insert(idx_hash, pchan, SET_INT_IN_POINTER(pchan_index));
 				}
 				for (i = 0, dg = target->defbase.first; dg; i++, dg = dg->next) {
-					defnrToPC[i] = BKE_pose_channel_find_name(armOb->pose, dg->name);
+					pchan = BKE_pose_channel_find_name(armOb->pose, dg->name);
 					/* exclude non-deforming bones */
-					if (defnrToPC[i]) {
-						if (defnrToPC[i]->bone->flag & BONE_NO_DEFORM) {
-							defnrToPC[i] = NULL;
-						}
-						else {
-							defnrToPCIndex[i] = GET_INT_FROM_POINTER(BLI_ghash_lookup(idx_hash, defnrToPC[i]));
-						}
+					if (pchan && !(pchan->bone->flag & BONE_NO_DEFORM)) {
+						defnrToPCIndex[i] = GET_INT_FROM_POINTER(BLI_ghash_lookup(idx_hash, pchan));
+					}
+					else {
+						defnrToPCIndex[i] = -1;
 					}
 				}
 				BLI_ghash_free(idx_hash, NULL, NULL);
@@ -1087,155 +1468,47 @@ void armature_deform_verts(Object *armOb, Object *target, DerivedMesh *dm, float
 		}
 	}
 
-	for (i = 0; i < numVerts; i++) {
-		MDeformVert *dvert;
-		DualQuat sumdq, *dq = NULL;
-		float *co, dco[3];
-		float sumvec[3], summat[3][3];
-		float *vec = NULL, (*smat)[3] = NULL;
-		float contrib = 0.0f;
-		float armature_weight = 1.0f; /* default to 1 if no overall def group */
-		float prevco_weight = 1.0f;   /* weight for optional cached vertexcos */
-
-		if (use_quaternion) {
-			memset(&sumdq, 0, sizeof(DualQuat));
-			dq = &sumdq;
-		}
-		else {
-			sumvec[0] = sumvec[1] = sumvec[2] = 0.0f;
-			vec = sumvec;
-
-			if (defMats) {
-				zero_m3(summat);
-				smat = summat;
-			}
-		}
-
-		if (use_dverts || armature_def_nr != -1) {
-			if (dm)
-				dvert = dm->getVertData(dm, i, CD_MDEFORMVERT);
-			else if (dverts && i < target_totvert)
-				dvert = dverts + i;
-			else
-				dvert = NULL;
-		}
-		else
-			dvert = NULL;
-
-		if (armature_def_nr != -1 && dvert) {
-			armature_weight = defvert_find_weight(dvert, armature_def_nr);
-
-			if (invert_vgroup)
-				armature_weight = 1.0f - armature_weight;
-
-			/* hackish: the blending factor can be used for blending with prevCos too */
-			if (prevCos) {
-				prevco_weight = armature_weight;
-				armature_weight = 1.0f;
-			}
-		}
-
-		/* check if there's any  point in calculating for this vert */
-		if (armature_weight == 0.0f)
-			continue;
-
-		/* get the coord we work on */
-		co = prevCos ? prevCos[i] : vertexCos[i];
-
-		/* Apply the object's matrix */
-		mul_m4_v3(premat, co);
-
-		if (use_dverts && dvert && dvert->totweight) { /* use weight groups ? */
-			MDeformWeight *dw = dvert->dw;
-			int deformed = 0;
-			unsigned int j;
-
-			for (j = dvert->totweight; j != 0; j--, dw++) {
-				const int index = dw->def_nr;
-				if (index >= 0 && index < defbase_tot && (pchan = defnrToPC[index])) {
-					float weight = dw->weight;
-					Bone *bone = pchan->bone;
-					pdef_info = pdef_info_array + defnrToPCIndex[index];
-
-					deformed = 1;
-
-					if (bone && bone->flag & BONE_MULT_VG_ENV) {
-						weight *= distfactor_to_bone(co, bone->arm_head, bone->arm_tail,
-						                             bone->rad_head, bone->rad_tail, bone->dist);
-					}
-					pchan_bone_deform(pchan, pdef_info, weight, vec, dq, smat, co, &contrib);
-				}
-			}
-			/* if there are vertexgroups but not groups with bones
-			 * (like for softbody groups) */
-			if (deformed == 0 && use_envelope) {
-				pdef_info = pdef_info_array;
-				for (pchan = armOb->pose->chanbase.first; pchan; pchan = pchan->next, pdef_info++) {
-					if (!(pchan->bone->flag & BONE_NO_DEFORM))
-						contrib += dist_bone_deform(pchan, pdef_info, vec, dq, smat, co);
-				}
-			}
-		}
-		else if (use_envelope) {
-			pdef_info = pdef_info_array;
-			for (pchan = armOb->pose->chanbase.first; pchan; pchan = pchan->next, pdef_info++) {
-				if (!(pchan->bone->flag & BONE_NO_DEFORM))
-					contrib += dist_bone_deform(pchan, pdef_info, vec, dq, smat, co);
-			}
-		}
-
-		/* actually should be EPSILON? weight values and contrib can be like 10e-39 small */
-		if (contrib > 0.0001f) {
-			if (use_quaternion) {
-				normalize_dq(dq, contrib);
-
-				if (armature_weight != 1.0f) {
-					copy_v3_v3(dco, co);
-					mul_v3m3_dq(dco, (defMats) ? summat : NULL, dq);
-					sub_v3_v3(dco, co);
-					mul_v3_fl(dco, armature_weight);
-					add_v3_v3(co, dco);
-				}
-				else
-					mul_v3m3_dq(co, (defMats) ? summat : NULL, dq);
-
-				smat = summat;
-			}
-			else {
-				mul_v3_fl(vec, armature_weight / contrib);
-				add_v3_v3v3(co, vec, co);
-			}
-
-			if (defMats) {
-				float pre[3][3], post[3][3], tmpmat[3][3];
+	weights_source.dverts = dverts;
+	weights_source.totvert = min_ii(target_totvert, numVerts);
+	weights_source.numVerts = numVerts;
+	weights_source.defnr_to_pdef_index = defnrToPCIndex;
+	weights_source.defbase_tot = defbase_tot;
+	weights_source.armature_def_nr = armature_def_nr;
+	weights_source.invert_vgroup = invert_vgroup;
 
-				copy_m3_m4(pre, premat);
-				copy_m3_m4(post, postmat);
-				copy_m3_m3(tmpmat, defMats[i]);
-
-				if (!use_quaternion) /* quaternion already is scale corrected */
-					mul_m3_fl(smat, armature_weight / contrib);
-
-				mul_m3_series(defMats[i], post, smat, pre, tmpmat);
-			}
+	/* Only weights of the original data can be kept, changes to it are tagged on the target data. */
+	if (cache && dverts && dverts == orig_dverts) {
+		const bool is_data_changed = (((ID *)target->data)->recalc & ID_RECALC_ALL) != 0;
+		weights = armature_deform_cache_ensure(cache, &weights_source, is_data_changed);
+	}
+	else {
+		if (cache && *cache) {
+			armature_deform_cache_free(*cache);
+			*cache = NULL;
 		}
+		armature_deform_weights_build(&local_weights, &weights_source);
+		weights = &local_weights;
+	}
 
-		/* always, check above code */
-		mul_m4_v3(postmat, co);
+	{
+		ArmatureDeformVertsData verts_data = {
+		    .vertexCos = vertexCos, .defMats = defMats, .prevCos = prevCos,
+		    .weights = weights, .pdef_info_array = pdef_info_array, .totchan = totchan,
+		    .premat = premat, .postmat = postmat,
+		    .use_envelope = use_envelope, .use_quaternion = use_quaternion
+		};
+		ParallelRangeSettings settings;
+		BLI_parallel_range_settings_defaults(&settings);
+		settings.min_iter_per_thread = ARMATURE_DEFORM_VERTS_PER_THREAD;
+		BLI_task_parallel_range(0, numVerts, &verts_data, armature_deform_vert_cb, &settings);
+	}
 
-		/* interpolate with previous modifier position using weight group */
-		if (prevCos) {
-			float mw = 1.0f - prevco_weight;
-			vertexCos[i][0] = prevco_weight * vertexCos[i][0] + mw * co[0];
-			vertexCos[i][1] = prevco_weight * vertexCos[i][1] + mw * co[1];
-			vertexCos[i][2] = prevco_weight * vertexCos[i][2] + mw * co[2];
-		}
+	if (weights == &local_weights) {
+		armature_deform_weights_free(&local_weights);
 	}
 
 	if (dualquats)
 		MEM_freeN(dualquats);
-	if (defnrToPC)
-		MEM_freeN(defnrToPC);
 	if (defnrToPCIndex)
 		MEM_freeN(defnrToPCIndex);
 
@@ -1763,6 +1763,16 @@ void DAG_relations_tag_update(Main *bmain)
 	}
 }
 
+void DAG_relations_tag_update_id(Main *bmain, ID *id)
+{
+	if (DEG_depsgraph_use_legacy()) {
+		DAG_relations_tag_update(bmain);
+	}
+	else {
+		DEG_relations_tag_update_id(bmain, id);
+	}
+}
+
 /* rebuild dependency graph only for a given scene */
 void DAG_scene_relations_rebuild(Main *bmain, Scene *sce)
 {
@@ -3666,6 +3676,12 @@ void DAG_relations_tag_update(Main *bmain)
 	DEG_relations_tag_update(bmain);
 }
 
+/* Tag relations of a single ID for update. */
+void DAG_relations_tag_update_id(Main *bmain, ID *id)
+{
+	DEG_relations_tag_update_id(bmain, id);
+}
+
 /* Rebuild dependency graph only for a given scene. */
 void DAG_scene_relations_rebuild(Main *bmain, Scene *scene)
 {
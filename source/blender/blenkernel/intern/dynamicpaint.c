@@ -623,16 +623,15 @@ static void grid_bound_insert_cb_ex(void *__restrict userdata,
 	boundInsert(grid_bound, bData->realCoord[bData->s_pos[i]].v);
 }
 
-static void grid_bound_insert_finalize(void *__restrict userdata,
-                                       void *__restrict userdata_chunk)
+static void grid_bound_insert_reduce(const void *__restrict UNUSED(userdata),
+                                     void *__restrict chunk_join,
+                                     void *__restrict userdata_chunk)
 {
-	PaintBakeData *bData = userdata;
-	VolumeGrid *grid = bData->grid;
-
+	Bounds3D *join = chunk_join;
 	Bounds3D *grid_bound = userdata_chunk;
 
-	boundInsert(&grid->grid_bounds, grid_bound->min);
-	boundInsert(&grid->grid_bounds, grid_bound->max);
+	boundInsert(join, grid_bound->min);
+	boundInsert(join, grid_bound->max);
 }
 
 static void grid_cell_points_cb_ex(void *__restrict userdata,
@@ -724,7 +723,7 @@ static void surfaceGenerateGrid(struct DynamicPaintSurface *surface)
 			settings.use_threading = (sData->total_points > 1000);
 			settings.userdata_chunk = &grid->grid_bounds;
 			settings.userdata_chunk_size = sizeof(grid->grid_bounds);
-			settings.func_finalize = grid_bound_insert_finalize;
+			settings.func_reduce = grid_bound_insert_reduce;
 			BLI_task_parallel_range(
 			        0, sData->total_points,
 			        bData,
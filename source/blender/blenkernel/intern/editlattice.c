@@ -102,6 +102,7 @@ void BKE_editlattice_load(Object *obedit)
 		/* active key: vertices */
 		tot = editlt->pntsu * editlt->pntsv * editlt->pntsw;
 
+		BKE_key_sparse_free(lt->key);
 		if (actkey->data) {
 			MEM_freeN(actkey->data);
 		}
@@ -39,6 +39,7 @@
 #include "BLI_blenlib.h"
 #include "BLI_math_vector.h"
 #include "BLI_string_utils.h"
+#include "BLI_task.h"
 #include "BLI_utildefines.h"
 
 #include "BLT_translation.h"
@@ -87,6 +88,7 @@ void BKE_key_free(Key *key)
 	while ((kb = BLI_pophead(&key->block))) {
 		if (kb->data)
 			MEM_freeN(kb->data);
+		BKE_keyblock_sparse_free(kb);
 		MEM_freeN(kb);
 	}
 }
@@ -98,6 +100,7 @@ void BKE_key_free_nolib(Key *key)
 	while ((kb = BLI_pophead(&key->block))) {
 		if (kb->data)
 			MEM_freeN(kb->data);
+		BKE_keyblock_sparse_free(kb);
 		MEM_freeN(kb);
 	}
 }
@@ -174,6 +177,7 @@ void BKE_key_copy_data(Main *UNUSED(bmain), Key *key_dst, const Key *key_src, co
 		if (kb_dst->data) {
 			kb_dst->data = MEM_dupallocN(kb_dst->data);
 		}
+		kb_dst->sparse = NULL;
 		if (kb_src == key_src->refkey) {
 			key_dst->refkey = kb_dst;
 		}
@@ -204,6 +208,7 @@ Key *BKE_key_copy_nolib(Key *key)
 	while (kbn) {
 
 		if (kbn->data) kbn->data = MEM_dupallocN(kbn->data);
+		kbn->sparse = NULL;
 		if (kb == key->refkey) keyn->refkey = kbn;
 
 		kbn = kbn->next;
@@ -721,6 +726,390 @@ static void cp_cu_key(Curve *cu, Key *key, KeyBlock *actkb, KeyBlock *kb, const
 	}
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Sparse Key Blocks
+ *
+ * Key blocks of meshes and lattices which only move a few elements away from
+ * the reference key are written to files as the (index, coordinate) pairs of
+ * those elements, see #KEYBLOCK_SPARSE. Reading expands them to full arrays
+ * again, keeping the indices so evaluation only touches the elements they move.
+ *
+ * The indices stay valid as long as neither data array is reallocated, code
+ * changing the data in place has to free them with #BKE_key_sparse_free.
+ * \{ */
+
+/* Write key blocks sparse when at most this fraction of the elements moves. */
+#define KEY_SPARSE_MAX_FRACTION 0.25f
+
+typedef struct KeyBlockSparse {
+	/* Sorted indices of the elements which differ from the reference key. */
+	int *index;
+	int index_len;
+	/* Data arrays the indices were computed for. */
+	const void *data, *refdata;
+} KeyBlockSparse;
+
+static bool keyblock_sparse_supported(const Key *key, const KeyBlock *kb)
+{
+	const KeyBlock *refkey = key->refkey;
+
+	return (refkey && kb != refkey && kb->data && refkey->data &&
+	        key->elemsize == sizeof(float[3]) && kb->totelem == refkey->totelem);
+}
+
+/* Returns the sorted element indices of \a kb which differ from the reference key,
+ * when it is used for evaluating relative to it, NULL otherwise. */
+static const KeyBlockSparse *keyblock_sparse_get(const Key *key, const KeyBlock *kb, const KeyBlock *refb)
+{
+	const KeyBlockSparse *sparse = kb->sparse;
+
+	if (sparse && refb == key->refkey &&
+	    sparse->data == kb->data && sparse->refdata == refb->data)
+	{
+		return sparse;
+	}
+	return NULL;
+}
+
+/**
+ * Elements of \a kb which differ from the reference key, for writing it to files.
+ *
+ * \return NULL when the key block is not worth storing sparse.
+ */
+KeyBlockSparseElem *BKE_keyblock_sparse_pack(const Key *key, const KeyBlock *kb, int *r_totsparse)
+{
+	const float (*cos)[3], (*refcos)[3];
+	KeyBlockSparseElem *elems;
+	int a, tot = 0;
+
+	if (!keyblock_sparse_supported(key, kb)) {
+		return NULL;
+	}
+
+	cos = kb->data;
+	refcos = key->refkey->data;
+
+	for (a = 0; a < kb->totelem; a++) {
+		if (memcmp(cos[a], refcos[a], sizeof(*cos)) != 0) {
+			tot++;
+		}
+	}
+
+	if (tot > (int)(kb->totelem * KEY_SPARSE_MAX_FRACTION)) {
+		return NULL;
+	}
+
+	elems = MEM_malloc_arrayN(max_ii(tot, 1), sizeof(*elems), __func__);
+
+	for (a = 0, tot = 0; a < kb->totelem; a++) {
+		if (memcmp(cos[a], refcos[a], sizeof(*cos)) != 0) {
+			elems[tot].index = a;
+			copy_v3_v3(elems[tot].co, cos[a]);
+			tot++;
+		}
+	}
+
+	*r_totsparse = tot;
+	return elems;
+}
+
+/**
+ * Expand \a kb read from a file with #KEYBLOCK_SPARSE to a full array of elements.
+ * The data of the reference key has to be read already.
+ */
+void BKE_keyblock_sparse_unpack(Key *key, KeyBlock *kb)
+{
+	KeyBlockSparseElem *elems = kb->data;
+	const KeyBlock *refkey = key->refkey;
+	KeyBlockSparse *sparse;
+	float (*cos)[3];
+	int a;
+
+	BLI_assert(kb->flag & KEYBLOCK_SPARSE);
+
+	if (refkey && refkey != kb && refkey->data && refkey->totelem == kb->totelem &&
+	    key->elemsize == sizeof(float[3]))
+	{
+		cos = MEM_dupallocN(refkey->data);
+	}
+	else {
+		/* should never happen */
+		cos = MEM_calloc_arrayN(kb->totelem, sizeof(*cos), __func__);
+	}
+
+	sparse = MEM_mallocN(sizeof(*sparse), __func__);
+	sparse->index = MEM_malloc_arrayN(max_ii(kb->totsparse, 1), sizeof(*sparse->index), __func__);
+	sparse->index_len = 0;
+
+	for (a = 0; a < kb->totsparse && elems; a++) {
+		const int index = elems[a].index;
+
+		/* skip corrupt elements, the indices have to stay sorted */
+		if (index >= 0 && index < kb->totelem &&
+		    (sparse->index_len == 0 || index > sparse->index[sparse->index_len - 1]))
+		{
+			copy_v3_v3(cos[index], elems[a].co);
+			sparse->index[sparse->index_len++] = index;
+		}
+	}
+
+	sparse->data = cos;
+	sparse->refdata = refkey ? refkey->data : NULL;
+
+	if (elems) {
+		MEM_freeN(elems);
+	}
+
+	BKE_keyblock_sparse_free(kb);
+	kb->data = cos;
+	kb->sparse = sparse;
+	kb->totsparse = 0;
+	kb->flag &= ~KEYBLOCK_SPARSE;
+}
+
+void BKE_keyblock_sparse_free(KeyBlock *kb)
+{
+	if (kb->sparse) {
+		MEM_freeN(kb->sparse->index);
+		MEM_freeN(kb->sparse);
+		kb->sparse = NULL;
+	}
+}
+
+void BKE_key_sparse_free(Key *key)
+{
+	KeyBlock *kb;
+
+	for (kb = key->block.first; kb; kb = kb->next) {
+		BKE_keyblock_sparse_free(kb);
+	}
+}
+
+/* Free the indices which are invalid after changing \a kb in place. */
+static void keyblock_sparse_free_changed(Key *key, KeyBlock *kb)
+{
+	if (key && kb == key->refkey) {
+		BKE_key_sparse_free(key);
+	}
+	else {
+		BKE_keyblock_sparse_free(kb);
+	}
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Relative Key Blending of Coordinates
+ *
+ * Meshes and lattices store a single coordinate per element, so all keys can be
+ * blended into a block of elements at once, with plain loops the compiler can
+ * vectorize instead of the per element dispatch on #Key.elemstr. Blocks are
+ * blended in parallel, keys without influence are skipped up-front.
+ * \{ */
+
+/* Elements blended at once, small enough for the output to stay in cache
+ * while all keys are added to it. */
+#define KEY_RELATIVE_BLOCK_SIZE 1024
+/* Minimum amount of element and key pairs to blend for threading to pay off. */
+#define KEY_RELATIVE_PARALLEL_THRESHOLD (64 * 1024)
+
+typedef struct RelativeKeyBlend {
+	const float *from;
+	const float *reffrom;
+	const float *weights;
+	float influence;
+	/* Sorted indices of the elements which move, NULL to blend all of them. */
+	const int *sparse_index;
+	int sparse_index_len;
+} RelativeKeyBlend;
+
+typedef struct RelativeKeyData {
+	float *out;
+	/* NULL when the basis is copied before blending. */
+	const float *basis;
+	const RelativeKeyBlend *blends;
+	int blends_len;
+	int start, end;
+} RelativeKeyData;
+
+/* Same as #rel_flerp over a block of \a len coordinates. */
+static void key_blend_relative_block(
+        float *__restrict out, const float *__restrict reffrom, const float *__restrict from,
+        const float fac, const int len)
+{
+	int a;
+
+	for (a = 0; a < len * 3; a++) {
+		out[a] -= fac * (reffrom[a] - from[a]);
+	}
+}
+
+static void key_blend_relative_block_weights(
+        float *__restrict out, const float *__restrict reffrom, const float *__restrict from,
+        const float *__restrict weights, const float influence, const int len)
+{
+	int a;
+
+	for (a = 0; a < len; a++) {
+		const float fac = weights[a] * influence;
+		out[a * 3 + 0] -= fac * (reffrom[a * 3 + 0] - from[a * 3 + 0]);
+		out[a * 3 + 1] -= fac * (reffrom[a * 3 + 1] - from[a * 3 + 1]);
+		out[a * 3 + 2] -= fac * (reffrom[a * 3 + 2] - from[a * 3 + 2]);
+	}
+}
+
+/* Blend the elements of a block which move, \a out is the block and the other
+ * arrays are not offset to it. */
+static void key_blend_relative_sparse(
+        float *__restrict out, const float *__restrict reffrom, const float *__restrict from,
+        const float *__restrict weights, const float influence,
+        const int *index, const int index_len, const int start, const int len)
+{
+	int lo = 0, hi = index_len, a;
+
+	/* first index in the block */
+	while (lo < hi) {
+		const int mid = (lo + hi) / 2;
+		if (index[mid] < start) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+
+	for (a = lo; a < index_len && index[a] < start + len; a++) {
+		const int elem = index[a];
+		const float fac = weights ? weights[elem] * influence : influence;
+		float *co = out + (elem - start) * 3;
+
+		co[0] -= fac * (reffrom[elem * 3 + 0] - from[elem * 3 + 0]);
+		co[1] -= fac * (reffrom[elem * 3 + 1] - from[elem * 3 + 1]);
+		co[2] -= fac * (reffrom[elem * 3 + 2] - from[elem * 3 + 2]);
+	}
+}
+
+static void key_evaluate_relative_block_cb(
+        void *__restrict userdata,
+        const int block,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	const RelativeKeyData *data = userdata;
+	const int start = data->start + block * KEY_RELATIVE_BLOCK_SIZE;
+	const int len = min_ii(KEY_RELATIVE_BLOCK_SIZE, data->end - start);
+	float *out = data->out + start * 3;
+	int i;
+
+	if (data->basis) {
+		memcpy(out, data->basis + start * 3, sizeof(float[3]) * len);
+	}
+
+	for (i = 0; i < data->blends_len; i++) {
+		const RelativeKeyBlend *blend = &data->blends[i];
+
+		if (blend->sparse_index) {
+			key_blend_relative_sparse(
+			        out, blend->reffrom, blend->from, blend->weights, blend->influence,
+			        blend->sparse_index, blend->sparse_index_len, start, len);
+		}
+		else if (blend->weights) {
+			key_blend_relative_block_weights(
+			        out, blend->reffrom + start * 3, blend->from + start * 3,
+			        blend->weights + start, blend->influence, len);
+		}
+		else {
+			key_blend_relative_block(
+			        out, blend->reffrom + start * 3, blend->from + start * 3,
+			        blend->influence, len);
+		}
+	}
+}
+
+static void key_evaluate_relative_coords(
+        const int start, const int end, const int tot, float *out, Key *key, KeyBlock *actkb,
+        float **per_keyblock_weights)
+{
+	RelativeKeyData data;
+	RelativeKeyBlend *blends;
+	KeyBlock *kb;
+	const float *actkb_data = NULL;
+	char *freeactkb = NULL;
+	int keyblock_index;
+
+	/* Get the edit-mode coordinates once, rather than for every key relative to it. */
+	if (actkb) {
+		actkb_data = (float *)key_block_get_data(key, actkb, actkb, &freeactkb);
+	}
+
+#define KEY_BLOCK_DATA(kb) ((kb) == actkb ? actkb_data : (const float *)(kb)->data)
+
+	blends = MEM_mallocN(sizeof(*blends) * key->totkey, __func__);
+
+	data.out = out;
+	data.basis = NULL;
+	data.blends = blends;
+	data.blends_len = 0;
+	data.start = start;
+	data.end = end;
+
+	if (key->refkey->totelem == tot) {
+		data.basis = KEY_BLOCK_DATA(key->refkey);
+	}
+	else {
+		/* Interpolates the basis to a different amount of elements. */
+		cp_key(start, end, tot, (char *)out, key, actkb, key->refkey, NULL, KEY_MODE_DUMMY);
+	}
+
+	for (kb = key->block.first, keyblock_index = 0; kb; kb = kb->next, keyblock_index++) {
+		if (kb != key->refkey) {
+			/* only with value, and no difference allowed */
+			if (!(kb->flag & KEYBLOCK_MUTE) && kb->curval != 0.0f && kb->totelem == tot) {
+				KeyBlock *refb = BLI_findlink(&key->block, kb->relative);
+				RelativeKeyBlend *blend = &blends[data.blends_len];
+				const KeyBlockSparse *sparse;
+
+				if (refb == NULL || refb == kb) {
+					/* no difference to blend */
+					continue;
+				}
+
+				blend->from = KEY_BLOCK_DATA(kb);
+				blend->reffrom = KEY_BLOCK_DATA(refb);
+				blend->weights = per_keyblock_weights ? per_keyblock_weights[keyblock_index] : NULL;
+				blend->influence = kb->curval;
+				blend->sparse_index = NULL;
+				blend->sparse_index_len = 0;
+
+				/* not when blending edit-mode coordinates */
+				sparse = keyblock_sparse_get(key, kb, refb);
+				if (sparse && blend->from == kb->data && blend->reffrom == refb->data) {
+					blend->sparse_index = sparse->index;
+					blend->sparse_index_len = sparse->index_len;
+				}
+				data.blends_len++;
+			}
+		}
+	}
+
+	{
+		const int num_blocks = (end - start + KEY_RELATIVE_BLOCK_SIZE - 1) / KEY_RELATIVE_BLOCK_SIZE;
+		ParallelRangeSettings settings;
+
+		BLI_parallel_range_settings_defaults(&settings);
+		settings.use_threading = (num_blocks > 1 &&
+		                          (size_t)(end - start) * (size_t)(data.blends_len + 1) >=
+		                          KEY_RELATIVE_PARALLEL_THRESHOLD);
+		BLI_task_parallel_range(0, num_blocks, &data, key_evaluate_relative_block_cb, &settings);
+	}
+
+#undef KEY_BLOCK_DATA
+
+	if (freeactkb) MEM_freeN(freeactkb);
+	MEM_freeN(blends);
+}
+
+/** \} */
+
 void BKE_key_evaluate_relative(const int start, int end, const int tot, char *basispoin, Key *key, KeyBlock *actkb,
                                float **per_keyblock_weights, const int mode)
 {
@@ -737,6 +1126,11 @@ void BKE_key_evaluate_relative(const int start, int end, const int tot, char *ba
 
 	if (end > tot) end = tot;
 
+	if (mode == KEY_MODE_DUMMY && key->elemsize == sizeof(float[3]) && key->refkey) {
+		key_evaluate_relative_coords(start, end, tot, (float *)basispoin, key, actkb, per_keyblock_weights);
+		return;
+	}
+
 	/* in case of beztriple */
 	elemstr[0] = 1;              /* nr of ipofloats */
 	elemstr[1] = IPO_BEZTRIPLE;
@@ -1618,6 +2012,8 @@ void BKE_keyblock_update_from_lattice(Lattice *lt, KeyBlock *kb)
 
 	BLI_assert(kb->totelem == lt->pntsu * lt->pntsv * lt->pntsw);
 
+	keyblock_sparse_free_changed(lt->key, kb);
+
 	tot = kb->totelem;
 	if (tot == 0) return;
 
@@ -1757,6 +2153,8 @@ void BKE_keyblock_update_from_mesh(Mesh *me, KeyBlock *kb)
 
 	BLI_assert(me->totvert == kb->totelem);
 
+	keyblock_sparse_free_changed(me->key, kb);
+
 	tot = me->totvert;
 	if (tot == 0) return;
 
@@ -1882,6 +2280,8 @@ void BKE_keyblock_update_from_vertcos(Object *ob, KeyBlock *kb, float (*vertCos)
 	}
 #endif
 
+	keyblock_sparse_free_changed(BKE_key_from_object(ob), kb);
+
 	tot = kb->totelem;
 	if (tot == 0) return;
 
@@ -1921,6 +2321,7 @@ void BKE_keyblock_convert_from_vertcos(Object *ob, KeyBlock *kb, float (*vertCos
 {
 	int tot = 0, elemsize;
 
+	keyblock_sparse_free_changed(BKE_key_from_object(ob), kb);
 	MEM_SAFE_FREE(kb->data);
 
 	/* Count of vertex coords in array */
@@ -2012,6 +2413,8 @@ void BKE_keyblock_update_from_offset(Object *ob, KeyBlock *kb, float (*ofs)[3])
 	int a;
 	float *fp = kb->data;
 
+	keyblock_sparse_free_changed(BKE_key_from_object(ob), kb);
+
 	if (ELEM(ob->type, OB_MESH, OB_LATTICE)) {
 		for (a = 0; a < kb->totelem; a++, fp += 3, ofs++) {
 			add_v3_v3(fp, *ofs);
@@ -2072,6 +2475,9 @@ bool BKE_keyblock_move(Object *ob, int org_index, int new_index)
 		return false;
 	}
 
+	/* the reference key may change */
+	BKE_key_sparse_free(key);
+
 	rev = ((new_index - org_index) < 0) ? true : false;
 
 	/* We swap 'org' element with its previous/next neighbor (depending on direction of the move) repeatedly,
@@ -40,6 +40,7 @@
 #include "BLI_listbase.h"
 #include "BLI_bitmap.h"
 #include "BLI_math.h"
+#include "BLI_task.h"
 
 #include "DNA_mesh_types.h"
 #include "DNA_meshdata_types.h"
@@ -338,9 +339,16 @@ void BKE_lattice_make_local(Main *bmain, Lattice *lt, const bool lib_local)
 	BKE_id_make_local_generic(bmain, &lt->id, true, lib_local);
 }
 
+/* Minimal number of vertices deformed by a single thread. */
+#define DEFORM_VERTS_PER_THREAD 1024
+
 typedef struct LatticeDeformData {
 	Object *object;
+	/* Lattice points are taken from, the edit lattice in edit-mode. */
+	Lattice *lattice;
 	float *latticedata;
+	/* Weight of every lattice point in the vertex group of the lattice, NULL when not used. */
+	float *latticeweights;
 	float latmat[4][4];
 } LatticeDeformData;
 
@@ -354,13 +362,29 @@ LatticeDeformData *init_latt_deform(Object *oblatt, Object *ob)
 	float *fp, imat[4][4];
 	float fu, fv, fw;
 	int u, v, w;
-	float *latticedata;
+	float *latticedata, *latticeweights = NULL;
 	float latmat[4][4];
 	LatticeDeformData *lattice_deform_data;
+	MDeformVert *dvert = BKE_lattice_deform_verts_get(oblatt);
+	int a;
 
 	if (lt->editlatt) lt = lt->editlatt->latt;
 	bp = lt->def;
 
+	/* vgroup influence, looked up once for all points instead of for every deformed vertex */
+	if (lt->vgroup[0] && dvert) {
+		const int defgrp_index = defgroup_name_index(oblatt, lt->vgroup);
+
+		if (defgrp_index != -1) {
+			const int tot = lt->pntsu * lt->pntsv * lt->pntsw;
+
+			latticeweights = MEM_mallocN(sizeof(float) * tot, "latticeweights");
+			for (a = 0; a < tot; a++) {
+				latticeweights[a] = defvert_find_weight(dvert + a, defgrp_index);
+			}
+		}
+	}
+
 	fp = latticedata = MEM_mallocN(sizeof(float) * 3 * lt->pntsu * lt->pntsv * lt->pntsw, "latticedata");
 
 	/* for example with a particle system: (ob == NULL) */
@@ -401,7 +425,9 @@ LatticeDeformData *init_latt_deform(Object *oblatt, Object *ob)
 
 	lattice_deform_data = MEM_mallocN(sizeof(LatticeDeformData), "Lattice Deform Data");
 	lattice_deform_data->latticedata = latticedata;
+	lattice_deform_data->latticeweights = latticeweights;
 	lattice_deform_data->object = oblatt;
+	lattice_deform_data->lattice = lt;
 	copy_m4_m4(lattice_deform_data->latmat, latmat);
 
 	return lattice_deform_data;
@@ -409,24 +435,19 @@ LatticeDeformData *init_latt_deform(Object *oblatt, Object *ob)
 
 void calc_latt_deform(LatticeDeformData *lattice_deform_data, float co[3], float weight)
 {
-	Object *ob = lattice_deform_data->object;
-	Lattice *lt = ob->data;
+	const Lattice *lt = lattice_deform_data->lattice;
+	const float *latticeweights = lattice_deform_data->latticeweights;
 	float u, v, w, tu[4], tv[4], tw[4];
 	float vec[3];
 	int idx_w, idx_v, idx_u;
 	int ui, vi, wi, uu, vv, ww;
 
 	/* vgroup influence */
-	int defgrp_index = -1;
 	float co_prev[3], weight_blend = 0.0f;
-	MDeformVert *dvert = BKE_lattice_deform_verts_get(ob);
-
 
-	if (lt->editlatt) lt = lt->editlatt->latt;
 	if (lattice_deform_data->latticedata == NULL) return;
 
-	if (lt->vgroup[0] && dvert) {
-		defgrp_index = defgroup_name_index(ob, lt->vgroup);
+	if (latticeweights) {
 		copy_v3_v3(co_prev, co);
 	}
 
@@ -506,8 +527,8 @@ void calc_latt_deform(LatticeDeformData *lattice_deform_data, float co[3], float
 
 							madd_v3_v3fl(co, &lattice_deform_data->latticedata[idx_u * 3], u);
 
-							if (defgrp_index != -1)
-								weight_blend += (u * defvert_find_weight(dvert + idx_u, defgrp_index));
+							if (latticeweights)
+								weight_blend += (u * latticeweights[idx_u]);
 						}
 					}
 				}
@@ -515,7 +536,7 @@ void calc_latt_deform(LatticeDeformData *lattice_deform_data, float co[3], float
 		}
 	}
 
-	if (defgrp_index != -1)
+	if (latticeweights)
 		interp_v3_v3v3(co, co_prev, co, weight_blend);
 
 }
@@ -524,6 +545,8 @@ void end_latt_deform(LatticeDeformData *lattice_deform_data)
 {
 	if (lattice_deform_data->latticedata)
 		MEM_freeN(lattice_deform_data->latticedata);
+	if (lattice_deform_data->latticeweights)
+		MEM_freeN(lattice_deform_data->latticeweights);
 
 	MEM_freeN(lattice_deform_data);
 }
@@ -704,13 +727,93 @@ static bool calc_curve_deform(Scene *scene, Object *par, float co[3],
 	return false;
 }
 
+typedef struct CurveDeformVertsData {
+	Scene *scene;
+	Object *cuOb;
+	CurveDeform *cd;
+	float (*vertexCos)[3];
+	MDeformVert *dvert;
+	int defgrp_index;
+	short defaxis;
+	/* Coordinates are already in 'cd->curvespace', transformed while computing the bounds. */
+	bool is_curvespace;
+} CurveDeformVertsData;
+
+typedef struct CurveDeformBounds {
+	float min[3], max[3];
+} CurveDeformBounds;
+
+static void curve_deform_bounds_cb(
+        void *__restrict userdata,
+        const int a,
+        const ParallelRangeTLS *__restrict tls)
+{
+	const CurveDeformVertsData *data = userdata;
+	CurveDeformBounds *bounds = tls->userdata_chunk;
+
+	if (data->dvert == NULL || defvert_find_weight(&data->dvert[a], data->defgrp_index) > 0.0f) {
+		mul_m4_v3(data->cd->curvespace, data->vertexCos[a]);
+		minmax_v3v3_v3(bounds->min, bounds->max, data->vertexCos[a]);
+	}
+}
+
+static void curve_deform_bounds_reduce(
+        const void *__restrict UNUSED(userdata),
+        void *__restrict chunk_join,
+        void *__restrict userdata_chunk)
+{
+	CurveDeformBounds *join = chunk_join;
+	const CurveDeformBounds *bounds = userdata_chunk;
+
+	/* chunks without weighted vertices keep their initial (inverted) bounds */
+	if (bounds->min[0] > bounds->max[0]) {
+		return;
+	}
+
+	minmax_v3v3_v3(join->min, join->max, bounds->min);
+	minmax_v3v3_v3(join->min, join->max, bounds->max);
+}
+
+static void curve_deform_vert_cb(
+        void *__restrict userdata,
+        const int a,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	const CurveDeformVertsData *data = userdata;
+	float *co = data->vertexCos[a];
+
+	if (data->dvert) {
+		const float weight = defvert_find_weight(&data->dvert[a], data->defgrp_index);
+
+		if (weight > 0.0f) {
+			float vec[3];
+
+			if (!data->is_curvespace) {
+				mul_m4_v3(data->cd->curvespace, co);
+			}
+			copy_v3_v3(vec, co);
+			calc_curve_deform(data->scene, data->cuOb, vec, data->defaxis, data->cd, NULL);
+			interp_v3_v3v3(co, co, vec, weight);
+			mul_m4_v3(data->cd->objectspace, co);
+		}
+	}
+	else {
+		if (!data->is_curvespace) {
+			mul_m4_v3(data->cd->curvespace, co);
+		}
+		calc_curve_deform(data->scene, data->cuOb, co, data->defaxis, data->cd, NULL);
+		mul_m4_v3(data->cd->objectspace, co);
+	}
+}
+
 void curve_deform_verts(
         Scene *scene, Object *cuOb, Object *target, DerivedMesh *dm, float (*vertexCos)[3],
         int numVerts, const char *vgroup, short defaxis)
 {
 	Curve *cu;
-	int a;
 	CurveDeform cd;
+	CurveDeformVertsData data;
+	ParallelRangeSettings settings;
 	MDeformVert *dvert = NULL;
 	int defgrp_index = -1;
 	const bool is_neg_axis = (defaxis > 2);
@@ -753,71 +856,44 @@ void curve_deform_verts(
 		}
 	}
 
-	if (dvert) {
-		MDeformVert *dvert_iter;
-		float vec[3];
-
-		if (cu->flag & CU_DEFORM_BOUNDS_OFF) {
-			for (a = 0, dvert_iter = dvert; a < numVerts; a++, dvert_iter++) {
-				const float weight = defvert_find_weight(dvert_iter, defgrp_index);
-
-				if (weight > 0.0f) {
-					mul_m4_v3(cd.curvespace, vertexCos[a]);
-					copy_v3_v3(vec, vertexCos[a]);
-					calc_curve_deform(scene, cuOb, vec, defaxis, &cd, NULL);
-					interp_v3_v3v3(vertexCos[a], vertexCos[a], vec, weight);
-					mul_m4_v3(cd.objectspace, vertexCos[a]);
-				}
-			}
-		}
-		else {
-			/* set mesh min/max bounds */
-			INIT_MINMAX(cd.dmin, cd.dmax);
-
-			for (a = 0, dvert_iter = dvert; a < numVerts; a++, dvert_iter++) {
-				if (defvert_find_weight(dvert_iter, defgrp_index) > 0.0f) {
-					mul_m4_v3(cd.curvespace, vertexCos[a]);
-					minmax_v3v3_v3(cd.dmin, cd.dmax, vertexCos[a]);
-				}
-			}
-
-			for (a = 0, dvert_iter = dvert; a < numVerts; a++, dvert_iter++) {
-				const float weight = defvert_find_weight(dvert_iter, defgrp_index);
-
-				if (weight > 0.0f) {
-					/* already in 'cd.curvespace', prev for loop */
-					copy_v3_v3(vec, vertexCos[a]);
-					calc_curve_deform(scene, cuOb, vec, defaxis, &cd, NULL);
-					interp_v3_v3v3(vertexCos[a], vertexCos[a], vec, weight);
-					mul_m4_v3(cd.objectspace, vertexCos[a]);
-				}
-			}
-		}
+	/* calc_curve_deform() can't build the path from the threads */
+#ifdef CYCLIC_DEPENDENCY_WORKAROUND
+	if (cuOb->curve_cache == NULL) {
+		BKE_displist_make_curveTypes(scene, cuOb, false);
 	}
-	else {
-		if (cu->flag & CU_DEFORM_BOUNDS_OFF) {
-			for (a = 0; a < numVerts; a++) {
-				mul_m4_v3(cd.curvespace, vertexCos[a]);
-				calc_curve_deform(scene, cuOb, vertexCos[a], defaxis, &cd, NULL);
-				mul_m4_v3(cd.objectspace, vertexCos[a]);
-			}
-		}
-		else {
-			/* set mesh min max bounds */
-			INIT_MINMAX(cd.dmin, cd.dmax);
-
-			for (a = 0; a < numVerts; a++) {
-				mul_m4_v3(cd.curvespace, vertexCos[a]);
-				minmax_v3v3_v3(cd.dmin, cd.dmax, vertexCos[a]);
-			}
+#endif
 
-			for (a = 0; a < numVerts; a++) {
-				/* already in 'cd.curvespace', prev for loop */
-				calc_curve_deform(scene, cuOb, vertexCos[a], defaxis, &cd, NULL);
-				mul_m4_v3(cd.objectspace, vertexCos[a]);
-			}
-		}
-	}
+	data.scene = scene;
+	data.cuOb = cuOb;
+	data.cd = &cd;
+	data.vertexCos = vertexCos;
+	data.dvert = dvert;
+	data.defgrp_index = defgrp_index;
+	data.defaxis = defaxis;
+	data.is_curvespace = false;
+
+	BLI_parallel_range_settings_defaults(&settings);
+	settings.min_iter_per_thread = DEFORM_VERTS_PER_THREAD;
+
+	if ((cu->flag & CU_DEFORM_BOUNDS_OFF) == 0) {
+		/* set mesh min/max bounds */
+		CurveDeformBounds bounds;
+		INIT_MINMAX(bounds.min, bounds.max);
+
+		settings.userdata_chunk = &bounds;
+		settings.userdata_chunk_size = sizeof(bounds);
+		settings.func_reduce = curve_deform_bounds_reduce;
+		BLI_task_parallel_range(0, numVerts, &data, curve_deform_bounds_cb, &settings);
+		settings.userdata_chunk = NULL;
+		settings.userdata_chunk_size = 0;
+		settings.func_reduce = NULL;
+
+		copy_v3_v3(cd.dmin, bounds.min);
+		copy_v3_v3(cd.dmax, bounds.max);
+		data.is_curvespace = true;
+	}
+
+	BLI_task_parallel_range(0, numVerts, &data, curve_deform_vert_cb, &settings);
 }
 
 /* input vec and orco = local coord in armature space */
@@ -855,13 +931,38 @@ void curve_deform_vector(Scene *scene, Object *cuOb, Object *target,
 
 }
 
+typedef struct LatticeDeformVertsData {
+	LatticeDeformData *lattice_deform_data;
+	float (*vertexCos)[3];
+	MDeformVert *dvert;
+	int defgrp_index;
+	float fac;
+} LatticeDeformVertsData;
+
+static void lattice_deform_vert_cb(
+        void *__restrict userdata,
+        const int a,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	const LatticeDeformVertsData *data = userdata;
+
+	if (data->dvert) {
+		const float weight = defvert_find_weight(&data->dvert[a], data->defgrp_index);
+		if (weight > 0.0f) {
+			calc_latt_deform(data->lattice_deform_data, data->vertexCos[a], weight * data->fac);
+		}
+	}
+	else {
+		calc_latt_deform(data->lattice_deform_data, data->vertexCos[a], data->fac);
+	}
+}
+
 void lattice_deform_verts(Object *laOb, Object *target, DerivedMesh *dm,
                           float (*vertexCos)[3], int numVerts, const char *vgroup, float fac)
 {
 	LatticeDeformData *lattice_deform_data;
 	MDeformVert *dvert = NULL;
 	int defgrp_index = -1;
-	int a;
 
 	if (laOb->type != OB_LATTICE)
 		return;
@@ -887,20 +988,18 @@ void lattice_deform_verts(Object *laOb, Object *target, DerivedMesh *dm,
 			}
 		}
 	}
-	if (dvert) {
-		MDeformVert *dvert_iter;
-		for (a = 0, dvert_iter = dvert; a < numVerts; a++, dvert_iter++) {
-			const float weight = defvert_find_weight(dvert_iter, defgrp_index);
-			if (weight > 0.0f) {
-				calc_latt_deform(lattice_deform_data, vertexCos[a], weight * fac);
-			}
-		}
-	}
-	else {
-		for (a = 0; a < numVerts; a++) {
-			calc_latt_deform(lattice_deform_data, vertexCos[a], fac);
-		}
+
+	{
+		LatticeDeformVertsData data = {
+		    .lattice_deform_data = lattice_deform_data, .vertexCos = vertexCos,
+		    .dvert = dvert, .defgrp_index = defgrp_index, .fac = fac
+		};
+		ParallelRangeSettings settings;
+		BLI_parallel_range_settings_defaults(&settings);
+		settings.min_iter_per_thread = DEFORM_VERTS_PER_THREAD;
+		BLI_task_parallel_range(0, numVerts, &data, lattice_deform_vert_cb, &settings);
 	}
+
 	end_latt_deform(lattice_deform_data);
 }
 
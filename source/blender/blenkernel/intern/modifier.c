@@ -185,6 +185,38 @@ bool modifier_dependsOnTime(ModifierData *md)
 	return mti->dependsOnTime && mti->dependsOnTime(md);
 }
 
+static void modifier_has_links_cb(void *userData, Object *UNUSED(ob), ID **idpoin, int UNUSED(cb_flag))
+{
+	if (*idpoin) {
+		*((bool *)userData) = true;
+	}
+}
+
+/**
+ * Check whether the result of the modifier only depends on its settings and its input,
+ * so it can be reused as long as they don't change.
+ * This is not the case for modifiers depending on time, linking to other IDs
+ * (objects, textures...) or using other data (see #eModifierTypeFlag_UsesImplicitInputs).
+ */
+bool modifier_isStatic(Object *ob, ModifierData *md)
+{
+	const ModifierTypeInfo *mti = modifierType_getInfo(md->type);
+	bool has_links = false;
+
+	if ((mti->flags & eModifierTypeFlag_UsesImplicitInputs) || modifier_dependsOnTime(md)) {
+		return false;
+	}
+
+	if (mti->foreachIDLink) {
+		mti->foreachIDLink(md, ob, modifier_has_links_cb, &has_links);
+	}
+	else if (mti->foreachObjectLink) {
+		mti->foreachObjectLink(md, ob, (ObjectWalkFunc)modifier_has_links_cb, &has_links);
+	}
+
+	return !has_links;
+}
+
 bool modifier_supportsMapping(ModifierData *md)
 {
 	const ModifierTypeInfo *mti = modifierType_getInfo(md->type);
@@ -723,6 +755,29 @@ bool modifiers_isPreview(Object *ob)
 	return false;
 }
 
+/* Fraction of the enabled modifiers in the stack which evaluate in parallel on their own.
+ * Objects with a low fraction keep a single thread busy for all of their evaluation. */
+float modifiers_getThreadedFraction(struct Scene *scene, Object *ob)
+{
+	ModifierData *md = ob->modifiers.first;
+	int num_enabled = 0, num_threaded = 0;
+
+	for (; md; md = md->next) {
+		const ModifierTypeInfo *mti = modifierType_getInfo(md->type);
+
+		if (!modifier_isEnabled(scene, md, eModifierMode_Realtime)) {
+			continue;
+		}
+
+		num_enabled++;
+		if (mti->flags & eModifierTypeFlag_UsesThreads) {
+			num_threaded++;
+		}
+	}
+
+	return (num_enabled != 0) ? (float)num_threaded / (float)num_enabled : 0.0f;
+}
+
 void modifier_freeTemporaryData(ModifierData *md)
 {
 	if (md->type == eModifierType_Armature) {
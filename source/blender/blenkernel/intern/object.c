@@ -396,6 +396,9 @@ void BKE_object_free_caches(Object *object)
 		}
 	}
 
+	/* Only speeds up following evaluations, no need to update. */
+	mesh_free_modifier_stack_cache(object);
+
 	/* Tag object for update, so once memory critical operation is over and
 	 * scene update routines are back to it's business the object will be
 	 * guaranteed to be in a known state.
@@ -464,6 +467,8 @@ void BKE_object_free(Object *ob)
 		ob->curve_cache = NULL;
 	}
 
+	mesh_free_modifier_stack_cache(ob);
+
 	BKE_previewimg_free(&ob->preview);
 }
 
@@ -1171,6 +1176,7 @@ void BKE_object_copy_data(Main *UNUSED(bmain), Object *ob_dst, const Object *ob_
 
 	ob_dst->derivedDeform = NULL;
 	ob_dst->derivedFinal = NULL;
+	ob_dst->modifier_stack_cache = NULL;
 
 	BLI_listbase_clear(&ob_dst->gpulamp);
 	BLI_listbase_clear(&ob_dst->pc_ids);
@@ -2988,6 +2994,7 @@ bool BKE_object_shapekey_remove(Main *bmain, Object *ob, KeyBlock *kb)
 
 	BLI_remlink(&key->block, kb);
 	key->totkey--;
+	BKE_key_sparse_free(key);
 	if (key->refkey == kb) {
 		key->refkey = key->block.first;
 
@@ -0,0 +1,77 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+#ifndef __BLI_CONCURRENT_HASH_H__
+#define __BLI_CONCURRENT_HASH_H__
+
+/** \file BLI_concurrent_hash.h
+ *  \ingroup bli
+ *
+ * ConcurrentHash is a thread-safe, insert-only hash-map using the same
+ * hash/compare callbacks as #GHash.
+ *
+ * Lookups never lock, insertions lock one of many stripes of the table,
+ * so threads only contend when they insert into the same stripe at once.
+ * Entries can't be removed individually, the map is meant to be filled
+ * by parallel builders and then read (or freed) as a whole.
+ */
+
+#include "BLI_compiler_attrs.h"
+#include "BLI_ghash.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct ConcurrentHash ConcurrentHash;
+
+/* Called with the stripe locked, at most once per key. */
+typedef void *(*ConcurrentHashCreateFP)(const void *key, void *userdata);
+
+/* ************************************************************************** */
+/* NOTE: These functions are NOT safe for use from threads. */
+
+ConcurrentHash *BLI_concurrent_hash_new_ex(
+        GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info,
+        const unsigned int nentries_reserve) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+ConcurrentHash *BLI_concurrent_hash_new(
+        GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+void BLI_concurrent_hash_free(ConcurrentHash *ch, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp);
+void BLI_concurrent_hash_clear(ConcurrentHash *ch, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp);
+
+/* ************************************************************************** */
+/* NOTE: These functions are safe for use from threads. */
+
+bool  BLI_concurrent_hash_add(ConcurrentHash *ch, void *key, void *val);
+void *BLI_concurrent_hash_lookup_or_add(ConcurrentHash *ch, void *key, void *val, bool *r_added);
+void *BLI_concurrent_hash_lookup_or_create(
+        ConcurrentHash *ch, void *key,
+        ConcurrentHashCreateFP createfp, void *userdata);
+void *BLI_concurrent_hash_lookup(const ConcurrentHash *ch, const void *key) ATTR_WARN_UNUSED_RESULT;
+void *BLI_concurrent_hash_lookup_default(
+        const ConcurrentHash *ch, const void *key, void *val_default) ATTR_WARN_UNUSED_RESULT;
+bool  BLI_concurrent_hash_haskey(const ConcurrentHash *ch, const void *key) ATTR_WARN_UNUSED_RESULT;
+unsigned int BLI_concurrent_hash_len(const ConcurrentHash *ch) ATTR_WARN_UNUSED_RESULT;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* __BLI_CONCURRENT_HASH_H__ */
@@ -0,0 +1,168 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+#ifndef __BLI_HASHMAP_H__
+#define __BLI_HASHMAP_H__
+
+/** \file BLI_hashmap.h
+ *  \ingroup bli
+ *
+ * HashMap is an open-addressing hash-map for integer or pointer keys,
+ * an alternative to #GHash when keys don't need custom hash/compare callbacks.
+ *
+ * Keys are stored inline (no per-entry allocation) and buckets are probed
+ * 16 at a time using one control byte per bucket, see hashmap.c for details.
+ *
+ * This is also used to implement a 'set' (see #HashSet below).
+ */
+
+#include "BLI_sys_types.h" /* for bool, uintptr_t */
+#include "BLI_compiler_attrs.h"
+#include "BLI_compiler_compat.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*HashMapValFreeFP)(void *val);
+
+typedef struct HashMap HashMap;
+
+typedef struct HashMapIterator {
+	const unsigned char *ctrl;
+	uintptr_t *keys;
+	void **vals;
+	unsigned int index;
+	unsigned int nbuckets;
+} HashMapIterator;
+
+typedef struct HashMapIterState {
+	unsigned int index;
+} HashMapIterState;
+
+/** \name HashMap API
+ *
+ * Defined in ``hashmap.c``
+ * \{ */
+
+HashMap *BLI_hashmap_new_ex(
+        const char *info,
+        const unsigned int nentries_reserve) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+HashMap *BLI_hashmap_new(const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+HashMap *BLI_hashmap_copy(HashMap *hm) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+void   BLI_hashmap_free(HashMap *hm, HashMapValFreeFP valfreefp);
+void   BLI_hashmap_reserve(HashMap *hm, const unsigned int nentries_reserve);
+void   BLI_hashmap_insert(HashMap *hm, uintptr_t key, void *val);
+bool   BLI_hashmap_reinsert(HashMap *hm, uintptr_t key, void *val, HashMapValFreeFP valfreefp);
+void  *BLI_hashmap_lookup(const HashMap *hm, uintptr_t key) ATTR_WARN_UNUSED_RESULT;
+void  *BLI_hashmap_lookup_default(const HashMap *hm, uintptr_t key, void *val_default) ATTR_WARN_UNUSED_RESULT;
+void **BLI_hashmap_lookup_p(HashMap *hm, uintptr_t key) ATTR_WARN_UNUSED_RESULT;
+bool   BLI_hashmap_ensure_p(HashMap *hm, uintptr_t key, void ***r_val) ATTR_WARN_UNUSED_RESULT;
+bool   BLI_hashmap_remove(HashMap *hm, uintptr_t key, HashMapValFreeFP valfreefp);
+void  *BLI_hashmap_popkey(HashMap *hm, uintptr_t key) ATTR_WARN_UNUSED_RESULT;
+bool   BLI_hashmap_haskey(const HashMap *hm, uintptr_t key) ATTR_WARN_UNUSED_RESULT;
+bool   BLI_hashmap_pop(
+        HashMap *hm, HashMapIterState *state,
+        uintptr_t *r_key, void **r_val) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL();
+void   BLI_hashmap_clear(HashMap *hm, HashMapValFreeFP valfreefp);
+void   BLI_hashmap_clear_ex(
+        HashMap *hm, HashMapValFreeFP valfreefp,
+        const unsigned int nentries_reserve);
+unsigned int BLI_hashmap_len(const HashMap *hm) ATTR_WARN_UNUSED_RESULT;
+
+/** \} */
+
+/** \name HashMap Iterator
+ * \{ */
+
+void BLI_hashmapIterator_init(HashMapIterator *hmi, HashMap *hm);
+void BLI_hashmapIterator_step(HashMapIterator *hmi);
+
+BLI_INLINE uintptr_t BLI_hashmapIterator_getKey(HashMapIterator *hmi)   { return  hmi->keys[hmi->index]; }
+BLI_INLINE void     *BLI_hashmapIterator_getValue(HashMapIterator *hmi) { return  hmi->vals[hmi->index]; }
+BLI_INLINE void    **BLI_hashmapIterator_getValue_p(HashMapIterator *hmi) { return &hmi->vals[hmi->index]; }
+BLI_INLINE bool      BLI_hashmapIterator_done(HashMapIterator *hmi)     { return hmi->index == hmi->nbuckets; }
+
+#define HASHMAP_ITER(hm_iter_, hashmap_) \
+	for (BLI_hashmapIterator_init(&hm_iter_, hashmap_); \
+	     BLI_hashmapIterator_done(&hm_iter_) == false; \
+	     BLI_hashmapIterator_step(&hm_iter_))
+
+/** \} */
+
+/** \name HashSet API
+ * A 'set' implementation (unordered collection of unique integer or pointer keys).
+ *
+ * Internally this is a 'HashMap' without values,
+ * which is why this API's are in the same header & source file.
+ *
+ * \{ */
+
+typedef struct HashSet HashSet;
+
+typedef HashMapIterState HashSetIterState;
+
+HashSet *BLI_hashset_new_ex(
+        const char *info,
+        const unsigned int nentries_reserve) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+HashSet *BLI_hashset_new(const char *info) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+HashSet *BLI_hashset_copy(HashSet *hs) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT;
+void   BLI_hashset_free(HashSet *hs);
+void   BLI_hashset_reserve(HashSet *hs, const unsigned int nentries_reserve);
+void   BLI_hashset_insert(HashSet *hs, uintptr_t key);
+bool   BLI_hashset_add(HashSet *hs, uintptr_t key);
+bool   BLI_hashset_haskey(const HashSet *hs, uintptr_t key) ATTR_WARN_UNUSED_RESULT;
+bool   BLI_hashset_remove(HashSet *hs, uintptr_t key);
+bool   BLI_hashset_pop(HashSet *hs, HashSetIterState *state, uintptr_t *r_key) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL();
+void   BLI_hashset_clear(HashSet *hs);
+void   BLI_hashset_clear_ex(HashSet *hs, const unsigned int nentries_reserve);
+unsigned int BLI_hashset_len(const HashSet *hs) ATTR_WARN_UNUSED_RESULT;
+
+/** \} */
+
+/** \name HashSet Iterator
+ * \{ */
+
+/* so we can cast but compiler sees as different */
+typedef struct HashSetIterator {
+	HashMapIterator _hmi
+#ifdef __GNUC__
+	__attribute__ ((deprecated))
+#endif
+	;
+} HashSetIterator;
+
+BLI_INLINE void BLI_hashsetIterator_init(HashSetIterator *hsi, HashSet *hs) { BLI_hashmapIterator_init((HashMapIterator *)hsi, (HashMap *)hs); }
+BLI_INLINE void BLI_hashsetIterator_step(HashSetIterator *hsi) { BLI_hashmapIterator_step((HashMapIterator *)hsi); }
+BLI_INLINE uintptr_t BLI_hashsetIterator_getKey(HashSetIterator *hsi) { return BLI_hashmapIterator_getKey((HashMapIterator *)hsi); }
+BLI_INLINE bool BLI_hashsetIterator_done(HashSetIterator *hsi) { return BLI_hashmapIterator_done((HashMapIterator *)hsi); }
+
+#define HASHSET_ITER(hs_iter_, hashset_) \
+	for (BLI_hashsetIterator_init(&hs_iter_, hashset_); \
+	     BLI_hashsetIterator_done(&hs_iter_) == false; \
+	     BLI_hashsetIterator_step(&hs_iter_))
+
+/** \} */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BLI_HASHMAP_H__ */
@@ -84,6 +84,14 @@ enum {
 	 * \note order of iteration is only assured to be the order of allocation when no chunks have been freed.
 	 */
 	BLI_MEMPOOL_ALLOW_ITER = (1 << 0),
+	/** allow allocating and freeing from multiple threads.
+	 *
+	 * #BLI_mempool_alloc & #BLI_mempool_free lock the pool,
+	 * threads doing many allocations should use a #BLI_mempool_thread_cache each instead.
+	 *
+	 * \note iteration, clearing and destroying the pool are still not thread safe.
+	 */
+	BLI_MEMPOOL_THREADSAFE = (1 << 1),
 };
 
 void  BLI_mempool_iternew(BLI_mempool *pool, BLI_mempool_iter *iter) ATTR_NONNULL();
@@ -92,6 +100,21 @@ void *BLI_mempool_iterstep(BLI_mempool_iter *iter) ATTR_WARN_UNUSED_RESULT ATTR_
 BLI_mempool_iter *BLI_mempool_iter_threadsafe_create(BLI_mempool *pool, const size_t num_iter) ATTR_WARN_UNUSED_RESULT ATTR_NONNULL();
 void  BLI_mempool_iter_threadsafe_free(BLI_mempool_iter *iter_arr) ATTR_NONNULL();
 
+/**
+ * Per-thread allocation cache, for pools created with #BLI_MEMPOOL_THREADSAFE.
+ *
+ * Each thread keeps a private list of free elements, only locking the pool
+ * to take or return elements in batches. A cache must only be used by one thread at a time.
+ */
+typedef struct BLI_mempool_thread_cache BLI_mempool_thread_cache;
+
+BLI_mempool_thread_cache *BLI_mempool_thread_cache_create(BLI_mempool *pool) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_NONNULL();
+void  BLI_mempool_thread_cache_destroy(BLI_mempool_thread_cache *cache) ATTR_NONNULL();
+void *BLI_mempool_thread_cache_alloc(BLI_mempool_thread_cache *cache) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_NONNULL();
+void *BLI_mempool_thread_cache_calloc(BLI_mempool_thread_cache *cache) ATTR_MALLOC ATTR_WARN_UNUSED_RESULT ATTR_NONNULL();
+void  BLI_mempool_thread_cache_free(BLI_mempool_thread_cache *cache, void *addr) ATTR_NONNULL();
+void  BLI_mempool_thread_cache_flush(BLI_mempool_thread_cache *cache) ATTR_NONNULL();
+
 #ifdef __cplusplus
 }
 #endif
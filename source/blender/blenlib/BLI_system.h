@@ -30,6 +30,12 @@
 int BLI_cpu_support_sse2(void);
 void BLI_system_backtrace(FILE *fp);
 
+/* NUMA topology */
+int BLI_system_numa_num_nodes(void);
+int BLI_system_numa_node_of_cpu(int cpu);
+bool BLI_system_thread_bind_numa_node(int node);
+void BLI_system_numa_num_nodes_override_set(int num);
+
 /* getpid */
 #ifdef WIN32
 #  define BLI_SYSTEM_PID_H <process.h>
@@ -41,8 +41,10 @@ struct BLI_mempool;
 
 /* Task Scheduler
  *
- * Central scheduler that holds running threads ready to execute tasks. A single
- * queue holds the task from all pools.
+ * Central scheduler that holds running threads ready to execute tasks. Each
+ * thread has its own work-stealing deque of tasks pushed from it, idle threads
+ * steal tasks from deques of other threads. Tasks pushed from threads which are
+ * not known to the scheduler and low priority tasks go to a single global queue.
  *
  * Init/exit must be called before/after any task pools are created/freed, and
  * must be called from the main threads. All other scheduler and pool functions
@@ -55,10 +57,19 @@ enum {
 	TASK_SCHEDULER_SINGLE_THREAD = 1
 };
 
+typedef enum eTaskSchedulerFlag {
+	/* Distribute threads across NUMA nodes and pin them to their nodes. Threads
+	 * prefer tasks from threads of their own node before stealing across nodes.
+	 */
+	TASK_SCHEDULER_USE_NUMA = (1 << 0),
+} eTaskSchedulerFlag;
+
 TaskScheduler *BLI_task_scheduler_create(int num_threads);
+TaskScheduler *BLI_task_scheduler_create_ex(int num_threads, const int flag);
 void BLI_task_scheduler_free(TaskScheduler *scheduler);
 
 int BLI_task_scheduler_num_threads(TaskScheduler *scheduler);
+int BLI_task_scheduler_num_numa_nodes(TaskScheduler *scheduler);
 
 /* Task Pool
  *
@@ -110,6 +121,10 @@ void *BLI_task_pool_userdata(TaskPool *pool);
 /* optional mutex to use from run function */
 ThreadMutex *BLI_task_pool_user_mutex(TaskPool *pool);
 
+/* Thread ID of the thread which created the pool, to be used for pushing
+ * tasks from that thread with BLI_task_pool_push_from_thread(). */
+int BLI_task_pool_creator_thread_id(TaskPool *pool);
+
 /* Delayed push, use that to reduce thread overhead by accumulating
  * all new tasks into local queue first and pushing it to scheduler
  * from within a single mutex lock.
@@ -146,6 +161,9 @@ typedef struct ParallelRangeTLS {
 typedef void (*TaskParallelRangeFunc)(void *__restrict userdata,
                                       const int iter,
                                       const ParallelRangeTLS *__restrict tls);
+typedef void (*TaskParallelRangeFuncReduce)(const void *__restrict userdata,
+                                            void *__restrict chunk_join,
+                                            void *__restrict userdata_chunk);
 typedef void (*TaskParallelRangeFuncFinalize)(void *__restrict userdata,
                                               void *__restrict userdata_chunk);
 
@@ -165,7 +183,16 @@ typedef struct ParallelRangeSettings {
 	void *userdata_chunk;        /* Pointer to actual data. */
 	size_t userdata_chunk_size;  /* Size of that data.  */
 	/* Function called from calling thread once whole range have been
-	 * processed.
+	 * processed, to join every copy of the chunk into the original
+	 * userdata_chunk memory. This allows to use per-thread accumulators
+	 * without any locks, in which case userdata_chunk is to be initialized
+	 * with the identity value of the reduction (zero for sums, inverted
+	 * bounds for min/max and so on). Copies are joined in a deterministic
+	 * order.
+	 */
+	TaskParallelRangeFuncReduce func_reduce;
+	/* Function called from calling thread once whole range have been
+	 * processed, for every copy of the chunk (after func_reduce, if any).
 	 */
 	TaskParallelRangeFuncFinalize func_finalize;
 	/* Minimum allowed number of range iterators to be handled by a single
@@ -179,6 +206,11 @@ typedef struct ParallelRangeSettings {
 	 * having a global use_threading switch based on just range size.
 	 */
 	int min_iter_per_thread;
+	/* NUMA node which owns the data processed by the range, threads of this
+	 * node will preferably be used. Only used when scheduler runs in NUMA mode,
+	 * -1 means no preference.
+	 */
+	int numa_node;
 } ParallelRangeSettings;
 
 BLI_INLINE void BLI_parallel_range_settings_defaults(
@@ -208,6 +240,26 @@ void BLI_task_parallel_mempool(
         TaskParallelMempoolFunc func,
         const bool use_threading);
 
+/* Task Graph
+ *
+ * Graph of tasks with dependencies between them: a node is only executed after
+ * all nodes it depends on are done. Graph is built once and can be executed by
+ * the central TaskScheduler any number of times. */
+
+typedef struct TaskGraph TaskGraph;
+typedef struct TaskGraphNode TaskGraphNode;
+typedef void (*TaskGraphNodeRunFunction)(void *__restrict taskdata, int thread_id);
+typedef void (*TaskGraphNodeFreeFunction)(void *taskdata);
+
+TaskGraph *BLI_task_graph_create(void);
+void BLI_task_graph_free(TaskGraph *graph);
+TaskGraphNode *BLI_task_graph_node_create(
+        TaskGraph *graph, TaskGraphNodeRunFunction run_func,
+        void *taskdata, TaskGraphNodeFreeFunction free_func);
+void BLI_task_graph_edge_create(TaskGraph *graph, TaskGraphNode *from_node, TaskGraphNode *to_node);
+int BLI_task_graph_num_nodes(TaskGraph *graph);
+void BLI_task_graph_work_and_wait(TaskScheduler *scheduler, TaskGraph *graph);
+
 /* TODO(sergey): Think of a better place for this. */
 BLI_INLINE void BLI_parallel_range_settings_defaults(
         ParallelRangeSettings *settings)
@@ -220,6 +272,7 @@ BLI_INLINE void BLI_parallel_range_settings_defaults(
 	 * for both static and dynamic scheduling.
 	 */
 	settings->min_iter_per_thread = 1;
+	settings->numa_node = -1;
 }
 
 #ifdef __cplusplus
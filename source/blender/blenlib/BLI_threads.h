@@ -74,6 +74,8 @@ void BLI_threaded_malloc_end(void);
 int     BLI_system_thread_count(void); /* gets the number of threads the system can make use of */
 void    BLI_system_num_threads_override_set(int num);
 int     BLI_system_num_threads_override_get(void);
+void    BLI_system_numa_scheduling_set(bool use_numa);
+bool    BLI_system_numa_scheduling_get(void);
 
 /* Global Mutex Locks
  *
@@ -958,6 +958,7 @@ BVHTree *BLI_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis)
 {
 	BVHTree *tree;
 	int numnodes, i;
+	const int domain_prev = MEM_domain_thread_set(MEM_DOMAIN_BVH);
 
 	BLI_assert(tree_type >= 2 && tree_type <= MAX_TREETYPE);
 
@@ -1024,6 +1025,7 @@ BVHTree *BLI_bvhtree_new(int maxsize, float epsilon, char tree_type, char axis)
 		}
 
 	}
+	MEM_domain_thread_set(domain_prev);
 	return tree;
 
 
@@ -1035,6 +1037,7 @@ fail:
 
 	MEM_freeN(tree);
 
+	MEM_domain_thread_set(domain_prev);
 	return NULL;
 }
 
@@ -36,6 +36,8 @@
  * - Freeing chunks.
  * - Iterating over allocated chunks
  *   (optionally when using the #BLI_MEMPOOL_ALLOW_ITER flag).
+ * - Allocating from multiple threads
+ *   (optionally when using the #BLI_MEMPOOL_THREADSAFE flag).
  */
 
 #include <string.h>
@@ -55,6 +57,11 @@
 #  include "valgrind/memcheck.h"
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define MEMPOOL_CPU_PAUSE _mm_pause
+#endif
+
 /* note: copied from BLO_blend_defs.h, don't use here because we're in BLI */
 #ifdef __BIG_ENDIAN__
 /* Big Endian */
@@ -93,6 +100,9 @@
 /* optimize pool size */
 #define USE_CHUNK_POW2
 
+/* number of elements a thread cache takes from or returns to the pool at once */
+#define THREAD_CACHE_BATCH 64
+
 
 #ifndef NDEBUG
 static bool mempool_debug_memset = false;
@@ -141,6 +151,21 @@ struct BLI_mempool {
 #ifdef USE_TOTALLOC
 	uint totalloc;          /* number of elements allocated in total */
 #endif
+
+	/* only used with BLI_MEMPOOL_THREADSAFE, protects all of the above */
+	uint32_t lock;
+	/* elements held by thread caches are counted in 'totused' */
+	struct BLI_mempool_thread_cache *thread_caches;
+};
+
+/**
+ * Private free list of one thread, see #BLI_mempool_thread_cache_create.
+ */
+struct BLI_mempool_thread_cache {
+	struct BLI_mempool_thread_cache *next, *prev;
+	BLI_mempool *pool;
+	BLI_freenode *free;
+	uint totfree;
 };
 
 #define MEMPOOL_ELEM_SIZE_MIN (sizeof(void *) * 2)
@@ -207,6 +232,26 @@ static BLI_mempool_chunk *mempool_chunk_alloc(BLI_mempool *pool)
 	return mpchunk;
 }
 
+/**
+ * Minimal spin-lock, the pool is also built into makesdna which doesn't link BLI_threads.
+ */
+BLI_INLINE void mempool_lock(BLI_mempool *pool)
+{
+	while (atomic_cas_uint32(&pool->lock, 0, 1) != 0) {
+		/* wait for the lock to be released before trying again, without hammering the cache line */
+		while (*(volatile uint32_t *)&pool->lock != 0) {
+#ifdef MEMPOOL_CPU_PAUSE
+			MEMPOOL_CPU_PAUSE();
+#endif
+		}
+	}
+}
+
+BLI_INLINE void mempool_unlock(BLI_mempool *pool)
+{
+	atomic_cas_uint32(&pool->lock, 1, 0);
+}
+
 /**
  * Initialize a chunk and add into \a pool->chunks
  *
@@ -336,6 +381,9 @@ BLI_mempool *BLI_mempool_create(uint esize, uint totelem,
 	pool->totalloc = 0;
 #endif
 	pool->totused = 0;
+	pool->thread_caches = NULL;
+
+	pool->lock = 0;
 
 	if (totelem) {
 		/* allocate the actual chunks */
@@ -356,6 +404,10 @@ void *BLI_mempool_alloc(BLI_mempool *pool)
 {
 	BLI_freenode *free_pop;
 
+	if (pool->flag & BLI_MEMPOOL_THREADSAFE) {
+		mempool_lock(pool);
+	}
+
 	if (UNLIKELY(pool->free == NULL)) {
 		/* need to allocate a new chunk */
 		BLI_mempool_chunk *mpchunk = mempool_chunk_alloc(pool);
@@ -373,6 +425,10 @@ void *BLI_mempool_alloc(BLI_mempool *pool)
 	pool->free = free_pop->next;
 	pool->totused++;
 
+	if (pool->flag & BLI_MEMPOOL_THREADSAFE) {
+		mempool_unlock(pool);
+	}
+
 #ifdef WITH_MEM_VALGRIND
 	VALGRIND_MEMPOOL_ALLOC(pool, free_pop, pool->esize);
 #endif
@@ -396,6 +452,10 @@ void BLI_mempool_free(BLI_mempool *pool, void *addr)
 {
 	BLI_freenode *newhead = addr;
 
+	if (pool->flag & BLI_MEMPOOL_THREADSAFE) {
+		mempool_lock(pool);
+	}
+
 #ifndef NDEBUG
 	{
 		BLI_mempool_chunk *chunk;
@@ -472,11 +532,19 @@ void BLI_mempool_free(BLI_mempool *pool, void *addr)
 		VALGRIND_MEMPOOL_FREE(pool, CHUNK_DATA(first));
 #endif
 	}
+
+	if (pool->flag & BLI_MEMPOOL_THREADSAFE) {
+		mempool_unlock(pool);
+	}
 }
 
 int BLI_mempool_len(BLI_mempool *pool)
 {
-	return (int)pool->totused;
+	uint totused = pool->totused;
+	for (BLI_mempool_thread_cache *cache = pool->thread_caches; cache; cache = cache->next) {
+		totused -= cache->totfree;
+	}
+	return (int)totused;
 }
 
 void *BLI_mempool_findelem(BLI_mempool *pool, uint index)
@@ -743,6 +811,10 @@ void BLI_mempool_clear_ex(BLI_mempool *pool, const int totelem_reserve)
 	/* re-initialize */
 	pool->free = NULL;
 	pool->totused = 0;
+	for (BLI_mempool_thread_cache *cache = pool->thread_caches; cache; cache = cache->next) {
+		cache->free = NULL;
+		cache->totfree = 0;
+	}
 #ifdef USE_TOTALLOC
 	pool->totalloc = 0;
 #endif
@@ -770,6 +842,8 @@ void BLI_mempool_clear(BLI_mempool *pool)
  */
 void BLI_mempool_destroy(BLI_mempool *pool)
 {
+	BLI_assert(pool->thread_caches == NULL);
+
 	mempool_chunk_free_all(pool->chunks);
 
 #ifdef WITH_MEM_VALGRIND
@@ -779,6 +853,201 @@ void BLI_mempool_destroy(BLI_mempool *pool)
 	MEM_freeN(pool);
 }
 
+/**
+ * Create a cache for allocating from \a pool in one thread, without locking the pool for every element.
+ *
+ * \note The pool must have the #BLI_MEMPOOL_THREADSAFE flag.
+ * Caches must be destroyed before the pool, clearing the pool empties them.
+ */
+BLI_mempool_thread_cache *BLI_mempool_thread_cache_create(BLI_mempool *pool)
+{
+	BLI_mempool_thread_cache *cache = MEM_mallocN(sizeof(*cache), __func__);
+
+	BLI_assert(pool->flag & BLI_MEMPOOL_THREADSAFE);
+
+	cache->pool = pool;
+	cache->free = NULL;
+	cache->totfree = 0;
+	cache->prev = NULL;
+
+	mempool_lock(pool);
+	cache->next = pool->thread_caches;
+	if (cache->next) {
+		cache->next->prev = cache;
+	}
+	pool->thread_caches = cache;
+	mempool_unlock(pool);
+
+	return cache;
+}
+
+/**
+ * Return all free elements of \a cache to its pool and free the cache.
+ */
+void BLI_mempool_thread_cache_destroy(BLI_mempool_thread_cache *cache)
+{
+	BLI_mempool *pool = cache->pool;
+
+	BLI_mempool_thread_cache_flush(cache);
+
+	mempool_lock(pool);
+	if (cache->prev) {
+		cache->prev->next = cache->next;
+	}
+	else {
+		pool->thread_caches = cache->next;
+	}
+	if (cache->next) {
+		cache->next->prev = cache->prev;
+	}
+	mempool_unlock(pool);
+
+	MEM_freeN(cache);
+}
+
+/**
+ * Move a batch of free elements from the pool into \a cache, allocating a new chunk when needed.
+ */
+static void mempool_thread_cache_refill(BLI_mempool_thread_cache *cache)
+{
+	BLI_mempool *pool = cache->pool;
+	BLI_freenode *head, *tail;
+	uint tot = 1;
+
+	mempool_lock(pool);
+
+	if (UNLIKELY(pool->free == NULL)) {
+		/* don't hold the lock while allocating */
+		BLI_mempool_chunk *mpchunk;
+		BLI_freenode *free_prev, *chunk_tail;
+
+		mempool_unlock(pool);
+		mpchunk = mempool_chunk_alloc(pool);
+		mempool_lock(pool);
+
+		/* other threads may have returned elements meanwhile, keep them after the new chunk */
+		free_prev = pool->free;
+		pool->free = NULL;
+		chunk_tail = mempool_chunk_add(pool, mpchunk, NULL);
+		chunk_tail->next = free_prev;
+	}
+
+	head = tail = pool->free;
+	while (tot < THREAD_CACHE_BATCH && tail->next) {
+		tail = tail->next;
+		tot++;
+	}
+	pool->free = tail->next;
+	pool->totused += tot;
+
+	mempool_unlock(pool);
+
+	tail->next = NULL;
+	cache->free = head;
+	cache->totfree = tot;
+}
+
+/**
+ * Move \a tot free elements from \a cache back into the pool.
+ */
+static void mempool_thread_cache_release(BLI_mempool_thread_cache *cache, uint tot)
+{
+	BLI_mempool *pool = cache->pool;
+	BLI_freenode *head = cache->free, *tail = head;
+
+	BLI_assert(tot != 0 && tot <= cache->totfree);
+
+	for (uint i = 1; i < tot; i++) {
+		tail = tail->next;
+	}
+	cache->free = tail->next;
+	cache->totfree -= tot;
+
+	mempool_lock(pool);
+	tail->next = pool->free;
+	pool->free = head;
+	pool->totused -= tot;
+	mempool_unlock(pool);
+}
+
+void *BLI_mempool_thread_cache_alloc(BLI_mempool_thread_cache *cache)
+{
+	BLI_freenode *free_pop;
+
+	if (UNLIKELY(cache->free == NULL)) {
+		mempool_thread_cache_refill(cache);
+	}
+
+	free_pop = cache->free;
+
+	if (cache->pool->flag & BLI_MEMPOOL_ALLOW_ITER) {
+		free_pop->freeword = USEDWORD;
+	}
+
+	cache->free = free_pop->next;
+	cache->totfree--;
+
+#ifdef WITH_MEM_VALGRIND
+	VALGRIND_MEMPOOL_ALLOC(cache->pool, free_pop, cache->pool->esize);
+#endif
+
+	return (void *)free_pop;
+}
+
+void *BLI_mempool_thread_cache_calloc(BLI_mempool_thread_cache *cache)
+{
+	void *retval = BLI_mempool_thread_cache_alloc(cache);
+	memset(retval, 0, (size_t)cache->pool->esize);
+	return retval;
+}
+
+/**
+ * Free an element into \a cache, the element may have been allocated by any thread.
+ *
+ * Unlike #BLI_mempool_free, chunks are not released when the pool becomes empty.
+ */
+void BLI_mempool_thread_cache_free(BLI_mempool_thread_cache *cache, void *addr)
+{
+	BLI_freenode *newhead = addr;
+
+#ifndef NDEBUG
+	if (UNLIKELY(mempool_debug_memset)) {
+		memset(addr, 255, cache->pool->esize);
+	}
+#endif
+
+	if (cache->pool->flag & BLI_MEMPOOL_ALLOW_ITER) {
+#ifndef NDEBUG
+		/* this will detect double free's */
+		BLI_assert(newhead->freeword != FREEWORD);
+#endif
+		newhead->freeword = FREEWORD;
+	}
+
+	newhead->next = cache->free;
+	cache->free = newhead;
+	cache->totfree++;
+
+#ifdef WITH_MEM_VALGRIND
+	VALGRIND_MEMPOOL_FREE(cache->pool, addr);
+#endif
+
+	/* keep a batch around for following allocations, return the rest */
+	if (UNLIKELY(cache->totfree >= THREAD_CACHE_BATCH * 2)) {
+		mempool_thread_cache_release(cache, THREAD_CACHE_BATCH);
+	}
+}
+
+/**
+ * Return all free elements of \a cache to the pool, so other threads can use them.
+ */
+void BLI_mempool_thread_cache_flush(BLI_mempool_thread_cache *cache)
+{
+	if (cache->totfree) {
+		mempool_thread_cache_release(cache, cache->totfree);
+	}
+}
+
 #ifndef NDEBUG
 void BLI_mempool_set_memory_debug(void)
 {
@@ -0,0 +1,408 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenlib/intern/concurrent_hash.c
+ *  \ingroup bli
+ *
+ * A striped, insert-only chaining hash table.
+ *
+ * The table is split into #CHASH_SEGMENTS independent segments selected by the top bits of the hash,
+ * each with its own lock, bucket array and memory arena.
+ *
+ * - Entries are immutable once linked into a bucket and are published with an atomic pointer swap,
+ *   so readers walk the chains without taking any lock.
+ * - Growing a segment builds a new bucket array with copies of all entries and swaps the array pointer,
+ *   the old array and entries stay valid for readers which already loaded it.
+ *   They are only released along with the segment's arena (on clear or free),
+ *   which bounds the overhead to roughly the size of the live entries.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_memarena.h"
+#include "BLI_threads.h"
+
+#include "BLI_concurrent_hash.h"  /* own include */
+
+#include "atomic_ops.h"
+
+/* keep last */
+#include "BLI_strict_flags.h"
+
+/* -------------------------------------------------------------------- */
+/** \name Structs & Constants
+ * \{ */
+
+#define CHASH_SEGMENTS_SHIFT 6
+#define CHASH_SEGMENTS (1 << CHASH_SEGMENTS_SHIFT)
+
+#define CHASH_MIN_BUCKETS 8
+
+#define CACHE_LINE_SIZE 64
+
+typedef struct CHashEntry {
+	struct CHashEntry *next;
+	void *key, *val;
+	uint hash;
+} CHashEntry;
+
+typedef struct CHashTable {
+	uint mask;
+	CHashEntry **buckets;  /* Allocated directly after the table. */
+} CHashTable;
+
+typedef struct CHashSegment {
+	/* Read without lock, replaced (never modified in-place) when growing. */
+	CHashTable *table;
+	uint nentries;
+
+	/* Protects insertions into this segment. */
+	ThreadMutex lock;
+	MemArena *arena;
+
+	/* Keep segments on separate cache lines. */
+	char _pad[CACHE_LINE_SIZE];
+} CHashSegment;
+
+struct ConcurrentHash {
+	GHashHashFP hashfp;
+	GHashCmpFP cmpfp;
+	uint nbuckets_init;
+
+	CHashSegment segments[CHASH_SEGMENTS];
+};
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Internal Utility API
+ * \{ */
+
+/**
+ * The segment uses the top bits and the bucket the low bits of the hash,
+ * mix user hashes (pointer hashes especially) so both are usable.
+ */
+BLI_INLINE uint chash_keyhash(const ConcurrentHash *ch, const void *key)
+{
+	uint h = ch->hashfp(key);
+	h ^= h >> 16;
+	h *= 0x85ebca6bu;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	h ^= h >> 16;
+	return h;
+}
+
+BLI_INLINE CHashSegment *chash_segment(const ConcurrentHash *ch, const uint hash)
+{
+	return (CHashSegment *)&ch->segments[hash >> (32 - CHASH_SEGMENTS_SHIFT)];
+}
+
+static CHashTable *chash_table_new(CHashSegment *seg, const uint nbuckets)
+{
+	CHashTable *table = BLI_memarena_alloc(seg->arena, sizeof(*table) + sizeof(*table->buckets) * nbuckets);
+	table->mask = nbuckets - 1;
+	table->buckets = (CHashEntry **)(table + 1);
+	memset(table->buckets, 0, sizeof(*table->buckets) * nbuckets);
+	return table;
+}
+
+static void chash_segment_init(CHashSegment *seg, const uint nbuckets)
+{
+	seg->arena = BLI_memarena_new(BLI_MEMARENA_STD_BUFSIZE, "ConcurrentHash segment");
+	seg->table = chash_table_new(seg, nbuckets);
+	seg->nentries = 0;
+	BLI_mutex_init(&seg->lock);
+}
+
+static void chash_segment_free(CHashSegment *seg, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	if (keyfreefp || valfreefp) {
+		const CHashTable *table = seg->table;
+		for (uint i = 0; i <= table->mask; i++) {
+			for (CHashEntry *e = table->buckets[i]; e; e = e->next) {
+				if (keyfreefp) {
+					keyfreefp(e->key);
+				}
+				if (valfreefp) {
+					valfreefp(e->val);
+				}
+			}
+		}
+	}
+
+	BLI_mutex_end(&seg->lock);
+	BLI_memarena_free(seg->arena);
+}
+
+/**
+ * Lock-free lookup, may run concurrently with insertions into the same segment.
+ */
+BLI_INLINE CHashEntry *chash_lookup_entry(const ConcurrentHash *ch, const void *key, const uint hash)
+{
+	const CHashSegment *seg = chash_segment(ch, hash);
+	const CHashTable *table = *(CHashTable *volatile *)&seg->table;
+	CHashEntry *e = *(CHashEntry *volatile *)&table->buckets[hash & table->mask];
+
+	for (; e; e = e->next) {
+		if (e->hash == hash && !ch->cmpfp(key, e->key)) {
+			return e;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Double the segment's bucket array and publish it, the previous array remains readable.
+ */
+static CHashTable *chash_segment_grow(CHashSegment *seg)
+{
+	const CHashTable *table_old = seg->table;
+	CHashTable *table = chash_table_new(seg, (table_old->mask + 1) * 2);
+	CHashEntry *entries = BLI_memarena_alloc(seg->arena, sizeof(*entries) * seg->nentries);
+
+	/* Entries reachable from the old array must not change, re-link copies instead. */
+	for (uint i = 0; i <= table_old->mask; i++) {
+		for (const CHashEntry *e_old = table_old->buckets[i]; e_old; e_old = e_old->next) {
+			CHashEntry *e = entries++;
+			const uint index = e_old->hash & table->mask;
+			*e = *e_old;
+			e->next = table->buckets[index];
+			table->buckets[index] = e;
+		}
+	}
+
+	/* Full barrier, the new array is complete before it can be seen. */
+	atomic_cas_ptr((void **)&seg->table, (void *)table_old, table);
+	return table;
+}
+
+/**
+ * Add an entry for \a key, caller must hold the segment lock and know the key isn't there.
+ */
+static void chash_segment_insert_locked(CHashSegment *seg, void *key, void *val, const uint hash)
+{
+	CHashTable *table = seg->table;
+	CHashEntry *e;
+	uint index;
+
+	if (seg->nentries > table->mask) {
+		table = chash_segment_grow(seg);
+	}
+
+	e = BLI_memarena_alloc(seg->arena, sizeof(*e));
+	index = hash & table->mask;
+	e->key = key;
+	e->val = val;
+	e->hash = hash;
+	e->next = table->buckets[index];
+
+	/* Full barrier, the entry is complete before it can be seen. */
+	atomic_cas_ptr((void **)&table->buckets[index], e->next, e);
+	atomic_add_and_fetch_u(&seg->nentries, 1);
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Public API
+ * \{ */
+
+/**
+ * Creates a new, empty ConcurrentHash.
+ *
+ * \param hashfp  Hash callback.
+ * \param cmpfp  Comparison callback.
+ * \param info  Identifier string for the ConcurrentHash.
+ * \param nentries_reserve  Optionally reserve the number of members that the hash will hold.
+ */
+ConcurrentHash *BLI_concurrent_hash_new_ex(
+        GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info,
+        const uint nentries_reserve)
+{
+	ConcurrentHash *ch = MEM_mallocN(sizeof(*ch), info);
+	uint nbuckets = CHASH_MIN_BUCKETS;
+
+	while (nbuckets * CHASH_SEGMENTS < nentries_reserve) {
+		nbuckets <<= 1;
+	}
+
+	ch->hashfp = hashfp;
+	ch->cmpfp = cmpfp;
+	ch->nbuckets_init = nbuckets;
+	for (int i = 0; i < CHASH_SEGMENTS; i++) {
+		chash_segment_init(&ch->segments[i], nbuckets);
+	}
+
+	return ch;
+}
+
+/**
+ * Wraps #BLI_concurrent_hash_new_ex with zero entries reserved.
+ */
+ConcurrentHash *BLI_concurrent_hash_new(GHashHashFP hashfp, GHashCmpFP cmpfp, const char *info)
+{
+	return BLI_concurrent_hash_new_ex(hashfp, cmpfp, info, 0);
+}
+
+/**
+ * Frees the ConcurrentHash and its members.
+ *
+ * \param keyfreefp  Optional callback to free the key.
+ * \param valfreefp  Optional callback to free the value.
+ */
+void BLI_concurrent_hash_free(ConcurrentHash *ch, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	for (int i = 0; i < CHASH_SEGMENTS; i++) {
+		chash_segment_free(&ch->segments[i], keyfreefp, valfreefp);
+	}
+	MEM_freeN(ch);
+}
+
+/**
+ * Remove all entries, also releasing memory kept for concurrent readers.
+ */
+void BLI_concurrent_hash_clear(ConcurrentHash *ch, GHashKeyFreeFP keyfreefp, GHashValFreeFP valfreefp)
+{
+	for (int i = 0; i < CHASH_SEGMENTS; i++) {
+		chash_segment_free(&ch->segments[i], keyfreefp, valfreefp);
+		chash_segment_init(&ch->segments[i], ch->nbuckets_init);
+	}
+}
+
+/**
+ * Insert a key/value pair unless \a key is already in \a ch.
+ *
+ * \returns true if a new key has been added.
+ */
+bool BLI_concurrent_hash_add(ConcurrentHash *ch, void *key, void *val)
+{
+	bool added;
+	BLI_concurrent_hash_lookup_or_add(ch, key, val, &added);
+	return added;
+}
+
+/**
+ * Insert a key/value pair unless \a key is already in \a ch.
+ *
+ * \param r_added  Optionally set to true when \a key was added.
+ * \returns the value stored for \a key, \a val when it was added.
+ */
+void *BLI_concurrent_hash_lookup_or_add(ConcurrentHash *ch, void *key, void *val, bool *r_added)
+{
+	const uint hash = chash_keyhash(ch, key);
+	CHashSegment *seg = chash_segment(ch, hash);
+	CHashEntry *e = chash_lookup_entry(ch, key, hash);
+	bool added = false;
+
+	if (e == NULL) {
+		BLI_mutex_lock(&seg->lock);
+		/* Another thread may have added it meanwhile. */
+		e = chash_lookup_entry(ch, key, hash);
+		if (e == NULL) {
+			chash_segment_insert_locked(seg, key, val, hash);
+			added = true;
+		}
+		BLI_mutex_unlock(&seg->lock);
+	}
+
+	if (r_added) {
+		*r_added = added;
+	}
+	return added ? val : e->val;
+}
+
+/**
+ * Lookup the value of \a key, creating it with \a createfp when it's not in \a ch.
+ *
+ * The value is only created once even when multiple threads request the same key,
+ * others wait for it to be created.
+ */
+void *BLI_concurrent_hash_lookup_or_create(
+        ConcurrentHash *ch, void *key,
+        ConcurrentHashCreateFP createfp, void *userdata)
+{
+	const uint hash = chash_keyhash(ch, key);
+	CHashSegment *seg = chash_segment(ch, hash);
+	CHashEntry *e = chash_lookup_entry(ch, key, hash);
+	void *val;
+
+	if (e != NULL) {
+		return e->val;
+	}
+
+	BLI_mutex_lock(&seg->lock);
+	e = chash_lookup_entry(ch, key, hash);
+	if (e == NULL) {
+		val = createfp(key, userdata);
+		chash_segment_insert_locked(seg, key, val, hash);
+	}
+	else {
+		val = e->val;
+	}
+	BLI_mutex_unlock(&seg->lock);
+
+	return val;
+}
+
+/**
+ * Lookup the value of \a key in \a ch, without locking.
+ *
+ * \returns the value for \a key or NULL.
+ */
+void *BLI_concurrent_hash_lookup(const ConcurrentHash *ch, const void *key)
+{
+	return BLI_concurrent_hash_lookup_default(ch, key, NULL);
+}
+
+/**
+ * A version of #BLI_concurrent_hash_lookup which accepts a fallback argument.
+ */
+void *BLI_concurrent_hash_lookup_default(const ConcurrentHash *ch, const void *key, void *val_default)
+{
+	const CHashEntry *e = chash_lookup_entry(ch, key, chash_keyhash(ch, key));
+	return e ? e->val : val_default;
+}
+
+/**
+ * \return true if the \a key is in \a ch.
+ */
+bool BLI_concurrent_hash_haskey(const ConcurrentHash *ch, const void *key)
+{
+	return (chash_lookup_entry(ch, key, chash_keyhash(ch, key)) != NULL);
+}
+
+/**
+ * \return size of the ConcurrentHash, only exact when no insertions are running.
+ */
+uint BLI_concurrent_hash_len(const ConcurrentHash *ch)
+{
+	uint nentries = 0;
+	for (int i = 0; i < CHASH_SEGMENTS; i++) {
+		nentries += *(volatile uint *)&ch->segments[i].nentries;
+	}
+	return nentries;
+}
+
+/** \} */
@@ -504,6 +504,48 @@ int BLI_rename(const char *from, const char *to)
 	return urename(from, to);
 }
 
+/**
+ * Move \a from to \a to, replacing \a to in one step when it exists,
+ * so there is no moment \a to is missing (unlike #BLI_rename).
+ */
+int BLI_rename_overwrite(const char *from, const char *to)
+{
+	int err;
+
+	UTF16_ENCODE(from);
+	UTF16_ENCODE(to);
+	err = !MoveFileExW(from_16, to_16, MOVEFILE_REPLACE_EXISTING);
+	UTF16_UN_ENCODE(to);
+	UTF16_UN_ENCODE(from);
+
+	/* callers report errno, as for rename() */
+	if (err) {
+		switch (GetLastError()) {
+			case ERROR_FILE_NOT_FOUND:
+			case ERROR_PATH_NOT_FOUND:
+				errno = ENOENT;
+				break;
+			case ERROR_ACCESS_DENIED:
+			case ERROR_SHARING_VIOLATION:
+			case ERROR_LOCK_VIOLATION:
+				errno = EACCES;
+				break;
+			case ERROR_NOT_SAME_DEVICE:
+				errno = EXDEV;
+				break;
+			case ERROR_DISK_FULL:
+			case ERROR_HANDLE_DISK_FULL:
+				errno = ENOSPC;
+				break;
+			default:
+				errno = EIO;
+				break;
+		}
+	}
+
+	return err;
+}
+
 #else /* The UNIX world */
 
 /* results from recursive_operation and its callbacks */
@@ -1071,4 +1113,10 @@ int BLI_rename(const char *from, const char *to)
 	return rename(from, to);
 }
 
+int BLI_rename_overwrite(const char *from, const char *to)
+{
+	/* POSIX rename() replaces the destination atomically */
+	return rename(from, to);
+}
+
 #endif
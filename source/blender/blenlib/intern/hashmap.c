@@ -0,0 +1,871 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenlib/intern/hashmap.c
+ *  \ingroup bli
+ *
+ * An open-addressing (integer/pointer -> pointer) hash table,
+ * laid out in the style of a 'Swiss table'.
+ *
+ * Every bucket has a matching control byte:
+ * - ``HASHMAP_CTRL_EMPTY`` the bucket was never used (terminates a probe sequence).
+ * - ``HASHMAP_CTRL_DELETED`` the bucket was removed but may be part of a probe sequence.
+ * - Otherwise the high bit is cleared and the low 7 bits hold part of the key's hash.
+ *
+ * Lookups test #HASHMAP_GROUP_SIZE control bytes at once (using SSE2 when available),
+ * only comparing keys whose 7 bit hash matches, so in practice a lookup touches
+ * one control group and a single key. Keys and values are stored in flat arrays
+ * (no per-entry allocation) and keys are compared directly, there are no hash/compare callbacks.
+ *
+ * The control array is over-allocated by #HASHMAP_GROUP_SIZE bytes, mirroring the first group,
+ * so a group can be loaded at any bucket index without wrapping.
+ *
+ * See: https://abseil.io/about/design/swisstables
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_sys_types.h"
+#include "BLI_utildefines.h"
+#include "BLI_math_bits.h"
+
+#include "BLI_hashmap.h"  /* own include */
+
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#endif
+
+/* keep last */
+#include "BLI_strict_flags.h"
+
+/* -------------------------------------------------------------------- */
+/** \name Structs & Constants
+ * \{ */
+
+#define HASHMAP_GROUP_SIZE 16
+#define HASHMAP_MIN_BUCKETS HASHMAP_GROUP_SIZE
+
+#define HASHMAP_CTRL_EMPTY    ((uchar)0x80)
+#define HASHMAP_CTRL_DELETED  ((uchar)0xFE)
+
+#define HASHMAP_INDEX_NONE UINT_MAX
+
+/* Maximum load factor is 7/8. */
+#define HASHMAP_MAX_ENTRIES(nbuckets) ((nbuckets) - ((nbuckets) / 8))
+
+enum {
+	HASHMAP_FLAG_IS_SET = (1 << 0),  /* Used as HashSet (no value storage). */
+};
+
+struct HashMap {
+	/* Single allocation holding keys, values (maps only) and control bytes. */
+	uintptr_t *keys;
+	void **vals;
+	uchar *ctrl;
+
+	uint nbuckets;  /* Always a power of two, at least #HASHMAP_MIN_BUCKETS. */
+	uint nentries;
+	/* Number of entries that can still be added before the table needs to be rebuilt,
+	 * deleted buckets count as used. */
+	uint growth_left;
+	uint flag;
+};
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Internal Utility API
+ * \{ */
+
+/**
+ * 64bit finalizer from MurmurHash3, pointers and indices have most of their entropy
+ * in a few low bits, both the bucket index and the control byte need well mixed bits.
+ */
+BLI_INLINE uint64_t hashmap_keyhash(uintptr_t key)
+{
+	uint64_t h = (uint64_t)key;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+BLI_INLINE uint hashmap_hash_index(const uint64_t hash)
+{
+	return (uint)(hash >> 7);
+}
+
+BLI_INLINE uchar hashmap_hash_ctrl(const uint64_t hash)
+{
+	return (uchar)(hash & 0x7F);
+}
+
+BLI_INLINE bool hashmap_ctrl_is_full(const uchar c)
+{
+	return (c & 0x80) == 0;
+}
+
+/* Group operations, each returns a bit-mask with one bit per matching bucket of the group. */
+
+#ifdef __SSE2__
+
+BLI_INLINE uint hashmap_group_match(const uchar *ctrl, const uchar c)
+{
+	const __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+	return (uint)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8((char)c), group));
+}
+
+BLI_INLINE uint hashmap_group_match_empty(const uchar *ctrl)
+{
+	return hashmap_group_match(ctrl, HASHMAP_CTRL_EMPTY);
+}
+
+BLI_INLINE uint hashmap_group_match_empty_or_deleted(const uchar *ctrl)
+{
+	/* Both are negative when interpreted as signed bytes, full buckets are never negative. */
+	const __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+	const __m128i minus_one = _mm_cmpeq_epi8(group, group);
+	return (uint)_mm_movemask_epi8(_mm_cmpgt_epi8(minus_one, group));
+}
+
+BLI_INLINE uint hashmap_group_match_full(const uchar *ctrl)
+{
+	const __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+	return (uint)_mm_movemask_epi8(group) ^ 0xFFFF;
+}
+
+#else  /* __SSE2__ */
+
+BLI_INLINE uint hashmap_group_match(const uchar *ctrl, const uchar c)
+{
+	uint mask = 0;
+	for (uint i = 0; i < HASHMAP_GROUP_SIZE; i++) {
+		mask |= (uint)(ctrl[i] == c) << i;
+	}
+	return mask;
+}
+
+BLI_INLINE uint hashmap_group_match_empty(const uchar *ctrl)
+{
+	return hashmap_group_match(ctrl, HASHMAP_CTRL_EMPTY);
+}
+
+BLI_INLINE uint hashmap_group_match_empty_or_deleted(const uchar *ctrl)
+{
+	uint mask = 0;
+	for (uint i = 0; i < HASHMAP_GROUP_SIZE; i++) {
+		mask |= (uint)(ctrl[i] == HASHMAP_CTRL_EMPTY || ctrl[i] == HASHMAP_CTRL_DELETED) << i;
+	}
+	return mask;
+}
+
+BLI_INLINE uint hashmap_group_match_full(const uchar *ctrl)
+{
+	uint mask = 0;
+	for (uint i = 0; i < HASHMAP_GROUP_SIZE; i++) {
+		mask |= (uint)hashmap_ctrl_is_full(ctrl[i]) << i;
+	}
+	return mask;
+}
+
+#endif  /* __SSE2__ */
+
+BLI_INLINE void hashmap_ctrl_set(HashMap *hm, const uint index, const uchar c)
+{
+	hm->ctrl[index] = c;
+	if (index < HASHMAP_GROUP_SIZE) {
+		hm->ctrl[hm->nbuckets + index] = c;
+	}
+}
+
+/**
+ * Smallest power of two bucket count that holds \a nentries without exceeding the maximum load.
+ */
+static uint hashmap_nbuckets_for_entries(const uint nentries)
+{
+	uint nbuckets = HASHMAP_MIN_BUCKETS;
+	while (HASHMAP_MAX_ENTRIES(nbuckets) < nentries) {
+		nbuckets <<= 1;
+	}
+	return nbuckets;
+}
+
+/**
+ * Allocate (uninitialized) keys/values and empty control bytes for \a nbuckets.
+ */
+static void hashmap_buckets_alloc(HashMap *hm, const uint nbuckets)
+{
+	const bool is_set = (hm->flag & HASHMAP_FLAG_IS_SET) != 0;
+	const size_t keys_size = sizeof(*hm->keys) * nbuckets;
+	const size_t vals_size = is_set ? 0 : sizeof(*hm->vals) * nbuckets;
+	const size_t ctrl_size = (size_t)nbuckets + HASHMAP_GROUP_SIZE;
+	char *mem = MEM_mallocN(keys_size + vals_size + ctrl_size, "HashMap buckets");
+
+	hm->keys = (uintptr_t *)mem;
+	hm->vals = is_set ? NULL : (void **)(mem + keys_size);
+	hm->ctrl = (uchar *)(mem + keys_size + vals_size);
+	memset(hm->ctrl, HASHMAP_CTRL_EMPTY, ctrl_size);
+
+	hm->nbuckets = nbuckets;
+	hm->growth_left = HASHMAP_MAX_ENTRIES(nbuckets);
+}
+
+/**
+ * \return the bucket index of \a key or #HASHMAP_INDEX_NONE.
+ */
+BLI_INLINE uint hashmap_lookup_index(const HashMap *hm, const uintptr_t key, const uint64_t hash)
+{
+	const uint mask = hm->nbuckets - 1;
+	const uchar c = hashmap_hash_ctrl(hash);
+	uint pos = hashmap_hash_index(hash) & mask;
+	uint step = 0;
+
+	while (true) {
+		const uchar *group = &hm->ctrl[pos];
+		uint match = hashmap_group_match(group, c);
+		while (match) {
+			const uint index = (pos + bitscan_forward_clear_uint(&match)) & mask;
+			if (LIKELY(hm->keys[index] == key)) {
+				return index;
+			}
+		}
+		if (LIKELY(hashmap_group_match_empty(group))) {
+			return HASHMAP_INDEX_NONE;
+		}
+		/* Triangular probing over groups, visits every bucket of a power of two table. */
+		step += HASHMAP_GROUP_SIZE;
+		pos = (pos + step) & mask;
+	}
+}
+
+/**
+ * \return the first empty or deleted bucket in the probe sequence of \a hash.
+ */
+BLI_INLINE uint hashmap_find_free_index(const HashMap *hm, const uint64_t hash)
+{
+	const uint mask = hm->nbuckets - 1;
+	uint pos = hashmap_hash_index(hash) & mask;
+	uint step = 0;
+
+	while (true) {
+		uint match = hashmap_group_match_empty_or_deleted(&hm->ctrl[pos]);
+		if (LIKELY(match)) {
+			return (pos + bitscan_forward_uint(match)) & mask;
+		}
+		step += HASHMAP_GROUP_SIZE;
+		pos = (pos + step) & mask;
+	}
+}
+
+/**
+ * Rebuild the table with \a nbuckets, dropping all deleted buckets.
+ */
+static void hashmap_buckets_resize(HashMap *hm, const uint nbuckets)
+{
+	uintptr_t *keys_old = hm->keys;
+	void **vals_old = hm->vals;
+	uchar *ctrl_old = hm->ctrl;
+	const uint nbuckets_old = hm->nbuckets;
+
+	BLI_assert(HASHMAP_MAX_ENTRIES(nbuckets) >= hm->nentries);
+
+	hashmap_buckets_alloc(hm, nbuckets);
+
+	for (uint i = 0; i < nbuckets_old; i++) {
+		if (hashmap_ctrl_is_full(ctrl_old[i])) {
+			const uint64_t hash = hashmap_keyhash(keys_old[i]);
+			const uint index = hashmap_find_free_index(hm, hash);
+			hashmap_ctrl_set(hm, index, hashmap_hash_ctrl(hash));
+			hm->keys[index] = keys_old[i];
+			if (vals_old) {
+				hm->vals[index] = vals_old[i];
+			}
+		}
+	}
+	hm->growth_left -= hm->nentries;
+
+	/* keys, values & control bytes share one allocation. */
+	MEM_freeN(keys_old);
+}
+
+/**
+ * Make room for at least one more entry.
+ */
+BLI_INLINE void hashmap_ensure_growth(HashMap *hm)
+{
+	if (UNLIKELY(hm->growth_left == 0)) {
+		/* When most used buckets are deleted ones, rebuilding at the same size is enough. */
+		if (hm->nentries <= HASHMAP_MAX_ENTRIES(hm->nbuckets) / 2) {
+			hashmap_buckets_resize(hm, hm->nbuckets);
+		}
+		else {
+			hashmap_buckets_resize(hm, hm->nbuckets * 2);
+		}
+	}
+}
+
+/**
+ * Add \a key (known not to be in \a hm).
+ * \return its bucket index, the caller is responsible for setting the value.
+ */
+BLI_INLINE uint hashmap_insert_key(HashMap *hm, const uintptr_t key, const uint64_t hash)
+{
+	uint index;
+
+	hashmap_ensure_growth(hm);
+
+	index = hashmap_find_free_index(hm, hash);
+	if (hm->ctrl[index] == HASHMAP_CTRL_EMPTY) {
+		hm->growth_left--;
+	}
+	hashmap_ctrl_set(hm, index, hashmap_hash_ctrl(hash));
+	hm->keys[index] = key;
+	hm->nentries++;
+	return index;
+}
+
+/**
+ * Remove the entry at \a index.
+ *
+ * When no probe sequence could have passed over this bucket without seeing an empty one,
+ * it can be marked empty again rather than deleted.
+ */
+static void hashmap_remove_index(HashMap *hm, const uint index)
+{
+	const uint mask = hm->nbuckets - 1;
+	const uint empty_before = hashmap_group_match_empty(&hm->ctrl[(index - HASHMAP_GROUP_SIZE) & mask]);
+	const uint empty_after = hashmap_group_match_empty(&hm->ctrl[index]);
+	bool was_never_full = false;
+
+	BLI_assert(hashmap_ctrl_is_full(hm->ctrl[index]));
+
+	if (empty_before && empty_after) {
+		/* Number of non-empty buckets directly before and from \a index. */
+		uint full_before = 0;
+		while (!(empty_before & (1u << (HASHMAP_GROUP_SIZE - 1 - full_before)))) {
+			full_before++;
+		}
+		was_never_full = (full_before + bitscan_forward_uint(empty_after)) < HASHMAP_GROUP_SIZE;
+	}
+
+	if (was_never_full) {
+		hashmap_ctrl_set(hm, index, HASHMAP_CTRL_EMPTY);
+		hm->growth_left++;
+	}
+	else {
+		hashmap_ctrl_set(hm, index, HASHMAP_CTRL_DELETED);
+	}
+	hm->nentries--;
+}
+
+static HashMap *hashmap_new(const char *info, const uint nentries_reserve, const uint flag)
+{
+	HashMap *hm = MEM_mallocN(sizeof(*hm), info);
+
+	hm->nentries = 0;
+	hm->flag = flag;
+	hashmap_buckets_alloc(hm, hashmap_nbuckets_for_entries(nentries_reserve));
+
+	return hm;
+}
+
+static HashMap *hashmap_copy(const HashMap *hm)
+{
+	HashMap *hm_copy = MEM_mallocN(sizeof(*hm_copy), __func__);
+	const size_t alloc_size = (size_t)(hm->ctrl - (uchar *)hm->keys) + hm->nbuckets + HASHMAP_GROUP_SIZE;
+	char *mem = MEM_mallocN(alloc_size, "HashMap buckets");
+
+	*hm_copy = *hm;
+	memcpy(mem, hm->keys, alloc_size);
+	hm_copy->keys = (uintptr_t *)mem;
+	hm_copy->vals = hm->vals ? (void **)(mem + ((char *)hm->vals - (char *)hm->keys)) : NULL;
+	hm_copy->ctrl = (uchar *)(mem + (hm->ctrl - (uchar *)hm->keys));
+
+	return hm_copy;
+}
+
+static void hashmap_free_cb(HashMap *hm, HashMapValFreeFP valfreefp)
+{
+	BLI_assert(valfreefp && hm->vals);
+
+	for (uint i = 0; i < hm->nbuckets; i++) {
+		if (hashmap_ctrl_is_full(hm->ctrl[i])) {
+			valfreefp(hm->vals[i]);
+		}
+	}
+}
+
+static void hashmap_clear(HashMap *hm, const uint nentries_reserve)
+{
+	const uint nbuckets = hashmap_nbuckets_for_entries(nentries_reserve);
+
+	hm->nentries = 0;
+	if (nbuckets != hm->nbuckets) {
+		MEM_freeN(hm->keys);
+		hashmap_buckets_alloc(hm, nbuckets);
+	}
+	else {
+		memset(hm->ctrl, HASHMAP_CTRL_EMPTY, (size_t)hm->nbuckets + HASHMAP_GROUP_SIZE);
+		hm->growth_left = HASHMAP_MAX_ENTRIES(hm->nbuckets);
+	}
+}
+
+/**
+ * Remove the first full bucket at or after \a state index.
+ */
+static uint hashmap_pop(HashMap *hm, HashMapIterState *state)
+{
+	uint index = state->index & (hm->nbuckets - 1);
+
+	if (hm->nentries == 0) {
+		return HASHMAP_INDEX_NONE;
+	}
+
+	/* Continuing from the previous pop avoids rescanning the start of a mostly empty table. */
+	while (!hashmap_ctrl_is_full(hm->ctrl[index])) {
+		index = (index + 1) & (hm->nbuckets - 1);
+	}
+
+	/* Removal may mark the bucket empty, it is never full again though. */
+	hashmap_remove_index(hm, index);
+	state->index = index;
+	return index;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name HashMap Public API
+ * \{ */
+
+/**
+ * Creates a new, empty HashMap.
+ *
+ * \param info  Identifier string for the HashMap.
+ * \param nentries_reserve  Optionally reserve the number of members that the hash will hold.
+ * Use this to avoid resizing buckets if the size is known or can be closely approximated.
+ * \return  An empty HashMap.
+ */
+HashMap *BLI_hashmap_new_ex(const char *info, const uint nentries_reserve)
+{
+	return hashmap_new(info, nentries_reserve, 0);
+}
+
+/**
+ * Wraps #BLI_hashmap_new_ex with zero entries reserved.
+ */
+HashMap *BLI_hashmap_new(const char *info)
+{
+	return BLI_hashmap_new_ex(info, 0);
+}
+
+/**
+ * Copy given HashMap, values are copied as pointers.
+ */
+HashMap *BLI_hashmap_copy(HashMap *hm)
+{
+	return hashmap_copy(hm);
+}
+
+/**
+ * Reserve given amount of entries (resize \a hm accordingly if needed).
+ */
+void BLI_hashmap_reserve(HashMap *hm, const uint nentries_reserve)
+{
+	const uint nbuckets = hashmap_nbuckets_for_entries(MAX2(nentries_reserve, hm->nentries));
+	if (nbuckets > hm->nbuckets) {
+		hashmap_buckets_resize(hm, nbuckets);
+	}
+}
+
+/**
+ * \return size of the HashMap.
+ */
+uint BLI_hashmap_len(const HashMap *hm)
+{
+	return hm->nentries;
+}
+
+/**
+ * Insert a key/value pair into the \a hm.
+ *
+ * \note Duplicates are not checked,
+ * the caller is expected to ensure elements are unique.
+ */
+void BLI_hashmap_insert(HashMap *hm, uintptr_t key, void *val)
+{
+	const uint64_t hash = hashmap_keyhash(key);
+	uint index;
+
+	BLI_assert(!(hm->flag & HASHMAP_FLAG_IS_SET));
+	BLI_assert(hashmap_lookup_index(hm, key, hash) == HASHMAP_INDEX_NONE);
+
+	index = hashmap_insert_key(hm, key, hash);
+	hm->vals[index] = val;
+}
+
+/**
+ * Inserts a new value to a key that may already be in the hashmap.
+ *
+ * \returns true if a new key has been added.
+ */
+bool BLI_hashmap_reinsert(HashMap *hm, uintptr_t key, void *val, HashMapValFreeFP valfreefp)
+{
+	void **val_p;
+	const bool haskey = BLI_hashmap_ensure_p(hm, key, &val_p);
+
+	if (haskey && valfreefp) {
+		valfreefp(*val_p);
+	}
+	*val_p = val;
+	return !haskey;
+}
+
+/**
+ * Lookup the value of \a key in \a hm.
+ *
+ * \returns the value for \a key or NULL.
+ *
+ * \note When NULL is a valid value, use #BLI_hashmap_lookup_p to differentiate a missing key
+ * from a key with a NULL value.
+ */
+void *BLI_hashmap_lookup(const HashMap *hm, uintptr_t key)
+{
+	return BLI_hashmap_lookup_default(hm, key, NULL);
+}
+
+/**
+ * A version of #BLI_hashmap_lookup which accepts a fallback argument.
+ */
+void *BLI_hashmap_lookup_default(const HashMap *hm, uintptr_t key, void *val_default)
+{
+	const uint index = hashmap_lookup_index(hm, key, hashmap_keyhash(key));
+	BLI_assert(!(hm->flag & HASHMAP_FLAG_IS_SET));
+	return (index != HASHMAP_INDEX_NONE) ? hm->vals[index] : val_default;
+}
+
+/**
+ * Lookup a pointer to the value of \a key in \a hm.
+ *
+ * \returns the pointer to value for \a key or NULL.
+ *
+ * \note The pointer is only valid until the next insertion.
+ */
+void **BLI_hashmap_lookup_p(HashMap *hm, uintptr_t key)
+{
+	const uint index = hashmap_lookup_index(hm, key, hashmap_keyhash(key));
+	BLI_assert(!(hm->flag & HASHMAP_FLAG_IS_SET));
+	return (index != HASHMAP_INDEX_NONE) ? &hm->vals[index] : NULL;
+}
+
+/**
+ * Ensure \a key is exists in \a hm, see #BLI_ghash_ensure_p.
+ *
+ * \returns true when the value didn't need to be added.
+ * (when false, the caller _must_ initialize the value).
+ */
+bool BLI_hashmap_ensure_p(HashMap *hm, uintptr_t key, void ***r_val)
+{
+	const uint64_t hash = hashmap_keyhash(key);
+	uint index = hashmap_lookup_index(hm, key, hash);
+	const bool haskey = (index != HASHMAP_INDEX_NONE);
+
+	BLI_assert(!(hm->flag & HASHMAP_FLAG_IS_SET));
+
+	if (!haskey) {
+		index = hashmap_insert_key(hm, key, hash);
+	}
+
+	*r_val = &hm->vals[index];
+	return haskey;
+}
+
+/**
+ * Remove \a key from \a hm, or return false if the key wasn't found.
+ *
+ * \param valfreefp  Optional callback to free the value.
+ * \return true if \a key was removed from \a hm.
+ */
+bool BLI_hashmap_remove(HashMap *hm, uintptr_t key, HashMapValFreeFP valfreefp)
+{
+	const uint index = hashmap_lookup_index(hm, key, hashmap_keyhash(key));
+	if (index != HASHMAP_INDEX_NONE) {
+		if (valfreefp) {
+			valfreefp(hm->vals[index]);
+		}
+		hashmap_remove_index(hm, index);
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
+/**
+ * Remove \a key from \a hm, returning the value or NULL if the key wasn't found.
+ */
+void *BLI_hashmap_popkey(HashMap *hm, uintptr_t key)
+{
+	const uint index = hashmap_lookup_index(hm, key, hashmap_keyhash(key));
+	BLI_assert(!(hm->flag & HASHMAP_FLAG_IS_SET));
+	if (index != HASHMAP_INDEX_NONE) {
+		void *val = hm->vals[index];
+		hashmap_remove_index(hm, index);
+		return val;
+	}
+	else {
+		return NULL;
+	}
+}
+
+/**
+ * \return true if the \a key is in \a hm.
+ */
+bool BLI_hashmap_haskey(const HashMap *hm, uintptr_t key)
+{
+	return (hashmap_lookup_index(hm, key, hashmap_keyhash(key)) != HASHMAP_INDEX_NONE);
+}
+
+/**
+ * Remove a random entry from \a hm, returning true if a key/value pair could be removed, false otherwise.
+ *
+ * \param state: Used for efficient removal, zero initialize before the first call.
+ * \return true if there was something to pop, false if the hashmap was already empty.
+ */
+bool BLI_hashmap_pop(
+        HashMap *hm, HashMapIterState *state,
+        uintptr_t *r_key, void **r_val)
+{
+	const uint index = hashmap_pop(hm, state);
+
+	BLI_assert(!(hm->flag & HASHMAP_FLAG_IS_SET));
+
+	if (index != HASHMAP_INDEX_NONE) {
+		*r_key = hm->keys[index];
+		*r_val = hm->vals[index];
+		return true;
+	}
+	else {
+		*r_key = 0;
+		*r_val = NULL;
+		return false;
+	}
+}
+
+/**
+ * Reset \a hm clearing all entries.
+ *
+ * \param valfreefp  Optional callback to free the value.
+ * \param nentries_reserve  Optionally reserve the number of members that the hash will hold.
+ */
+void BLI_hashmap_clear_ex(
+        HashMap *hm, HashMapValFreeFP valfreefp,
+        const uint nentries_reserve)
+{
+	if (valfreefp) {
+		hashmap_free_cb(hm, valfreefp);
+	}
+	hashmap_clear(hm, nentries_reserve);
+}
+
+/**
+ * Wraps #BLI_hashmap_clear_ex with zero entries reserved.
+ */
+void BLI_hashmap_clear(HashMap *hm, HashMapValFreeFP valfreefp)
+{
+	BLI_hashmap_clear_ex(hm, valfreefp, 0);
+}
+
+/**
+ * Frees the HashMap and its members.
+ *
+ * \param hm  The HashMap to free.
+ * \param valfreefp  Optional callback to free the value.
+ */
+void BLI_hashmap_free(HashMap *hm, HashMapValFreeFP valfreefp)
+{
+	if (valfreefp) {
+		hashmap_free_cb(hm, valfreefp);
+	}
+
+	MEM_freeN(hm->keys);
+	MEM_freeN(hm);
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name HashMap Iterator API
+ * \{ */
+
+/**
+ * Init an already allocated HashMapIterator. The hash table must not
+ * be mutated while the iterator is in use.
+ */
+void BLI_hashmapIterator_init(HashMapIterator *hmi, HashMap *hm)
+{
+	hmi->ctrl = hm->ctrl;
+	hmi->keys = hm->keys;
+	hmi->vals = hm->vals;
+	hmi->nbuckets = hm->nbuckets;
+	hmi->index = UINT_MAX;  /* wraps to zero */
+	BLI_hashmapIterator_step(hmi);
+}
+
+/**
+ * Steps the iterator to the next full bucket.
+ */
+void BLI_hashmapIterator_step(HashMapIterator *hmi)
+{
+	uint index = hmi->index + 1;
+
+	/* Skip whole groups of empty buckets at once, the mirrored tail is never reported. */
+	while (index < hmi->nbuckets) {
+		const uint match = hashmap_group_match_full(&hmi->ctrl[index]);
+		if (match) {
+			index += bitscan_forward_uint(match);
+			break;
+		}
+		index += HASHMAP_GROUP_SIZE;
+	}
+	hmi->index = MIN2(index, hmi->nbuckets);
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name HashSet Public API
+ *
+ * Use hashmap API to give 'set' functionality
+ * \{ */
+
+HashSet *BLI_hashset_new_ex(const char *info, const uint nentries_reserve)
+{
+	return (HashSet *)hashmap_new(info, nentries_reserve, HASHMAP_FLAG_IS_SET);
+}
+
+HashSet *BLI_hashset_new(const char *info)
+{
+	return BLI_hashset_new_ex(info, 0);
+}
+
+/**
+ * Copy given HashSet.
+ */
+HashSet *BLI_hashset_copy(HashSet *hs)
+{
+	return (HashSet *)hashmap_copy((HashMap *)hs);
+}
+
+void BLI_hashset_reserve(HashSet *hs, const uint nentries_reserve)
+{
+	BLI_hashmap_reserve((HashMap *)hs, nentries_reserve);
+}
+
+uint BLI_hashset_len(const HashSet *hs)
+{
+	return ((const HashMap *)hs)->nentries;
+}
+
+/**
+ * Adds the key to the set (no checks for unique keys!).
+ * Matching #BLI_hashmap_insert
+ */
+void BLI_hashset_insert(HashSet *hs, uintptr_t key)
+{
+	HashMap *hm = (HashMap *)hs;
+	const uint64_t hash = hashmap_keyhash(key);
+
+	BLI_assert(hashmap_lookup_index(hm, key, hash) == HASHMAP_INDEX_NONE);
+
+	hashmap_insert_key(hm, key, hash);
+}
+
+/**
+ * A version of BLI_hashset_insert which checks first if the key is in the set.
+ * \returns true if a new key has been added.
+ */
+bool BLI_hashset_add(HashSet *hs, uintptr_t key)
+{
+	HashMap *hm = (HashMap *)hs;
+	const uint64_t hash = hashmap_keyhash(key);
+
+	if (hashmap_lookup_index(hm, key, hash) == HASHMAP_INDEX_NONE) {
+		hashmap_insert_key(hm, key, hash);
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
+bool BLI_hashset_haskey(const HashSet *hs, uintptr_t key)
+{
+	const HashMap *hm = (const HashMap *)hs;
+	return (hashmap_lookup_index(hm, key, hashmap_keyhash(key)) != HASHMAP_INDEX_NONE);
+}
+
+bool BLI_hashset_remove(HashSet *hs, uintptr_t key)
+{
+	return BLI_hashmap_remove((HashMap *)hs, key, NULL);
+}
+
+/**
+ * Remove a random entry from \a hs, returning true if a key could be removed, false otherwise.
+ *
+ * \param state: Used for efficient removal, zero initialize before the first call.
+ */
+bool BLI_hashset_pop(HashSet *hs, HashSetIterState *state, uintptr_t *r_key)
+{
+	HashMap *hm = (HashMap *)hs;
+	const uint index = hashmap_pop(hm, state);
+
+	if (index != HASHMAP_INDEX_NONE) {
+		*r_key = hm->keys[index];
+		return true;
+	}
+	else {
+		*r_key = 0;
+		return false;
+	}
+}
+
+void BLI_hashset_clear_ex(HashSet *hs, const uint nentries_reserve)
+{
+	hashmap_clear((HashMap *)hs, nentries_reserve);
+}
+
+void BLI_hashset_clear(HashSet *hs)
+{
+	BLI_hashset_clear_ex(hs, 0);
+}
+
+void BLI_hashset_free(HashSet *hs)
+{
+	BLI_hashmap_free((HashMap *)hs, NULL);
+}
+
+/** \} */
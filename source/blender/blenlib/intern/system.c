@@ -22,10 +22,22 @@
  *  \ingroup bli
  */
 
+#ifdef __linux__
+/* for sched_setaffinity() and CPU_SET() */
+#  ifndef _GNU_SOURCE
+#    define _GNU_SOURCE
+#  endif
+#  include <sched.h>
+#  include <unistd.h>
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "BLI_utildefines.h"
+#include "BLI_math_base.h"
+#include "BLI_string.h"
 #include "BLI_system.h"
 
 #include "MEM_guardedalloc.h"
@@ -138,3 +150,160 @@ void BLI_system_backtrace(FILE *fp)
 
 }
 /* end BLI_system_backtrace */
+
+/* NUMA topology
+ *
+ * Topology is read from sysfs on Linux, without linking against libnuma. On
+ * other platforms, or when topology can not be queried, the whole system is
+ * reported as a single node. Nodes which have no CPUs (memory-only nodes) are
+ * skipped, so node indices are always in [0 .. BLI_system_numa_num_nodes()).
+ */
+
+#define NUMA_MAX_CPUS 1024
+#define NUMA_MAX_NODES 64
+
+static struct {
+	bool is_initialized;
+	int num_nodes;
+	int num_cpus;
+	/* Node index for every CPU. */
+	short cpu_node[NUMA_MAX_CPUS];
+} numa_topology = {false};
+
+static int numa_num_nodes_override = 0;
+
+#ifdef __linux__
+/* Parse cpulist such as "0-7,16-23" and assign CPUs from it to the node. */
+static bool numa_parse_cpulist(const char *cpulist, const int node)
+{
+	const char *p = cpulist;
+	bool has_cpus = false;
+	while (*p != '\0' && *p != '\n') {
+		char *end;
+		long first = strtol(p, &end, 10), last;
+		if (end == p) {
+			break;
+		}
+		last = first;
+		p = end;
+		if (*p == '-') {
+			last = strtol(p + 1, &end, 10);
+			p = end;
+		}
+		for (long cpu = first; cpu <= last && cpu < NUMA_MAX_CPUS; cpu++) {
+			numa_topology.cpu_node[cpu] = (short)node;
+			has_cpus = true;
+		}
+		if (*p == ',') {
+			p++;
+		}
+	}
+	return has_cpus;
+}
+#endif
+
+static void numa_topology_ensure(void)
+{
+	if (numa_topology.is_initialized) {
+		return;
+	}
+	numa_topology.is_initialized = true;
+	numa_topology.num_nodes = 1;
+	numa_topology.num_cpus = 1;
+	memset(numa_topology.cpu_node, 0, sizeof(numa_topology.cpu_node));
+
+#ifdef __linux__
+	numa_topology.num_cpus = min_ii((int)sysconf(_SC_NPROCESSORS_CONF), NUMA_MAX_CPUS);
+	int num_nodes = 0;
+	for (int node = 0; node < NUMA_MAX_NODES; node++) {
+		char filepath[64], cpulist[4096];
+		FILE *f;
+		BLI_snprintf(filepath, sizeof(filepath), "/sys/devices/system/node/node%d/cpulist", node);
+		if ((f = fopen(filepath, "r")) == NULL) {
+			continue;
+		}
+		if (fgets(cpulist, sizeof(cpulist), f) != NULL) {
+			if (numa_parse_cpulist(cpulist, num_nodes)) {
+				num_nodes++;
+			}
+		}
+		fclose(f);
+	}
+	if (num_nodes > 1) {
+		numa_topology.num_nodes = num_nodes;
+	}
+	else {
+		memset(numa_topology.cpu_node, 0, sizeof(numa_topology.cpu_node));
+	}
+#endif
+
+	numa_topology.num_cpus = max_ii(numa_topology.num_cpus, 1);
+}
+
+/**
+ * Number of NUMA nodes which have CPUs.
+ *
+ * \note Topology is initialized on first query, which is expected to happen
+ * from the main thread.
+ */
+int BLI_system_numa_num_nodes(void)
+{
+	if (numa_num_nodes_override != 0) {
+		return numa_num_nodes_override;
+	}
+	numa_topology_ensure();
+	return numa_topology.num_nodes;
+}
+
+/**
+ * NUMA node index which the given CPU belongs to.
+ */
+int BLI_system_numa_node_of_cpu(int cpu)
+{
+	numa_topology_ensure();
+	CLAMP(cpu, 0, numa_topology.num_cpus - 1);
+	if (numa_num_nodes_override != 0) {
+		/* Fake topology: split CPUs into contiguous equal sized nodes. */
+		return cpu * numa_num_nodes_override / numa_topology.num_cpus;
+	}
+	return numa_topology.cpu_node[cpu];
+}
+
+/**
+ * Restrict calling thread to run on CPUs of the given NUMA node only.
+ * Memory which is touched first by this thread will then be allocated from
+ * that node by the operating system.
+ *
+ * \return false if the thread affinity is not supported or failed to be set.
+ */
+bool BLI_system_thread_bind_numa_node(int node)
+{
+#ifdef __linux__
+	cpu_set_t cpuset;
+	bool has_cpus = false;
+	numa_topology_ensure();
+	CPU_ZERO(&cpuset);
+	for (int cpu = 0; cpu < numa_topology.num_cpus; cpu++) {
+		if (BLI_system_numa_node_of_cpu(cpu) == node) {
+			CPU_SET(cpu, &cpuset);
+			has_cpus = true;
+		}
+	}
+	if (!has_cpus) {
+		return false;
+	}
+	return sched_setaffinity(0, sizeof(cpuset), &cpuset) == 0;
+#else
+	UNUSED_VARS(node);
+	return false;
+#endif
+}
+
+/**
+ * Fake NUMA topology with the given number of nodes, 0 to use the real one.
+ * Allows to test NUMA code paths on machines without NUMA.
+ */
+void BLI_system_numa_num_nodes_override_set(int num)
+{
+	numa_num_nodes_override = num;
+}
@@ -33,6 +33,7 @@
 #include "BLI_listbase.h"
 #include "BLI_math.h"
 #include "BLI_mempool.h"
+#include "BLI_system.h"
 #include "BLI_task.h"
 #include "BLI_threads.h"
 
@@ -62,6 +63,19 @@
  */
 #define DELAYED_QUEUE_SIZE 4096
 
+/* Number of tasks which fit into a per-thread work-stealing deque.
+ *
+ * Must be power of two. When deque is full, tasks are pushed to the global
+ * scheduler queue instead. More details could be found at TaskDeque.
+ */
+#define TASK_DEQUE_SIZE 4096
+#define TASK_DEQUE_MASK (TASK_DEQUE_SIZE - 1)
+
+/* Used to keep deque indices which are modified by different threads on
+ * separate cache lines.
+ */
+#define CACHE_LINE_SIZE 64
+
 #ifndef NDEBUG
 #  define ASSERT_THREAD_ID(scheduler, thread_id)                              \
 	do {                                                                      \
@@ -161,12 +175,44 @@ typedef struct TaskThreadLocalStorage {
 	Task *delayed_queue[DELAYED_QUEUE_SIZE];
 } TaskThreadLocalStorage;
 
+/* Work-stealing deque of a single scheduler thread (Chase-Lev).
+ *
+ * Only the owner thread pushes and pops tasks at the bottom of the deque, which
+ * does not need any locks. Other threads are stealing tasks from the top of the
+ * deque using CAS on the top index.
+ *
+ * The pool pointer is stored next to the task pointer, so thieves can check the
+ * pool of a task before stealing it without dereferencing memory of a task which
+ * might have been taken and freed by another thread already.
+ */
+typedef struct TaskDequeSlot {
+	Task *task;
+	TaskPool *pool;
+} TaskDequeSlot;
+
+typedef struct TaskDeque {
+	/* Index of the oldest task, advanced by thieves. */
+	int64_t top;
+	char pad_top[CACHE_LINE_SIZE - sizeof(int64_t)];
+	/* Index past the newest task, only modified by the owner thread. */
+	int64_t bottom;
+	char pad_bottom[CACHE_LINE_SIZE - sizeof(int64_t)];
+	TaskDequeSlot slots[TASK_DEQUE_SIZE];
+	/* NUMA node of the owner thread. */
+	int numa_node;
+} TaskDeque;
+
 struct TaskPool {
 	TaskScheduler *scheduler;
 
 	volatile size_t num;
 	ThreadMutex num_mutex;
 	ThreadCondition num_cond;
+	/* Incremented (with num_mutex locked) every time task of this pool is moved
+	 * from a thread's deque to the global queue, so work_and_wait() does not go
+	 * to sleep while there is a task it could pick up.
+	 */
+	unsigned int num_spilled;
 
 	void *userdata;
 	ThreadMutex user_mutex;
@@ -184,6 +230,11 @@ struct TaskPool {
 	 */
 	bool run_in_background;
 
+	/* NUMA node which is preferred to execute tasks of this pool, -1 when
+	 * there is no preference.
+	 */
+	int numa_node;
+
 	/* This is a task scheduler's ID of a thread at which pool was constructed.
 	 * It will be used to access task TLS.
 	 */
@@ -210,10 +261,25 @@ struct TaskScheduler {
 	int num_threads;
 	bool background_thread_only;
 
+	/* Global queue, used for tasks pushed from threads which are not known to
+	 * the scheduler, low priority tasks and tasks which did not fit into deques.
+	 */
 	ListBase queue;
 	ThreadMutex queue_mutex;
 	ThreadCondition queue_cond;
 
+	/* Number of worker threads waiting on queue_cond. Used to avoid locking the
+	 * queue mutex for notification when tasks are pushed to deques.
+	 */
+	int num_sleeping_threads;
+
+	/* Number of NUMA nodes threads are distributed across, 1 when NUMA mode
+	 * is not used. Every node has its own queue for tasks of the pools which
+	 * prefer that node, guarded by the queue_mutex.
+	 */
+	int num_numa_nodes;
+	ListBase *numa_queues;
+
 	volatile bool do_exit;
 
 	/* NOTE: In pthread's TLS we store the whole TaskThread structure. */
@@ -224,6 +290,12 @@ typedef struct TaskThread {
 	TaskScheduler *scheduler;
 	int id;
 	TaskThreadLocalStorage tls;
+	TaskDeque deque;
+	/* IDs of threads to steal tasks from, threads of the same NUMA node come
+	 * first.
+	 */
+	int *steal_order;
+	int num_steal_local;
 } TaskThread;
 
 /* Helper */
@@ -326,6 +398,90 @@ static void task_free(TaskPool *pool, Task *task, const int thread_id)
 	}
 }
 
+/* Task Deque */
+
+BLI_INLINE void task_deque_init(TaskDeque *deque)
+{
+	deque->top = 0;
+	deque->bottom = 0;
+}
+
+BLI_INLINE int64_t task_deque_read_index(int64_t *index)
+{
+	return *(volatile int64_t *)index;
+}
+
+BLI_INLINE bool task_deque_is_empty(TaskDeque *deque)
+{
+	return task_deque_read_index(&deque->bottom) <= task_deque_read_index(&deque->top);
+}
+
+/* Push task to the bottom of the deque, only allowed from the owner thread.
+ * Returns false if the deque is full.
+ */
+static bool task_deque_push(TaskDeque *deque, Task *task)
+{
+	const int64_t bottom = deque->bottom;
+	const int64_t top = task_deque_read_index(&deque->top);
+	if (bottom - top >= TASK_DEQUE_SIZE) {
+		return false;
+	}
+	TaskDequeSlot *slot = &deque->slots[bottom & TASK_DEQUE_MASK];
+	slot->task = task;
+	slot->pool = task->pool;
+	/* Atomic increment acts as a barrier which makes slot visible to thieves
+	 * before the new bottom is.
+	 */
+	atomic_add_and_fetch_int64(&deque->bottom, 1);
+	return true;
+}
+
+/* Pop the most recently pushed task, only allowed from the owner thread. */
+static Task *task_deque_pop(TaskDeque *deque)
+{
+	const int64_t bottom = atomic_sub_and_fetch_int64(&deque->bottom, 1);
+	const int64_t top = task_deque_read_index(&deque->top);
+	if (bottom < top) {
+		/* Deque is empty, restore its state. */
+		atomic_add_and_fetch_int64(&deque->bottom, 1);
+		return NULL;
+	}
+	Task *task = deque->slots[bottom & TASK_DEQUE_MASK].task;
+	if (bottom == top) {
+		/* This is the last task in the deque, race against thieves for it. */
+		if (atomic_cas_int64(&deque->top, top, top + 1) != top) {
+			task = NULL;
+		}
+		atomic_add_and_fetch_int64(&deque->bottom, 1);
+	}
+	return task;
+}
+
+/* Steal the oldest task from the deque, allowed from any thread.
+ *
+ * If pool is not NULL, only task from that pool will be stolen. Might fail
+ * when other thread took the task first, task_deque_is_empty() is to be used
+ * to see whether there is still work to be done.
+ */
+static Task *task_deque_steal(TaskDeque *deque, TaskPool *pool)
+{
+	const int64_t top = task_deque_read_index(&deque->top);
+	/* Atomic read of bottom is also a barrier for reading the slot. */
+	const int64_t bottom = atomic_fetch_and_add_int64(&deque->bottom, 0);
+	if (bottom <= top) {
+		return NULL;
+	}
+	TaskDequeSlot *slot = &deque->slots[top & TASK_DEQUE_MASK];
+	Task *task = slot->task;
+	if (pool != NULL && slot->pool != pool) {
+		return NULL;
+	}
+	if (atomic_cas_int64(&deque->top, top, top + 1) != top) {
+		return NULL;
+	}
+	return task;
+}
+
 /* Task Scheduler */
 
 static void task_pool_num_decrease(TaskPool *pool, size_t done)
@@ -352,54 +508,251 @@ static void task_pool_num_increase(TaskPool *pool, size_t new)
 	BLI_mutex_unlock(&pool->num_mutex);
 }
 
-static bool task_scheduler_thread_wait_pop(TaskScheduler *scheduler, Task **task)
+/* Get deque to be used for pushing tasks from the given thread, NULL if the
+ * thread is not allowed to use deques.
+ */
+BLI_INLINE TaskDeque *get_task_deque(TaskPool *pool, const int thread_id)
 {
-	bool found_task = false;
-	BLI_mutex_lock(&scheduler->queue_mutex);
-
-	while (!scheduler->queue.first && !scheduler->do_exit)
-		BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
+	TaskScheduler *scheduler = pool->scheduler;
+	if (thread_id == -1 || scheduler->background_thread_only) {
+		/* Background-only thread must not be able to see tasks from the
+		 * non-background pools, keep all tasks in the global queue where they
+		 * can be filtered.
+		 */
+		return NULL;
+	}
+	if (thread_id == 0 && pool->use_local_tls) {
+		/* Thread is not managed by the scheduler, it does not own a deque. */
+		return NULL;
+	}
+	BLI_assert(thread_id <= scheduler->num_threads);
+	return &scheduler->task_threads[thread_id].deque;
+}
 
-	do {
-		Task *current_task;
+/* Get deque of the calling thread, NULL if thread does not own a deque. */
+static TaskDeque *task_scheduler_current_deque(TaskScheduler *scheduler)
+{
+	if (scheduler->background_thread_only) {
+		return NULL;
+	}
+	if (BLI_thread_is_main()) {
+		return &scheduler->task_threads[0].deque;
+	}
+	TaskThread *thread = pthread_getspecific(scheduler->tls_id_key);
+	if (thread == NULL) {
+		return NULL;
+	}
+	return &thread->deque;
+}
 
-		/* Assuming we can only have a void queue in 'exit' case here seems logical (we should only be here after
-		 * our worker thread has been woken up from a condition_wait(), which only happens after a new task was
-		 * added to the queue), but it is wrong.
-		 * Waiting on condition may wake up the thread even if condition is not signaled (spurious wake-ups), and some
-		 * race condition may also empty the queue **after** condition has been signaled, but **before** awoken thread
-		 * reaches this point...
-		 * See http://stackoverflow.com/questions/8594591
-		 *
-		 * So we only abort here if do_exit is set.
-		 */
-		if (scheduler->do_exit) {
-			BLI_mutex_unlock(&scheduler->queue_mutex);
+static bool task_scheduler_deques_are_empty(TaskScheduler *scheduler)
+{
+	for (int i = 0; i < scheduler->num_threads + 1; i++) {
+		if (!task_deque_is_empty(&scheduler->task_threads[i].deque)) {
 			return false;
 		}
+	}
+	return true;
+}
+
+/* Wake up sleeping worker threads after task was pushed to a deque.
+ *
+ * NOTE: Pushing to a deque implies full memory barrier, and sleeping threads
+ * are checking deques after increasing num_sleeping_threads, so either we see
+ * the sleeper here or the sleeper sees the new task.
+ */
+static void task_scheduler_wake_sleeping(TaskScheduler *scheduler, const bool wake_all)
+{
+	if (*(volatile int *)&scheduler->num_sleeping_threads == 0) {
+		return;
+	}
+	BLI_mutex_lock(&scheduler->queue_mutex);
+	if (wake_all) {
+		BLI_condition_notify_all(&scheduler->queue_cond);
+	}
+	else {
+		BLI_condition_notify_one(&scheduler->queue_cond);
+	}
+	BLI_mutex_unlock(&scheduler->queue_mutex);
+}
+
+/* Move task from a deque to the global queue. This happens when thread which
+ * waits for its own pool pops task of another pool from its deque. The task is
+ * to be picked up by some other thread then.
+ */
+static void task_scheduler_spill(TaskScheduler *scheduler, Task *task)
+{
+	TaskPool *pool = task->pool;
 
-		for (current_task = scheduler->queue.first;
-		     current_task != NULL;
-		     current_task = current_task->next)
-		{
-			TaskPool *pool = current_task->pool;
+	/* Notify pool first: as soon as task is in the queue it might be done and
+	 * the pool might be freed.
+	 */
+	BLI_mutex_lock(&pool->num_mutex);
+	pool->num_spilled++;
+	BLI_condition_notify_all(&pool->num_cond);
+	BLI_mutex_unlock(&pool->num_mutex);
+
+	BLI_mutex_lock(&scheduler->queue_mutex);
+	BLI_addhead(&scheduler->queue, task);
+	BLI_condition_notify_one(&scheduler->queue_cond);
+	BLI_mutex_unlock(&scheduler->queue_mutex);
+}
+
+/* Steal task from deques of other threads. Thread ID is -1 when calling thread
+ * does not own a deque. If local_only is true, only threads of the same NUMA
+ * node are checked.
+ */
+static Task *task_scheduler_steal(TaskScheduler *scheduler,
+                                  const int thread_id,
+                                  TaskPool *pool,
+                                  const bool local_only)
+{
+	Task *task;
+	if (thread_id == -1) {
+		for (int i = 0; i < scheduler->num_threads + 1; i++) {
+			if ((task = task_deque_steal(&scheduler->task_threads[i].deque, pool)) != NULL) {
+				return task;
+			}
+		}
+		return NULL;
+	}
+	TaskThread *thread = &scheduler->task_threads[thread_id];
+	const int num_steal = local_only ? thread->num_steal_local : scheduler->num_threads;
+	for (int i = 0; i < num_steal; i++) {
+		TaskDeque *deque = &scheduler->task_threads[thread->steal_order[i]].deque;
+		if ((task = task_deque_steal(deque, pool)) != NULL) {
+			return task;
+		}
+	}
+	return NULL;
+}
 
-			if (scheduler->background_thread_only && !pool->run_in_background) {
+/* Pop task from the global or a NUMA node queue, queue mutex is to be locked. */
+static Task *task_scheduler_queue_pop(TaskScheduler *scheduler, ListBase *queue, TaskPool *pool)
+{
+	Task *task;
+	for (task = queue->first; task != NULL; task = task->next) {
+		if (pool != NULL) {
+			if (task->pool != pool) {
 				continue;
 			}
+		}
+		else if (scheduler->background_thread_only && !task->pool->run_in_background) {
+			continue;
+		}
+		BLI_remlink(queue, task);
+		return task;
+	}
+	return NULL;
+}
 
-			*task = current_task;
-			found_task = true;
-			BLI_remlink(&scheduler->queue, *task);
-			break;
+/* Pop any task for the worker thread, queue mutex is to be locked.
+ * Queue of the thread's own NUMA node goes first.
+ */
+static Task *task_scheduler_queue_pop_any(TaskScheduler *scheduler, TaskThread *thread)
+{
+	Task *task;
+	if (scheduler->num_numa_nodes > 1) {
+		ListBase *numa_queue = &scheduler->numa_queues[thread->deque.numa_node];
+		if ((task = task_scheduler_queue_pop(scheduler, numa_queue, NULL)) != NULL) {
+			return task;
+		}
+	}
+	if ((task = task_scheduler_queue_pop(scheduler, &scheduler->queue, NULL)) != NULL) {
+		return task;
+	}
+	for (int node = 0; node < scheduler->num_numa_nodes && scheduler->num_numa_nodes > 1; node++) {
+		if ((task = task_scheduler_queue_pop(scheduler, &scheduler->numa_queues[node], NULL)) != NULL) {
+			return task;
 		}
-		if (!found_task)
+	}
+	return NULL;
+}
+
+/* Queue to be used for tasks of a pool which prefers another NUMA node than
+ * the pushing thread, NULL if task can go to the deque.
+ */
+BLI_INLINE ListBase *task_pool_numa_queue(TaskPool *pool, TaskDeque *deque)
+{
+	if (pool->numa_node == -1) {
+		return NULL;
+	}
+	if (deque != NULL && deque->numa_node == pool->numa_node) {
+		return NULL;
+	}
+	return &pool->scheduler->numa_queues[pool->numa_node];
+}
+
+static bool task_scheduler_thread_wait_pop(TaskThread *thread, Task **task)
+{
+	TaskScheduler *scheduler = thread->scheduler;
+	const bool use_deques = !scheduler->background_thread_only;
+
+	while (true) {
+		if (scheduler->do_exit) {
+			return false;
+		}
+
+		/* Lock-free paths first: own deque, then steal from other threads of
+		 * the same NUMA node, then from the node's queue and only then from
+		 * threads of other nodes.
+		 */
+		if (use_deques) {
+			if ((*task = task_deque_pop(&thread->deque)) != NULL) {
+				return true;
+			}
+			if ((*task = task_scheduler_steal(scheduler, thread->id, NULL, true)) != NULL) {
+				return true;
+			}
+			if (scheduler->num_numa_nodes > 1) {
+				ListBase *numa_queue = &scheduler->numa_queues[thread->deque.numa_node];
+				if (!BLI_listbase_is_empty(numa_queue)) {
+					BLI_mutex_lock(&scheduler->queue_mutex);
+					*task = task_scheduler_queue_pop(scheduler, numa_queue, NULL);
+					BLI_mutex_unlock(&scheduler->queue_mutex);
+					if (*task != NULL) {
+						return true;
+					}
+				}
+				if ((*task = task_scheduler_steal(scheduler, thread->id, NULL, false)) != NULL) {
+					return true;
+				}
+			}
+		}
+
+		BLI_mutex_lock(&scheduler->queue_mutex);
+		atomic_add_and_fetch_int32(&scheduler->num_sleeping_threads, 1);
+
+		while (true) {
+			/* Waiting on condition may wake up the thread even if condition is
+			 * not signaled (spurious wake-ups), and some race condition may also
+			 * empty the queue **after** condition has been signaled, but
+			 * **before** awoken thread reaches this point...
+			 * See http://stackoverflow.com/questions/8594591
+			 *
+			 * So we only abort here if do_exit is set.
+			 */
+			if (scheduler->do_exit) {
+				*task = NULL;
+				break;
+			}
+			*task = task_scheduler_queue_pop_any(scheduler, thread);
+			if (*task != NULL) {
+				break;
+			}
+			if (use_deques && !task_scheduler_deques_are_empty(scheduler)) {
+				break;
+			}
 			BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
-	} while (!found_task);
+		}
 
-	BLI_mutex_unlock(&scheduler->queue_mutex);
+		atomic_sub_and_fetch_int32(&scheduler->num_sleeping_threads, 1);
+		BLI_mutex_unlock(&scheduler->queue_mutex);
 
-	return true;
+		if (*task != NULL) {
+			return true;
+		}
+	}
 }
 
 BLI_INLINE void handle_local_queue(TaskThreadLocalStorage *tls,
@@ -432,14 +785,23 @@ static void *task_scheduler_thread_run(void *thread_p)
 
 	pthread_setspecific(scheduler->tls_id_key, thread);
 
+	if (scheduler->num_numa_nodes > 1) {
+		BLI_system_thread_bind_numa_node(thread->deque.numa_node);
+	}
+
 	/* keep popping off tasks */
-	while (task_scheduler_thread_wait_pop(scheduler, &task)) {
+	while (task_scheduler_thread_wait_pop(thread, &task)) {
 		TaskPool *pool = task->pool;
 
-		/* run task */
-		BLI_assert(!tls->do_delayed_push);
-		task->run(pool, task->taskdata, thread_id);
-		BLI_assert(!tls->do_delayed_push);
+		/* Tasks of canceled pool which are still in deques are discarded
+		 * here, same as task_scheduler_clear() does for the global queue.
+		 */
+		if (!pool->do_cancel) {
+			/* run task */
+			BLI_assert(!tls->do_delayed_push);
+			task->run(pool, task->taskdata, thread_id);
+			BLI_assert(!tls->do_delayed_push);
+		}
 
 		/* delete task */
 		task_free(pool, task, thread_id);
@@ -454,7 +816,36 @@ static void *task_scheduler_thread_run(void *thread_p)
 	return NULL;
 }
 
+/* Fill in order in which thread steals tasks from other threads: threads of
+ * the same NUMA node first, in cyclic order starting from the next thread.
+ */
+static void task_scheduler_init_steal_order(TaskScheduler *scheduler, TaskThread *thread)
+{
+	const int num_deques = scheduler->num_threads + 1;
+	int num_steal = 0;
+	thread->steal_order = MEM_mallocN(sizeof(int) * max_ii(scheduler->num_threads, 1),
+	                                  "TaskThread steal order");
+	for (int pass = 0; pass < 2; pass++) {
+		for (int i = 1; i < num_deques; i++) {
+			const int other_id = (thread->id + i) % num_deques;
+			const bool is_local = (scheduler->task_threads[other_id].deque.numa_node ==
+			                       thread->deque.numa_node);
+			if (is_local == (pass == 0)) {
+				thread->steal_order[num_steal++] = other_id;
+			}
+		}
+		if (pass == 0) {
+			thread->num_steal_local = num_steal;
+		}
+	}
+}
+
 TaskScheduler *BLI_task_scheduler_create(int num_threads)
+{
+	return BLI_task_scheduler_create_ex(num_threads, 0);
+}
+
+TaskScheduler *BLI_task_scheduler_create_ex(int num_threads, const int flag)
 {
 	TaskScheduler *scheduler = MEM_callocN(sizeof(TaskScheduler), "TaskScheduler");
 
@@ -483,8 +874,34 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
 	scheduler->task_threads = MEM_mallocN(sizeof(TaskThread) * (num_threads + 1),
 	                                      "TaskScheduler task threads");
 
-	/* Initialize TLS for main thread. */
-	initialize_task_tls(&scheduler->task_threads[0].tls);
+	scheduler->num_threads = num_threads;
+
+	/* Distribute threads evenly across NUMA nodes, main thread is assumed to
+	 * be on the first node.
+	 */
+	scheduler->num_numa_nodes = 1;
+	if ((flag & TASK_SCHEDULER_USE_NUMA) && !scheduler->background_thread_only) {
+		scheduler->num_numa_nodes = min_ii(BLI_system_numa_num_nodes(), num_threads + 1);
+	}
+	if (scheduler->num_numa_nodes > 1) {
+		scheduler->numa_queues = MEM_callocN(sizeof(ListBase) * scheduler->num_numa_nodes,
+		                                     "TaskScheduler NUMA queues");
+	}
+
+	/* Initialize TLS and deques of all threads before any of the threads
+	 * might try to steal.
+	 */
+	for (int i = 0; i < num_threads + 1; i++) {
+		TaskThread *thread = &scheduler->task_threads[i];
+		thread->scheduler = scheduler;
+		thread->id = i;
+		initialize_task_tls(&thread->tls);
+		task_deque_init(&thread->deque);
+		thread->deque.numa_node = i * scheduler->num_numa_nodes / (num_threads + 1);
+	}
+	for (int i = 0; i < num_threads + 1; i++) {
+		task_scheduler_init_steal_order(scheduler, &scheduler->task_threads[i]);
+	}
 
 	pthread_key_create(&scheduler->tls_id_key, NULL);
 
@@ -492,15 +909,10 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
 	if (num_threads > 0) {
 		int i;
 
-		scheduler->num_threads = num_threads;
 		scheduler->threads = MEM_callocN(sizeof(pthread_t) * num_threads, "TaskScheduler threads");
 
 		for (i = 0; i < num_threads; i++) {
 			TaskThread *thread = &scheduler->task_threads[i + 1];
-			thread->scheduler = scheduler;
-			thread->id = i + 1;
-			initialize_task_tls(&thread->tls);
-
 			if (pthread_create(&scheduler->threads[i], NULL, task_scheduler_thread_run, thread) != 0) {
 				fprintf(stderr, "TaskScheduler failed to launch thread %d/%d\n", i, num_threads);
 			}
@@ -538,7 +950,15 @@ void BLI_task_scheduler_free(TaskScheduler *scheduler)
 	if (scheduler->task_threads) {
 		for (int i = 0; i < scheduler->num_threads + 1; ++i) {
 			TaskThreadLocalStorage *tls = &scheduler->task_threads[i].tls;
+			TaskDeque *deque = &scheduler->task_threads[i].deque;
 			free_task_tls(tls);
+			MEM_freeN(scheduler->task_threads[i].steal_order);
+			/* delete leftover tasks */
+			for (int64_t j = deque->top; j < deque->bottom; j++) {
+				task = deque->slots[j & TASK_DEQUE_MASK].task;
+				task_data_free(task, 0);
+				MEM_freeN(task);
+			}
 		}
 
 		MEM_freeN(scheduler->task_threads);
@@ -549,6 +969,13 @@ void BLI_task_scheduler_free(TaskScheduler *scheduler)
 		task_data_free(task, 0);
 	}
 	BLI_freelistN(&scheduler->queue);
+	for (int node = 0; node < scheduler->num_numa_nodes && scheduler->numa_queues; node++) {
+		for (task = scheduler->numa_queues[node].first; task; task = task->next) {
+			task_data_free(task, 0);
+		}
+		BLI_freelistN(&scheduler->numa_queues[node]);
+	}
+	MEM_SAFE_FREE(scheduler->numa_queues);
 
 	/* delete mutex/condition */
 	BLI_mutex_end(&scheduler->queue_mutex);
@@ -562,10 +989,38 @@ int BLI_task_scheduler_num_threads(TaskScheduler *scheduler)
 	return scheduler->num_threads + 1;
 }
 
-static void task_scheduler_push(TaskScheduler *scheduler, Task *task, TaskPriority priority)
+int BLI_task_scheduler_num_numa_nodes(TaskScheduler *scheduler)
 {
+	return scheduler->num_numa_nodes;
+}
+
+static void task_scheduler_push(TaskScheduler *scheduler,
+                                Task *task,
+                                TaskPriority priority,
+                                TaskDeque *deque)
+{
+	ListBase *numa_queue = task_pool_numa_queue(task->pool, deque);
+
 	task_pool_num_increase(task->pool, 1);
 
+	if (numa_queue != NULL) {
+		BLI_mutex_lock(&scheduler->queue_mutex);
+		BLI_addtail(numa_queue, task);
+		BLI_condition_notify_all(&scheduler->queue_cond);
+		BLI_mutex_unlock(&scheduler->queue_mutex);
+		return;
+	}
+
+	/* High priority tasks are pushed to the deque of the pushing thread, they
+	 * are picked up by this thread next, or stolen by an idle one.
+	 */
+	if (priority == TASK_PRIORITY_HIGH && deque != NULL) {
+		if (task_deque_push(deque, task)) {
+			task_scheduler_wake_sleeping(scheduler, false);
+			return;
+		}
+	}
+
 	/* add task to queue */
 	BLI_mutex_lock(&scheduler->queue_mutex);
 
@@ -581,18 +1036,36 @@ static void task_scheduler_push(TaskScheduler *scheduler, Task *task, TaskPriori
 static void task_scheduler_push_all(TaskScheduler *scheduler,
                                     TaskPool *pool,
                                     Task **tasks,
-                                    int num_tasks)
+                                    int num_tasks,
+                                    TaskDeque *deque)
 {
+	ListBase *queue = &scheduler->queue;
+	int i = 0;
+
 	if (num_tasks == 0) {
 		return;
 	}
 
 	task_pool_num_increase(pool, num_tasks);
 
+	if (task_pool_numa_queue(pool, deque) != NULL) {
+		queue = task_pool_numa_queue(pool, deque);
+	}
+	else if (deque != NULL) {
+		while (i < num_tasks && task_deque_push(deque, tasks[i])) {
+			i++;
+		}
+		task_scheduler_wake_sleeping(scheduler, true);
+		if (i == num_tasks) {
+			return;
+		}
+	}
+
+	/* Tasks which did not fit into deque go to the global queue. */
 	BLI_mutex_lock(&scheduler->queue_mutex);
 
-	for (int i = 0; i < num_tasks; i++) {
-		BLI_addhead(&scheduler->queue, tasks[i]);
+	for (; i < num_tasks; i++) {
+		BLI_addhead(queue, tasks[i]);
 	}
 
 	BLI_condition_notify_all(&scheduler->queue_cond);
@@ -602,8 +1075,26 @@ static void task_scheduler_push_all(TaskScheduler *scheduler,
 static void task_scheduler_clear(TaskScheduler *scheduler, TaskPool *pool)
 {
 	Task *task, *nexttask;
+	TaskDeque *deque = task_scheduler_current_deque(scheduler);
 	size_t done = 0;
 
+	/* Drain deque of the calling thread, nobody else might be able to pick up
+	 * tasks from it while we are waiting. Tasks of other pools are moved to
+	 * the global queue.
+	 */
+	if (deque != NULL) {
+		while ((task = task_deque_pop(deque)) != NULL) {
+			if (task->pool == pool) {
+				task_data_free(task, pool->thread_id);
+				MEM_freeN(task);
+				done++;
+			}
+			else {
+				task_scheduler_spill(scheduler, task);
+			}
+		}
+	}
+
 	BLI_mutex_lock(&scheduler->queue_mutex);
 
 	/* free all tasks from this pool from the queue */
@@ -618,10 +1109,27 @@ static void task_scheduler_clear(TaskScheduler *scheduler, TaskPool *pool)
 		}
 	}
 
+	if (pool->numa_node != -1) {
+		ListBase *numa_queue = &scheduler->numa_queues[pool->numa_node];
+		for (task = numa_queue->first; task; task = nexttask) {
+			nexttask = task->next;
+			if (task->pool == pool) {
+				task_data_free(task, pool->thread_id);
+				BLI_freelinkN(numa_queue, task);
+				done++;
+			}
+		}
+	}
+
 	BLI_mutex_unlock(&scheduler->queue_mutex);
 
 	/* notify done */
 	task_pool_num_decrease(pool, done);
+
+	/* Tasks of this pool which are left in deques of other threads are
+	 * discarded by the thread which picks them up, see
+	 * task_scheduler_thread_run().
+	 */
 }
 
 /* Task Pool */
@@ -647,6 +1155,7 @@ static TaskPool *task_pool_create_ex(TaskScheduler *scheduler,
 
 	pool->scheduler = scheduler;
 	pool->num = 0;
+	pool->num_spilled = 0;
 	pool->do_cancel = false;
 	pool->do_work = false;
 	pool->is_suspended = is_suspended;
@@ -654,6 +1163,7 @@ static TaskPool *task_pool_create_ex(TaskScheduler *scheduler,
 	pool->suspended_queue.first = pool->suspended_queue.last = NULL;
 	pool->run_in_background = is_background;
 	pool->use_local_tls = false;
+	pool->numa_node = -1;
 
 	BLI_mutex_init(&pool->num_mutex);
 	BLI_condition_init(&pool->num_cond);
@@ -816,10 +1326,11 @@ static void task_pool_push(
 			return;
 		}
 	}
-	/* Do push to a global execution ppol, slowest possible method,
-	 * causes quite reasonable amount of threading overhead.
+	/* Push to the deque of current thread, or to a global execution pool if
+	 * the thread does not own a deque, which is the slowest possible method
+	 * and causes quite reasonable amount of threading overhead.
 	 */
-	task_scheduler_push(pool->scheduler, task, priority);
+	task_scheduler_push(pool->scheduler, task, priority, get_task_deque(pool, thread_id));
 }
 
 void BLI_task_pool_push_ex(
@@ -841,20 +1352,85 @@ void BLI_task_pool_push_from_thread(TaskPool *pool, TaskRunFunction run,
 	task_pool_push(pool, run, taskdata, free_taskdata, NULL, priority, thread_id);
 }
 
+/* Find task of the given pool which can be executed by the waiting thread. */
+static Task *task_pool_find_task(TaskPool *pool, TaskDeque *deque)
+{
+	TaskScheduler *scheduler = pool->scheduler;
+	Task *task;
+
+	/* Pop from own deque first. Tasks of other pools can not be executed here,
+	 * if we get a task from another pool, we can get into deadlock. Move them
+	 * to the global queue where other threads will pick them up.
+	 */
+	if (deque != NULL) {
+		while ((task = task_deque_pop(deque)) != NULL) {
+			if (task->pool == pool) {
+				return task;
+			}
+			task_scheduler_spill(scheduler, task);
+		}
+	}
+
+	BLI_mutex_lock(&scheduler->queue_mutex);
+	task = task_scheduler_queue_pop(scheduler, &scheduler->queue, pool);
+	if (task == NULL && pool->numa_node != -1) {
+		task = task_scheduler_queue_pop(scheduler, &scheduler->numa_queues[pool->numa_node], pool);
+	}
+	BLI_mutex_unlock(&scheduler->queue_mutex);
+	if (task != NULL) {
+		return task;
+	}
+
+	/* Steal tasks of this pool which were pushed from other threads. */
+	if (!scheduler->background_thread_only) {
+		const int thread_id = (deque != NULL) ? pool->thread_id : -1;
+		task = task_scheduler_steal(scheduler, thread_id, pool, false);
+	}
+
+	return task;
+}
+
 void BLI_task_pool_work_and_wait(TaskPool *pool)
 {
 	TaskThreadLocalStorage *tls = get_task_tls(pool, pool->thread_id);
+	TaskDeque *deque = get_task_deque(pool, pool->thread_id);
 	TaskScheduler *scheduler = pool->scheduler;
 
 	if (atomic_fetch_and_and_uint8((uint8_t *)&pool->is_suspended, 0)) {
 		if (pool->num_suspended) {
 			task_pool_num_increase(pool, pool->num_suspended);
-			BLI_mutex_lock(&scheduler->queue_mutex);
 
-			BLI_movelisttolist(&scheduler->queue, &pool->suspended_queue);
+			ListBase *numa_queue = task_pool_numa_queue(pool, deque);
+
+			/* Move as many tasks as possible to own deque, from where other
+			 * threads can steal them without locking. Tasks which prefer other
+			 * NUMA node go to the queue of that node.
+			 */
+			if (numa_queue != NULL) {
+				BLI_mutex_lock(&scheduler->queue_mutex);
+				BLI_movelisttolist(numa_queue, &pool->suspended_queue);
+				BLI_condition_notify_all(&scheduler->queue_cond);
+				BLI_mutex_unlock(&scheduler->queue_mutex);
+			}
+			else if (deque != NULL) {
+				Task *task;
+				while ((task = pool->suspended_queue.last) != NULL) {
+					if (!task_deque_push(deque, task)) {
+						break;
+					}
+					BLI_remlink(&pool->suspended_queue, task);
+				}
+				task_scheduler_wake_sleeping(scheduler, true);
+			}
+
+			if (!BLI_listbase_is_empty(&pool->suspended_queue)) {
+				BLI_mutex_lock(&scheduler->queue_mutex);
 
-			BLI_condition_notify_all(&scheduler->queue_cond);
-			BLI_mutex_unlock(&scheduler->queue_mutex);
+				BLI_movelisttolist(&scheduler->queue, &pool->suspended_queue);
+
+				BLI_condition_notify_all(&scheduler->queue_cond);
+				BLI_mutex_unlock(&scheduler->queue_mutex);
+			}
 		}
 	}
 
@@ -865,36 +1441,22 @@ void BLI_task_pool_work_and_wait(TaskPool *pool)
 	BLI_mutex_lock(&pool->num_mutex);
 
 	while (pool->num != 0) {
-		Task *task, *work_task = NULL;
-		bool found_task = false;
+		const unsigned int num_spilled = pool->num_spilled;
+		Task *work_task;
 
 		BLI_mutex_unlock(&pool->num_mutex);
 
-		BLI_mutex_lock(&scheduler->queue_mutex);
-
-		/* find task from this pool. if we get a task from another pool,
-		 * we can get into deadlock */
-
-		for (task = scheduler->queue.first; task; task = task->next) {
-			if (task->pool == pool) {
-				work_task = task;
-				found_task = true;
-				BLI_remlink(&scheduler->queue, task);
-				break;
-			}
-		}
-
-		BLI_mutex_unlock(&scheduler->queue_mutex);
+		work_task = task_pool_find_task(pool, deque);
 
 		/* if found task, do it, otherwise wait until other tasks are done */
-		if (found_task) {
+		if (work_task != NULL) {
 			/* run task */
 			BLI_assert(!tls->do_delayed_push);
 			work_task->run(pool, work_task->taskdata, pool->thread_id);
 			BLI_assert(!tls->do_delayed_push);
 
 			/* delete task */
-			task_free(pool, task, pool->thread_id);
+			task_free(pool, work_task, pool->thread_id);
 
 			/* Handle all tasks from local queue. */
 			handle_local_queue(tls, pool->thread_id);
@@ -907,7 +1469,10 @@ void BLI_task_pool_work_and_wait(TaskPool *pool)
 		if (pool->num == 0)
 			break;
 
-		if (!found_task)
+		/* Don't wait if some task of this pool was moved to the global queue
+		 * while we were looking for a task.
+		 */
+		if (work_task == NULL && num_spilled == pool->num_spilled)
 			BLI_condition_wait(&pool->num_cond, &pool->num_mutex);
 	}
 
@@ -946,6 +1511,11 @@ ThreadMutex *BLI_task_pool_user_mutex(TaskPool *pool)
 	return &pool->user_mutex;
 }
 
+int BLI_task_pool_creator_thread_id(TaskPool *pool)
+{
+	return pool->thread_id;
+}
+
 void BLI_task_pool_delayed_push_begin(TaskPool *pool, int thread_id)
 {
 	if (task_can_use_local_queues(pool, thread_id)) {
@@ -964,7 +1534,8 @@ void BLI_task_pool_delayed_push_end(TaskPool *pool, int thread_id)
 		task_scheduler_push_all(pool->scheduler,
 		                        pool,
 		                        tls->delayed_queue,
-		                        tls->num_delayed_queue);
+		                        tls->num_delayed_queue,
+		                        get_task_deque(pool, thread_id));
 		tls->do_delayed_push = false;
 		tls->num_delayed_queue = 0;
 	}
@@ -1049,8 +1620,13 @@ static void palallel_range_single_thread(const int start, int const stop,
 	for (int i = start; i < stop; ++i) {
 		func(userdata, i, &tls);
 	}
-	if (settings->func_finalize != NULL) {
-		settings->func_finalize(userdata, userdata_chunk_local);
+	if (use_userdata_chunk) {
+		if (settings->func_reduce != NULL) {
+			settings->func_reduce(userdata, userdata_chunk, userdata_chunk_local);
+		}
+		if (settings->func_finalize != NULL) {
+			settings->func_finalize(userdata, userdata_chunk_local);
+		}
 	}
 	MALLOCA_FREE(userdata_chunk_local, userdata_chunk_size);
 }
@@ -1059,6 +1635,10 @@ static void palallel_range_single_thread(const int start, int const stop,
  * This function allows to parallelized for loops in a similar way to OpenMP's 'parallel for' statement.
  *
  * See public API doc of ParallelRangeSettings for description of all settings.
+ *
+ * \note It is safe to call this function from a task of another pool or range (nested parallelism):
+ * calling thread works on the range too, no new threads are created and idle threads of the
+ * scheduler steal the rest of the work.
  */
 void BLI_task_parallel_range(const int start, const int stop,
                              void *userdata,
@@ -1134,6 +1714,11 @@ void BLI_task_parallel_range(const int start, const int stop,
 	}
 
 	task_pool = BLI_task_pool_create_suspended(task_scheduler, &state);
+	if (task_scheduler->num_numa_nodes > 1 &&
+	    settings->numa_node >= 0 && settings->numa_node < task_scheduler->num_numa_nodes)
+	{
+		task_pool->numa_node = settings->numa_node;
+	}
 
 	/* NOTE: This way we are adding a memory barrier and ensure all worker
 	 * threads can read and modify the value, without any locks. */
@@ -1160,6 +1745,12 @@ void BLI_task_parallel_range(const int start, const int stop,
 	BLI_task_pool_free(task_pool);
 
 	if (use_userdata_chunk) {
+		if (settings->func_reduce != NULL) {
+			for (i = 0; i < num_tasks; i++) {
+				userdata_chunk_local = (char *)userdata_chunk_array + (userdata_chunk_size * i);
+				settings->func_reduce(userdata, userdata_chunk, userdata_chunk_local);
+			}
+		}
 		if (settings->func_finalize != NULL) {
 			for (i = 0; i < num_tasks; i++) {
 				userdata_chunk_local = (char *)userdata_chunk_array + (userdata_chunk_size * i);
@@ -0,0 +1,225 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/blenlib/intern/task_graph.c
+ *  \ingroup bli
+ *
+ * Graph of tasks with dependencies, executed by the task scheduler.
+ *
+ * Every node keeps number of its parents. On every execution pending counter
+ * of each node is initialized from it, and decremented atomically once a
+ * parent is done. The thread which brings the counter to zero is responsible
+ * for the child: the first ready child is executed right away by the same
+ * thread (continuation), other ready children are pushed to the pool.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_math_base.h"
+#include "BLI_memarena.h"
+#include "BLI_task.h"
+
+#include "atomic_ops.h"
+
+/* Number of children a node can have before its array is reallocated. */
+#define NODE_CHILDREN_INLINE_SIZE 2
+
+/* Number of root nodes which are pushed to the pool by a single task. This way
+ * pushing roots is distributed across threads and goes to their deques, instead
+ * of having all of them in the global queue.
+ */
+#define ROOTS_CHUNK_SIZE 64
+
+struct TaskGraphNode {
+	TaskGraphNodeRunFunction run_func;
+	void *taskdata;
+	TaskGraphNodeFreeFunction free_func;
+
+	/* Nodes which can only be executed after this one. */
+	TaskGraphNode **children;
+	int num_children;
+	int children_alloc;
+	TaskGraphNode *children_inline[NODE_CHILDREN_INLINE_SIZE];
+
+	/* Number of nodes this one depends on. */
+	int num_parents;
+	/* Number of parents which are not done yet in the current execution. */
+	uint32_t num_pending;
+};
+
+struct TaskGraph {
+	/* Nodes and their children arrays. */
+	MemArena *arena;
+
+	TaskGraphNode **nodes;
+	int num_nodes;
+	int nodes_alloc;
+
+	/* Nodes without parents, updated on execution. */
+	TaskGraphNode **roots;
+	int num_roots;
+};
+
+TaskGraph *BLI_task_graph_create(void)
+{
+	TaskGraph *graph = MEM_callocN(sizeof(TaskGraph), "TaskGraph");
+	graph->arena = BLI_memarena_new(BLI_MEMARENA_STD_BUFSIZE, "TaskGraph arena");
+	return graph;
+}
+
+void BLI_task_graph_free(TaskGraph *graph)
+{
+	for (int i = 0; i < graph->num_nodes; i++) {
+		TaskGraphNode *node = graph->nodes[i];
+		if (node->free_func != NULL) {
+			node->free_func(node->taskdata);
+		}
+	}
+	MEM_SAFE_FREE(graph->nodes);
+	MEM_SAFE_FREE(graph->roots);
+	BLI_memarena_free(graph->arena);
+	MEM_freeN(graph);
+}
+
+/**
+ * Create new node in the graph. If \a free_func is not NULL, it will be called
+ * for \a taskdata when the graph is freed.
+ */
+TaskGraphNode *BLI_task_graph_node_create(TaskGraph *graph,
+                                          TaskGraphNodeRunFunction run_func,
+                                          void *taskdata,
+                                          TaskGraphNodeFreeFunction free_func)
+{
+	TaskGraphNode *node = BLI_memarena_alloc(graph->arena, sizeof(TaskGraphNode));
+	node->run_func = run_func;
+	node->taskdata = taskdata;
+	node->free_func = free_func;
+	node->children = node->children_inline;
+	node->num_children = 0;
+	node->children_alloc = NODE_CHILDREN_INLINE_SIZE;
+	node->num_parents = 0;
+	node->num_pending = 0;
+
+	if (graph->num_nodes == graph->nodes_alloc) {
+		graph->nodes_alloc = max_ii(graph->nodes_alloc * 2, 64);
+		graph->nodes = MEM_reallocN(graph->nodes, sizeof(*graph->nodes) * graph->nodes_alloc);
+	}
+	graph->nodes[graph->num_nodes++] = node;
+
+	return node;
+}
+
+/**
+ * Make \a to_node depend on \a from_node, so it is only executed after
+ * \a from_node is done.
+ */
+void BLI_task_graph_edge_create(TaskGraph *graph, TaskGraphNode *from_node, TaskGraphNode *to_node)
+{
+	if (from_node->num_children == from_node->children_alloc) {
+		const int children_alloc = from_node->children_alloc * 2;
+		TaskGraphNode **children = BLI_memarena_alloc(graph->arena, sizeof(*children) * children_alloc);
+		memcpy(children, from_node->children, sizeof(*children) * from_node->num_children);
+		from_node->children = children;
+		from_node->children_alloc = children_alloc;
+	}
+	from_node->children[from_node->num_children++] = to_node;
+	to_node->num_parents++;
+}
+
+int BLI_task_graph_num_nodes(TaskGraph *graph)
+{
+	return graph->num_nodes;
+}
+
+static void task_graph_node_run(TaskPool *__restrict pool, void *taskdata, int thread_id)
+{
+	TaskGraphNode *node = taskdata;
+	while (node != NULL) {
+		TaskGraphNode *next_node = NULL;
+		node->run_func(node->taskdata, thread_id);
+		BLI_task_pool_delayed_push_begin(pool, thread_id);
+		for (int i = 0; i < node->num_children; i++) {
+			TaskGraphNode *child = node->children[i];
+			if (atomic_sub_and_fetch_uint32(&child->num_pending, 1) != 0) {
+				continue;
+			}
+			if (next_node == NULL) {
+				next_node = child;
+			}
+			else {
+				BLI_task_pool_push_from_thread(
+				        pool, task_graph_node_run, child, false, TASK_PRIORITY_HIGH, thread_id);
+			}
+		}
+		BLI_task_pool_delayed_push_end(pool, thread_id);
+		node = next_node;
+	}
+}
+
+static void task_graph_roots_run(TaskPool *__restrict pool, void *taskdata, int thread_id)
+{
+	TaskGraph *graph = BLI_task_pool_userdata(pool);
+	const int first_root = GET_INT_FROM_POINTER(taskdata);
+	const int last_root = min_ii(first_root + ROOTS_CHUNK_SIZE, graph->num_roots);
+	BLI_task_pool_delayed_push_begin(pool, thread_id);
+	for (int i = first_root + 1; i < last_root; i++) {
+		BLI_task_pool_push_from_thread(
+		        pool, task_graph_node_run, graph->roots[i], false, TASK_PRIORITY_HIGH, thread_id);
+	}
+	BLI_task_pool_delayed_push_end(pool, thread_id);
+	task_graph_node_run(pool, graph->roots[first_root], thread_id);
+}
+
+/**
+ * Execute all nodes of the graph, respecting their dependencies, and wait for
+ * all of them to be done. Calling thread participates in the execution.
+ *
+ * Graph can be executed any number of times. Nodes which are part of a
+ * dependency cycle (and their descendants) are never executed.
+ */
+void BLI_task_graph_work_and_wait(TaskScheduler *scheduler, TaskGraph *graph)
+{
+	TaskPool *pool = BLI_task_pool_create_suspended(scheduler, graph);
+	const int thread_id = BLI_task_pool_creator_thread_id(pool);
+
+	graph->roots = MEM_reallocN(graph->roots, sizeof(*graph->roots) * max_ii(graph->num_nodes, 1));
+	graph->num_roots = 0;
+	for (int i = 0; i < graph->num_nodes; i++) {
+		TaskGraphNode *node = graph->nodes[i];
+		node->num_pending = (uint32_t)node->num_parents;
+		if (node->num_parents == 0) {
+			graph->roots[graph->num_roots++] = node;
+		}
+	}
+	/* Make sure pending counters are visible to worker threads. */
+	atomic_fetch_and_add_int32(&graph->num_roots, 0);
+
+	for (int i = 0; i < graph->num_roots; i += ROOTS_CHUNK_SIZE) {
+		BLI_task_pool_push_from_thread(
+		        pool, task_graph_roots_run, SET_INT_IN_POINTER(i), false, TASK_PRIORITY_HIGH, thread_id);
+	}
+
+	BLI_task_pool_work_and_wait(pool);
+	BLI_task_pool_free(pool);
+}
@@ -128,6 +128,7 @@ static pthread_mutex_t _view3d_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_t mainid;
 static unsigned int thread_levels = 0;  /* threads can be invoked inside threads */
 static int num_threads_override = 0;
+static bool use_numa_scheduling = false;
 
 /* just a max for security reasons */
 #define RE_MAX_THREAD BLENDER_MAX_THREADS
@@ -161,6 +162,7 @@ void BLI_threadapi_exit(void)
 {
 	if (task_scheduler) {
 		BLI_task_scheduler_free(task_scheduler);
+		task_scheduler = NULL;
 	}
 	BLI_spin_end(&_malloc_lock);
 }
@@ -173,7 +175,9 @@ TaskScheduler *BLI_task_scheduler_get(void)
 		/* Do a lazy initialization, so it happens after
 		 * command line arguments parsing
 		 */
-		task_scheduler = BLI_task_scheduler_create(tot_thread);
+		task_scheduler = BLI_task_scheduler_create_ex(
+		        tot_thread,
+		        use_numa_scheduling ? TASK_SCHEDULER_USE_NUMA : 0);
 	}
 
 	return task_scheduler;
@@ -385,6 +389,19 @@ int BLI_system_num_threads_override_get(void)
 	return num_threads_override;
 }
 
+/* Make task scheduler pin its threads to NUMA nodes, only has effect when
+ * called before scheduler is created.
+ */
+void BLI_system_numa_scheduling_set(bool use_numa)
+{
+	use_numa_scheduling = use_numa;
+}
+
+bool BLI_system_numa_scheduling_get(void)
+{
+	return use_numa_scheduling;
+}
+
 /* Global Mutex Locks */
 
 static ThreadMutex *global_mutex_from_type(const int type)
@@ -75,6 +75,13 @@ enum {
 	ENDB = BLEND_MAKE_ID('E', 'N', 'D', 'B'),
 };
 
+/**
+ * Start of files written with #G_FILE_COMPRESS_FRAMES,
+ * in place of the "BLENDER" header of regular and gzip compressed files.
+ */
+#define BLEND_FRAMES_MAGIC "BLENDFRM"
+#define BLEND_FRAMES_MAGIC_LEN 8
+
 #define BLEN_THUMB_MEMSIZE_FILE(_x, _y) (sizeof(int) * (2 + (size_t)(_x) * (size_t)(_y)))
 
 #endif  /* __BLO_BLEND_DEFS_H__ */
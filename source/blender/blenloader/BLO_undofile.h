@@ -67,5 +67,8 @@ extern void BLO_memfile_merge(MemFile *first, MemFile *second);
 /* utilities */
 extern struct Main *BLO_memfile_main_get(struct MemFile *memfile, struct Main *bmain, struct Scene **r_scene);
 extern bool BLO_memfile_write_file(struct MemFile *memfile, const char *filename);
+extern bool BLO_memfile_write_file_atomic(
+        struct MemFile *memfile, const char *filename,
+        const short *stop, float *progress);
 
 #endif  /* __BLO_UNDOFILE_H__ */
@@ -83,7 +83,7 @@ BlendHandle *BLO_blendhandle_from_file(const char *filepath, ReportList *reports
 {
 	BlendHandle *bh;
 
-	bh = (BlendHandle *)blo_openblenderfile(filepath, reports);
+	bh = (BlendHandle *)blo_openblenderfile(filepath, reports, true);
 
 	return bh;
 }
@@ -210,13 +210,9 @@ LinkNode *BLO_blendhandle_get_previews(BlendHandle *bh, int ofblocktype, int *to
 					if (prv) {
 						memcpy(new_prv, prv, sizeof(PreviewImage));
 						if (prv->rect[0] && prv->w[0] && prv->h[0]) {
-							unsigned int *rect = NULL;
-							size_t len = new_prv->w[0] * new_prv->h[0] * sizeof(unsigned int);
-							new_prv->rect[0] = MEM_callocN(len, __func__);
 							bhead = blo_nextbhead(fd, bhead);
-							rect = (unsigned int *)(bhead + 1);
-							BLI_assert(len == bhead->len);
-							memcpy(new_prv->rect[0], rect, len);
+							BLI_assert((new_prv->w[0] * new_prv->h[0] * sizeof(unsigned int)) == bhead->len);
+							new_prv->rect[0] = BLO_library_read_struct(fd, bhead, "PreviewImage Icon Rect");
 						}
 						else {
 							/* This should not be needed, but can happen in 'broken' .blend files,
@@ -227,13 +223,9 @@ LinkNode *BLO_blendhandle_get_previews(BlendHandle *bh, int ofblocktype, int *to
 						}
 
 						if (prv->rect[1] && prv->w[1] && prv->h[1]) {
-							unsigned int *rect = NULL;
-							size_t len = new_prv->w[1] * new_prv->h[1] * sizeof(unsigned int);
-							new_prv->rect[1] = MEM_callocN(len, __func__);
 							bhead = blo_nextbhead(fd, bhead);
-							rect = (unsigned int *)(bhead + 1);
-							BLI_assert(len == bhead->len);
-							memcpy(new_prv->rect[1], rect, len);
+							BLI_assert((new_prv->w[1] * new_prv->h[1] * sizeof(unsigned int)) == bhead->len);
+							new_prv->rect[1] = BLO_library_read_struct(fd, bhead, "PreviewImage Icon Rect");
 						}
 						else {
 							/* This should not be needed, but can happen in 'broken' .blend files,
@@ -324,7 +316,7 @@ BlendFileData *BLO_read_from_file(
 	BlendFileData *bfd = NULL;
 	FileData *fd;
 
-	fd = blo_openblenderfile(filepath, reports);
+	fd = blo_openblenderfile(filepath, reports, false);
 	if (fd) {
 		fd->reports = reports;
 		fd->skip_flags = skip_flags;
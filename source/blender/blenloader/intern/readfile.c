@@ -46,6 +46,8 @@
 #include "BLI_utildefines.h"
 #ifndef WIN32
 #  include <unistd.h> // for read close
+#  include <sys/mman.h> // for mmap
+#  include <sys/stat.h> // for fstat
 #else
 #  include <io.h> // for open close read
 #  include "winsock2.h"
@@ -109,6 +111,7 @@
 #include "BLI_blenlib.h"
 #include "BLI_math.h"
 #include "BLI_threads.h"
+#include "BLI_task.h"
 #include "BLI_mempool.h"
 
 #include "BLT_translation.h"
@@ -131,6 +134,7 @@
 #include "BKE_library_query.h"
 #include "BKE_idcode.h"
 #include "BKE_idprop.h"
+#include "BKE_key.h"
 #include "BKE_material.h"
 #include "BKE_main.h" // for Main
 #include "BKE_mesh.h" // for ME_ defines (patching)
@@ -162,6 +166,13 @@
 
 #include "readfile.h"
 
+#ifdef WITH_LZO
+#  ifdef WITH_SYSTEM_LZO
+#    include <lzo/lzo1x.h>
+#  else
+#    include "minilzo.h"
+#  endif
+#endif
 
 #include <errno.h>
 
@@ -221,6 +232,17 @@
 /* Use GHash for restoring pointers by name */
 #define USE_GHASH_RESTORE_POINTER
 
+/* Memory map uncompressed files, blocks of native files are used from the mapping without copying. */
+#ifndef WIN32
+#  define USE_MMAP_FILE
+#endif
+
+/* Blocks in files are only 4 byte aligned, so their #BHead is only used in place
+ * on platforms which support unaligned access, see #FD_FLAGS_MMAP_BHEADS. */
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#  define USE_MMAP_BHEADS
+#endif
+
 /* Define this to have verbose debug prints. */
 #define USE_DEBUG_PRINT
 
@@ -238,16 +260,31 @@ typedef struct OldNew {
 	int nr;
 } OldNew;
 
+typedef struct OldNewMapStats {
+	/* lookups of non NULL addresses */
+	uint64_t lookups;
+	/* lookups not finding an entry */
+	uint64_t misses;
+	/* slots visited after the first one, over all lookups */
+	uint64_t probes;
+} OldNewMapStats;
+
 typedef struct OldNewMap {
+	/* entries in the order they are inserted */
 	OldNew *entries;
 	int nentries, entriessize;
-	bool sorted;
-	int lasthit;
+	/* Open addressing hash on the old address, with linear probing.
+	 * Slots store an index into \a entries, -1 when empty. */
+	int *map;
+	int map_size_exp;
+
+	OldNewMapStats stats;
 } OldNewMap;
 
 
 /* local prototypes */
 static void *read_struct(FileData *fd, BHead *bh, const char *blockname);
+static bool fd_seek_frames(FileData *fd, const uint64_t offset);
 static void direct_link_modifiers(FileData *fd, ListBase *lb);
 static void convert_tface_mt(FileData *fd, Main *main);
 static BHead *find_bhead_from_code_name(FileData *fd, const short idcode, const char *name);
@@ -285,31 +322,95 @@ static const char *library_parent_filepath(Library *lib)
 	return lib->parent ? lib->parent->filepath : "<direct>";
 }
 
-static OldNewMap *oldnewmap_new(void)
+/* -------------------------------------------------------------------- */
+/** \name Old/New Address Map
+ *
+ * Maps addresses stored in the file to the newly read data.
+ * \{ */
+
+/* the map has at least twice as many slots as entries */
+#define OLDNEWMAP_ENTRIES_INIT 1024
+#define OLDNEWMAP_MAP_SIZE_EXP_INIT 11
+
+#define OLDNEWMAP_MAP_SIZE(onm) (1u << (onm)->map_size_exp)
+
+BLI_INLINE unsigned int oldnewmap_hash(const OldNewMap *onm, const void *addr)
 {
-	OldNewMap *onm= MEM_callocN(sizeof(*onm), "OldNewMap");
+	/* Fibonacci hashing, taking the high bits since the low bits of addresses are mostly zero. */
+	return (unsigned int)(((uint64_t)(uintptr_t)addr * 0x9E3779B97F4A7C15ull) >> (64 - onm->map_size_exp));
+}
 
-	onm->entriessize = 1024;
-	onm->entries = MEM_malloc_arrayN(onm->entriessize, sizeof(*onm->entries), "OldNewMap.entries");
+static void oldnewmap_map_insert(OldNewMap *onm, int index)
+{
+	const unsigned int mask = OLDNEWMAP_MAP_SIZE(onm) - 1;
+	unsigned int slot = oldnewmap_hash(onm, onm->entries[index].old);
 
-	return onm;
+	while (onm->map[slot] != -1) {
+		slot = (slot + 1) & mask;
+	}
+	onm->map[slot] = index;
 }
 
-static int verg_oldnewmap(const void *v1, const void *v2)
+static void oldnewmap_map_reset(OldNewMap *onm)
 {
-	const struct OldNew *x1=v1, *x2=v2;
+	memset(onm->map, 0xff, sizeof(*onm->map) * OLDNEWMAP_MAP_SIZE(onm));
+}
 
-	if (x1->old > x2->old) return 1;
-	else if (x1->old < x2->old) return -1;
-	return 0;
+static void oldnewmap_map_grow(OldNewMap *onm)
+{
+	int i;
+
+	onm->map_size_exp++;
+	MEM_freeN(onm->map);
+	onm->map = MEM_malloc_arrayN(OLDNEWMAP_MAP_SIZE(onm), sizeof(*onm->map), "OldNewMap.map");
+	oldnewmap_map_reset(onm);
+
+	/* in insertion order, so duplicate addresses keep finding the first entry */
+	for (i = 0; i < onm->nentries; i++) {
+		oldnewmap_map_insert(onm, i);
+	}
+}
+
+static OldNewMap *oldnewmap_new_ex(const int entries_init)
+{
+	OldNewMap *onm = MEM_callocN(sizeof(*onm), "OldNewMap");
+
+	onm->entriessize = max_ii(entries_init, 1);
+	onm->entries = MEM_malloc_arrayN(onm->entriessize, sizeof(*onm->entries), "OldNewMap.entries");
+
+	onm->map_size_exp = 2;
+	while ((unsigned int)onm->entriessize * 2 > OLDNEWMAP_MAP_SIZE(onm)) {
+		onm->map_size_exp++;
+	}
+	onm->map = MEM_malloc_arrayN(OLDNEWMAP_MAP_SIZE(onm), sizeof(*onm->map), "OldNewMap.map");
+	oldnewmap_map_reset(onm);
+
+	return onm;
 }
 
+static OldNewMap *oldnewmap_new(void)
+{
+	OldNewMap *onm = oldnewmap_new_ex(OLDNEWMAP_ENTRIES_INIT);
+	BLI_assert(onm->map_size_exp == OLDNEWMAP_MAP_SIZE_EXP_INIT);
+	return onm;
+}
 
-static void oldnewmap_sort(FileData *fd)
+/**
+ * Copy of \a onm_src sized to the entries it holds, keeps the data of an ID around until it's linked.
+ */
+static OldNewMap *oldnewmap_copy(const OldNewMap *onm_src)
 {
-	BLI_assert(fd->libmap->sorted == false);
-	qsort(fd->libmap->entries, fd->libmap->nentries, sizeof(OldNew), verg_oldnewmap);
-	fd->libmap->sorted = 1;
+	OldNewMap *onm = oldnewmap_new_ex(onm_src->nentries);
+	int i;
+
+	memcpy(onm->entries, onm_src->entries, sizeof(*onm->entries) * onm_src->nentries);
+	onm->nentries = onm_src->nentries;
+
+	for (i = 0; i < onm->nentries; i++) {
+		oldnewmap_map_insert(onm, i);
+	}
+
+	return onm;
 }
 
 /* nr is zero for data, and ID code for libdata */
@@ -328,6 +429,13 @@ static void oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void *newaddr,
 	entry->old = oldaddr;
 	entry->newp = newaddr;
 	entry->nr = nr;
+
+	if (UNLIKELY((unsigned int)onm->nentries * 2 > OLDNEWMAP_MAP_SIZE(onm))) {
+		oldnewmap_map_grow(onm);
+	}
+	else {
+		oldnewmap_map_insert(onm, onm->nentries - 1);
+	}
 }
 
 void blo_do_versions_oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void *newaddr, int nr)
@@ -336,52 +444,25 @@ void blo_do_versions_oldnewmap_insert(OldNewMap *onm, const void *oldaddr, void
 }
 
 /**
- * Do a full search (no state).
- *
- * \param lasthit: Use as a reference position to avoid a full search
- * from either end of the array, giving more efficient lookups.
- *
- * \note This would seem an ideal case for hash or btree lookups.
- * However the data is written in-order, using the \a lasthit will normally avoid calling this function.
- * Creating a btree/hash structure adds overhead for the common-case to optimize the corner-case
- * (since most entries will never be retrieved).
- * So just keep full lookups as a fall-back.
+ * \return the index of the (first inserted) entry of \a addr, -1 when not found.
  */
-static int oldnewmap_lookup_entry_full(const OldNewMap *onm, const void *addr, int lasthit)
+static int oldnewmap_lookup_entry(OldNewMap *onm, const void *addr)
 {
-	const int nentries = onm->nentries;
-	const OldNew *entries = onm->entries;
-	int i;
-
-	/* search relative to lasthit where possible */
-	if (lasthit >= 0 && lasthit < nentries) {
+	const unsigned int mask = OLDNEWMAP_MAP_SIZE(onm) - 1;
+	unsigned int slot = oldnewmap_hash(onm, addr);
+	int index;
 
-		/* search forwards */
-		i = lasthit;
-		while (++i != nentries) {
-			if (entries[i].old == addr) {
-				return i;
-			}
-		}
+	onm->stats.lookups++;
 
-		/* search backwards */
-		i = lasthit + 1;
-		while (i--) {
-			if (entries[i].old == addr) {
-				return i;
-			}
-		}
-	}
-	else {
-		/* search backwards (full) */
-		i = nentries;
-		while (i--) {
-			if (entries[i].old == addr) {
-				return i;
-			}
+	while ((index = onm->map[slot]) != -1) {
+		if (onm->entries[index].old == addr) {
+			return index;
 		}
+		slot = (slot + 1) & mask;
+		onm->stats.probes++;
 	}
 
+	onm->stats.misses++;
 	return -1;
 }
 
@@ -391,21 +472,9 @@ static void *oldnewmap_lookup_and_inc(OldNewMap *onm, const void *addr, bool inc
 
 	if (addr == NULL) return NULL;
 
-	if (onm->lasthit < onm->nentries-1) {
-		OldNew *entry = &onm->entries[++onm->lasthit];
-
-		if (entry->old == addr) {
-			if (increase_users)
-				entry->nr++;
-			return entry->newp;
-		}
-	}
-
-	i = oldnewmap_lookup_entry_full(onm, addr, onm->lasthit);
+	i = oldnewmap_lookup_entry(onm, addr);
 	if (i != -1) {
 		OldNew *entry = &onm->entries[i];
-		BLI_assert(entry->old == addr);
-		onm->lasthit = i;
 		if (increase_users)
 			entry->nr++;
 		return entry->newp;
@@ -417,32 +486,17 @@ static void *oldnewmap_lookup_and_inc(OldNewMap *onm, const void *addr, bool inc
 /* for libdata, nr has ID code, no increment */
 static void *oldnewmap_liblookup(OldNewMap *onm, const void *addr, const void *lib)
 {
+	int i;
+
 	if (addr == NULL) {
 		return NULL;
 	}
 
-	/* lasthit works fine for non-libdata, linking there is done in same sequence as writing */
-	if (onm->sorted) {
-		const OldNew entry_s = {.old = addr};
-		OldNew *entry = bsearch(&entry_s, onm->entries, onm->nentries, sizeof(OldNew), verg_oldnewmap);
-		if (entry) {
-			ID *id = entry->newp;
-
-			if (id && (!lib || id->lib)) {
-				return id;
-			}
-		}
-	}
-	else {
-		/* note, this can be a bottle neck when loading some files */
-		const int i = oldnewmap_lookup_entry_full(onm, addr, -1);
-		if (i != -1) {
-			OldNew *entry = &onm->entries[i];
-			ID *id = entry->newp;
-			BLI_assert(entry->old == addr);
-			if (id && (!lib || id->lib)) {
-				return id;
-			}
+	i = oldnewmap_lookup_entry(onm, addr);
+	if (i != -1) {
+		ID *id = onm->entries[i].newp;
+		if (id && (!lib || id->lib)) {
+			return id;
 		}
 	}
 
@@ -464,16 +518,70 @@ static void oldnewmap_free_unused(OldNewMap *onm)
 
 static void oldnewmap_clear(OldNewMap *onm)
 {
+	/* The data map is cleared after every ID, avoid resetting a map grown by big IDs each time.
+	 * Removing entries in reverse insertion order keeps the probe sequences of the others intact. */
+	if ((unsigned int)onm->nentries * 8 < OLDNEWMAP_MAP_SIZE(onm)) {
+		const unsigned int mask = OLDNEWMAP_MAP_SIZE(onm) - 1;
+		int i;
+
+		for (i = onm->nentries - 1; i >= 0; i--) {
+			unsigned int slot = oldnewmap_hash(onm, onm->entries[i].old);
+			while (onm->map[slot] != i) {
+				slot = (slot + 1) & mask;
+			}
+			onm->map[slot] = -1;
+		}
+	}
+	else {
+		oldnewmap_map_reset(onm);
+	}
+
 	onm->nentries = 0;
-	onm->lasthit = 0;
 }
 
 static void oldnewmap_free(OldNewMap *onm)
 {
 	MEM_freeN(onm->entries);
+	MEM_freeN(onm->map);
 	MEM_freeN(onm);
 }
 
+static void oldnewmap_print_stats(const OldNewMap *onm, const char *name)
+{
+	const OldNewMapStats *stats = &onm->stats;
+
+	printf("  %-8s %10llu lookups, %5.1f%% misses, %.2f probes per lookup, %u slots\n",
+	       name, (unsigned long long)stats->lookups,
+	       stats->lookups ? (double)stats->misses * 100.0 / (double)stats->lookups : 0.0,
+	       stats->lookups ? (double)stats->probes / (double)stats->lookups : 0.0,
+	       OLDNEWMAP_MAP_SIZE(onm));
+}
+
+/**
+ * Add the entries of \a onm_src to \a onm, in insertion order.
+ */
+static void oldnewmap_merge(OldNewMap *onm, const OldNewMap *onm_src)
+{
+	int i;
+
+	for (i = 0; i < onm_src->nentries; i++) {
+		const OldNew *entry = &onm_src->entries[i];
+		oldnewmap_insert(onm, entry->old, entry->newp, entry->nr);
+	}
+}
+
+static void oldnewmap_stats_add(OldNewMap *onm, const OldNewMap *onm_src)
+{
+	onm->stats.lookups += onm_src->stats.lookups;
+	onm->stats.misses += onm_src->stats.misses;
+	onm->stats.probes += onm_src->stats.probes;
+}
+
+#undef OLDNEWMAP_ENTRIES_INIT
+#undef OLDNEWMAP_MAP_SIZE_EXP_INIT
+
+/** \} */
+
 /***/
 
 static void read_libraries(FileData *basefd, ListBase *mainlist);
@@ -806,10 +914,29 @@ static BHeadN *get_bhead(FileData *fd)
 			/* bhead now contains the (converted) bhead structure. Now read
 			 * the associated data and put everything in a BHeadN (creative naming !)
 			 */
-			if (!fd->eof) {
+			if (fd->eof) {
+				/* pass */
+			}
+			else if ((fd->flags & FD_FLAGS_BHEAD_READ_ON_DEMAND) && bhead.code == DATA) {
+				/* Seek over the data, read_struct() reads it when the block is used. */
+				new_bhead = MEM_mallocN(sizeof(BHeadN), "new_bhead");
+				new_bhead->next = new_bhead->prev = NULL;
+				new_bhead->data_offset = fd->frames_seek;
+				new_bhead->has_data = false;
+				new_bhead->bhead = bhead;
+
+				if (!fd_seek_frames(fd, fd->frames_seek + (uint64_t)bhead.len)) {
+					fd->eof = 1;
+					MEM_freeN(new_bhead);
+					new_bhead = NULL;
+				}
+			}
+			else {
 				new_bhead = MEM_mallocN(sizeof(BHeadN) + bhead.len, "new_bhead");
 				if (new_bhead) {
 					new_bhead->next = new_bhead->prev = NULL;
+					new_bhead->data_offset = 0;
+					new_bhead->has_data = true;
 					new_bhead->bhead = bhead;
 
 					readsize = fd->read(fd, new_bhead + 1, bhead.len);
@@ -837,11 +964,96 @@ static BHeadN *get_bhead(FileData *fd)
 	return(new_bhead);
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Memory Mapped Blocks
+ *
+ * When the file matches the pointer size and endianness of this build,
+ * blocks are used in place from the (private, copy-on-write) mapping,
+ * only #read_struct copies them into their own allocations.
+ * This avoids reading the whole file into a #BHeadN list first.
+ * Decompressed block framed files are used the same way, see #FD_FLAGS_MMAP_ALLOCATED.
+ *
+ * \note Blocks are only 4 byte aligned in files, so this is only used on platforms
+ * supporting unaligned access of the #BHead (see #USE_MMAP_BHEADS). Elsewhere the
+ * blocks are read from the mapping into a #BHeadN list like from any other file.
+ * \{ */
+
+/* Block at \a offset, NULL past the end of the file or when the block is truncated. */
+static BHead *mmap_bhead_at(FileData *fd, size_t offset)
+{
+	BHead *bhead;
+
+	if (offset > fd->mmap_size || fd->mmap_size - offset < sizeof(BHead)) {
+		return NULL;
+	}
+
+	bhead = (BHead *)(fd->mmap_buffer + offset);
+
+	/* make sure people are not trying to pass bad blend files */
+	if (bhead->len < 0 || fd->mmap_size - offset - sizeof(BHead) < (size_t)bhead->len) {
+		return NULL;
+	}
+
+	return bhead;
+}
+
+static BHead *mmap_nextbhead(FileData *fd, BHead *thisblock)
+{
+	const char *next = (const char *)(thisblock + 1) + thisblock->len;
+	return mmap_bhead_at(fd, (size_t)(next - fd->mmap_buffer));
+}
+
+static BHead *mmap_prevbhead(FileData *fd, BHead *thisblock)
+{
+	int low, high;
+
+	/* Blocks can't be walked backwards, index them the first time it's needed. */
+	if (fd->mmap_bheads == NULL) {
+		BHead *bhead;
+		int i;
+
+		fd->mmap_bheads_len = 0;
+		for (bhead = blo_firstbhead(fd); bhead; bhead = mmap_nextbhead(fd, bhead)) {
+			fd->mmap_bheads_len++;
+		}
+
+		fd->mmap_bheads = MEM_mallocN(sizeof(*fd->mmap_bheads) * (size_t)max_ii(fd->mmap_bheads_len, 1), __func__);
+		for (bhead = blo_firstbhead(fd), i = 0; bhead; bhead = mmap_nextbhead(fd, bhead), i++) {
+			fd->mmap_bheads[i] = bhead;
+		}
+	}
+
+	/* blocks are sorted by their address in the mapping */
+	low = 0;
+	high = fd->mmap_bheads_len - 1;
+	while (low <= high) {
+		const int mid = (low + high) / 2;
+		if (fd->mmap_bheads[mid] < thisblock) {
+			low = mid + 1;
+		}
+		else if (fd->mmap_bheads[mid] > thisblock) {
+			high = mid - 1;
+		}
+		else {
+			return (mid > 0) ? fd->mmap_bheads[mid - 1] : NULL;
+		}
+	}
+
+	BLI_assert(!"block not in the file");
+	return NULL;
+}
+
+/** \} */
+
 BHead *blo_firstbhead(FileData *fd)
 {
 	BHeadN *new_bhead;
 	BHead *bhead = NULL;
 
+	if (fd->flags & FD_FLAGS_MMAP_BHEADS) {
+		return mmap_bhead_at(fd, SIZEOFBLENDERHEADER);
+	}
+
 	/* Rewind the file
 	 * Read in a new block if necessary
 	 */
@@ -857,10 +1069,17 @@ BHead *blo_firstbhead(FileData *fd)
 	return(bhead);
 }
 
-BHead *blo_prevbhead(FileData *UNUSED(fd), BHead *thisblock)
+BHead *blo_prevbhead(FileData *fd, BHead *thisblock)
 {
-	BHeadN *bheadn = (BHeadN *)POINTER_OFFSET(thisblock, -offsetof(BHeadN, bhead));
-	BHeadN *prev = bheadn->prev;
+	BHeadN *bheadn;
+	BHeadN *prev;
+
+	if (fd->flags & FD_FLAGS_MMAP_BHEADS) {
+		return mmap_prevbhead(fd, thisblock);
+	}
+
+	bheadn = (BHeadN *)POINTER_OFFSET(thisblock, -offsetof(BHeadN, bhead));
+	prev = bheadn->prev;
 
 	return (prev) ? &prev->bhead : NULL;
 }
@@ -870,6 +1089,10 @@ BHead *blo_nextbhead(FileData *fd, BHead *thisblock)
 	BHeadN *new_bhead = NULL;
 	BHead *bhead = NULL;
 
+	if (fd->flags & FD_FLAGS_MMAP_BHEADS) {
+		return (thisblock) ? mmap_nextbhead(fd, thisblock) : NULL;
+	}
+
 	if (thisblock) {
 		/* bhead is actually a sub part of BHeadN
 		 * We calculate the BHeadN pointer from the BHead pointer below */
@@ -937,6 +1160,13 @@ static void decode_blender_header(FileData *fd)
 		memcpy(num, header + 9, 3);
 		num[3] = 0;
 		fd->fileversion = atoi(num);
+
+#ifdef USE_MMAP_BHEADS
+		/* native blocks can be used from the mapping as they are */
+		if (fd->mmap_buffer && !(fd->flags & (FD_FLAGS_SWITCH_ENDIAN | FD_FLAGS_POINTSIZE_DIFFERS))) {
+			fd->flags |= FD_FLAGS_MMAP_BHEADS;
+		}
+#endif
 	}
 }
 
@@ -1052,6 +1282,17 @@ static int fd_read_from_memory(FileData *filedata, void *buffer, unsigned int si
 	return (readsize);
 }
 
+static int fd_read_from_mmap(FileData *filedata, void *buffer, unsigned int size)
+{
+	/* don't read more bytes then there are available in the mapping */
+	const size_t readsize = MIN2((size_t)size, filedata->mmap_size - filedata->mmap_seek);
+
+	memcpy(buffer, filedata->mmap_buffer + filedata->mmap_seek, readsize);
+	filedata->mmap_seek += readsize;
+
+	return (int)readsize;
+}
+
 static int fd_read_from_memfile(FileData *filedata, void *buffer, unsigned int size)
 {
 	static unsigned int seek = (1<<30);	/* the current position */
@@ -1150,86 +1391,714 @@ static FileData *blo_decode_and_check(FileData *fd, ReportList *reports)
 	return fd;
 }
 
-/* cannot be called with relative paths anymore! */
-/* on each new library added, it now checks for the current FileData and expands relativeness */
-FileData *blo_openblenderfile(const char *filepath, ReportList *reports)
+#ifdef USE_MMAP_FILE
+/**
+ * Map uncompressed files into memory, NULL for compressed files or when mapping fails,
+ * these are read through zlib.
+ */
+static FileData *blo_openblenderfile_mmap(const char *filepath)
 {
-	gzFile gzfile;
-	errno = 0;
-	gzfile = BLI_gzopen(filepath, "rb");
+	FileData *fd;
+	struct stat st;
+	void *buffer;
+	int file;
 
-	if (gzfile == (gzFile)Z_NULL) {
-		BKE_reportf(reports, RPT_WARNING, "Unable to open '%s': %s",
-		            filepath, errno ? strerror(errno) : TIP_("unknown error reading file"));
+	file = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
+	if (file == -1) {
 		return NULL;
 	}
-	else {
-		FileData *fd = filedata_new();
-		fd->gzfiledes = gzfile;
-		fd->read = fd_read_gzip_from_file;
 
-		/* needed for library_append and read_libraries */
-		BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
+	if (fstat(file, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size < SIZEOFBLENDERHEADER) {
+		close(file);
+		return NULL;
+	}
 
-		return blo_decode_and_check(fd, reports);
+	/* Private mapping, since some blocks are patched in place while reading,
+	 * these pages are copied on write without changing the file. */
+	buffer = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+	close(file);
+
+	if (buffer == MAP_FAILED) {
+		return NULL;
 	}
+
+	if (!STREQLEN(buffer, "BLENDER", 7)) {
+		munmap(buffer, (size_t)st.st_size);
+		return NULL;
+	}
+
+	fd = filedata_new();
+	fd->mmap_buffer = buffer;
+	fd->mmap_size = (size_t)st.st_size;
+	fd->read = fd_read_from_mmap;
+
+	return fd;
 }
+#endif
 
-/**
- * Same as blo_openblenderfile(), but does not reads DNA data, only header. Use it for light access
- * (e.g. thumbnail reading).
- */
-static FileData *blo_openblenderfile_minimal(const char *filepath)
+/* -------------------------------------------------------------------- */
+/** \name Block Framed Files
+ *
+ * Frames are decompressed in parallel into one buffer,
+ * which is then read like a memory mapped file.
+ * With a single thread they are streamed one at a time instead.
+ *
+ * Partial reads (thumbnails, previews and linking) stream the frames too,
+ * but use the index to seek over the data of blocks, which is only read when used.
+ * So frames which only hold data that isn't used are never decompressed.
+ * \{ */
+
+void blo_frame_header_switch_endian(BlendFrameHeader *header)
 {
-	gzFile gzfile;
-	errno = 0;
-	gzfile = BLI_gzopen(filepath, "rb");
+	BLI_endian_switch_uint32(&header->compressed_len);
+	BLI_endian_switch_uint32(&header->uncompressed_len);
+	BLI_endian_switch_uint32(&header->codec);
+}
 
-	if (gzfile != (gzFile)Z_NULL) {
-		FileData *fd = filedata_new();
-		fd->gzfiledes = gzfile;
-		fd->read = fd_read_gzip_from_file;
+void blo_frame_index_switch_endian(BlendFrameIndex *index)
+{
+	BLI_endian_switch_uint64(&index->offset);
+	BLI_endian_switch_uint64(&index->uncompressed_offset);
+}
 
-		decode_blender_header(fd);
+void blo_frames_footer_switch_endian(BlendFramesFooter *footer)
+{
+	BLI_endian_switch_uint64(&footer->index_offset);
+	BLI_endian_switch_uint32(&footer->frames_num);
+}
 
-		if (fd->flags & FD_FLAGS_FILE_OK) {
-			return fd;
+static bool blo_frame_decompress(const BlendFrameHeader *header, const void *in, void *out)
+{
+	switch (header->codec) {
+		case BLEND_FRAME_CODEC_NONE:
+		{
+			if (header->compressed_len != header->uncompressed_len) {
+				return false;
+			}
+			memcpy(out, in, header->uncompressed_len);
+			return true;
 		}
-
-		blo_freefiledata(fd);
+		case BLEND_FRAME_CODEC_ZLIB:
+		{
+			uLongf out_len = header->uncompressed_len;
+			return (uncompress(out, &out_len, in, header->compressed_len) == Z_OK &&
+			        out_len == header->uncompressed_len);
+		}
+#ifdef WITH_LZO
+		case BLEND_FRAME_CODEC_LZO:
+		{
+			lzo_uint out_len = header->uncompressed_len;
+			return (lzo1x_decompress_safe(in, header->compressed_len, out, &out_len, NULL) == LZO_E_OK &&
+			        out_len == header->uncompressed_len);
+		}
+#endif
+		default:
+			return false;
 	}
-
-	return NULL;
 }
 
-static int fd_read_gzip_from_memory(FileData *filedata, void *buffer, unsigned int size)
+static bool blo_frames_file_check(const char *filepath)
 {
-	int err;
+	char magic[BLEND_FRAMES_MAGIC_LEN];
+	int file = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
+	bool is_frames = false;
 
-	filedata->strm.next_out = (Bytef *) buffer;
-	filedata->strm.avail_out = size;
+	if (file != -1) {
+		is_frames = (read(file, magic, sizeof(magic)) == sizeof(magic) &&
+		             STREQLEN(magic, BLEND_FRAMES_MAGIC, BLEND_FRAMES_MAGIC_LEN));
+		close(file);
+	}
 
-	// Inflate another chunk.
-	err = inflate (&filedata->strm, Z_SYNC_FLUSH);
+	return is_frames;
+}
 
-	if (err == Z_STREAM_END) {
-		return 0;
-	}
-	else if (err != Z_OK) {
-		printf("fd_read_gzip_from_memory: zlib error\n");
-		return 0;
-	}
+typedef struct FramesDecompressData {
+	const char *file_buffer;
+	const BlendFrameIndex *index;
+	char *buffer;
+	bool error;
+} FramesDecompressData;
 
-	filedata->seek += size;
+static void blo_frames_decompress_cb(
+        void *__restrict userdata,
+        const int i,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	FramesDecompressData *data = userdata;
+	const BlendFrameIndex *index = &data->index[i];
+	BlendFrameHeader header;
 
-	return (size);
+	memcpy(&header, data->file_buffer + index->offset, sizeof(header));
+	if (ENDIAN_ORDER == B_ENDIAN) {
+		blo_frame_header_switch_endian(&header);
+	}
+
+	if (!blo_frame_decompress(&header, data->file_buffer + index->offset + sizeof(header),
+	                          data->buffer + index->uncompressed_offset))
+	{
+		data->error = true;
+	}
 }
 
-static int fd_read_gzip_from_memory_init(FileData *fd)
+/**
+ * \return the uncompressed size of the file, 0 when the index is invalid.
+ */
+static size_t blo_frames_index_validate(
+        const char *file_buffer, const BlendFrameIndex *index, const BlendFramesFooter *footer)
 {
+	size_t uncompressed_size = 0;
+	uint i;
 
-	fd->strm.next_in = (Bytef *) fd->buffer;
-	fd->strm.avail_in = fd->buffersize;
+	for (i = 0; i < footer->frames_num; i++) {
+		BlendFrameHeader header;
+
+		if (index[i].offset < BLEND_FRAMES_MAGIC_LEN ||
+		    index[i].offset > footer->index_offset - sizeof(header) ||
+		    index[i].uncompressed_offset != uncompressed_size)
+		{
+			return 0;
+		}
+
+		memcpy(&header, file_buffer + index[i].offset, sizeof(header));
+		if (ENDIAN_ORDER == B_ENDIAN) {
+			blo_frame_header_switch_endian(&header);
+		}
+		/* frames which don't compress are stored */
+		if (header.compressed_len > footer->index_offset - index[i].offset - sizeof(header) ||
+		    header.compressed_len > header.uncompressed_len ||
+		    header.uncompressed_len > BLEND_FRAME_SIZE)
+		{
+			return 0;
+		}
+		uncompressed_size += header.uncompressed_len;
+	}
+
+	return uncompressed_size;
+}
+
+static FileData *blo_openblenderfile_frames(const char *filepath, ReportList *reports)
+{
+	FramesDecompressData data = {NULL};
+	BlendFramesFooter footer;
+	BlendFrameIndex *index = NULL;
+	FileData *fd;
+	char *file_buffer;
+	size_t file_size, size;
+
+	file_buffer = BLI_file_read_binary_as_mem(filepath, 0, &file_size);
+	if (file_buffer == NULL) {
+		BKE_reportf(reports, RPT_WARNING, "Unable to open '%s': %s",
+		            filepath, errno ? strerror(errno) : TIP_("unknown error reading file"));
+		return NULL;
+	}
+
+	if (file_size < BLEND_FRAMES_MAGIC_LEN + sizeof(footer)) {
+		goto error;
+	}
+
+	memcpy(&footer, file_buffer + file_size - sizeof(footer), sizeof(footer));
+	if (ENDIAN_ORDER == B_ENDIAN) {
+		blo_frames_footer_switch_endian(&footer);
+	}
+
+	if (!STREQLEN(footer.magic, BLEND_FRAMES_MAGIC, BLEND_FRAMES_MAGIC_LEN) ||
+	    footer.index_offset < BLEND_FRAMES_MAGIC_LEN + sizeof(BlendFrameHeader) ||
+	    footer.index_offset > file_size - sizeof(footer) ||
+	    file_size - sizeof(footer) - footer.index_offset != sizeof(BlendFrameIndex) * (size_t)footer.frames_num)
+	{
+		goto error;
+	}
+
+	/* the index is only 4 byte aligned in the file */
+	index = MEM_malloc_arrayN(max_ii((int)footer.frames_num, 1), sizeof(*index), __func__);
+	memcpy(index, file_buffer + footer.index_offset, sizeof(*index) * footer.frames_num);
+	if (ENDIAN_ORDER == B_ENDIAN) {
+		uint i;
+		for (i = 0; i < footer.frames_num; i++) {
+			blo_frame_index_switch_endian(&index[i]);
+		}
+	}
+
+	size = blo_frames_index_validate(file_buffer, index, &footer);
+	if (size < SIZEOFBLENDERHEADER) {
+		goto error;
+	}
+
+	data.file_buffer = file_buffer;
+	data.index = index;
+	data.buffer = MEM_mallocN(size, __func__);
+
+	{
+		ParallelRangeSettings settings;
+		BLI_parallel_range_settings_defaults(&settings);
+		settings.use_threading = (footer.frames_num > 1);
+		BLI_task_parallel_range(0, (int)footer.frames_num, &data, blo_frames_decompress_cb, &settings);
+	}
+
+	MEM_freeN(file_buffer);
+	MEM_freeN(index);
+
+	if (data.error) {
+		MEM_freeN(data.buffer);
+		BKE_reportf(reports, RPT_ERROR,
+		            "Failed to read blend file '%s': compressed data is corrupt or uses a codec not in this build",
+		            filepath);
+		return NULL;
+	}
+
+	fd = filedata_new();
+	fd->mmap_buffer = data.buffer;
+	fd->mmap_size = size;
+	fd->read = fd_read_from_mmap;
+	fd->flags |= FD_FLAGS_MMAP_ALLOCATED;
+
+	return fd;
+
+error:
+	MEM_freeN(file_buffer);
+	MEM_SAFE_FREE(index);
+	BKE_reportf(reports, RPT_ERROR, "Failed to read blend file '%s', compressed frames are invalid", filepath);
+	return NULL;
+}
+
+/**
+ * Read the header of the next frame.
+ * \return false at the end marker, or when the header is corrupt or doesn't match the index.
+ */
+static bool fd_read_frame_header(FileData *fd, BlendFrameHeader *header)
+{
+	bool ok = (read(fd->filedes, header, sizeof(*header)) == sizeof(*header));
+
+	if (ok && ENDIAN_ORDER == B_ENDIAN) {
+		blo_frame_header_switch_endian(header);
+	}
+	/* end marker, or a corrupt header (frames which don't compress are stored) */
+	ok = ok && (header->uncompressed_len != 0 && header->uncompressed_len <= BLEND_FRAME_SIZE &&
+	            header->compressed_len <= header->uncompressed_len);
+
+	if (ok && fd->frame_index) {
+		const BlendFrameIndex *index = fd->frame_index;
+		const uint i = fd->frame_next;
+
+		if (i < fd->frame_index_len) {
+			const uint64_t end = (i + 1 < fd->frame_index_len) ? index[i + 1].uncompressed_offset : fd->frames_size;
+			ok = (end - index[i].uncompressed_offset == header->uncompressed_len);
+		}
+		else {
+			ok = false;
+		}
+	}
+
+	if (!ok) {
+		/* the file isn't at the start of a frame anymore, seeking has to move it */
+		fd->frame_next = UINT_MAX;
+	}
+
+	return ok;
+}
+
+/**
+ * Decompress the frame of \a header into \a out, which is #FileData.frame_buffer or large enough for the frame.
+ */
+static bool fd_read_frame_data(FileData *fd, const BlendFrameHeader *header, char *out)
+{
+	void *in = MEM_mallocN(header->compressed_len, __func__);
+	bool ok;
+
+	ok = (read(fd->filedes, in, header->compressed_len) == (int)header->compressed_len);
+	ok = ok && blo_frame_decompress(header, in, out);
+	MEM_freeN(in);
+
+	if (!ok) {
+		fd->frame_next = UINT_MAX;
+		fd->frame_buffered = -1;
+		return false;
+	}
+
+	if (out == fd->frame_buffer) {
+		fd->frame_buffered = (int)fd->frame_next;
+		fd->frame_len = header->uncompressed_len;
+		fd->frame_seek = 0;
+	}
+	fd->frame_next++;
+
+	return true;
+}
+
+/**
+ * Read frames one after the other, only decompressing the ones needed for what is read.
+ */
+static int fd_read_from_frames(FileData *filedata, void *buffer, unsigned int size)
+{
+	unsigned int totread = 0;
+
+	while (totread < size) {
+		unsigned int readsize;
+
+		if (filedata->frame_seek == filedata->frame_len) {
+			BlendFrameHeader header;
+
+			if (!fd_read_frame_header(filedata, &header)) {
+				break;
+			}
+
+			/* decompress frames which are read whole directly into the buffer */
+			if (size - totread >= header.uncompressed_len) {
+				if (!fd_read_frame_data(filedata, &header, (char *)buffer + totread)) {
+					break;
+				}
+				totread += header.uncompressed_len;
+				continue;
+			}
+
+			if (filedata->frame_buffer == NULL) {
+				filedata->frame_buffer = MEM_mallocN(BLEND_FRAME_SIZE, __func__);
+			}
+			if (!fd_read_frame_data(filedata, &header, filedata->frame_buffer)) {
+				break;
+			}
+		}
+
+		readsize = MIN2(size - totread, filedata->frame_len - filedata->frame_seek);
+		memcpy((char *)buffer + totread, filedata->frame_buffer + filedata->frame_seek, readsize);
+		filedata->frame_seek += readsize;
+		totread += readsize;
+	}
+
+	filedata->seek += totread;
+	filedata->frames_seek += totread;
+
+	return (int)totread;
+}
+
+/**
+ * Seek to \a offset in the uncompressed file using the frame index,
+ * only the frame holding \a offset is decompressed (unless it's still in #FileData.frame_buffer).
+ */
+static bool fd_seek_frames(FileData *fd, const uint64_t offset)
+{
+	const BlendFrameIndex *index = fd->frame_index;
+	uint first = 0, last = fd->frame_index_len - 1;
+
+	BLI_assert(index != NULL);
+
+	if (offset >= fd->frames_size) {
+		if (offset != fd->frames_size ||
+		    lseek(fd->filedes, (off_t)fd->frames_end_offset, SEEK_SET) == -1)
+		{
+			return false;
+		}
+		/* the next read finds the end marker */
+		fd->frame_next = fd->frame_index_len;
+		fd->frame_len = fd->frame_seek = 0;
+		fd->frames_seek = offset;
+		return true;
+	}
+
+	/* last frame starting at or before the offset */
+	while (first < last) {
+		const uint mid = (first + last + 1) / 2;
+		if (index[mid].uncompressed_offset <= offset) {
+			first = mid;
+		}
+		else {
+			last = mid - 1;
+		}
+	}
+
+	if (fd->frame_buffered == (int)first) {
+		/* continue reading after the buffered frame */
+		if (fd->frame_next != first + 1) {
+			const uint64_t next_offset = (first + 1 < fd->frame_index_len) ?
+			                             index[first + 1].offset : fd->frames_end_offset;
+			if (lseek(fd->filedes, (off_t)next_offset, SEEK_SET) == -1) {
+				return false;
+			}
+			fd->frame_next = first + 1;
+		}
+		fd->frame_len = (uint)(((first + 1 < fd->frame_index_len) ?
+		                        index[first + 1].uncompressed_offset : fd->frames_size) -
+		                       index[first].uncompressed_offset);
+	}
+	else {
+		BlendFrameHeader header;
+
+		if (fd->frame_buffer == NULL) {
+			fd->frame_buffer = MEM_mallocN(BLEND_FRAME_SIZE, __func__);
+		}
+		fd->frame_next = first;
+		if (lseek(fd->filedes, (off_t)index[first].offset, SEEK_SET) == -1 ||
+		    !fd_read_frame_header(fd, &header) ||
+		    !fd_read_frame_data(fd, &header, fd->frame_buffer))
+		{
+			fd->frame_len = fd->frame_seek = 0;
+			return false;
+		}
+	}
+
+	fd->frame_seek = (uint)(offset - index[first].uncompressed_offset);
+	fd->frames_seek = offset;
+
+	return true;
+}
+
+/**
+ * Read the index of a streamed file, which is only needed to seek over blocks read on demand.
+ *
+ * \return false when the index is missing or invalid, the frames can still be read from the start.
+ */
+static bool blo_frames_stream_index_read(FileData *fd)
+{
+	BlendFramesFooter footer;
+	BlendFrameHeader header;
+	BlendFrameIndex *index;
+	size_t index_size;
+	off_t file_size;
+	uint i;
+
+	file_size = lseek(fd->filedes, 0, SEEK_END);
+	if (file_size < (off_t)(BLEND_FRAMES_MAGIC_LEN + 2 * sizeof(header) + sizeof(footer)) ||
+	    lseek(fd->filedes, file_size - (off_t)sizeof(footer), SEEK_SET) == -1 ||
+	    read(fd->filedes, &footer, sizeof(footer)) != sizeof(footer))
+	{
+		return false;
+	}
+	if (ENDIAN_ORDER == B_ENDIAN) {
+		blo_frames_footer_switch_endian(&footer);
+	}
+
+	index_size = sizeof(*index) * (size_t)footer.frames_num;
+	if (!STREQLEN(footer.magic, BLEND_FRAMES_MAGIC, BLEND_FRAMES_MAGIC_LEN) ||
+	    footer.frames_num == 0 ||
+	    footer.index_offset < BLEND_FRAMES_MAGIC_LEN + 2 * sizeof(header) ||
+	    footer.index_offset > (uint64_t)file_size - sizeof(footer) ||
+	    (uint64_t)file_size - sizeof(footer) - footer.index_offset != index_size)
+	{
+		return false;
+	}
+
+	index = MEM_mallocN(index_size, __func__);
+	if (lseek(fd->filedes, (off_t)footer.index_offset, SEEK_SET) == -1 ||
+	    read(fd->filedes, index, index_size) != (int)index_size)
+	{
+		goto error;
+	}
+	if (ENDIAN_ORDER == B_ENDIAN) {
+		for (i = 0; i < footer.frames_num; i++) {
+			blo_frame_index_switch_endian(&index[i]);
+		}
+	}
+
+	/* Frames are in order, the lengths in their headers are checked against the index when they are read. */
+	for (i = 0; i < footer.frames_num; i++) {
+		const uint64_t offset_min = i ? index[i - 1].offset + sizeof(header) : BLEND_FRAMES_MAGIC_LEN;
+		if (index[i].offset < offset_min ||
+		    index[i].offset > footer.index_offset - 2 * sizeof(header) ||
+		    (i == 0 && index[i].uncompressed_offset != 0) ||
+		    (i != 0 && (index[i].uncompressed_offset <= index[i - 1].uncompressed_offset ||
+		                index[i].uncompressed_offset - index[i - 1].uncompressed_offset > BLEND_FRAME_SIZE)))
+		{
+			goto error;
+		}
+	}
+
+	/* the size of the uncompressed file, from the header of the last frame */
+	if (lseek(fd->filedes, (off_t)index[footer.frames_num - 1].offset, SEEK_SET) == -1 ||
+	    read(fd->filedes, &header, sizeof(header)) != sizeof(header))
+	{
+		goto error;
+	}
+	if (ENDIAN_ORDER == B_ENDIAN) {
+		blo_frame_header_switch_endian(&header);
+	}
+	if (header.uncompressed_len == 0 || header.uncompressed_len > BLEND_FRAME_SIZE) {
+		goto error;
+	}
+
+	fd->frame_index = index;
+	fd->frame_index_len = footer.frames_num;
+	fd->frames_size = index[footer.frames_num - 1].uncompressed_offset + header.uncompressed_len;
+	fd->frames_end_offset = footer.index_offset - sizeof(header);
+
+	return true;
+
+error:
+	MEM_freeN(index);
+	return false;
+}
+
+/**
+ * \param use_index: Read the frame index, so blocks which aren't used can be seeked over
+ * (see #FD_FLAGS_BHEAD_READ_ON_DEMAND).
+ */
+static FileData *blo_openblenderfile_frames_stream(const char *filepath, const bool use_index)
+{
+	FileData *fd;
+	int file;
+
+	errno = 0;
+	file = BLI_open(filepath, O_BINARY | O_RDONLY, 0);
+	if (file == -1) {
+		return NULL;
+	}
+
+	fd = filedata_new();
+	fd->filedes = file;
+	fd->read = fd_read_from_frames;
+	fd->frame_buffered = -1;
+
+	if (use_index && blo_frames_stream_index_read(fd)) {
+		fd->flags |= FD_FLAGS_BHEAD_READ_ON_DEMAND;
+	}
+
+	if (lseek(file, BLEND_FRAMES_MAGIC_LEN, SEEK_SET) != BLEND_FRAMES_MAGIC_LEN) {
+		blo_freefiledata(fd);
+		return NULL;
+	}
+
+	return fd;
+}
+
+/** \} */
+
+/* cannot be called with relative paths anymore! */
+/* on each new library added, it now checks for the current FileData and expands relativeness */
+/**
+ * \param is_partial: Only some data-blocks are read (linking, previews),
+ * so block framed files only decompress the frames holding the blocks which are used.
+ */
+FileData *blo_openblenderfile(const char *filepath, ReportList *reports, const bool is_partial)
+{
+	gzFile gzfile;
+
+#ifdef USE_MMAP_FILE
+	{
+		FileData *fd = blo_openblenderfile_mmap(filepath);
+		if (fd) {
+			/* needed for library_append and read_libraries */
+			BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
+
+			return blo_decode_and_check(fd, reports);
+		}
+	}
+#endif
+
+	if (blo_frames_file_check(filepath)) {
+		FileData *fd;
+
+		/* Without threads to decompress on, stream the frames like gzip files
+		 * instead of decompressing the whole file up front.
+		 * Partial reads seek over the blocks they don't use instead. */
+		if (BLI_system_thread_count() > 1 && !is_partial) {
+			fd = blo_openblenderfile_frames(filepath, reports);
+		}
+		else {
+			fd = blo_openblenderfile_frames_stream(filepath, is_partial);
+			if (fd == NULL) {
+				BKE_reportf(reports, RPT_WARNING, "Unable to open '%s': %s",
+				            filepath, errno ? strerror(errno) : TIP_("unknown error reading file"));
+			}
+		}
+
+		if (fd) {
+			BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
+
+			return blo_decode_and_check(fd, reports);
+		}
+		return NULL;
+	}
+
+	errno = 0;
+	gzfile = BLI_gzopen(filepath, "rb");
+
+	if (gzfile == (gzFile)Z_NULL) {
+		BKE_reportf(reports, RPT_WARNING, "Unable to open '%s': %s",
+		            filepath, errno ? strerror(errno) : TIP_("unknown error reading file"));
+		return NULL;
+	}
+	else {
+		FileData *fd = filedata_new();
+		fd->gzfiledes = gzfile;
+		fd->read = fd_read_gzip_from_file;
+
+		/* needed for library_append and read_libraries */
+		BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
+
+		return blo_decode_and_check(fd, reports);
+	}
+}
+
+/**
+ * Same as blo_openblenderfile(), but does not reads DNA data, only header. Use it for light access
+ * (e.g. thumbnail reading).
+ */
+static FileData *blo_openblenderfile_minimal(const char *filepath)
+{
+	gzFile gzfile;
+
+	if (blo_frames_file_check(filepath)) {
+		FileData *fd = blo_openblenderfile_frames_stream(filepath, true);
+
+		if (fd) {
+			decode_blender_header(fd);
+
+			if (fd->flags & FD_FLAGS_FILE_OK) {
+				return fd;
+			}
+
+			blo_freefiledata(fd);
+		}
+		return NULL;
+	}
+
+	errno = 0;
+	gzfile = BLI_gzopen(filepath, "rb");
+
+	if (gzfile != (gzFile)Z_NULL) {
+		FileData *fd = filedata_new();
+		fd->gzfiledes = gzfile;
+		fd->read = fd_read_gzip_from_file;
+
+		decode_blender_header(fd);
+
+		if (fd->flags & FD_FLAGS_FILE_OK) {
+			return fd;
+		}
+
+		blo_freefiledata(fd);
+	}
+
+	return NULL;
+}
+
+static int fd_read_gzip_from_memory(FileData *filedata, void *buffer, unsigned int size)
+{
+	int err;
+
+	filedata->strm.next_out = (Bytef *) buffer;
+	filedata->strm.avail_out = size;
+
+	// Inflate another chunk.
+	err = inflate (&filedata->strm, Z_SYNC_FLUSH);
+
+	if (err == Z_STREAM_END) {
+		return 0;
+	}
+	else if (err != Z_OK) {
+		printf("fd_read_gzip_from_memory: zlib error\n");
+		return 0;
+	}
+
+	filedata->seek += size;
+
+	return (size);
+}
+
+static int fd_read_gzip_from_memory_init(FileData *fd)
+{
+
+	fd->strm.next_in = (Bytef *) fd->buffer;
+	fd->strm.avail_in = fd->buffersize;
 	fd->strm.total_out = 0;
 	fd->strm.zalloc = Z_NULL;
 	fd->strm.zfree = Z_NULL;
@@ -1314,6 +2183,20 @@ void blo_freefiledata(FileData *fd)
 		// Free all BHeadN data blocks
 		BLI_freelistN(&fd->listbase);
 
+		if (fd->mmap_buffer) {
+			if (fd->flags & FD_FLAGS_MMAP_ALLOCATED) {
+				MEM_freeN((void *)fd->mmap_buffer);
+			}
+#ifdef USE_MMAP_FILE
+			else {
+				munmap((void *)fd->mmap_buffer, fd->mmap_size);
+			}
+#endif
+		}
+		MEM_SAFE_FREE(fd->mmap_bheads);
+		MEM_SAFE_FREE(fd->frame_buffer);
+		MEM_SAFE_FREE(fd->frame_index);
+
 		if (fd->filesdna)
 			DNA_sdna_free(fd->filesdna);
 		if (fd->compflags)
@@ -1472,31 +2355,6 @@ static void *newdataadr(FileData *fd, const void *adr)		/* only direct databocks
 	return oldnewmap_lookup_and_inc(fd->datamap, adr, true);
 }
 
-/* This is a special version of newdataadr() which allows us to keep lasthit of
- * map unchanged. In certain cases this makes file loading time significantly
- * faster.
- *
- * Use this function in cases like restoring pointer from one list element to
- * another list element, but keep lasthit value so we can continue restoring
- * pointers efficiently.
- *
- * Example of this could be found in direct_link_fcurves() which restores the
- * fcurve group pointer and keeps lasthit optimal for linking all further
- * fcurves.
- */
-static void *newdataadr_ex(FileData *fd, const void *adr, bool increase_lasthit)		/* only direct databocks */
-{
-	if (increase_lasthit) {
-		return newdataadr(fd, adr);
-	}
-	else {
-		int lasthit = fd->datamap->lasthit;
-		void *newadr = newdataadr(fd, adr);
-		fd->datamap->lasthit = lasthit;
-		return newadr;
-	}
-}
-
 static void *newdataadr_no_us(FileData *fd, const void *adr)		/* only direct databocks */
 {
 	return oldnewmap_lookup_and_inc(fd->datamap, adr, false);
@@ -1574,9 +2432,6 @@ static void change_idid_adr_fd(FileData *fd, const void *old, void *new)
 {
 	int i;
 
-	/* use a binary search if we have a sorted libmap, for now it's not needed. */
-	BLI_assert(fd->libmap->sorted == false);
-
 	for (i = 0; i < fd->libmap->nentries; i++) {
 		OldNew *entry = &fd->libmap->entries[i];
 
@@ -1907,10 +2762,50 @@ static void switch_endian_structs(const struct SDNA *filesdna, BHead *bhead)
 	}
 }
 
+/**
+ * Read the data of a block which get_bhead() seeked over (see #FD_FLAGS_BHEAD_READ_ON_DEMAND).
+ *
+ * \return A copy of the block with its data, freed with #MEM_freeN, NULL on failure.
+ */
+static BHead *blo_bhead_read_full(FileData *fd, BHead *thisblock)
+{
+	const BHeadN *bheadn = BHEADN_FROM_BHEAD(thisblock);
+	const uint64_t frames_seek = fd->frames_seek;
+	BHeadN *new_bhead;
+	bool ok;
+
+	new_bhead = MEM_mallocN(sizeof(BHeadN) + thisblock->len, __func__);
+	new_bhead->next = new_bhead->prev = NULL;
+	new_bhead->data_offset = bheadn->data_offset;
+	new_bhead->has_data = true;
+	new_bhead->bhead = *thisblock;
+
+	ok = (fd_seek_frames(fd, bheadn->data_offset) &&
+	      fd->read(fd, new_bhead + 1, thisblock->len) == thisblock->len);
+	/* continue reading blocks where get_bhead() stopped */
+	ok = fd_seek_frames(fd, frames_seek) && ok;
+
+	if (!ok) {
+		MEM_freeN(new_bhead);
+		return NULL;
+	}
+
+	return &new_bhead->bhead;
+}
+
 static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
 {
+	BHead *bh_orig = bh;
 	void *temp = NULL;
 
+	if ((fd->flags & FD_FLAGS_BHEAD_READ_ON_DEMAND) && bh->len && !BHEADN_FROM_BHEAD(bh)->has_data) {
+		bh = blo_bhead_read_full(fd, bh);
+		if (bh == NULL) {
+			blo_reportf_wrap(fd->reports, RPT_ERROR, TIP_("Failed to read '%s' from '%s'"), blockname, fd->relabase);
+			return NULL;
+		}
+	}
+
 	if (bh->len) {
 		/* switch is based on file dna */
 		if (bh->SDNAnr && (fd->flags & FD_FLAGS_SWITCH_ENDIAN))
@@ -1921,13 +2816,17 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
 				temp = DNA_struct_reconstruct(fd->memsdna, fd->filesdna, fd->compflags, bh->SDNAnr, bh->nr, (bh+1));
 			}
 			else {
-				/* SDNA_CMP_EQUAL */
+				/* SDNA_CMP_EQUAL, for memory mapped files this is the only copy of the data. */
 				temp = MEM_mallocN(bh->len, blockname);
 				memcpy(temp, (bh+1), bh->len);
 			}
 		}
 	}
 
+	if (bh != bh_orig) {
+		MEM_freeN(BHEADN_FROM_BHEAD(bh));
+	}
+
 	return temp;
 }
 
@@ -2538,7 +3437,7 @@ static void direct_link_fcurves(FileData *fd, ListBase *list)
 		fcu->rna_path = newdataadr(fd, fcu->rna_path);
 
 		/* group */
-		fcu->grp = newdataadr_ex(fd, fcu->grp, false);
+		fcu->grp = newdataadr(fd, fcu->grp);
 
 		/* clear disabled flag - allows disabled drivers to be tried again ([#32155]),
 		 * but also means that another method for "reviving disabled F-Curves" exists
@@ -3596,9 +4495,26 @@ static void direct_link_key(FileData *fd, Key *key)
 
 	for (kb = key->block.first; kb; kb = kb->next) {
 		kb->data = newdataadr(fd, kb->data);
+		kb->sparse = NULL;
+
+		if (fd->flags & FD_FLAGS_SWITCH_ENDIAN) {
+			if (kb->flag & KEYBLOCK_SPARSE) {
+				if (kb->data) {
+					BLI_endian_switch_int32_array(
+					        kb->data, kb->totsparse * (int)(sizeof(KeyBlockSparseElem) / sizeof(int)));
+				}
+			}
+			else {
+				switch_endian_keyblock(key, kb);
+			}
+		}
+	}
 
-		if (fd->flags & FD_FLAGS_SWITCH_ENDIAN)
-			switch_endian_keyblock(key, kb);
+	/* expand sparse key blocks once the reference key is read */
+	for (kb = key->block.first; kb; kb = kb->next) {
+		if (kb->flag & KEYBLOCK_SPARSE) {
+			BKE_keyblock_sparse_unpack(key, kb);
+		}
 	}
 }
 
@@ -5144,6 +6060,7 @@ static void direct_link_modifiers(FileData *fd, ListBase *lb)
 			ArmatureModifierData *amd = (ArmatureModifierData *)md;
 
 			amd->prevCos = NULL;
+			amd->deform_cache = NULL;
 		}
 		else if (md->type == eModifierType_Cloth) {
 			ClothModifierData *clmd = (ClothModifierData *)md;
@@ -5673,6 +6590,7 @@ static void direct_link_object(FileData *fd, Object *ob)
 	ob->bb = NULL;
 	ob->derivedDeform = NULL;
 	ob->derivedFinal = NULL;
+	ob->modifier_stack_cache = NULL;
 	BLI_listbase_clear(&ob->gpulamp);
 	link_list(fd, &ob->pc_ids);
 
@@ -8067,111 +8985,357 @@ static void direct_link_linestyle_thickness_modifier(FileData *fd, LineStyleModi
 	}
 }
 
-static void direct_link_linestyle_geometry_modifier(FileData *UNUSED(fd), LineStyleModifier *UNUSED(modifier))
+static void direct_link_linestyle_geometry_modifier(FileData *UNUSED(fd), LineStyleModifier *UNUSED(modifier))
+{
+}
+
+static void direct_link_linestyle(FileData *fd, FreestyleLineStyle *linestyle)
+{
+	int a;
+	LineStyleModifier *modifier;
+
+	linestyle->adt= newdataadr(fd, linestyle->adt);
+	direct_link_animdata(fd, linestyle->adt);
+	link_list(fd, &linestyle->color_modifiers);
+	for (modifier = linestyle->color_modifiers.first; modifier; modifier = modifier->next)
+		direct_link_linestyle_color_modifier(fd, modifier);
+	link_list(fd, &linestyle->alpha_modifiers);
+	for (modifier = linestyle->alpha_modifiers.first; modifier; modifier = modifier->next)
+		direct_link_linestyle_alpha_modifier(fd, modifier);
+	link_list(fd, &linestyle->thickness_modifiers);
+	for (modifier = linestyle->thickness_modifiers.first; modifier; modifier = modifier->next)
+		direct_link_linestyle_thickness_modifier(fd, modifier);
+	link_list(fd, &linestyle->geometry_modifiers);
+	for (modifier = linestyle->geometry_modifiers.first; modifier; modifier = modifier->next)
+		direct_link_linestyle_geometry_modifier(fd, modifier);
+	for (a = 0; a < MAX_MTEX; a++) {
+		linestyle->mtex[a] = newdataadr(fd, linestyle->mtex[a]);
+	}
+	linestyle->nodetree = newdataadr(fd, linestyle->nodetree);
+	if (linestyle->nodetree) {
+		direct_link_id(fd, &linestyle->nodetree->id);
+		direct_link_nodetree(fd, linestyle->nodetree);
+	}
+}
+
+/* ************** GENERAL & MAIN ******************** */
+
+
+static const char *dataname(short id_code)
+{
+	switch (id_code) {
+		case ID_OB: return "Data from OB";
+		case ID_ME: return "Data from ME";
+		case ID_IP: return "Data from IP";
+		case ID_SCE: return "Data from SCE";
+		case ID_MA: return "Data from MA";
+		case ID_TE: return "Data from TE";
+		case ID_CU: return "Data from CU";
+		case ID_GR: return "Data from GR";
+		case ID_AR: return "Data from AR";
+		case ID_AC: return "Data from AC";
+		case ID_LI: return "Data from LI";
+		case ID_MB: return "Data from MB";
+		case ID_IM: return "Data from IM";
+		case ID_LT: return "Data from LT";
+		case ID_LA: return "Data from LA";
+		case ID_CA: return "Data from CA";
+		case ID_KE: return "Data from KE";
+		case ID_WO: return "Data from WO";
+		case ID_SCR: return "Data from SCR";
+		case ID_VF: return "Data from VF";
+		case ID_TXT: return "Data from TXT";
+		case ID_SPK: return "Data from SPK";
+		case ID_SO: return "Data from SO";
+		case ID_NT: return "Data from NT";
+		case ID_BR: return "Data from BR";
+		case ID_PA: return "Data from PA";
+		case ID_PAL: return "Data from PAL";
+		case ID_PC: return "Data from PCRV";
+		case ID_GD: return "Data from GD";
+		case ID_WM: return "Data from WM";
+		case ID_MC: return "Data from MC";
+		case ID_MSK: return "Data from MSK";
+		case ID_LS: return "Data from LS";
+		case ID_CF: return "Data from CF";
+	}
+	return "Data from Lib Block";
+
+}
+
+static BHead *read_data_into_oldnewmap(FileData *fd, BHead *bhead, const char *allocname)
+{
+	bhead = blo_nextbhead(fd, bhead);
+
+	while (bhead && bhead->code==DATA) {
+		void *data;
+#if 0
+		/* XXX DUMB DEBUGGING OPTION TO GIVE NAMES for guarded malloc errors */
+		short *sp = fd->filesdna->structs[bhead->SDNAnr];
+		char *tmp = malloc(100);
+		allocname = fd->filesdna->types[ sp[0] ];
+		strcpy(tmp, allocname);
+		data = read_struct(fd, bhead, tmp);
+#else
+		data = read_struct(fd, bhead, allocname);
+#endif
+
+		if (data) {
+			oldnewmap_insert(fd->datamap, bhead->old, data, 0);
+		}
+
+		bhead = blo_nextbhead(fd, bhead);
+	}
+
+	return bhead;
+}
+
+/**
+ * Link the direct data of \a id, read into fd->datamap.
+ *
+ * \return false when the ID is invalid and has to be freed.
+ */
+static bool direct_link_libblock(FileData *fd, Main *main, ID *id, const short tag)
+{
+	bool wrong_id = false;
+
+	/* init pointers direct data */
+	direct_link_id(fd, id);
+
+	/* That way, we know which datablock needs do_versions (required currently for linking). */
+	/* Note: doing this after driect_link_id(), which resets that field. */
+	id->tag = tag | LIB_TAG_NEED_LINK | LIB_TAG_NEW;
+
+	switch (GS(id->name)) {
+		case ID_WM:
+			direct_link_windowmanager(fd, (wmWindowManager *)id);
+			break;
+		case ID_SCR:
+			wrong_id = direct_link_screen(fd, (bScreen *)id);
+			break;
+		case ID_SCE:
+			direct_link_scene(fd, (Scene *)id);
+			break;
+		case ID_OB:
+			direct_link_object(fd, (Object *)id);
+			break;
+		case ID_ME:
+			direct_link_mesh(fd, (Mesh *)id);
+			break;
+		case ID_CU:
+			direct_link_curve(fd, (Curve *)id);
+			break;
+		case ID_MB:
+			direct_link_mball(fd, (MetaBall *)id);
+			break;
+		case ID_MA:
+			direct_link_material(fd, (Material *)id);
+			break;
+		case ID_TE:
+			direct_link_texture(fd, (Tex *)id);
+			break;
+		case ID_IM:
+			direct_link_image(fd, (Image *)id);
+			break;
+		case ID_LA:
+			direct_link_lamp(fd, (Lamp *)id);
+			break;
+		case ID_VF:
+			direct_link_vfont(fd, (VFont *)id);
+			break;
+		case ID_TXT:
+			direct_link_text(fd, (Text *)id);
+			break;
+		case ID_IP:
+			direct_link_ipo(fd, (Ipo *)id);
+			break;
+		case ID_KE:
+			direct_link_key(fd, (Key *)id);
+			break;
+		case ID_LT:
+			direct_link_latt(fd, (Lattice *)id);
+			break;
+		case ID_WO:
+			direct_link_world(fd, (World *)id);
+			break;
+		case ID_LI:
+			direct_link_library(fd, (Library *)id, main);
+			break;
+		case ID_CA:
+			direct_link_camera(fd, (Camera *)id);
+			break;
+		case ID_SPK:
+			direct_link_speaker(fd, (Speaker *)id);
+			break;
+		case ID_SO:
+			direct_link_sound(fd, (bSound *)id);
+			break;
+		case ID_GR:
+			direct_link_group(fd, (Group *)id);
+			break;
+		case ID_AR:
+			direct_link_armature(fd, (bArmature*)id);
+			break;
+		case ID_AC:
+			direct_link_action(fd, (bAction*)id);
+			break;
+		case ID_NT:
+			direct_link_nodetree(fd, (bNodeTree*)id);
+			break;
+		case ID_BR:
+			direct_link_brush(fd, (Brush*)id);
+			break;
+		case ID_PA:
+			direct_link_particlesettings(fd, (ParticleSettings*)id);
+			break;
+		case ID_GD:
+			direct_link_gpencil(fd, (bGPdata *)id);
+			break;
+		case ID_MC:
+			direct_link_movieclip(fd, (MovieClip *)id);
+			break;
+		case ID_MSK:
+			direct_link_mask(fd, (Mask *)id);
+			break;
+		case ID_LS:
+			direct_link_linestyle(fd, (FreestyleLineStyle *)id);
+			break;
+		case ID_PAL:
+			direct_link_palette(fd, (Palette *)id);
+			break;
+		case ID_PC:
+			direct_link_paint_curve(fd, (PaintCurve *)id);
+			break;
+		case ID_CF:
+			direct_link_cachefile(fd, (CacheFile *)id);
+			break;
+	}
+
+	oldnewmap_free_unused(fd->datamap);
+
+	return !wrong_id;
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Parallel Direct Linking
+ *
+ * Once its blocks are read, direct linking of most ID types only touches the data of the
+ * ID itself and the maps of the file, so these can be linked in parallel to each other.
+ * Each queued ID keeps its own copy of the data map, and adds to its own global map
+ * (for logic bricks), merged into the global map of the file afterwards in file order.
+ * Lib-linking and versioning run afterwards, as before.
+ * \{ */
+
+typedef struct DirectLinkTask {
+	Main *main;
+	ID *id;
+	OldNewMap *datamap;
+	/* Entries added to the global map while linking, NULL when not linked yet. */
+	OldNewMap *globmap;
+	short tag;
+} DirectLinkTask;
+
+/**
+ * ID types which direct linking doesn't depend on other ID's nor on global state.
+ * Window-managers, screens, scenes and libraries change the main database or the
+ * interface while linking, and stay in file order.
+ */
+static bool direct_link_is_independent(const short idcode)
 {
+	switch (idcode) {
+		case ID_OB:
+		case ID_ME:
+		case ID_CU:
+		case ID_MB:
+		case ID_MA:
+		case ID_TE:
+		case ID_IM:
+		case ID_LA:
+		case ID_KE:
+		case ID_LT:
+		case ID_WO:
+		case ID_CA:
+		case ID_SPK:
+		case ID_AR:
+		case ID_AC:
+		case ID_NT:
+			return true;
+		default:
+			return false;
+	}
 }
 
-static void direct_link_linestyle(FileData *fd, FreestyleLineStyle *linestyle)
+static void direct_link_task_add(FileData *fd, Main *main, ID *id, const short tag)
 {
-	int a;
-	LineStyleModifier *modifier;
+	DirectLinkTask *task;
 
-	linestyle->adt= newdataadr(fd, linestyle->adt);
-	direct_link_animdata(fd, linestyle->adt);
-	link_list(fd, &linestyle->color_modifiers);
-	for (modifier = linestyle->color_modifiers.first; modifier; modifier = modifier->next)
-		direct_link_linestyle_color_modifier(fd, modifier);
-	link_list(fd, &linestyle->alpha_modifiers);
-	for (modifier = linestyle->alpha_modifiers.first; modifier; modifier = modifier->next)
-		direct_link_linestyle_alpha_modifier(fd, modifier);
-	link_list(fd, &linestyle->thickness_modifiers);
-	for (modifier = linestyle->thickness_modifiers.first; modifier; modifier = modifier->next)
-		direct_link_linestyle_thickness_modifier(fd, modifier);
-	link_list(fd, &linestyle->geometry_modifiers);
-	for (modifier = linestyle->geometry_modifiers.first; modifier; modifier = modifier->next)
-		direct_link_linestyle_geometry_modifier(fd, modifier);
-	for (a = 0; a < MAX_MTEX; a++) {
-		linestyle->mtex[a] = newdataadr(fd, linestyle->mtex[a]);
-	}
-	linestyle->nodetree = newdataadr(fd, linestyle->nodetree);
-	if (linestyle->nodetree) {
-		direct_link_id(fd, &linestyle->nodetree->id);
-		direct_link_nodetree(fd, linestyle->nodetree);
+	if (fd->direct_link_tasks_len == fd->direct_link_tasks_size) {
+		fd->direct_link_tasks_size = max_ii(fd->direct_link_tasks_size * 2, 1024);
+		fd->direct_link_tasks = MEM_reallocN_id(
+		        fd->direct_link_tasks, sizeof(*fd->direct_link_tasks) * fd->direct_link_tasks_size, __func__);
 	}
-}
-
-/* ************** GENERAL & MAIN ******************** */
 
+	task = &fd->direct_link_tasks[fd->direct_link_tasks_len++];
+	task->main = main;
+	task->id = id;
+	task->datamap = oldnewmap_copy(fd->datamap);
+	task->globmap = NULL;
+	task->tag = tag;
+}
 
-static const char *dataname(short id_code)
+static void direct_link_task_run(
+        void *__restrict userdata,
+        const int index,
+        const ParallelRangeTLS *__restrict UNUSED(tls))
 {
-	switch (id_code) {
-		case ID_OB: return "Data from OB";
-		case ID_ME: return "Data from ME";
-		case ID_IP: return "Data from IP";
-		case ID_SCE: return "Data from SCE";
-		case ID_MA: return "Data from MA";
-		case ID_TE: return "Data from TE";
-		case ID_CU: return "Data from CU";
-		case ID_GR: return "Data from GR";
-		case ID_AR: return "Data from AR";
-		case ID_AC: return "Data from AC";
-		case ID_LI: return "Data from LI";
-		case ID_MB: return "Data from MB";
-		case ID_IM: return "Data from IM";
-		case ID_LT: return "Data from LT";
-		case ID_LA: return "Data from LA";
-		case ID_CA: return "Data from CA";
-		case ID_KE: return "Data from KE";
-		case ID_WO: return "Data from WO";
-		case ID_SCR: return "Data from SCR";
-		case ID_VF: return "Data from VF";
-		case ID_TXT: return "Data from TXT";
-		case ID_SPK: return "Data from SPK";
-		case ID_SO: return "Data from SO";
-		case ID_NT: return "Data from NT";
-		case ID_BR: return "Data from BR";
-		case ID_PA: return "Data from PA";
-		case ID_PAL: return "Data from PAL";
-		case ID_PC: return "Data from PCRV";
-		case ID_GD: return "Data from GD";
-		case ID_WM: return "Data from WM";
-		case ID_MC: return "Data from MC";
-		case ID_MSK: return "Data from MSK";
-		case ID_LS: return "Data from LS";
-		case ID_CF: return "Data from CF";
-	}
-	return "Data from Lib Block";
+	FileData *fd = userdata;
+	DirectLinkTask *task = &fd->direct_link_tasks[index];
+	FileData fd_task = *fd;
+	bool ok;
+
+	/* Most ID's don't add to the global map, start small. */
+	task->globmap = oldnewmap_new_ex(0);
 
+	fd_task.datamap = task->datamap;
+	fd_task.globmap = task->globmap;
+	ok = direct_link_libblock(&fd_task, task->main, task->id, task->tag);
+	BLI_assert(ok);
+	UNUSED_VARS_NDEBUG(ok);
 }
 
-static BHead *read_data_into_oldnewmap(FileData *fd, BHead *bhead, const char *allocname)
+/**
+ * Link the direct data of all queued ID's.
+ */
+static void direct_link_tasks_run(FileData *fd)
 {
-	bhead = blo_nextbhead(fd, bhead);
+	ParallelRangeSettings settings;
+	int i;
 
-	while (bhead && bhead->code==DATA) {
-		void *data;
-#if 0
-		/* XXX DUMB DEBUGGING OPTION TO GIVE NAMES for guarded malloc errors */
-		short *sp = fd->filesdna->structs[bhead->SDNAnr];
-		char *tmp = malloc(100);
-		allocname = fd->filesdna->types[ sp[0] ];
-		strcpy(tmp, allocname);
-		data = read_struct(fd, bhead, tmp);
-#else
-		data = read_struct(fd, bhead, allocname);
-#endif
+	if (fd->direct_link_tasks_len == 0) {
+		return;
+	}
 
-		if (data) {
-			oldnewmap_insert(fd->datamap, bhead->old, data, 0);
-		}
+	BLI_parallel_range_settings_defaults(&settings);
+	/* cost varies a lot between ID's, from a material to a big mesh */
+	settings.scheduling_mode = TASK_SCHEDULING_DYNAMIC;
+	settings.use_threading = (fd->direct_link_tasks_len > 1);
+	BLI_task_parallel_range(0, fd->direct_link_tasks_len, fd, direct_link_task_run, &settings);
 
-		bhead = blo_nextbhead(fd, bhead);
+	for (i = 0; i < fd->direct_link_tasks_len; i++) {
+		DirectLinkTask *task = &fd->direct_link_tasks[i];
+		oldnewmap_stats_add(fd->datamap, task->datamap);
+		oldnewmap_merge(fd->globmap, task->globmap);
+		oldnewmap_free(task->datamap);
+		oldnewmap_free(task->globmap);
 	}
 
-	return bhead;
+	MEM_freeN(fd->direct_link_tasks);
+	fd->direct_link_tasks = NULL;
+	fd->direct_link_tasks_len = fd->direct_link_tasks_size = 0;
 }
 
+/** \} */
+
 static BHead *read_libblock(FileData *fd, Main *main, BHead *bhead, const short tag, ID **r_id)
 {
 	/* this routine reads a libblock and its direct data. Use link functions to connect it all
@@ -8179,7 +9343,6 @@ static BHead *read_libblock(FileData *fd, Main *main, BHead *bhead, const short
 	ID *id;
 	ListBase *lb;
 	const char *allocname;
-	bool wrong_id = false;
 
 	/* In undo case, most libs and linked data should be kept as is from previous state (see BLO_read_from_memfile).
 	 * However, some needed by the snapshot being read may have been removed in previous one, and would go missing.
@@ -8278,125 +9441,15 @@ static BHead *read_libblock(FileData *fd, Main *main, BHead *bhead, const short
 	/* read all data into fd->datamap */
 	bhead = read_data_into_oldnewmap(fd, bhead, allocname);
 
-	/* init pointers direct data */
-	direct_link_id(fd, id);
-
-	/* That way, we know which datablock needs do_versions (required currently for linking). */
-	/* Note: doing this after driect_link_id(), which resets that field. */
-	id->tag = tag | LIB_TAG_NEED_LINK | LIB_TAG_NEW;
-
-	switch (GS(id->name)) {
-		case ID_WM:
-			direct_link_windowmanager(fd, (wmWindowManager *)id);
-			break;
-		case ID_SCR:
-			wrong_id = direct_link_screen(fd, (bScreen *)id);
-			break;
-		case ID_SCE:
-			direct_link_scene(fd, (Scene *)id);
-			break;
-		case ID_OB:
-			direct_link_object(fd, (Object *)id);
-			break;
-		case ID_ME:
-			direct_link_mesh(fd, (Mesh *)id);
-			break;
-		case ID_CU:
-			direct_link_curve(fd, (Curve *)id);
-			break;
-		case ID_MB:
-			direct_link_mball(fd, (MetaBall *)id);
-			break;
-		case ID_MA:
-			direct_link_material(fd, (Material *)id);
-			break;
-		case ID_TE:
-			direct_link_texture(fd, (Tex *)id);
-			break;
-		case ID_IM:
-			direct_link_image(fd, (Image *)id);
-			break;
-		case ID_LA:
-			direct_link_lamp(fd, (Lamp *)id);
-			break;
-		case ID_VF:
-			direct_link_vfont(fd, (VFont *)id);
-			break;
-		case ID_TXT:
-			direct_link_text(fd, (Text *)id);
-			break;
-		case ID_IP:
-			direct_link_ipo(fd, (Ipo *)id);
-			break;
-		case ID_KE:
-			direct_link_key(fd, (Key *)id);
-			break;
-		case ID_LT:
-			direct_link_latt(fd, (Lattice *)id);
-			break;
-		case ID_WO:
-			direct_link_world(fd, (World *)id);
-			break;
-		case ID_LI:
-			direct_link_library(fd, (Library *)id, main);
-			break;
-		case ID_CA:
-			direct_link_camera(fd, (Camera *)id);
-			break;
-		case ID_SPK:
-			direct_link_speaker(fd, (Speaker *)id);
-			break;
-		case ID_SO:
-			direct_link_sound(fd, (bSound *)id);
-			break;
-		case ID_GR:
-			direct_link_group(fd, (Group *)id);
-			break;
-		case ID_AR:
-			direct_link_armature(fd, (bArmature*)id);
-			break;
-		case ID_AC:
-			direct_link_action(fd, (bAction*)id);
-			break;
-		case ID_NT:
-			direct_link_nodetree(fd, (bNodeTree*)id);
-			break;
-		case ID_BR:
-			direct_link_brush(fd, (Brush*)id);
-			break;
-		case ID_PA:
-			direct_link_particlesettings(fd, (ParticleSettings*)id);
-			break;
-		case ID_GD:
-			direct_link_gpencil(fd, (bGPdata *)id);
-			break;
-		case ID_MC:
-			direct_link_movieclip(fd, (MovieClip *)id);
-			break;
-		case ID_MSK:
-			direct_link_mask(fd, (Mask *)id);
-			break;
-		case ID_LS:
-			direct_link_linestyle(fd, (FreestyleLineStyle *)id);
-			break;
-		case ID_PAL:
-			direct_link_palette(fd, (Palette *)id);
-			break;
-		case ID_PC:
-			direct_link_paint_curve(fd, (PaintCurve *)id);
-			break;
-		case ID_CF:
-			direct_link_cachefile(fd, (CacheFile *)id);
-			break;
+	if ((fd->flags & FD_FLAGS_DEFER_DIRECT_LINK) && direct_link_is_independent(GS(id->name))) {
+		direct_link_task_add(fd, main, id, tag);
 	}
-
-	oldnewmap_free_unused(fd->datamap);
-	oldnewmap_clear(fd->datamap);
-
-	if (wrong_id) {
+	else if (!direct_link_libblock(fd, main, id, tag)) {
 		BKE_libblock_free(main, id);
 	}
 
+	oldnewmap_clear(fd->datamap);
+
 	return (bhead);
 }
 
@@ -8544,8 +9597,6 @@ static void do_versions_after_linking(Main *main)
 
 static void lib_link_all(FileData *fd, Main *main)
 {
-	oldnewmap_sort(fd);
-
 	/* No load UI for undo memfiles */
 	if (fd->memfile == NULL) {
 		lib_link_windowmanager(fd, main);
@@ -8702,6 +9753,12 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
 		}
 	}
 
+	/* Undo keeps using the image, movie clip, sound and packed file pointer maps while linking.
+	 * Without threads, deferring only adds the copies of the data maps. */
+	if (fd->memfile == NULL && BLI_system_thread_count() > 1) {
+		fd->flags |= FD_FLAGS_DEFER_DIRECT_LINK;
+	}
+
 	while (bhead) {
 		switch (bhead->code) {
 		case DATA:
@@ -8750,6 +9807,9 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
 		}
 	}
 
+	direct_link_tasks_run(fd);
+	fd->flags &= ~FD_FLAGS_DEFER_DIRECT_LINK;
+
 	/* do before read_libraries, but skip undo case */
 	if (fd->memfile == NULL) {
 		do_versions(fd, NULL, bfd->main);
@@ -8780,6 +9840,13 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
 
 	link_global(fd, bfd);	/* as last */
 
+	if (G.debug & G_DEBUG_IO) {
+		printf("read file %s\n  pointer lookups:\n", fd->relabase);
+		oldnewmap_print_stats(fd->datamap, "data");
+		oldnewmap_print_stats(fd->globmap, "global");
+		oldnewmap_print_stats(fd->libmap, "library");
+	}
+
 	fd->mainlist = NULL;  /* Safety, this is local variable, shall not be used afterward. */
 
 	return bfd;
@@ -10541,7 +11608,7 @@ static void read_libraries(FileData *basefd, ListBase *mainlist)
 						        mainptr->curlib->filepath,
 						        mainptr->curlib->name,
 						        library_parent_filepath(mainptr->curlib));
-						fd = blo_openblenderfile(mainptr->curlib->filepath, basefd->reports);
+						fd = blo_openblenderfile(mainptr->curlib->filepath, basefd->reports, true);
 					}
 					/* allow typing in a new lib path */
 					if (G.debug_value == -666) {
@@ -10558,7 +11625,7 @@ static void read_libraries(FileData *basefd, ListBase *mainlist)
 								BLI_strncpy(mainptr->curlib->filepath, newlib_path, sizeof(mainptr->curlib->filepath));
 								BLI_cleanup_path(BKE_main_blendfile_path_from_global(), mainptr->curlib->filepath);
 
-								fd = blo_openblenderfile(mainptr->curlib->filepath, basefd->reports);
+								fd = blo_openblenderfile(mainptr->curlib->filepath, basefd->reports, true);
 
 								if (fd) {
 									fd->mainlist = mainlist;
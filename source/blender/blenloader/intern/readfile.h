@@ -34,6 +34,7 @@
 #define __READFILE_H__
 
 #include "zlib.h"
+#include "BLI_sys_types.h"
 #include "DNA_windowmanager_types.h"  /* for ReportType */
 
 struct OldNewMap;
@@ -62,6 +63,26 @@ typedef struct FileData {
 	int filedes;
 	gzFile gzfiledes;
 
+	// variables needed for reading from a memory mapped file
+	const char *mmap_buffer;
+	size_t mmap_size;
+	size_t mmap_seek;
+	// blocks are used in place from the mapping, see FD_FLAGS_MMAP_BHEADS
+	struct BHead **mmap_bheads;
+	int mmap_bheads_len;
+
+	// variables needed for streaming block framed files (uses filedes)
+	char *frame_buffer;
+	unsigned int frame_len, frame_seek;
+	unsigned int frame_next;  /* frame read next from filedes */
+	int frame_buffered;       /* frame in frame_buffer, -1 for none */
+	uint64_t frames_seek;     /* offset in the uncompressed file */
+	// index of the frames, to seek over blocks which are read on demand (see FD_FLAGS_BHEAD_READ_ON_DEMAND)
+	struct BlendFrameIndex *frame_index;
+	unsigned int frame_index_len;
+	uint64_t frames_size;        /* size of the uncompressed file */
+	uint64_t frames_end_offset;  /* offset of the end marker in the file */
+
 	// now only in use for library appending
 	char relabase[FILE_MAX];
 
@@ -94,6 +115,10 @@ typedef struct FileData {
 	struct BHeadSort *bheadmap;
 	int tot_bheadmap;
 
+	/* ID's which direct data is linked in parallel once all blocks are read */
+	struct DirectLinkTask *direct_link_tasks;
+	int direct_link_tasks_len, direct_link_tasks_size;
+
 	/* see: USE_GHASH_BHEAD */
 	struct GHash *bhead_idname_hash;
 
@@ -109,9 +134,14 @@ typedef struct FileData {
 
 typedef struct BHeadN {
 	struct BHeadN *next, *prev;
+	/* offset of the data in the uncompressed file, for blocks read on demand */
+	uint64_t data_offset;
+	bool has_data;
 	struct BHead bhead;
 } BHeadN;
 
+#define BHEADN_FROM_BHEAD(bh) ((BHeadN *)POINTER_OFFSET(bh, -offsetof(BHeadN, bhead)))
+
 /* FileData->flags */
 enum {
 	FD_FLAGS_SWITCH_ENDIAN         = 1 << 0,
@@ -120,10 +150,59 @@ enum {
 	FD_FLAGS_FILE_OK               = 1 << 3,
 	FD_FLAGS_NOT_MY_BUFFER         = 1 << 4,
 	FD_FLAGS_NOT_MY_LIBMAP         = 1 << 5,  /* XXX Unused in practice (checked once but never set). */
+	FD_FLAGS_MMAP_BHEADS           = 1 << 6,  /* BHeads point into mmap_buffer instead of the BHeadN list. */
+	FD_FLAGS_DEFER_DIRECT_LINK     = 1 << 7,  /* Queue independent ID's in direct_link_tasks, see read_libblock. */
+	FD_FLAGS_MMAP_ALLOCATED        = 1 << 8,  /* mmap_buffer holds decompressed frames, freed with MEM_freeN. */
+	FD_FLAGS_BHEAD_READ_ON_DEMAND  = 1 << 9,  /* DATA blocks are skipped by get_bhead and read by read_struct. */
 };
 
 #define SIZEOFBLENDERHEADER 12
 
+/* -------------------------------------------------------------------- */
+/* Block Framed Files (G_FILE_COMPRESS_FRAMES)
+ *
+ * The contents of a regular file are split in frames which are compressed independently,
+ * so they can be compressed and decompressed in parallel, and any frame can be read
+ * without the ones before it.
+ *
+ * - #BLEND_FRAMES_MAGIC (see BLO_blend_defs.h)
+ * - Frames: #BlendFrameHeader followed by its compressed data.
+ * - End marker: #BlendFrameHeader with all members zero.
+ * - Index: #BlendFrameIndex of each frame.
+ * - #BlendFramesFooter
+ *
+ * Values are stored little endian.
+ */
+
+/* uncompressed size of all frames but the last */
+#define BLEND_FRAME_SIZE (1 << 20)
+
+enum {
+	BLEND_FRAME_CODEC_NONE = 0,  /* stored, for data which doesn't compress */
+	BLEND_FRAME_CODEC_ZLIB = 1,
+	BLEND_FRAME_CODEC_LZO  = 2,
+};
+
+typedef struct BlendFrameHeader {
+	uint32_t compressed_len;
+	uint32_t uncompressed_len;
+	uint32_t codec;
+} BlendFrameHeader;
+
+typedef struct BlendFrameIndex {
+	/* offset of the frame header in the file */
+	uint64_t offset;
+	/* offset of the frame contents in the uncompressed file */
+	uint64_t uncompressed_offset;
+} BlendFrameIndex;
+
+typedef struct BlendFramesFooter {
+	uint64_t index_offset;
+	uint32_t frames_num;
+	uint32_t _pad;
+	char magic[8];  /* #BLEND_FRAMES_MAGIC */
+} BlendFramesFooter;
+
 /***/
 struct Main;
 void blo_join_main(ListBase *mainlist);
@@ -131,7 +210,7 @@ void blo_split_main(ListBase *mainlist, struct Main *main);
 
 BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath);
 
-FileData *blo_openblenderfile(const char *filepath, struct ReportList *reports);
+FileData *blo_openblenderfile(const char *filepath, struct ReportList *reports, const bool is_partial);
 FileData *blo_openblendermemory(const void *buffer, int buffersize, struct ReportList *reports);
 FileData *blo_openblendermemfile(struct MemFile *memfile, struct ReportList *reports);
 
@@ -154,6 +233,11 @@ BHead *blo_prevbhead(FileData *fd, BHead *thisblock);
 
 const char *bhead_id_name(const FileData *fd, const BHead *bhead);
 
+/* block framed files, only needed on big endian systems */
+void blo_frame_header_switch_endian(BlendFrameHeader *header);
+void blo_frame_index_switch_endian(BlendFrameIndex *index);
+void blo_frames_footer_switch_endian(BlendFramesFooter *footer);
+
 /* do versions stuff */
 
 void blo_reportf_wrap(struct ReportList *reports, ReportType type, const char *format, ...) ATTR_PRINTF_FORMAT(3, 4);
@@ -100,6 +100,7 @@ void memfile_chunk_add(
         MemFile *memfile, const char *buf, unsigned int size,
         MemFileChunk **compchunk_step)
 {
+	const int domain_prev = MEM_domain_thread_set(MEM_DOMAIN_UNDO);
 	MemFileChunk *curchunk = MEM_mallocN(sizeof(MemFileChunk), "MemFileChunk");
 	curchunk->size = size;
 	curchunk->buf = NULL;
@@ -125,6 +126,8 @@ void memfile_chunk_add(
 		curchunk->buf = buf_new;
 		memfile->size += size;
 	}
+
+	MEM_domain_thread_set(domain_prev);
 }
 
 struct Main *BLO_memfile_main_get(struct MemFile *memfile, struct Main *oldmain, struct Scene **r_scene)
@@ -146,14 +149,17 @@ struct Main *BLO_memfile_main_get(struct MemFile *memfile, struct Main *oldmain,
 
 
 /**
- * Saves .blend using undo buffer.
- *
- * \return success.
+ * \param use_sync: Flush the file to disk before returning,
+ * for files which replace another one once they're written.
  */
-bool BLO_memfile_write_file(struct MemFile *memfile, const char *filename)
+static bool memfile_write_file_ex(
+        struct MemFile *memfile, const char *filename,
+        const short *stop, float *progress, const bool use_sync)
 {
 	MemFileChunk *chunk;
+	size_t size_written = 0, size_total = 0;
 	int file, oflags;
+	bool ok;
 
 	/* note: This is currently used for autosave and 'quit.blend', where _not_ following symlinks is OK,
 	 * however if this is ever executed explicitly by the user, we may want to allow writing to symlinks.
@@ -177,18 +183,92 @@ bool BLO_memfile_write_file(struct MemFile *memfile, const char *filename)
 		return false;
 	}
 
+	if (progress) {
+		for (chunk = memfile->chunks.first; chunk; chunk = chunk->next) {
+			size_total += chunk->size;
+		}
+	}
+
 	for (chunk = memfile->chunks.first; chunk; chunk = chunk->next) {
+		if (stop && *stop) {
+			break;
+		}
 		if ((size_t)write(file, chunk->buf, chunk->size) != chunk->size) {
 			break;
 		}
+		if (progress) {
+			size_written += chunk->size;
+			*progress = (float)((double)size_written / (double)size_total);
+		}
+	}
+
+	ok = (chunk == NULL);
+
+	if (ok && use_sync) {
+		/* the data has to be on disk before the rename,
+		 * otherwise a crash can leave an empty file in place of the previous one */
+#ifdef _WIN32
+		ok = (_commit(file) == 0);
+#else
+		ok = (fsync(file) == 0);
+#endif
+	}
+
+	/* write errors can be deferred until the file is closed (network file systems, quotas) */
+	if (close(file) == -1) {
+		ok = false;
+	}
+
+	if (!ok) {
+		if (!(stop && *stop)) {
+			fprintf(stderr, "Unable to save '%s': %s\n",
+			        filename, errno ? strerror(errno) : "Unknown error writing file");
+		}
+		return false;
 	}
+	return true;
+}
+
+/**
+ * Saves .blend using undo buffer.
+ *
+ * \return success.
+ */
+bool BLO_memfile_write_file(struct MemFile *memfile, const char *filename)
+{
+	return memfile_write_file_ex(memfile, filename, NULL, NULL, false);
+}
 
-	close(file);
+/**
+ * Saves .blend using undo buffer, written to a temporary file first which replaces \a filename
+ * once it's complete, so an existing file is never left half written.
+ *
+ * Can run in a thread, as long as \a memfile is owned by the caller (not part of the undo stack).
+ *
+ * \param stop: Cancels writing when set, the temporary file is removed (may be NULL).
+ * \param progress: Fraction of \a memfile written (may be NULL).
+ * \return success.
+ */
+bool BLO_memfile_write_file_atomic(
+        struct MemFile *memfile, const char *filename,
+        const short *stop, float *progress)
+{
+	char tempname[FILE_MAX + 1];
 
-	if (chunk) {
+	BLI_snprintf(tempname, sizeof(tempname), "%s@", filename);
+
+	if (!memfile_write_file_ex(memfile, tempname, stop, progress, true)) {
+		BLI_delete(tempname, false, false);
+		return false;
+	}
+
+	/* readers see either the previous file or the new one, never a missing or partial file */
+	if (BLI_rename_overwrite(tempname, filename) != 0) {
 		fprintf(stderr, "Unable to save '%s': %s\n",
-		        filename, errno ? strerror(errno) : "Unknown error writing file");
+		        filename, errno ? strerror(errno) : "Unknown error renaming file");
+		BLI_delete(tempname, false, false);
 		return false;
 	}
+
 	return true;
 }
@@ -154,6 +154,7 @@
 #include "BLI_blenlib.h"
 #include "BLI_linklist.h"
 #include "BLI_mempool.h"
+#include "BLI_task.h"
 
 #include "BKE_action.h"
 #include "BKE_blender_version.h"
@@ -162,6 +163,7 @@
 #include "BKE_constraint.h"
 #include "BKE_global.h" // for G
 #include "BKE_idcode.h"
+#include "BKE_key.h"
 #include "BKE_library.h" // for  set_listbasepointers
 #include "BKE_main.h"
 #include "BKE_node.h"
@@ -186,6 +188,15 @@
 
 #include "readfile.h"
 
+#ifdef WITH_LZO
+#  ifdef WITH_SYSTEM_LZO
+#    include <lzo/lzo1x.h>
+#  else
+#    include "minilzo.h"
+#  endif
+#  define LZO_OUT_LEN(size)     ((size) + (size) / 16 + 64 + 3)
+#endif
+
 /* for SDNA_TYPE_FROM_STRUCT() macro */
 #include "dna_type_offsets.h"
 
@@ -207,6 +218,7 @@
 typedef enum {
 	WW_WRAP_NONE = 1,
 	WW_WRAP_ZLIB,
+	WW_WRAP_FRAMES,
 } eWriteWrapType;
 
 typedef struct WriteWrap WriteWrap;
@@ -220,6 +232,7 @@ struct WriteWrap {
 	union {
 		int file_handle;
 		gzFile gz_handle;
+		struct WriteFrames *frames;
 	} _user_data;
 };
 
@@ -279,6 +292,231 @@ static size_t ww_write_zlib(WriteWrap *ww, const char *buf, size_t buf_len)
 }
 #undef FILE_HANDLE
 
+/* block framed, see BLEND_FRAMES_MAGIC */
+#define FRAMES(ww) \
+	(ww)->_user_data.frames
+
+typedef struct WriteFrame {
+	uchar *data;
+	uint data_len;
+
+	/* result of compression */
+	uchar *compressed;
+	BlendFrameHeader header;
+} WriteFrame;
+
+typedef struct WriteFrames {
+	int file_handle;
+	bool error;
+
+	/* Full frames are compressed by the task pool while the next ones are filled,
+	 * the batch is written out in order once all of its frames are used. */
+	TaskPool *pool;
+	WriteFrame *batch;
+	int batch_len, batch_size;
+
+	uint64_t offset, uncompressed_offset;
+	BlendFrameIndex *index;
+	uint index_len, index_size;
+} WriteFrames;
+
+static void ww_frame_compress(TaskPool *__restrict UNUSED(pool), void *taskdata, int UNUSED(threadid))
+{
+	WriteFrame *frame = taskdata;
+	uint compressed_len;
+
+#ifdef WITH_LZO
+	{
+		void *wrkmem = MEM_mallocN(LZO1X_1_MEM_COMPRESS, __func__);
+		lzo_uint out_len = LZO_OUT_LEN(frame->data_len);
+
+		frame->compressed = MEM_mallocN(out_len, __func__);
+		if (lzo1x_1_compress(frame->data, frame->data_len, frame->compressed, &out_len, wrkmem) == LZO_E_OK) {
+			compressed_len = (uint)out_len;
+		}
+		else {
+			compressed_len = frame->data_len;
+		}
+		MEM_freeN(wrkmem);
+		frame->header.codec = BLEND_FRAME_CODEC_LZO;
+	}
+#else
+	{
+		uLongf out_len = compressBound(frame->data_len);
+
+		frame->compressed = MEM_mallocN(out_len, __func__);
+		if (compress2(frame->compressed, &out_len, frame->data, frame->data_len, 1) == Z_OK) {
+			compressed_len = (uint)out_len;
+		}
+		else {
+			compressed_len = frame->data_len;
+		}
+		frame->header.codec = BLEND_FRAME_CODEC_ZLIB;
+	}
+#endif
+
+	/* store data which doesn't compress (or failed to) as it is */
+	if (compressed_len >= frame->data_len) {
+		MEM_freeN(frame->compressed);
+		frame->compressed = NULL;
+		compressed_len = frame->data_len;
+		frame->header.codec = BLEND_FRAME_CODEC_NONE;
+	}
+
+	frame->header.compressed_len = compressed_len;
+	frame->header.uncompressed_len = frame->data_len;
+}
+
+static bool ww_frames_write_raw(WriteFrames *frames, const void *data, size_t data_len)
+{
+	if (!frames->error) {
+		if ((size_t)write(frames->file_handle, data, data_len) == data_len) {
+			frames->offset += data_len;
+		}
+		else {
+			frames->error = true;
+		}
+	}
+	return !frames->error;
+}
+
+/* Wait for the frames of the batch to be compressed and write them out. */
+static void ww_frames_flush(WriteFrames *frames)
+{
+	int i;
+
+	BLI_task_pool_work_and_wait(frames->pool);
+
+	for (i = 0; i < frames->batch_len; i++) {
+		WriteFrame *frame = &frames->batch[i];
+		BlendFrameHeader header = frame->header;
+		BlendFrameIndex *index;
+
+		if (frames->index_len == frames->index_size) {
+			frames->index_size *= 2;
+			frames->index = MEM_reallocN(frames->index, sizeof(*frames->index) * frames->index_size);
+		}
+		index = &frames->index[frames->index_len++];
+		index->offset = frames->offset;
+		index->uncompressed_offset = frames->uncompressed_offset;
+		frames->uncompressed_offset += frame->data_len;
+
+		if (ENDIAN_ORDER == B_ENDIAN) {
+			blo_frame_header_switch_endian(&header);
+		}
+		ww_frames_write_raw(frames, &header, sizeof(header));
+		ww_frames_write_raw(frames, frame->compressed ? frame->compressed : frame->data, frame->header.compressed_len);
+
+		MEM_SAFE_FREE(frame->compressed);
+		frame->data_len = 0;
+	}
+
+	frames->batch_len = 0;
+}
+
+static bool ww_open_frames(WriteWrap *ww, const char *filepath)
+{
+	WriteFrames *frames;
+	int file, i;
+
+	file = BLI_open(filepath, O_BINARY + O_WRONLY + O_CREAT + O_TRUNC, 0666);
+
+	if (file == -1) {
+		return false;
+	}
+
+	frames = MEM_callocN(sizeof(*frames), __func__);
+	frames->file_handle = file;
+
+	frames->pool = BLI_task_pool_create(BLI_task_scheduler_get(), NULL);
+	/* enough frames to keep all threads busy while the next ones are filled */
+	frames->batch_size = BLI_task_scheduler_num_threads(BLI_task_scheduler_get()) * 2 + 1;
+	frames->batch = MEM_callocN(sizeof(*frames->batch) * frames->batch_size, __func__);
+	for (i = 0; i < frames->batch_size; i++) {
+		frames->batch[i].data = MEM_mallocN(BLEND_FRAME_SIZE, __func__);
+	}
+	frames->batch_len = 1;
+
+	frames->index_size = 256;
+	frames->index = MEM_mallocN(sizeof(*frames->index) * frames->index_size, __func__);
+
+	FRAMES(ww) = frames;
+
+	ww_frames_write_raw(frames, BLEND_FRAMES_MAGIC, BLEND_FRAMES_MAGIC_LEN);
+
+	return true;
+}
+static bool ww_close_frames(WriteWrap *ww)
+{
+	WriteFrames *frames = FRAMES(ww);
+	const BlendFrameHeader end_marker = {0};
+	BlendFramesFooter footer = {0};
+	bool ok;
+	uint i;
+	int j;
+
+	/* last frame, if it's not empty */
+	if (frames->batch[frames->batch_len - 1].data_len != 0) {
+		BLI_task_pool_push(frames->pool, ww_frame_compress, &frames->batch[frames->batch_len - 1], false, TASK_PRIORITY_HIGH);
+	}
+	else {
+		frames->batch_len--;
+	}
+	ww_frames_flush(frames);
+
+	ww_frames_write_raw(frames, &end_marker, sizeof(end_marker));
+
+	footer.index_offset = frames->offset;
+	footer.frames_num = frames->index_len;
+	memcpy(footer.magic, BLEND_FRAMES_MAGIC, BLEND_FRAMES_MAGIC_LEN);
+
+	if (ENDIAN_ORDER == B_ENDIAN) {
+		for (i = 0; i < frames->index_len; i++) {
+			blo_frame_index_switch_endian(&frames->index[i]);
+		}
+		blo_frames_footer_switch_endian(&footer);
+	}
+	ww_frames_write_raw(frames, frames->index, sizeof(*frames->index) * frames->index_len);
+	ww_frames_write_raw(frames, &footer, sizeof(footer));
+
+	ok = (close(frames->file_handle) != -1) && !frames->error;
+
+	BLI_task_pool_free(frames->pool);
+	for (j = 0; j < frames->batch_size; j++) {
+		MEM_freeN(frames->batch[j].data);
+	}
+	MEM_freeN(frames->batch);
+	MEM_freeN(frames->index);
+	MEM_freeN(frames);
+
+	return ok;
+}
+static size_t ww_write_frames(WriteWrap *ww, const char *buf, size_t buf_len)
+{
+	WriteFrames *frames = FRAMES(ww);
+	size_t written = 0;
+
+	while (written < buf_len) {
+		WriteFrame *frame = &frames->batch[frames->batch_len - 1];
+		const uint len = (uint)MIN2(buf_len - written, (size_t)(BLEND_FRAME_SIZE - frame->data_len));
+
+		memcpy(frame->data + frame->data_len, buf + written, len);
+		frame->data_len += len;
+		written += len;
+
+		if (frame->data_len == BLEND_FRAME_SIZE) {
+			BLI_task_pool_push(frames->pool, ww_frame_compress, frame, false, TASK_PRIORITY_HIGH);
+			if (frames->batch_len == frames->batch_size) {
+				ww_frames_flush(frames);
+			}
+			frames->batch_len++;
+		}
+	}
+
+	return frames->error ? 0 : buf_len;
+}
+#undef FRAMES
+
 /* --- end compression types --- */
 
 static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
@@ -293,6 +531,13 @@ static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
 			r_ww->write = ww_write_zlib;
 			break;
 		}
+		case WW_WRAP_FRAMES:
+		{
+			r_ww->open  = ww_open_frames;
+			r_ww->close = ww_close_frames;
+			r_ww->write = ww_write_frames;
+			break;
+		}
 		default:
 		{
 			r_ww->open  = ww_open_none;
@@ -334,6 +579,8 @@ typedef struct {
 	} mem;
 	/** When true, write to #WriteData.current, could also call 'is_undo'. */
 	bool use_memfile;
+	/** Write key blocks sparse where possible, see #G_FILE_SPARSE_KEYS (never for undo). */
+	bool use_sparse_keys;
 
 	/**
 	 * Wrap writing, so we can use zlib or
@@ -558,7 +805,10 @@ static void writestruct_id(
 	writestruct_at_address_id(wd, filecode, structname, nr, adr, adr);
 }
 
-static void writedata(WriteData *wd, int filecode, int len, const void *adr)  /* do not use for structs */
+/* Write \a data in place of the data at \a adr, to store it in a different form. */
+static void writedata_at_address(
+        WriteData *wd, int filecode, int len,
+        const void *adr, const void *data)  /* do not use for structs */
 {
 	BHead bh;
 
@@ -577,7 +827,12 @@ static void writedata(WriteData *wd, int filecode, int len, const void *adr)  /*
 	bh.len    = len;
 
 	mywrite(wd, &bh, sizeof(BHead));
-	mywrite(wd, adr, len);
+	mywrite(wd, data, len);
+}
+
+static void writedata(WriteData *wd, int filecode, int len, const void *adr)  /* do not use for structs */
+{
+	writedata_at_address(wd, filecode, len, adr, adr);
 }
 
 /* use this to force writing of lists in same order as reading (using link_list) */
@@ -1993,9 +2248,25 @@ static void write_key(WriteData *wd, Key *key)
 
 		/* direct data */
 		for (KeyBlock *kb = key->block.first; kb; kb = kb->next) {
-			writestruct(wd, DATA, KeyBlock, 1, kb);
-			if (kb->data) {
-				writedata(wd, DATA, kb->totelem * key->elemsize, kb->data);
+			int totsparse = 0;
+			KeyBlockSparseElem *sparse = wd->use_sparse_keys ? BKE_keyblock_sparse_pack(key, kb, &totsparse) : NULL;
+
+			if (sparse) {
+				/* only the elements which differ from the reference key */
+				KeyBlock kb_sparse = *kb;
+				kb_sparse.flag |= KEYBLOCK_SPARSE;
+				kb_sparse.totsparse = totsparse;
+				kb_sparse.sparse = NULL;
+
+				writestruct_at_address(wd, DATA, KeyBlock, 1, kb, &kb_sparse);
+				writedata_at_address(wd, DATA, totsparse * sizeof(*sparse), kb->data, sparse);
+				MEM_freeN(sparse);
+			}
+			else {
+				writestruct(wd, DATA, KeyBlock, 1, kb);
+				if (kb->data) {
+					writedata(wd, DATA, kb->totelem * key->elemsize, kb->data);
+				}
 			}
 		}
 	}
@@ -3768,6 +4039,7 @@ static bool write_file_handle(
 	blo_split_main(&mainlist, mainvar);
 
 	wd = mywrite_begin(ww, compare, current);
+	wd->use_sparse_keys = (write_flags & G_FILE_SPARSE_KEYS) && !wd->use_memfile;
 
 #ifdef USE_NODE_COMPAT_CUSTOMNODES
 	/* don't write compatibility data on undo */
@@ -4028,7 +4300,7 @@ bool BLO_write_file(
 	BLI_snprintf(tempname, sizeof(tempname), "%s@", filepath);
 
 	if (write_flags & G_FILE_COMPRESS) {
-		ww_type = WW_WRAP_ZLIB;
+		ww_type = (write_flags & G_FILE_COMPRESS_FRAMES) ? WW_WRAP_FRAMES : WW_WRAP_ZLIB;
 	}
 	else {
 		ww_type = WW_WRAP_NONE;
@@ -4077,9 +4349,11 @@ bool BLO_write_file(
 	}
 
 	/* actual file writing */
-	const bool err = write_file_handle(mainvar, &ww, NULL, NULL, write_flags, thumb);
+	bool err = write_file_handle(mainvar, &ww, NULL, NULL, write_flags, thumb);
 
-	ww.close(&ww);
+	if (ww.close(&ww) == false) {
+		err = true;
+	}
 
 	if (UNLIKELY(path_list_backup)) {
 		BKE_bpath_list_restore(mainvar, path_list_flag, path_list_backup);
@@ -873,6 +873,9 @@ void BM_mesh_bm_to_me(
 		}
 
 
+		/* all key blocks are rewritten below */
+		BKE_key_sparse_free(me->key);
+
 		/* editing the base key should update others */
 		if ((me->key->type == KEY_RELATIVE) && /* only need offsets for relative shape keys */
 		    (actkey != NULL) &&                /* unlikely, but the active key may not be valid if the
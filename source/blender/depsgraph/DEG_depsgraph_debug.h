@@ -48,6 +48,44 @@ void DEG_stats_simple(const struct Depsgraph *graph,
                       size_t *r_operations,
                       size_t *r_relations);
 
+/* Time spent in each phase of the last build of the graph, in seconds. */
+typedef struct DepsgraphBuildStats {
+	double nodes_time;
+	double relations_time;
+	double cycles_time;
+	double transitive_reduction_time;
+	double finalize_time;
+	double total_time;
+	/* Number of threads relations were built with, 1 when not threaded. */
+	int relations_num_threads;
+	/* Number of IDs rebuilt by an incremental update, 0 for a full build. */
+	int num_rebuilt_ids;
+} DepsgraphBuildStats;
+
+void DEG_stats_build(const struct Depsgraph *graph,
+                     struct DepsgraphBuildStats *r_stats);
+
+/* Timing of the last evaluation of the graph, in seconds. Only gathered when
+ * evaluation timing is enabled (--debug-depsgraph-time).
+ */
+typedef struct DepsgraphEvalStats {
+	/* Wall clock time of the whole evaluation. */
+	double total_time;
+	/* Sum of the time spent in all evaluated operations. */
+	double operations_time;
+	/* Time of the longest chain of dependent operations, the evaluation can
+	 * not be faster than this no matter the number of threads.
+	 */
+	double critical_path_time;
+	/* Fraction of the evaluation time the threads spent in operations. */
+	float utilization;
+	int num_threads;
+	int num_operations;
+} DepsgraphEvalStats;
+
+void DEG_stats_eval(const struct Depsgraph *graph,
+                    struct DepsgraphEvalStats *r_stats);
+
 /* ************************************************ */
 /* Diagram-Based Graph Debugging */
 
@@ -38,6 +38,8 @@
 #include "BLI_ghash.h"
 #include "BLI_stack.h"
 
+#include "PIL_time.h"
+
 #include "intern/depsgraph.h"
 #include "intern/depsgraph_types.h"
 #include "intern/nodes/deg_node.h"
@@ -169,4 +171,28 @@ void deg_graph_build_finalize(Depsgraph *graph)
 	}
 }
 
+double deg_build_phase_time(double *phase_time)
+{
+	const double time = PIL_check_seconds_timer();
+	const double duration = time - *phase_time;
+	*phase_time = time;
+	return duration;
+}
+
+IDDepsNode *deg_node_get_id_node(DepsNode *node)
+{
+	switch (node->get_class()) {
+		case DEG_NODE_CLASS_OPERATION:
+			return ((OperationDepsNode *)node)->owner->owner;
+		case DEG_NODE_CLASS_COMPONENT:
+			return ((ComponentDepsNode *)node)->owner;
+		case DEG_NODE_CLASS_GENERIC:
+			if (node->type == DEG_NODE_TYPE_ID_REF) {
+				return (IDDepsNode *)node;
+			}
+			break;
+	}
+	return NULL;
+}
+
 }  // namespace DEG
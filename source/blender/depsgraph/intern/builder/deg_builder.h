@@ -37,8 +37,16 @@ struct FCurve;
 namespace DEG {
 
 struct Depsgraph;
+struct DepsNode;
+struct IDDepsNode;
 
 void deg_graph_build_finalize(struct Depsgraph *graph);
 void deg_graph_build_flush_layers(struct Depsgraph *graph);
 
+/* Time since the previous phase of the build, updating its start time. */
+double deg_build_phase_time(double *phase_time);
+
+/* ID node which the given node belongs to, NULL for the time source. */
+IDDepsNode *deg_node_get_id_node(DepsNode *node);
+
 }  // namespace DEG
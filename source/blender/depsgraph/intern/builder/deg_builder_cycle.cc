@@ -200,8 +200,91 @@ void solve_cycles(CyclesSolverState *state)
 	}
 }
 
+/* Check whether \a target is reachable from \a node, not going through
+ * cyclic relations. Visited nodes are tagged and added to the vector, for the
+ * caller to clear the tag.
+ */
+bool is_node_reachable(OperationDepsNode *node,
+                       OperationDepsNode *target,
+                       BLI_Stack *stack,
+                       vector<OperationDepsNode *> *visited)
+{
+	node->done = 1;
+	visited->push_back(node);
+	BLI_stack_push(stack, &node);
+	while (!BLI_stack_is_empty(stack)) {
+		OperationDepsNode *current;
+		BLI_stack_pop(stack, &current);
+		if (current == target) {
+			BLI_stack_clear(stack);
+			return true;
+		}
+		foreach (DepsRelation *rel, current->outlinks) {
+			if (rel->to->type != DEG_NODE_TYPE_OPERATION ||
+			    (rel->flag & DEPSREL_FLAG_CYCLIC))
+			{
+				continue;
+			}
+			OperationDepsNode *to = (OperationDepsNode *)rel->to;
+			if (to->done == 0) {
+				to->done = 1;
+				visited->push_back(to);
+				BLI_stack_push(stack, &to);
+			}
+		}
+	}
+	return false;
+}
+
 }  // namespace
 
+void deg_graph_detect_relations_cycles(Depsgraph *graph,
+                                       const vector<DepsRelation *>& relations)
+{
+	BLI_Stack *stack = BLI_stack_new(sizeof(OperationDepsNode *),
+	                                 "DEG detect relations cycles stack");
+	vector<OperationDepsNode *> visited;
+	int num_cycles = 0;
+	foreach (OperationDepsNode *node, graph->operations) {
+		node->done = 0;
+	}
+	/* Relations are ignored until they are checked, so every relation only
+	 * needs to be checked against the ones which were accepted before it.
+	 */
+	foreach (DepsRelation *rel, relations) {
+		rel->flag |= DEPSREL_FLAG_CYCLIC;
+	}
+	foreach (DepsRelation *rel, relations) {
+		if (rel->from->type != DEG_NODE_TYPE_OPERATION ||
+		    rel->to->type != DEG_NODE_TYPE_OPERATION)
+		{
+			rel->flag &= ~DEPSREL_FLAG_CYCLIC;
+			continue;
+		}
+		OperationDepsNode *from = (OperationDepsNode *)rel->from;
+		OperationDepsNode *to = (OperationDepsNode *)rel->to;
+		if (is_node_reachable(to, from, stack, &visited)) {
+			printf("Dependency cycle detected:\n");
+			printf("  '%s' depends on '%s' through '%s'\n",
+			       to->full_identifier().c_str(),
+			       from->full_identifier().c_str(),
+			       rel->name);
+			++num_cycles;
+		}
+		else {
+			rel->flag &= ~DEPSREL_FLAG_CYCLIC;
+		}
+		foreach (OperationDepsNode *node, visited) {
+			node->done = 0;
+		}
+		visited.clear();
+	}
+	BLI_stack_free(stack);
+	if (num_cycles != 0) {
+		printf("Detected %d dependency cycles\n", num_cycles);
+	}
+}
+
 void deg_graph_detect_cycles(Depsgraph *graph)
 {
 	CyclesSolverState state(graph);
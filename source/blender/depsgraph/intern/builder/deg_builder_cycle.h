@@ -30,11 +30,20 @@
 
 #pragma once
 
+#include "intern/depsgraph_types.h"
+
 namespace DEG {
 
 struct Depsgraph;
+struct DepsRelation;
 
 /* Detect and solve dependency cycles. */
 void deg_graph_detect_cycles(Depsgraph *graph);
 
+/* Detect and solve dependency cycles introduced by the given relations,
+ * the rest of the graph is expected to be free of cycles.
+ */
+void deg_graph_detect_relations_cycles(Depsgraph *graph,
+                                       const vector<DepsRelation *>& relations);
+
 }  // namespace DEG
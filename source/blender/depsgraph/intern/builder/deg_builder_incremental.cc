@@ -0,0 +1,335 @@
+/*
+ * ***** BEGIN GPL LICENSE BLOCK *****
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ * The Original Code is Copyright (C) 2017 Blender Foundation.
+ * All rights reserved.
+ *
+ * Contributor(s): None Yet
+ *
+ * ***** END GPL LICENSE BLOCK *****
+ */
+
+/** \file blender/depsgraph/intern/builder/deg_builder_incremental.cc
+ *  \ingroup depsgraph
+ *
+ * Incremental update of relations of some of the IDs in an existing graph.
+ *
+ * Nodes of the tagged objects are removed together with all their relations
+ * and built again. Relations from and to the new nodes come from builders of
+ * the objects themselves and of their immediate neighbors, so all of them are
+ * built again, only keeping relations which involve the new nodes. The rest
+ * of the graph is kept as-is, including the relations which the objects
+ * might have had before the update, so cycles only need to be checked for the
+ * new relations.
+ */
+
+#include "intern/builder/deg_builder_incremental.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_ghash.h"
+#include "BLI_listbase.h"
+
+#include "PIL_time.h"
+
+extern "C" {
+#include "DNA_key_types.h"
+#include "DNA_object_types.h"
+#include "DNA_scene_types.h"
+} /* extern "C" */
+
+#include "intern/builder/deg_builder.h"
+#include "intern/builder/deg_builder_cycle.h"
+#include "intern/builder/deg_builder_nodes.h"
+#include "intern/builder/deg_builder_relations.h"
+
+#include "intern/nodes/deg_node.h"
+#include "intern/nodes/deg_node_component.h"
+#include "intern/nodes/deg_node_id.h"
+#include "intern/nodes/deg_node_operation.h"
+
+#include "intern/depsgraph.h"
+#include "intern/depsgraph_intern.h"
+#include "intern/depsgraph_types.h"
+
+#include "util/deg_util_foreach.h"
+
+namespace DEG {
+
+namespace {
+
+struct RebuildState {
+	RebuildState(Depsgraph *graph)
+	        : graph(graph),
+	          rebuild_ids(BLI_gset_ptr_new("DEG rebuild ids"))
+	{
+	}
+	~RebuildState()
+	{
+		BLI_gset_free(rebuild_ids, NULL);
+	}
+	Depsgraph *graph;
+	/* IDs which relations are built again. */
+	GSet *rebuild_ids;
+	/* IDs to start building relations from, in order. */
+	vector<ID *> roots;
+};
+
+bool add_root(RebuildState *state, ID *id)
+{
+	if (BLI_gset_add(state->rebuild_ids, id)) {
+		state->roots.push_back(id);
+	}
+	return true;
+}
+
+/* Object data relations are built by the first object which uses it. */
+bool add_obdata(RebuildState *state, ID *obdata)
+{
+	if (obdata == NULL) {
+		return false;
+	}
+	BLI_gset_add(state->rebuild_ids, obdata);
+	foreach (IDDepsNode *id_node, state->graph->id_nodes) {
+		ID *id = id_node->id;
+		if (GS(id->name) == ID_OB && ((Object *)id)->data == obdata) {
+			return add_root(state, id);
+		}
+	}
+	return false;
+}
+
+/* Make sure relations of the ID are built again. */
+bool add_id(RebuildState *state, ID *id)
+{
+	if (BLI_gset_haskey(state->rebuild_ids, id)) {
+		return true;
+	}
+	switch (GS(id->name)) {
+		case ID_OB:
+		case ID_NT:
+		case ID_MA:
+		case ID_TE:
+		case ID_WO:
+		case ID_GD:
+		case ID_CF:
+		case ID_MSK:
+		case ID_MC:
+			return add_root(state, id);
+		case OB_DATA_SUPPORT_ID_CASE:
+			return add_obdata(state, id);
+		case ID_KE:
+			BLI_gset_add(state->rebuild_ids, id);
+			return add_obdata(state, ((Key *)id)->from);
+		default:
+			/* Scene level relations (such as rigid body) and anything else
+			 * not handled here, requires the whole graph to be built.
+			 */
+			return false;
+	}
+}
+
+bool add_node_neighbors(RebuildState *state, DepsNode *node)
+{
+	foreach (DepsRelation *rel, node->inlinks) {
+		IDDepsNode *id_node = deg_node_get_id_node(rel->from);
+		if (id_node != NULL && !add_id(state, id_node->id)) {
+			return false;
+		}
+	}
+	foreach (DepsRelation *rel, node->outlinks) {
+		IDDepsNode *id_node = deg_node_get_id_node(rel->to);
+		if (id_node != NULL && !add_id(state, id_node->id)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool add_id_node_neighbors(RebuildState *state, IDDepsNode *id_node)
+{
+	if (!add_node_neighbors(state, id_node)) {
+		return false;
+	}
+	GHASH_FOREACH_BEGIN(ComponentDepsNode *, comp_node, id_node->components)
+	{
+		if (!add_node_neighbors(state, comp_node)) {
+			return false;
+		}
+		foreach (OperationDepsNode *op_node, comp_node->operations) {
+			if (!add_node_neighbors(state, op_node)) {
+				return false;
+			}
+		}
+	}
+	GHASH_FOREACH_END();
+	return true;
+}
+
+void build_object_nodes(DepsgraphNodeBuilder *builder,
+                        Scene *scene,
+                        Object *object)
+{
+	bool has_base = false;
+	for (Scene *sce = scene; sce != NULL; sce = sce->set) {
+		LISTBASE_FOREACH (Base *, base, &sce->base) {
+			if (base->object == object) {
+				builder->build_object(base, object);
+				has_base = true;
+			}
+		}
+	}
+	if (!has_base) {
+		builder->build_object(NULL, object);
+	}
+}
+
+}  // namespace
+
+bool deg_graph_build_incremental(Main *bmain,
+                                 Depsgraph *graph,
+                                 Scene *scene,
+                                 GSet *ids)
+{
+	DepsgraphBuildStats *stats = &graph->build_stats;
+	const double start_time = PIL_check_seconds_timer();
+	double phase_time = start_time;
+
+	/* Tagged objects, in the order of the graph. */
+	vector<Object *> objects;
+	vector<int> indices;
+	vector<unsigned int> layers;
+	for (int i = 0; i < graph->id_nodes.size(); i++) {
+		IDDepsNode *id_node = graph->id_nodes[i];
+		if (BLI_gset_haskey(ids, id_node->id)) {
+			if (GS(id_node->id->name) != ID_OB) {
+				return false;
+			}
+			objects.push_back((Object *)id_node->id);
+			indices.push_back(i);
+			layers.push_back(id_node->layers);
+		}
+	}
+	if (objects.size() != BLI_gset_len(ids)) {
+		/* Some of the IDs are not in the graph. */
+		return false;
+	}
+
+	/* Find builders of all relations of the objects before touching the
+	 * graph, so it is still intact if the update can not be done.
+	 */
+	RebuildState state(graph);
+	foreach (Object *object, objects) {
+		add_root(&state, &object->id);
+	}
+	foreach (Object *object, objects) {
+		if (!add_id_node_neighbors(&state, graph->find_id_node(&object->id))) {
+			return false;
+		}
+	}
+
+	/* Remove old nodes, together with all relations from and to them. */
+	foreach (Object *object, objects) {
+		graph->remove_id_node(graph->find_id_node(&object->id));
+	}
+
+	/* Build new nodes. Layers are kept from the old nodes since they might
+	 * come from objects which are not built again (dupli-groups).
+	 */
+	const int num_id_nodes = graph->id_nodes.size();
+	DepsgraphNodeBuilder node_builder(bmain, graph);
+	node_builder.begin_partial_build(scene);
+	for (int i = 0; i < objects.size(); i++) {
+		build_object_nodes(&node_builder, scene, objects[i]);
+		graph->find_id_node(&objects[i]->id)->layers |= layers[i];
+	}
+	/* Nodes of the objects go back to their place in the ordered list, other
+	 * IDs which were not in the graph yet are kept at its end.
+	 */
+	vector<IDDepsNode *> new_id_nodes(graph->id_nodes.begin() + num_id_nodes,
+	                                  graph->id_nodes.end());
+	graph->id_nodes.resize(num_id_nodes);
+	GSet *new_id_nodes_set = BLI_gset_ptr_new(__func__);
+	for (int i = 0; i < objects.size(); i++) {
+		IDDepsNode *id_node = graph->find_id_node(&objects[i]->id);
+		graph->id_nodes.insert(graph->id_nodes.begin() + indices[i], id_node);
+		BLI_gset_insert(new_id_nodes_set, id_node);
+	}
+	foreach (IDDepsNode *id_node, new_id_nodes) {
+		if (!BLI_gset_haskey(new_id_nodes_set, id_node)) {
+			graph->id_nodes.push_back(id_node);
+			BLI_gset_insert(new_id_nodes_set, id_node);
+			BLI_gset_add(state.rebuild_ids, id_node->id);
+		}
+	}
+	stats->nodes_time = deg_build_phase_time(&phase_time);
+
+	/* Build relations, starting with the objects themselves. */
+	DepsgraphRelationBuilder relation_builder(bmain, graph);
+	DepsgraphRelationStaging staging;
+	relation_builder.begin_partial_build(scene, state.rebuild_ids);
+	foreach (ID *id, state.roots) {
+		relation_builder.build_id_staged(id, &staging);
+	}
+	vector<DepsRelation *> relations;
+	staging.apply_partial(graph, new_id_nodes_set, &relations);
+	GSET_FOREACH_BEGIN(IDDepsNode *, id_node, new_id_nodes_set)
+	{
+		if (GS(id_node->id->name) != ID_OB) {
+			continue;
+		}
+		Object *object = (Object *)id_node->id;
+		GHASH_FOREACH_BEGIN(ComponentDepsNode *, comp_node, id_node->components)
+		{
+			GHASH_FOREACH_BEGIN(OperationDepsNode *, op_node, comp_node->operations_map)
+			{
+				object->customdata_mask |= op_node->customdata_mask;
+			}
+			GHASH_FOREACH_END();
+		}
+		GHASH_FOREACH_END();
+	}
+	GSET_FOREACH_END();
+	foreach (const DepsgraphRelationStaging::CustomDataMask& customdata_mask,
+	         staging.customdata_masks)
+	{
+		ID *id = customdata_mask.node->owner->owner->id;
+		if (GS(id->name) == ID_OB) {
+			((Object *)id)->customdata_mask |= customdata_mask.mask;
+		}
+	}
+	stats->relations_time = deg_build_phase_time(&phase_time);
+	stats->relations_num_threads = 1;
+
+	/* The rest of the graph has no cycles, only check the new relations. */
+	deg_graph_detect_relations_cycles(graph, relations);
+	stats->cycles_time = deg_build_phase_time(&phase_time);
+	stats->transitive_reduction_time = 0.0;
+
+	/* Layers are flushed over the whole graph, new nodes are finalized. */
+	deg_graph_build_finalize(graph);
+	stats->finalize_time = deg_build_phase_time(&phase_time);
+
+	stats->total_time = phase_time - start_time;
+	stats->num_rebuilt_ids = BLI_gset_len(new_id_nodes_set);
+
+	BLI_gset_free(new_id_nodes_set, NULL);
+	return true;
+}
+
+}  // namespace DEG
@@ -32,35 +32,41 @@
 
 #include "BLI_utildefines.h"
 #include "BLI_ghash.h"
+#include "BLI_concurrent_hash.h"
 
 #include "DNA_ID.h"
 
 namespace DEG {
 
 BuilderMap::BuilderMap() {
-	set = BLI_gset_ptr_new("deg builder gset");
+	set = BLI_concurrent_hash_new(BLI_ghashutil_ptrhash,
+	                              BLI_ghashutil_ptrcmp,
+	                              "deg builder map");
+	animation_set = BLI_concurrent_hash_new(BLI_ghashutil_ptrhash,
+	                                        BLI_ghashutil_ptrcmp,
+	                                        "deg builder animation map");
 }
 
 
 BuilderMap::~BuilderMap() {
-	BLI_gset_free(set, NULL);
+	BLI_concurrent_hash_free(set, NULL, NULL);
+	BLI_concurrent_hash_free(animation_set, NULL, NULL);
 }
 
 bool BuilderMap::checkIsBuilt(ID *id) {
-	return BLI_gset_haskey(set, id);
+	return BLI_concurrent_hash_haskey(set, id);
 }
 
 void BuilderMap::tagBuild(ID *id) {
-	BLI_gset_insert(set, id);
+	BLI_concurrent_hash_add(set, id, id);
 }
 
 bool BuilderMap::checkIsBuiltAndTag(ID *id) {
-	void **key_p;
-	if (!BLI_gset_ensure_p_ex(set, id, &key_p)) {
-		*key_p = id;
-		return false;
-	}
-	return true;
+	return !BLI_concurrent_hash_add(set, id, id);
+}
+
+bool BuilderMap::checkIsAnimationBuiltAndTag(ID *id) {
+	return !BLI_concurrent_hash_add(animation_set, id, id);
 }
 
 }  // namespace DEG
@@ -30,7 +30,7 @@
 
 #pragma once
 
-struct GSet;
+struct ConcurrentHash;
 struct ID;
 
 namespace DEG {
@@ -40,6 +40,10 @@ public:
 	BuilderMap();
 	~BuilderMap();
 
+	/* NOTE: All checks and tags are thread-safe, so the map can be shared by
+	 * builders running in multiple threads.
+	 */
+
 	/* Check whether given ID is already handled by builder (or if it's being
 	 * handled).
 	 */
@@ -53,6 +57,12 @@ public:
 	 */
 	bool checkIsBuiltAndTag(ID *id);
 
+	/* Check whether animation of given ID is already handled by builder, tag
+	 * it as handled otherwise. Used for object data, which is only tagged as
+	 * built after its animation is handled by the first object using it.
+	 */
+	bool checkIsAnimationBuiltAndTag(ID *id);
+
 	template<typename T> bool checkIsBuilt(T *datablock) {
 		return checkIsBuilt(&datablock->id);
 	}
@@ -63,7 +73,8 @@ public:
 		return checkIsBuiltAndTag(&datablock->id);
 	}
 
-	GSet *set;
+	ConcurrentHash *set;
+	ConcurrentHash *animation_set;
 };
 
 }  // namespace DEG
@@ -264,6 +264,13 @@ OperationDepsNode *DepsgraphNodeBuilder::find_operation_node(
 void DepsgraphNodeBuilder::begin_build() {
 }
 
+void DepsgraphNodeBuilder::begin_partial_build(Scene *scene) {
+	scene_ = scene;
+	foreach (IDDepsNode *id_node, graph_->id_nodes) {
+		built_map_.tagBuild(id_node->id);
+	}
+}
+
 void DepsgraphNodeBuilder::build_id(ID* id) {
 	if (id == NULL) {
 		return;
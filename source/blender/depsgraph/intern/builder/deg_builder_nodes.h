@@ -72,6 +72,10 @@ struct DepsgraphNodeBuilder {
 	~DepsgraphNodeBuilder();
 
 	void begin_build();
+	/* Build nodes into an existing graph, IDs which already have nodes in
+	 * the graph are considered built.
+	 */
+	void begin_partial_build(Scene *scene);
 
 	IDDepsNode *add_id_node(ID *id);
 	TimeSourceDepsNode *add_time_source();
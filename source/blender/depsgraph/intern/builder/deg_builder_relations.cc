@@ -40,6 +40,7 @@
 
 #include "BLI_utildefines.h"
 #include "BLI_blenlib.h"
+#include "BLI_ghash.h"
 
 extern "C" {
 #include "DNA_action_types.h"
@@ -174,10 +175,95 @@ DepsgraphRelationBuilder::DepsgraphRelationBuilder(Main *bmain,
                                                    Depsgraph *graph)
     : bmain_(bmain),
       graph_(graph),
-      scene_(NULL)
+      scene_(NULL),
+      built_map_(OBJECT_GUARDED_NEW(BuilderMap)),
+      owns_built_map_(true),
+      staging_(NULL),
+      scene_lookup_mutex_(NULL)
 {
 }
 
+DepsgraphRelationBuilder::DepsgraphRelationBuilder(
+        DepsgraphRelationBuilder *parent)
+    : bmain_(parent->bmain_),
+      graph_(parent->graph_),
+      scene_(parent->scene_),
+      built_map_(parent->built_map_),
+      owns_built_map_(false),
+      staging_(NULL),
+      scene_lookup_mutex_(NULL)
+{
+}
+
+DepsgraphRelationBuilder::~DepsgraphRelationBuilder()
+{
+	if (owns_built_map_) {
+		OBJECT_GUARDED_DELETE(built_map_, BuilderMap);
+	}
+}
+
+/* Relations between operations go through their own graph API, which might
+ * tag nodes for update.
+ */
+static DepsRelation *graph_add_new_relation(Depsgraph *graph,
+                                            DepsNode *node_from,
+                                            DepsNode *node_to,
+                                            const char *description,
+                                            bool check_unique)
+{
+	if (node_from->type == DEG_NODE_TYPE_OPERATION &&
+	    node_to->type == DEG_NODE_TYPE_OPERATION)
+	{
+		return graph->add_new_relation((OperationDepsNode *)node_from,
+		                               (OperationDepsNode *)node_to,
+		                               description,
+		                               check_unique);
+	}
+	return graph->add_new_relation(node_from,
+	                               node_to,
+	                               description,
+	                               check_unique);
+}
+
+void DepsgraphRelationStaging::apply(Depsgraph *graph)
+{
+	foreach (const Relation& rel, relations) {
+		graph_add_new_relation(graph,
+		                       rel.from,
+		                       rel.to,
+		                       rel.description,
+		                       rel.check_unique);
+	}
+	foreach (const CustomDataMask& customdata_mask, customdata_masks) {
+		customdata_mask.node->customdata_mask |= customdata_mask.mask;
+	}
+}
+
+void DepsgraphRelationStaging::apply_partial(
+        Depsgraph *graph,
+        GSet *id_nodes,
+        vector<DepsRelation *> *r_relations)
+{
+	foreach (const Relation& rel, relations) {
+		IDDepsNode *id_from = deg_node_get_id_node(rel.from);
+		IDDepsNode *id_to = deg_node_get_id_node(rel.to);
+		if ((id_from == NULL || !BLI_gset_haskey(id_nodes, id_from)) &&
+		    (id_to == NULL || !BLI_gset_haskey(id_nodes, id_to)))
+		{
+			continue;
+		}
+		r_relations->push_back(graph_add_new_relation(graph,
+		                                              rel.from,
+		                                              rel.to,
+		                                              rel.description,
+		                                              rel.check_unique));
+	}
+	/* Masks are only ever added, so re-applying the existing ones is fine. */
+	foreach (const CustomDataMask& customdata_mask, customdata_masks) {
+		customdata_mask.node->customdata_mask |= customdata_mask.mask;
+	}
+}
+
 TimeSourceDepsNode *DepsgraphRelationBuilder::get_node(
         const TimeSourceKey &key) const
 {
@@ -247,7 +333,7 @@ DepsRelation *DepsgraphRelationBuilder::add_time_relation(
         bool check_unique)
 {
 	if (timesrc && node_to) {
-		return graph_->add_new_relation(timesrc, node_to, description, check_unique);
+		return add_new_relation(timesrc, node_to, description, check_unique);
 	}
 	else {
 		DEG_DEBUG_PRINTF(BUILD, "add_time_relation(%p = %s, %p = %s, %s) Failed\n",
@@ -265,10 +351,7 @@ DepsRelation *DepsgraphRelationBuilder::add_operation_relation(
         bool check_unique)
 {
 	if (node_from && node_to) {
-		return graph_->add_new_relation(node_from,
-		                                node_to,
-		                                description,
-		                                check_unique);
+		return add_new_relation(node_from, node_to, description, check_unique);
 	}
 	else {
 		DEG_DEBUG_PRINTF(BUILD, "add_operation_relation(%p = %s, %p = %s, %s) Failed\n",
@@ -279,6 +362,42 @@ DepsRelation *DepsgraphRelationBuilder::add_operation_relation(
 	return NULL;
 }
 
+DepsRelation *DepsgraphRelationBuilder::add_new_relation(
+        DepsNode *node_from,
+        DepsNode *node_to,
+        const char *description,
+        bool check_unique)
+{
+	if (staging_ != NULL) {
+		DepsgraphRelationStaging::Relation rel;
+		rel.from = node_from;
+		rel.to = node_to;
+		rel.description = description;
+		rel.check_unique = check_unique;
+		staging_->relations.push_back(rel);
+		return NULL;
+	}
+	return graph_add_new_relation(graph_,
+	                              node_from,
+	                              node_to,
+	                              description,
+	                              check_unique);
+}
+
+void DepsgraphRelationBuilder::add_customdata_mask(OperationDepsNode *node,
+                                                   uint64_t mask)
+{
+	/* Node might belong to an object which is built by another thread. */
+	if (staging_ != NULL) {
+		DepsgraphRelationStaging::CustomDataMask customdata_mask;
+		customdata_mask.node = node;
+		customdata_mask.mask = mask;
+		staging_->customdata_masks.push_back(customdata_mask);
+		return;
+	}
+	node->customdata_mask |= mask;
+}
+
 void DepsgraphRelationBuilder::add_collision_relations(
         const OperationKey &key,
         Scene *scene,
@@ -320,7 +439,7 @@ void DepsgraphRelationBuilder::add_forcefield_relations(
         bool add_absorption,
         const char *name)
 {
-	ListBase *effectors = pdInitEffectors(scene, object, psys, eff, false);
+	ListBase *effectors = find_effectors(scene, object, psys, eff);
 	if (effectors != NULL) {
 		LISTBASE_FOREACH(EffectorCache *, eff, effectors) {
 			if (eff->ob != object) {
@@ -370,6 +489,33 @@ void DepsgraphRelationBuilder::add_forcefield_relations(
 	pdEndEffectors(&effectors);
 }
 
+Object *DepsgraphRelationBuilder::find_mball_basis(Object *object)
+{
+	if (scene_lookup_mutex_ != NULL) {
+		BLI_mutex_lock(scene_lookup_mutex_);
+	}
+	Object *mom = BKE_mball_basis_find(bmain_, bmain_->eval_ctx, scene_, object);
+	if (scene_lookup_mutex_ != NULL) {
+		BLI_mutex_unlock(scene_lookup_mutex_);
+	}
+	return mom;
+}
+
+ListBase *DepsgraphRelationBuilder::find_effectors(Scene *scene,
+                                                   Object *object,
+                                                   ParticleSystem *psys,
+                                                   EffectorWeights *eff)
+{
+	if (scene_lookup_mutex_ != NULL) {
+		BLI_mutex_lock(scene_lookup_mutex_);
+	}
+	ListBase *effectors = pdInitEffectors(scene, object, psys, eff, false);
+	if (scene_lookup_mutex_ != NULL) {
+		BLI_mutex_unlock(scene_lookup_mutex_);
+	}
+	return effectors;
+}
+
 Depsgraph *DepsgraphRelationBuilder::getGraph()
 {
 	return graph_;
@@ -381,9 +527,73 @@ void DepsgraphRelationBuilder::begin_build()
 {
 }
 
+void DepsgraphRelationBuilder::begin_partial_build(Scene *scene,
+                                                   GSet *rebuild_ids)
+{
+	scene_ = scene;
+	foreach (IDDepsNode *id_node, graph_->id_nodes) {
+		ID *id = id_node->id;
+		if (!BLI_gset_haskey(rebuild_ids, id)) {
+			built_map_->tagBuild(id);
+			built_map_->checkIsAnimationBuiltAndTag(id);
+		}
+	}
+}
+
+void DepsgraphRelationBuilder::build_id(ID *id)
+{
+	if (id == NULL) {
+		return;
+	}
+	switch (GS(id->name)) {
+		case ID_GR:
+			build_group(NULL, (Group *)id);
+			break;
+		case ID_OB:
+			build_object((Object *)id);
+			break;
+		case ID_NT:
+			build_nodetree((bNodeTree *)id);
+			break;
+		case ID_MA:
+			build_material((Material *)id);
+			break;
+		case ID_TE:
+			build_texture((Tex *)id);
+			break;
+		case ID_WO:
+			build_world((World *)id);
+			break;
+		case ID_GD:
+			build_gpencil((bGPdata *)id);
+			break;
+		case ID_CF:
+			build_cachefile((CacheFile *)id);
+			break;
+		case ID_MSK:
+			build_mask((Mask *)id);
+			break;
+		case ID_MC:
+			build_movieclip((MovieClip *)id);
+			break;
+		default:
+			/* fprintf(stderr, "Unhandled ID %s\n", id->name); */
+			break;
+	}
+}
+
+void DepsgraphRelationBuilder::build_id_staged(
+        ID *id,
+        DepsgraphRelationStaging *staging)
+{
+	staging_ = staging;
+	build_id(id);
+	staging_ = NULL;
+}
+
 void DepsgraphRelationBuilder::build_group(Object *object, Group *group)
 {
-	const bool group_done = built_map_.checkIsBuiltAndTag(group);
+	const bool group_done = built_map_->checkIsBuiltAndTag(group);
 	OperationKey object_local_transform_key(object != NULL ? &object->id : NULL,
 	                                        DEG_NODE_TYPE_TRANSFORM,
 	                                        DEG_OPCODE_TRANSFORM_LOCAL);
@@ -400,7 +610,7 @@ void DepsgraphRelationBuilder::build_group(Object *object, Group *group)
 
 void DepsgraphRelationBuilder::build_object(Object *object)
 {
-	if (built_map_.checkIsBuiltAndTag(object)) {
+	if (built_map_->checkIsBuiltAndTag(object)) {
 		return;
 	}
 	/* Object Transforms */
@@ -509,7 +719,7 @@ void DepsgraphRelationBuilder::build_object_data(Object *object)
 	}
 	ID *obdata_id = (ID *)object->data;
 	/* Object data animation. */
-	if (!built_map_.checkIsBuilt(obdata_id)) {
+	if (!built_map_->checkIsAnimationBuiltAndTag(obdata_id)) {
 		build_animdata(obdata_id);
 	}
 	/* type-specific data. */
@@ -575,7 +785,7 @@ void DepsgraphRelationBuilder::build_object_parent(Object *object)
 			/* XXX not sure what this is for or how you could be done properly - lukas */
 			OperationDepsNode *parent_node = find_operation_node(parent_key);
 			if (parent_node != NULL) {
-				parent_node->customdata_mask |= CD_MASK_ORIGINDEX;
+				add_customdata_mask(parent_node, CD_MASK_ORIGINDEX);
 			}
 
 			ComponentKey transform_key(&object->parent->id, DEG_NODE_TYPE_TRANSFORM);
@@ -785,7 +995,7 @@ void DepsgraphRelationBuilder::build_constraints(ID *id,
 					if (ct->tar->type == OB_MESH) {
 						OperationDepsNode *node2 = find_operation_node(target_key);
 						if (node2 != NULL) {
-							node2->customdata_mask |= CD_MASK_MDEFORMVERT;
+							add_customdata_mask(node2, CD_MASK_MDEFORMVERT);
 						}
 					}
 				}
@@ -932,9 +1142,9 @@ void DepsgraphRelationBuilder::build_animdata_curves_targets(
 			add_relation(adt_key, pose_init_key, "Animation -> Prop", true);
 			continue;
 		}
-		graph_->add_new_relation(operation_from, operation_to,
-		                         "Animation -> Prop",
-		                         true);
+		add_new_relation(operation_from, operation_to,
+		                 "Animation -> Prop",
+		                 true);
 	}
 }
 
@@ -1070,12 +1280,14 @@ void DepsgraphRelationBuilder::build_driver_data(ID *id, FCurve *fcu)
 		char *bone_name = BLI_str_quoted_substrN(rna_path, "bones[");
 		if (arm_node && bone_name) {
 			/* Find objects which use this, and make their eval callbacks
-			 * depend on this.
+			 * depend on this. Look through the ID nodes rather than the
+			 * relations, which worker builders only stage.
 			 */
-			foreach (DepsRelation *rel, arm_node->outlinks) {
-				IDDepsNode *to_node = (IDDepsNode *)rel->to;
+			foreach (IDDepsNode *to_node, graph_->id_nodes) {
 				/* We only care about objects with pose data which use this. */
-				if (GS(to_node->id->name) == ID_OB) {
+				if (GS(to_node->id->name) == ID_OB &&
+				    ((Object *)to_node->id)->data == id)
+				{
 					Object *object = (Object *)to_node->id;
 					/* NOTE: object->pose may be NULL. */
 					bPoseChannel *pchan = BKE_pose_channel_find_name(
@@ -1212,7 +1424,7 @@ void DepsgraphRelationBuilder::build_driver_variables(ID *id, FCurve *fcu)
 
 void DepsgraphRelationBuilder::build_world(World *world)
 {
-	if (built_map_.checkIsBuiltAndTag(world)) {
+	if (built_map_->checkIsBuiltAndTag(world)) {
 		return;
 	}
 	build_animdata(&world->id);
@@ -1581,7 +1793,7 @@ void DepsgraphRelationBuilder::build_obdata_geom(Object *object)
 		add_relation(geom_init_key, obdata_ubereval_key, "Object Geometry UberEval");
 	}
 
-	if (built_map_.checkIsBuiltAndTag(obdata)) {
+	if (built_map_->checkIsBuiltAndTag(obdata)) {
 		return;
 	}
 
@@ -1612,7 +1824,7 @@ void DepsgraphRelationBuilder::build_obdata_geom(Object *object)
 
 		case OB_MBALL:
 		{
-			Object *mom = BKE_mball_basis_find(bmain_, bmain_->eval_ctx, scene_, object);
+			Object *mom = find_mball_basis(object);
 			ComponentKey mom_geom_key(&mom->id, DEG_NODE_TYPE_GEOMETRY);
 			/* motherball - mom depends on children! */
 			if (mom == object) {
@@ -1680,7 +1892,7 @@ void DepsgraphRelationBuilder::build_obdata_geom(Object *object)
 void DepsgraphRelationBuilder::build_camera(Object *object)
 {
 	Camera *camera = (Camera *)object->data;
-	if (built_map_.checkIsBuiltAndTag(camera)) {
+	if (built_map_->checkIsBuiltAndTag(camera)) {
 		return;
 	}
 	/* DOF */
@@ -1695,7 +1907,7 @@ void DepsgraphRelationBuilder::build_camera(Object *object)
 void DepsgraphRelationBuilder::build_lamp(Object *object)
 {
 	Lamp *lamp = (Lamp *)object->data;
-	if (built_map_.checkIsBuiltAndTag(lamp)) {
+	if (built_map_->checkIsBuiltAndTag(lamp)) {
 		return;
 	}
 	/* lamp's nodetree */
@@ -1714,7 +1926,7 @@ void DepsgraphRelationBuilder::build_nodetree(bNodeTree *ntree)
 	if (ntree == NULL) {
 		return;
 	}
-	if (built_map_.checkIsBuiltAndTag(ntree)) {
+	if (built_map_->checkIsBuiltAndTag(ntree)) {
 		return;
 	}
 	build_animdata(&ntree->id);
@@ -1765,7 +1977,7 @@ void DepsgraphRelationBuilder::build_nodetree(bNodeTree *ntree)
 /* Recursively build graph for material */
 void DepsgraphRelationBuilder::build_material(Material *material)
 {
-	if (built_map_.checkIsBuiltAndTag(material)) {
+	if (built_map_->checkIsBuiltAndTag(material)) {
 		return;
 	}
 	/* animation */
@@ -1789,7 +2001,7 @@ void DepsgraphRelationBuilder::build_material(Material *material)
 /* Recursively build graph for texture */
 void DepsgraphRelationBuilder::build_texture(Tex *texture)
 {
-	if (built_map_.checkIsBuiltAndTag(texture)) {
+	if (built_map_->checkIsBuiltAndTag(texture)) {
 		return;
 	}
 	/* texture itself */
@@ -42,6 +42,7 @@
 
 #include "BLI_utildefines.h"
 #include "BLI_string.h"
+#include "BLI_threads.h"
 
 #include "intern/builder/deg_builder_map.h"
 #include "intern/nodes/deg_node.h"
@@ -53,6 +54,7 @@ struct bGPdata;
 struct CacheFile;
 struct ListBase;
 struct GHash;
+struct GSet;
 struct ID;
 struct FCurve;
 struct Group;
@@ -167,11 +169,52 @@ struct RNAPathKey
 	PropertyRNA *prop;
 };
 
+/* Changes to the graph done by a builder which runs in a thread, applied to
+ * the graph once all threads are finished.
+ */
+struct DepsgraphRelationStaging
+{
+	struct Relation {
+		DepsNode *from;
+		DepsNode *to;
+		const char *description;
+		bool check_unique;
+	};
+
+	struct CustomDataMask {
+		OperationDepsNode *node;
+		uint64_t mask;
+	};
+
+	/* Apply all changes to the graph, in the order they were staged. */
+	void apply(Depsgraph *graph);
+
+	/* Apply changes of a partial build, only adding relations from or to
+	 * nodes of the given ID nodes, the rest of them are already in the graph.
+	 * Added relations are appended to the given vector.
+	 */
+	void apply_partial(Depsgraph *graph,
+	                   GSet *id_nodes,
+	                   vector<DepsRelation *> *r_relations);
+
+	vector<Relation> relations;
+	vector<CustomDataMask> customdata_masks;
+};
+
 struct DepsgraphRelationBuilder
 {
 	DepsgraphRelationBuilder(Main *bmain, Depsgraph *graph);
+	/* Builder for a worker thread, which shares the map of built IDs with
+	 * the given builder and stages all relations instead of adding them.
+	 */
+	DepsgraphRelationBuilder(DepsgraphRelationBuilder *parent);
+	~DepsgraphRelationBuilder();
 
 	void begin_build();
+	/* Build relations into an existing graph, IDs which have nodes in the
+	 * graph are considered built unless they are in the given set.
+	 */
+	void begin_partial_build(Scene *scene, GSet *rebuild_ids);
 
 	template <typename KeyFrom, typename KeyTo>
 	DepsRelation *add_relation(const KeyFrom& key_from,
@@ -191,7 +234,12 @@ struct DepsgraphRelationBuilder
 	                                       const char *description,
 	                                       bool check_unique = false);
 
+	void build_id(ID *id);
+	void build_id_staged(ID *id, DepsgraphRelationStaging *staging);
 	void build_scene(Scene *scene);
+	void build_scene_objects(Scene *scene);
+	void build_object_staged(Object *object,
+	                         DepsgraphRelationStaging *staging);
 	void build_group(Object *object, Group *group);
 	void build_object(Object *object);
 	void build_object_data(Object *object);
@@ -261,6 +309,16 @@ struct DepsgraphRelationBuilder
 	                              bool add_absorption,
 	                              const char *name);
 
+	/* Lookups through the whole scene, these write to the objects they visit
+	 * (BKE_scene_base_iter_next() and pdInitEffectors()), so worker builders
+	 * take turns.
+	 */
+	Object *find_mball_basis(Object *object);
+	ListBase *find_effectors(Scene *scene,
+	                         Object *object,
+	                         ParticleSystem *psys,
+	                         EffectorWeights *eff);
+
 	template <typename KeyType>
 	OperationDepsNode *find_operation_node(const KeyType &key);
 
@@ -284,6 +342,15 @@ protected:
 	                                     const char *description,
 	                                     bool check_unique = false);
 
+	/* Add relation to the graph, or stage it when building from a thread.
+	 * Staged relations are not returned.
+	 */
+	DepsRelation *add_new_relation(DepsNode *node_from,
+	                               DepsNode *node_to,
+	                               const char *description,
+	                               bool check_unique);
+	void add_customdata_mask(OperationDepsNode *node, uint64_t mask);
+
 	template <typename KeyType>
 	DepsNodeHandle create_node_handle(const KeyType& key,
 	                                  const char *default_name = "");
@@ -335,7 +402,15 @@ private:
 	/* State which demotes currently built entities. */
 	Scene *scene_;
 
-	BuilderMap built_map_;
+	/* Shared with the worker builders. */
+	BuilderMap *built_map_;
+	bool owns_built_map_;
+
+	/* Changes of the object which is being built, used by worker builders. */
+	DepsgraphRelationStaging *staging_;
+
+	/* Held during scene lookups of worker builders, NULL otherwise. */
+	ThreadMutex *scene_lookup_mutex_;
 };
 
 struct DepsNodeHandle
@@ -131,7 +131,7 @@ void DepsgraphRelationBuilder::build_ik_pose(Object *object,
 			if (data->tar->type == OB_MESH) {
 				OperationDepsNode *node2 = find_operation_node(target_key);
 				if (node2 != NULL) {
-					node2->customdata_mask |= CD_MASK_MDEFORMVERT;
+					add_customdata_mask(node2, CD_MASK_MDEFORMVERT);
 				}
 			}
 		}
@@ -166,7 +166,7 @@ void DepsgraphRelationBuilder::build_ik_pose(Object *object,
 			if (data->poletar->type == OB_MESH) {
 				OperationDepsNode *node2 = find_operation_node(target_key);
 				if (node2 != NULL) {
-					node2->customdata_mask |= CD_MASK_MDEFORMVERT;
+					add_customdata_mask(node2, CD_MASK_MDEFORMVERT);
 				}
 			}
 		}
@@ -316,7 +316,7 @@ void DepsgraphRelationBuilder::build_rig(Object *object)
 	add_relation(init_ik_key, flush_key, "Pose Init IK -> Pose Cleanup");
 
 	/* Make sure pose is up-to-date with armature updates. */
-	if (!built_map_.checkIsBuiltAndTag(arm)) {
+	if (!built_map_->checkIsBuiltAndTag(arm)) {
 		OperationKey armature_key(&arm->id,
 		                          DEG_NODE_TYPE_PARAMETERS,
 		                          DEG_OPCODE_PLACEHOLDER,
@@ -40,12 +40,16 @@
 
 #include "BLI_utildefines.h"
 #include "BLI_blenlib.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
 
 extern "C" {
+#include "DNA_modifier_types.h"
 #include "DNA_node_types.h"
 #include "DNA_object_types.h"
 #include "DNA_scene_types.h"
 
+#include "BKE_global.h"
 #include "BKE_main.h"
 #include "BKE_node.h"
 } /* extern "C" */
@@ -68,6 +72,140 @@ extern "C" {
 
 namespace DEG {
 
+/* Scenes with less objects are not worth building from multiple threads. */
+#define DEG_RELATIONS_PARALLEL_MIN_OBJECTS 64
+
+namespace {
+
+struct BuildObjectsState {
+	/* One builder per thread, they only differ in their staging. */
+	vector<DepsgraphRelationBuilder *> builders;
+	vector<Object *> objects;
+	/* Changes done by building each of the objects. */
+	vector<DepsgraphRelationStaging> stagings;
+	/* Scene lookups of objects which are not built up front. */
+	ThreadMutex scene_lookup_mutex;
+};
+
+/* Whether relations of the object are found by looking through the whole
+ * scene, see DepsgraphRelationBuilder::find_mball_basis() and
+ * DepsgraphRelationBuilder::find_effectors().
+ */
+bool object_needs_scene_lookup(Object *object)
+{
+	if (object->type == OB_MBALL || object->particlesystem.first != NULL) {
+		return true;
+	}
+	/* Modifiers which add force field relations. */
+	LISTBASE_FOREACH (ModifierData *, md, &object->modifiers) {
+		switch (md->type) {
+			case eModifierType_Cloth:
+			case eModifierType_DynamicPaint:
+			case eModifierType_Smoke:
+			case eModifierType_Softbody:
+				return true;
+		}
+	}
+	return false;
+}
+
+void build_object_task(TaskPool * __restrict pool,
+                       void *taskdata,
+                       int thread_id)
+{
+	BuildObjectsState *state = (BuildObjectsState *)BLI_task_pool_userdata(pool);
+	const int index = GET_INT_FROM_POINTER(taskdata);
+	DepsgraphRelationBuilder *builder = state->builders[thread_id];
+	builder->build_object_staged(state->objects[index],
+	                             &state->stagings[index]);
+}
+
+}  // namespace
+
+void DepsgraphRelationBuilder::build_object_staged(
+        Object *object,
+        DepsgraphRelationStaging *staging)
+{
+	staging_ = staging;
+	build_object(object);
+	staging_ = NULL;
+}
+
+/* Build relations of all scene objects.
+ *
+ * Objects are built from multiple threads, every object stages its relations,
+ * which are added to the graph in the order of bases once all of them are
+ * built. IDs shared by objects are built by whichever thread gets to them
+ * first.
+ *
+ * Metaballs and objects with effectors are built from this thread before the
+ * others, their relations are found by walking the scene, which writes to the
+ * objects on the way. Such objects outside of the scene, only reached from
+ * other objects, lock for these lookups instead.
+ */
+void DepsgraphRelationBuilder::build_scene_objects(Scene *scene)
+{
+	const int num_objects = BLI_listbase_count(&scene->base);
+	if (num_objects < DEG_RELATIONS_PARALLEL_MIN_OBJECTS ||
+	    (G.debug & G_DEBUG_DEPSGRAPH_NO_THREADS))
+	{
+		LISTBASE_FOREACH (Base *, base, &scene->base) {
+			build_object(base->object);
+		}
+		return;
+	}
+	/* Entry and exit operations are cached on first access, do it now
+	 * rather than from threads.
+	 */
+	foreach (IDDepsNode *id_node, graph_->id_nodes) {
+		GHASH_FOREACH_BEGIN(ComponentDepsNode *, comp_node, id_node->components)
+		{
+			comp_node->get_entry_operation();
+			comp_node->get_exit_operation();
+		}
+		GHASH_FOREACH_END();
+	}
+	LISTBASE_FOREACH (Base *, base, &scene->base) {
+		if (object_needs_scene_lookup(base->object)) {
+			build_object(base->object);
+		}
+	}
+	TaskScheduler *task_scheduler = BLI_task_scheduler_get();
+	const int num_threads = BLI_task_scheduler_num_threads(task_scheduler);
+	BuildObjectsState state;
+	BLI_mutex_init(&state.scene_lookup_mutex);
+	/* Thread ID zero is used by the thread which waits for the pool. */
+	for (int i = 0; i < num_threads + 1; ++i) {
+		DepsgraphRelationBuilder *builder =
+		        OBJECT_GUARDED_NEW(DepsgraphRelationBuilder, this);
+		builder->scene_lookup_mutex_ = &state.scene_lookup_mutex;
+		state.builders.push_back(builder);
+	}
+	state.objects.reserve(num_objects);
+	LISTBASE_FOREACH (Base *, base, &scene->base) {
+		state.objects.push_back(base->object);
+	}
+	state.stagings.resize(num_objects);
+	TaskPool *task_pool = BLI_task_pool_create(task_scheduler, &state);
+	for (int i = 0; i < num_objects; ++i) {
+		BLI_task_pool_push(task_pool,
+		                   build_object_task,
+		                   SET_INT_IN_POINTER(i),
+		                   false,
+		                   TASK_PRIORITY_LOW);
+	}
+	BLI_task_pool_work_and_wait(task_pool);
+	BLI_task_pool_free(task_pool);
+	foreach (DepsgraphRelationBuilder *builder, state.builders) {
+		OBJECT_GUARDED_DELETE(builder, DepsgraphRelationBuilder);
+	}
+	BLI_mutex_end(&state.scene_lookup_mutex);
+	foreach (DepsgraphRelationStaging& staging, state.stagings) {
+		staging.apply(graph_);
+	}
+	graph_->build_stats.relations_num_threads = num_threads;
+}
+
 void DepsgraphRelationBuilder::build_scene(Scene *scene)
 {
 	if (scene->set != NULL) {
@@ -76,10 +214,7 @@ void DepsgraphRelationBuilder::build_scene(Scene *scene)
 	/* Setup currently building context. */
 	scene_ = scene;
 	/* Scene objects. */
-	LISTBASE_FOREACH (Base *, base, &scene->base) {
-		Object *object = base->object;
-		build_object(object);
-	}
+	build_scene_objects(scene);
 	/* Rigidbody. */
 	if (scene->rigidbody_world != NULL) {
 		build_rigidbody(scene);
@@ -83,12 +83,17 @@ static void remove_from_vector(vector<T> *vector, const T& value)
 
 Depsgraph::Depsgraph()
   : time_source(NULL),
+    scene(NULL),
     need_update(false),
+    flush_generation(0),
     layers(0)
 {
 	BLI_spin_init(&lock);
+	memset(&build_stats, 0, sizeof(build_stats));
+	memset(&eval_stats, 0, sizeof(eval_stats));
 	id_hash = BLI_ghash_ptr_new("Depsgraph id hash");
 	entry_tags = BLI_gset_ptr_new("Depsgraph entry_tags");
+	relations_update_ids = BLI_gset_ptr_new("Depsgraph relations_update_ids");
 }
 
 Depsgraph::~Depsgraph()
@@ -96,6 +101,7 @@ Depsgraph::~Depsgraph()
 	clear_id_nodes();
 	BLI_ghash_free(id_hash, NULL, NULL);
 	BLI_gset_free(entry_tags, NULL);
+	BLI_gset_free(relations_update_ids, NULL);
 	if (time_source != NULL) {
 		OBJECT_GUARDED_DELETE(time_source, TimeSourceDepsNode);
 	}
@@ -312,6 +318,38 @@ IDDepsNode *Depsgraph::add_id_node(ID *id, const char *name)
 	return id_node;
 }
 
+static void remove_node_relations(DepsNode *node)
+{
+	while (!node->inlinks.empty()) {
+		DepsRelation *rel = node->inlinks.back();
+		rel->unlink();
+		OBJECT_GUARDED_DELETE(rel, DepsRelation);
+	}
+	while (!node->outlinks.empty()) {
+		DepsRelation *rel = node->outlinks.back();
+		rel->unlink();
+		OBJECT_GUARDED_DELETE(rel, DepsRelation);
+	}
+}
+
+void Depsgraph::remove_id_node(IDDepsNode *id_node)
+{
+	remove_node_relations(id_node);
+	GHASH_FOREACH_BEGIN(ComponentDepsNode *, comp_node, id_node->components)
+	{
+		remove_node_relations(comp_node);
+		foreach (OperationDepsNode *op_node, comp_node->operations) {
+			remove_node_relations(op_node);
+			BLI_gset_remove(entry_tags, op_node, NULL);
+			remove_from_vector(&operations, op_node);
+		}
+	}
+	GHASH_FOREACH_END();
+	BLI_ghash_remove(id_hash, id_node->id, NULL, NULL);
+	remove_from_vector(&id_nodes, id_node);
+	id_node_deleter(id_node);
+}
+
 void Depsgraph::clear_id_nodes()
 {
 	BLI_ghash_clear(id_hash, NULL, id_node_deleter);
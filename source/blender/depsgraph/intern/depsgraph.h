@@ -38,9 +38,12 @@
 
 #include "BLI_threads.h"  /* for SpinLock */
 
+#include "DEG_depsgraph_debug.h"
+
 #include "intern/depsgraph_types.h"
 
 struct ID;
+struct Scene;
 struct GHash;
 struct GSet;
 struct PointerRNA;
@@ -115,6 +118,8 @@ struct Depsgraph {
 
 	IDDepsNode *find_id_node(const ID *id) const;
 	IDDepsNode *add_id_node(ID *id, const char *name = "");
+	/* Remove ID node with all its components, operations and relations. */
+	void remove_id_node(IDDepsNode *id_node);
 	void clear_id_nodes();
 
 	/* Add new relationship between two nodes. */
@@ -158,9 +163,17 @@ struct Depsgraph {
 	/* Top-level time source node. */
 	TimeSourceDepsNode *time_source;
 
+	/* Scene the graph was built for. */
+	Scene *scene;
+
 	/* Indicates whether relations needs to be updated. */
 	bool need_update;
 
+	/* IDs which relations are to be updated, when only some of the IDs were
+	 * tagged and the graph can be updated incrementally.
+	 */
+	GSet *relations_update_ids;
+
 	/* Quick-Access Temp Data ............. */
 
 	/* Nodes which have been tagged as "directly modified". */
@@ -172,6 +185,11 @@ struct Depsgraph {
 	/* All operation nodes, sorted in order of single-thread traversal order. */
 	OperationNodes operations;
 
+	/* Incremented by every flush of updates, so components do not need to be
+	 * reset before it.
+	 */
+	uint32_t flush_generation;
+
 	/* Spin lock for threading-critical operations.
 	 * Mainly used by graph evaluation.
 	 */
@@ -182,6 +200,14 @@ struct Depsgraph {
 	/* Visible layers bitfield, used for skipping invisible objects updates. */
 	unsigned int layers;
 
+	/* Debug ............................. */
+
+	/* Timing of the last build, see DEG_stats_build(). */
+	DepsgraphBuildStats build_stats;
+
+	/* Timing of the last evaluation, see DEG_stats_eval(). */
+	DepsgraphEvalStats eval_stats;
+
 	// XXX: additional stuff like eval contexts, mempools for allocating nodes from, etc.
 };
 
@@ -30,6 +30,8 @@
  * Methods for constructing depsgraph.
  */
 
+#include <cstring>
+
 #include "MEM_guardedalloc.h"
 
 #include "BLI_utildefines.h"
@@ -50,12 +52,15 @@ extern "C" {
 #include "BKE_modifier.h"
 } /* extern "C" */
 
+#include "atomic_ops.h"
+
 #include "DEG_depsgraph.h"
 #include "DEG_depsgraph_debug.h"
 #include "DEG_depsgraph_build.h"
 
 #include "builder/deg_builder.h"
 #include "builder/deg_builder_cycle.h"
+#include "builder/deg_builder_incremental.h"
 #include "builder/deg_builder_nodes.h"
 #include "builder/deg_builder_relations.h"
 #include "builder/deg_builder_transitive.h"
@@ -182,7 +187,8 @@ void DEG_add_special_eval_flag(Depsgraph *graph, ID *id, short flag)
 		BLI_assert(!"ID should always be valid");
 		return;
 	}
-	id_node->eval_flags |= flag;
+	/* Might be called by relation builders running in multiple threads. */
+	atomic_fetch_and_or_int32((int32_t *)&id_node->eval_flags, flag);
 }
 
 /* ******************** */
@@ -196,17 +202,21 @@ void DEG_add_special_eval_flag(Depsgraph *graph, ID *id, short flag)
  */
 void DEG_graph_build_from_scene(Depsgraph *graph, Main *bmain, Scene *scene)
 {
-	double start_time;
-	if (G.debug & G_DEBUG_DEPSGRAPH_BUILD) {
-		start_time = PIL_check_seconds_timer();
-	}
-
 	DEG::Depsgraph *deg_graph = reinterpret_cast<DEG::Depsgraph *>(graph);
+	DepsgraphBuildStats *stats = &deg_graph->build_stats;
+	memset(stats, 0, sizeof(*stats));
+	stats->relations_num_threads = 1;
+
+	const double start_time = PIL_check_seconds_timer();
+	double phase_time = start_time;
+
+	deg_graph->scene = scene;
 
 	/* 1) Generate all the nodes in the graph first */
 	DEG::DepsgraphNodeBuilder node_builder(bmain, deg_graph);
 	node_builder.begin_build();
 	node_builder.build_scene(scene);
+	stats->nodes_time = DEG::deg_build_phase_time(&phase_time);
 
 	/* 2) Hook up relationships between operations - to determine evaluation
 	 *    order.
@@ -214,9 +224,11 @@ void DEG_graph_build_from_scene(Depsgraph *graph, Main *bmain, Scene *scene)
 	DEG::DepsgraphRelationBuilder relation_builder(bmain, deg_graph);
 	relation_builder.begin_build();
 	relation_builder.build_scene(scene);
+	stats->relations_time = DEG::deg_build_phase_time(&phase_time);
 
 	/* Detect and solve cycles. */
 	DEG::deg_graph_detect_cycles(deg_graph);
+	stats->cycles_time = DEG::deg_build_phase_time(&phase_time);
 
 	/* 3) Simplify the graph by removing redundant relations (to optimize
 	 *    traversal later). */
@@ -226,9 +238,11 @@ void DEG_graph_build_from_scene(Depsgraph *graph, Main *bmain, Scene *scene)
 	if (G.debug_value == 799) {
 		DEG::deg_graph_transitive_reduction(deg_graph);
 	}
+	stats->transitive_reduction_time = DEG::deg_build_phase_time(&phase_time);
 
 	/* 4) Flush visibility layer and re-schedule nodes for update. */
 	DEG::deg_graph_build_finalize(deg_graph);
+	stats->finalize_time = DEG::deg_build_phase_time(&phase_time);
 
 #if 0
 	if (!DEG_debug_consistency_check(deg_graph)) {
@@ -237,10 +251,45 @@ void DEG_graph_build_from_scene(Depsgraph *graph, Main *bmain, Scene *scene)
 	}
 #endif
 
+	stats->total_time = phase_time - start_time;
+
+	if (G.debug & G_DEBUG_DEPSGRAPH_BUILD) {
+		printf("Depsgraph built in %f seconds.\n", stats->total_time);
+		printf("  Nodes:                %f\n", stats->nodes_time);
+		printf("  Relations:            %f (%d threads)\n",
+		       stats->relations_time, stats->relations_num_threads);
+		printf("  Cycles:               %f\n", stats->cycles_time);
+		printf("  Transitive reduction: %f\n", stats->transitive_reduction_time);
+		printf("  Finalize:             %f\n", stats->finalize_time);
+	}
+}
+
+/* Update relations of the tagged IDs only, returns false if the graph is to
+ * be built from scratch.
+ */
+static bool deg_graph_update_incremental(Main *bmain,
+                                         DEG::Depsgraph *graph,
+                                         Scene *scene)
+{
+	DepsgraphBuildStats *stats = &graph->build_stats;
+	memset(stats, 0, sizeof(*stats));
+	if (!DEG::deg_graph_build_incremental(bmain,
+	                                      graph,
+	                                      scene,
+	                                      graph->relations_update_ids))
+	{
+		DEG_DEBUG_PRINTF(BUILD, "Incremental update not possible, building full graph\n");
+		return false;
+	}
 	if (G.debug & G_DEBUG_DEPSGRAPH_BUILD) {
-		printf("Depsgraph built in %f seconds.\n",
-		       PIL_check_seconds_timer() - start_time);
+		printf("Depsgraph updated %d IDs in %f seconds.\n",
+		       stats->num_rebuilt_ids, stats->total_time);
+		printf("  Nodes:                %f\n", stats->nodes_time);
+		printf("  Relations:            %f\n", stats->relations_time);
+		printf("  Cycles:               %f\n", stats->cycles_time);
+		printf("  Finalize:             %f\n", stats->finalize_time);
 	}
+	return true;
 }
 
 /* Tag graph relations for update. */
@@ -263,6 +312,33 @@ void DEG_relations_tag_update(Main *bmain)
 	}
 }
 
+/* Tag relations of a single ID for update. */
+void DEG_relations_tag_update_id(Main *bmain, ID *id)
+{
+	for (Scene *scene = (Scene *)bmain->scene.first;
+	     scene != NULL;
+	     scene = (Scene *)scene->id.next)
+	{
+		if (scene->depsgraph == NULL) {
+			continue;
+		}
+		DEG::Depsgraph *graph =
+		        reinterpret_cast<DEG::Depsgraph *>(scene->depsgraph);
+		if (graph->need_update) {
+			continue;
+		}
+		/* Only objects which are already in the graph can be updated
+		 * incrementally.
+		 */
+		if (GS(id->name) == ID_OB && graph->find_id_node(id) != NULL) {
+			BLI_gset_add(graph->relations_update_ids, id);
+		}
+		else {
+			graph->need_update = true;
+		}
+	}
+}
+
 /* Create new graph if didn't exist yet,
  * or update relations if graph was tagged for update.
  */
@@ -277,14 +353,23 @@ void DEG_scene_relations_update(Main *bmain, Scene *scene)
 
 	DEG::Depsgraph *graph = reinterpret_cast<DEG::Depsgraph *>(scene->depsgraph);
 	if (!graph->need_update) {
-		/* Graph is up to date, nothing to do. */
-		return;
+		if (BLI_gset_len(graph->relations_update_ids) == 0) {
+			/* Graph is up to date, nothing to do. */
+			return;
+		}
+		if (!(G.debug & G_DEBUG_DEPSGRAPH_NO_INCREMENTAL) &&
+		    deg_graph_update_incremental(bmain, graph, scene))
+		{
+			BLI_gset_clear(graph->relations_update_ids, NULL);
+			return;
+		}
 	}
 
 	/* Clear all previous nodes and operations. */
 	graph->clear_all_nodes();
 	graph->operations.clear();
 	BLI_gset_clear(graph->entry_tags, NULL);
+	BLI_gset_clear(graph->relations_update_ids, NULL);
 
 	/* Build new nodes and relations. */
 	DEG_graph_build_from_scene(reinterpret_cast< ::Depsgraph * >(graph),
@@ -345,7 +430,9 @@ void DEG_add_forcefield_relations(DepsNodeHandle *handle,
                                   int skip_forcefield,
                                   const char *name)
 {
-	ListBase *effectors = pdInitEffectors(scene, object, NULL, effector_weights, false);
+	DEG::DepsNodeHandle *deg_handle = get_handle(handle);
+	ListBase *effectors = deg_handle->builder->find_effectors(
+	        scene, object, NULL, effector_weights);
 	if (effectors == NULL) {
 		return;
 	}
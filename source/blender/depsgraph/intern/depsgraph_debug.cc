@@ -221,3 +221,23 @@ void DEG_stats_simple(const Depsgraph *graph, size_t *r_outer,
 		if (r_outer)     *r_outer     = tot_outer;
 	}
 }
+
+/**
+ * Obtain time spent in each phase of the last build of the depsgraph
+ * \param[out] r_stats  Timing of the build phases
+ */
+void DEG_stats_build(const Depsgraph *graph, DepsgraphBuildStats *r_stats)
+{
+	const DEG::Depsgraph *deg_graph = reinterpret_cast<const DEG::Depsgraph *>(graph);
+	*r_stats = deg_graph->build_stats;
+}
+
+/**
+ * Obtain timing of the last evaluation of the depsgraph
+ * \param[out] r_stats  Timing of the evaluation
+ */
+void DEG_stats_eval(const Depsgraph *graph, DepsgraphEvalStats *r_stats)
+{
+	const DEG::Depsgraph *deg_graph = reinterpret_cast<const DEG::Depsgraph *>(graph);
+	*r_stats = deg_graph->eval_stats;
+}
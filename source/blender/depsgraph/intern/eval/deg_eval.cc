@@ -39,8 +39,14 @@
 #include "BLI_ghash.h"
 
 extern "C" {
+#include "BLI_heap.h"
+#include "BLI_math_base.h"
+
+#include "DNA_object_types.h"
+
 #include "BKE_depsgraph.h"
 #include "BKE_global.h"
+#include "BKE_modifier.h"
 } /* extern "C" */
 
 #include "DEG_depsgraph.h"
@@ -65,10 +71,10 @@ namespace DEG {
 /* Evaluation Entrypoints */
 
 /* Forward declarations. */
+struct DepsgraphEvalState;
 static void schedule_children(TaskPool *pool,
-                              Depsgraph *graph,
+                              DepsgraphEvalState *state,
                               OperationDepsNode *node,
-                              const unsigned int layers,
                               const int thread_id);
 
 struct DepsgraphEvalState {
@@ -76,32 +82,58 @@ struct DepsgraphEvalState {
 	Depsgraph *graph;
 	unsigned int layers;
 	bool do_stats;
+	int num_threads;
+	/* Operations which are ready to be evaluated, ordered by priority. Tasks
+	 * in the pool are not bound to an operation, they evaluate the one with
+	 * the highest priority at the time they run.
+	 */
+	Heap *ready_heap;
+	SpinLock ready_lock;
+	/* Operations in the order they finished evaluating in. */
+	OperationDepsNode **evaluated;
+	uint32_t num_evaluated;
 };
 
+static void operation_finished(DepsgraphEvalState *state,
+                               OperationDepsNode *node)
+{
+	const uint32_t index = atomic_fetch_and_add_uint32(&state->num_evaluated, 1);
+	state->evaluated[index] = node;
+}
+
 static void deg_task_run_func(TaskPool *pool,
-                              void *taskdata,
+                              void *UNUSED(taskdata),
                               int thread_id)
 {
 	void *userdata_v = BLI_task_pool_userdata(pool);
 	DepsgraphEvalState *state = (DepsgraphEvalState *)userdata_v;
-	OperationDepsNode *node = (OperationDepsNode *)taskdata;
+	/* Every task was pushed along with an operation, so there is one. */
+	BLI_spin_lock(&state->ready_lock);
+	OperationDepsNode *node =
+	        (OperationDepsNode *)BLI_heap_pop_min(state->ready_heap);
+	BLI_spin_unlock(&state->ready_lock);
 	/* Sanity checks. */
 	BLI_assert(!node->is_noop() && "NOOP nodes should not actually be scheduled");
-	/* Perform operation. */
-	if (state->do_stats) {
-		const double start_time = PIL_check_seconds_timer();
-		node->evaluate(state->eval_ctx);
-		node->stats.current_time += PIL_check_seconds_timer() - start_time;
-	}
-	else {
-		node->evaluate(state->eval_ctx);
-	}
+	/* Perform operation, timing is always gathered since it is used to
+	 * estimate the cost of the operation in the next evaluations.
+	 */
+	const double start_time = PIL_check_seconds_timer();
+	node->evaluate(state->eval_ctx);
+	node->stats.current_time += PIL_check_seconds_timer() - start_time;
+	operation_finished(state, node);
 	/* Schedule children. */
 	BLI_task_pool_delayed_push_begin(pool, thread_id);
-	schedule_children(pool, state->graph, node, state->layers, thread_id);
+	schedule_children(pool, state, node, thread_id);
 	BLI_task_pool_delayed_push_end(pool, thread_id);
 }
 
+BLI_INLINE bool operation_needs_evaluation(const OperationDepsNode *node,
+                                           const unsigned int layers)
+{
+	return (node->owner->owner->layers & layers) != 0 &&
+	       (node->flag & DEPSOP_FLAG_NEEDS_UPDATE) != 0;
+}
+
 typedef struct CalculatePengindData {
 	Depsgraph *graph;
 	unsigned int layers;
@@ -116,24 +148,18 @@ static void calculate_pending_func(
 	Depsgraph *graph = data->graph;
 	unsigned int layers = data->layers;
 	OperationDepsNode *node = graph->operations[i];
-	IDDepsNode *id_node = node->owner->owner;
 
 	node->num_links_pending = 0;
 	node->scheduled = false;
 
 	/* count number of inputs that need updates */
-	if ((id_node->layers & layers) != 0 &&
-	    (node->flag & DEPSOP_FLAG_NEEDS_UPDATE) != 0)
-	{
+	if (operation_needs_evaluation(node, layers)) {
 		foreach (DepsRelation *rel, node->inlinks) {
 			if (rel->from->type == DEG_NODE_TYPE_OPERATION &&
 			    (rel->flag & DEPSREL_FLAG_CYCLIC) == 0)
 			{
 				OperationDepsNode *from = (OperationDepsNode *)rel->from;
-				IDDepsNode *id_from_node = from->owner->owner;
-				if ((id_from_node->layers & layers) != 0 &&
-				    (from->flag & DEPSOP_FLAG_NEEDS_UPDATE) != 0)
-				{
+				if (operation_needs_evaluation(from, layers)) {
 					++node->num_links_pending;
 				}
 			}
@@ -157,16 +183,56 @@ static void calculate_pending_parents(Depsgraph *graph, unsigned int layers)
 	                        &settings);
 }
 
+/* Priority of an operation is the estimated time of the longest chain of
+ * operations starting at it, so operations on the critical path are started
+ * first. Operations finish after all their parents, so visiting them in the
+ * reverse order they finished in visits children first.
+ *
+ * Priorities are computed after the evaluation for the next one, which
+ * usually evaluates the same operations, when playing back animation for
+ * example. This avoids an extra traversal of the graph before evaluating.
+ *
+ * Operations which evaluate in parallel themselves finish sooner once other
+ * threads become idle, so only part of their cost counts towards the path.
+ * This starts the operations which keep a single thread busy first, and
+ * leaves the threaded ones to fill up the idle threads at the end of the
+ * evaluation rather than competing with them for the cores.
+ */
+static void update_priorities(DepsgraphEvalState *state)
+{
+	for (int i = (int)state->num_evaluated - 1; i >= 0; --i) {
+		OperationDepsNode *node = state->evaluated[i];
+		float priority = 0.0f;
+		foreach (DepsRelation *rel, node->outlinks) {
+			OperationDepsNode *child = (OperationDepsNode *)rel->to;
+			/* Only children which were evaluated have an updated priority. */
+			if (child->scheduled && (rel->flag & DEPSREL_FLAG_CYCLIC) == 0) {
+				priority = max_ff(priority, child->priority);
+			}
+		}
+		/* Modifiers are enabled and disabled without rebuilding the graph,
+		 * so the fraction is updated along with the cost.
+		 */
+		if (node->opcode == DEG_OPCODE_GEOMETRY_UBEREVAL) {
+			Object *object = (Object *)node->owner->owner->id;
+			node->parallel_fraction =
+			        modifiers_getThreadedFraction(state->graph->scene, object);
+		}
+		const float parallel_fraction = node->parallel_fraction;
+		const float cost_factor = (1.0f - parallel_fraction) +
+		                          parallel_fraction / state->num_threads;
+		node->priority = priority +
+		                 deg_eval_stats_operation_cost(node) * cost_factor;
+	}
+}
+
 static void initialize_execution(DepsgraphEvalState *state, Depsgraph *graph)
 {
-	const bool do_stats = state->do_stats;
 	calculate_pending_parents(graph, state->layers);
 	/* Clear tags and other things which needs to be clear. */
 	foreach (OperationDepsNode *node, graph->operations) {
 		node->done = 0;
-		if (do_stats) {
-			node->stats.reset_current();
-		}
+		node->stats.reset_current();
 	}
 }
 
@@ -174,15 +240,11 @@ static void initialize_execution(DepsgraphEvalState *state, Depsgraph *graph)
  *   dec_parents: Decrement pending parents count, true when child nodes are
  *                scheduled after a task has been completed.
  */
-static void schedule_node(TaskPool *pool, Depsgraph *graph, unsigned int layers,
+static void schedule_node(TaskPool *pool, DepsgraphEvalState *state,
                           OperationDepsNode *node, bool dec_parents,
                           const int thread_id)
 {
-	unsigned int id_layers = node->owner->owner->layers;
-
-	if ((node->flag & DEPSOP_FLAG_NEEDS_UPDATE) != 0 &&
-	    (id_layers & layers) != 0)
-	{
+	if (operation_needs_evaluation(node, state->layers)) {
 		if (dec_parents) {
 			BLI_assert(node->num_links_pending > 0);
 			atomic_sub_and_fetch_uint32(&node->num_links_pending, 1);
@@ -194,13 +256,17 @@ static void schedule_node(TaskPool *pool, Depsgraph *graph, unsigned int layers,
 			if (!is_scheduled) {
 				if (node->is_noop()) {
 					/* skip NOOP node, schedule children right away */
-					schedule_children(pool, graph, node, layers, thread_id);
+					operation_finished(state, node);
+					schedule_children(pool, state, node, thread_id);
 				}
 				else {
 					/* children are scheduled once this task is completed */
+					BLI_spin_lock(&state->ready_lock);
+					BLI_heap_insert(state->ready_heap, -node->priority, node);
+					BLI_spin_unlock(&state->ready_lock);
 					BLI_task_pool_push_from_thread(pool,
 					                               deg_task_run_func,
-					                               node,
+					                               NULL,
 					                               false,
 					                               TASK_PRIORITY_HIGH,
 					                               thread_id);
@@ -210,19 +276,16 @@ static void schedule_node(TaskPool *pool, Depsgraph *graph, unsigned int layers,
 	}
 }
 
-static void schedule_graph(TaskPool *pool,
-                           Depsgraph *graph,
-                           const unsigned int layers)
+static void schedule_graph(TaskPool *pool, DepsgraphEvalState *state)
 {
-	foreach (OperationDepsNode *node, graph->operations) {
-		schedule_node(pool, graph, layers, node, false, 0);
+	foreach (OperationDepsNode *node, state->graph->operations) {
+		schedule_node(pool, state, node, false, 0);
 	}
 }
 
 static void schedule_children(TaskPool *pool,
-                              Depsgraph *graph,
+                              DepsgraphEvalState *state,
                               OperationDepsNode *node,
-                              const unsigned int layers,
                               const int thread_id)
 {
 	foreach (DepsRelation *rel, node->outlinks) {
@@ -233,8 +296,7 @@ static void schedule_children(TaskPool *pool,
 			continue;
 		}
 		schedule_node(pool,
-		              graph,
-		              layers,
+		              state,
 		              child,
 		              (rel->flag & DEPSREL_FLAG_CYCLIC) == 0,
 		              thread_id);
@@ -266,11 +328,16 @@ void deg_evaluate_on_refresh(EvaluationContext *eval_ctx,
 	const bool do_time_debug = ((G.debug & G_DEBUG_DEPSGRAPH_TIME) != 0);
 	const double start_time = do_time_debug ? PIL_check_seconds_timer() : 0;
 	/* Set up evaluation context for depsgraph itself. */
+	vector<OperationDepsNode *> evaluated(graph->operations.size());
 	DepsgraphEvalState state;
 	state.eval_ctx = eval_ctx;
 	state.graph = graph;
 	state.layers = layers;
 	state.do_stats = do_time_debug;
+	state.ready_heap = BLI_heap_new();
+	BLI_spin_init(&state.ready_lock);
+	state.evaluated = evaluated.data();
+	state.num_evaluated = 0;
 	/* Set up task scheduler and pull for threaded evaluation. */
 	TaskScheduler *task_scheduler;
 	bool need_free_scheduler;
@@ -282,18 +349,33 @@ void deg_evaluate_on_refresh(EvaluationContext *eval_ctx,
 		task_scheduler = BLI_task_scheduler_get();
 		need_free_scheduler = false;
 	}
+	const int num_threads = BLI_task_scheduler_num_threads(task_scheduler);
+	state.num_threads = num_threads;
 	TaskPool *task_pool = BLI_task_pool_create_suspended(task_scheduler, &state);
 	/* Prepare all nodes for evaluation. */
 	initialize_execution(&state, graph);
 	/* Do actual evaluation now. */
-	schedule_graph(task_pool, graph, layers);
+	const double eval_start_time = PIL_check_seconds_timer();
+	schedule_graph(task_pool, &state);
 	BLI_task_pool_work_and_wait(task_pool);
+	const double eval_time = PIL_check_seconds_timer() - eval_start_time;
 	BLI_task_pool_free(task_pool);
+	BLI_assert(BLI_heap_is_empty(state.ready_heap));
+	BLI_heap_free(state.ready_heap, NULL);
+	BLI_spin_end(&state.ready_lock);
+	/* Update cost estimates and priorities for the next evaluations. */
+	deg_eval_stats_update_costs(state.evaluated, state.num_evaluated);
+	update_priorities(&state);
 	/* Finalize statistics gathering. This is because we only gather single
 	 * operation timing here, without aggregating anything to avoid any extra
 	 * synchronization.
 	 */
 	if (state.do_stats) {
+		deg_eval_stats_evaluation(graph,
+		                          state.evaluated,
+		                          state.num_evaluated,
+		                          eval_time,
+		                          num_threads);
 		deg_eval_stats_aggregate(graph);
 	}
 	/* Clear any uncleared tags - just in case. */
@@ -302,8 +384,14 @@ void deg_evaluate_on_refresh(EvaluationContext *eval_ctx,
 		BLI_task_scheduler_free(task_scheduler);
 	}
 	if (do_time_debug) {
+		const DepsgraphEvalStats *stats = &graph->eval_stats;
 		printf("Depsgraph updated in %f seconds.\n",
 		       PIL_check_seconds_timer() - start_time);
+		printf("  Operations:           %d in %f seconds\n",
+		       stats->num_operations, stats->operations_time);
+		printf("  Critical path:        %f\n", stats->critical_path_time);
+		printf("  Utilization:          %.1f%% of %d threads\n",
+		       stats->utilization * 100.0f, stats->num_threads);
 	}
 }
 
@@ -32,9 +32,6 @@
 
 #include "intern/eval/deg_eval_flush.h"
 
-// TODO(sergey): Use some sort of wrapper.
-#include <deque>
-
 #include "BLI_utildefines.h"
 #include "BLI_task.h"
 #include "BLI_ghash.h"
@@ -45,6 +42,8 @@ extern "C" {
 
 #include "DEG_depsgraph.h"
 
+#include "atomic_ops.h"
+
 #include "intern/nodes/deg_node.h"
 #include "intern/nodes/deg_node_component.h"
 #include "intern/nodes/deg_node_id.h"
@@ -55,18 +54,37 @@ extern "C" {
 
 namespace DEG {
 
-enum {
-	ID_STATE_NONE     = 0,
-	ID_STATE_MODIFIED = 1,
-};
+/* Number of operations a flush task keeps to itself, further operations it
+ * reaches are pushed to the task pool so other threads can pick them up.
+ */
+#define FLUSH_LOCAL_STACK_SIZE 16
+/* Number of tagged entry operations handled by a single flush task. */
+#define FLUSH_ENTRY_CHUNK_SIZE 64
+
+#define COMPONENT_TYPE_BIT(type) (1u << (type))
 
-enum {
-	COMPONENT_STATE_NONE      = 0,
-	COMPONENT_STATE_SCHEDULED = 1,
-	COMPONENT_STATE_DONE      = 2,
+/* Components which only affect the object itself and not its data. */
+#define OBJECT_NON_DATA_COMPONENTS (COMPONENT_TYPE_BIT(DEG_NODE_TYPE_ANIMATION) | \
+                                    COMPONENT_TYPE_BIT(DEG_NODE_TYPE_TRANSFORM) | \
+                                    COMPONENT_TYPE_BIT(DEG_NODE_TYPE_PARAMETERS))
+
+BLI_STATIC_ASSERT(NUM_DEG_NODE_TYPES <= 32, "Component types must fit into bitmask");
+
+struct FlushState {
+	Depsgraph *graph;
+	/* Generation of this flush, see Depsgraph::flush_generation. */
+	uint32_t generation;
+	/* Operations tagged for update, flush starts from them. */
+	vector<OperationDepsNode *> entry_operations;
 };
 
-typedef std::deque<OperationDepsNode *> FlushQueue;
+/* Operations to be handled by a flush task. */
+struct FlushTaskStack {
+	TaskPool *pool;
+	int thread_id;
+	OperationDepsNode *operations[FLUSH_LOCAL_STACK_SIZE];
+	int num_operations;
+};
 
 namespace {
 
@@ -93,109 +111,93 @@ void flush_init_operation_node_func(
 	node->scheduled = false;
 }
 
-void flush_init_id_node_func(
-        void *__restrict data_v,
-        const int i,
-        const ParallelRangeTLS *__restrict /*tls*/)
+/* Component and ID nodes are not reset here, components are flushed once per
+ * generation and ID nodes are reset as soon as their changes are handled.
+ */
+BLI_INLINE void flush_prepare(Depsgraph *graph)
 {
-	Depsgraph *graph = (Depsgraph *)data_v;
-	IDDepsNode *id_node = graph->id_nodes[i];
-	id_node->done = ID_STATE_NONE;
-	GHASH_FOREACH_BEGIN(ComponentDepsNode *, comp_node, id_node->components)
-		comp_node->done = COMPONENT_STATE_NONE;
-	GHASH_FOREACH_END();
+	const int num_operations = graph->operations.size();
+	ParallelRangeSettings settings;
+	BLI_parallel_range_settings_defaults(&settings);
+	settings.min_iter_per_thread = 1024;
+	BLI_task_parallel_range(0, num_operations,
+	                        graph,
+	                        flush_init_operation_node_func,
+	                        &settings);
 }
 
-BLI_INLINE void flush_prepare(Depsgraph *graph)
+void flush_task_run(TaskPool *__restrict pool, void *taskdata, int thread_id);
+
+/* Mark operation as scheduled for flush, returns false if it already was. */
+BLI_INLINE bool flush_operation_try_schedule(OperationDepsNode *op_node)
 {
-	{
-		const int num_operations = graph->operations.size();
-		ParallelRangeSettings settings;
-		BLI_parallel_range_settings_defaults(&settings);
-		settings.min_iter_per_thread = 1024;
-		BLI_task_parallel_range(0, num_operations,
-		                        graph,
-		                        flush_init_operation_node_func,
-		                        &settings);
+	if (op_node->scheduled) {
+		return false;
 	}
-	{
-		const int num_id_nodes = graph->id_nodes.size();
-		ParallelRangeSettings settings;
-		BLI_parallel_range_settings_defaults(&settings);
-		settings.min_iter_per_thread = 1024;
-		BLI_task_parallel_range(0, num_id_nodes,
-		                        graph,
-		                        flush_init_id_node_func,
-		                        &settings);
+	return !atomic_fetch_and_or_uint8((uint8_t *)&op_node->scheduled,
+	                                  (uint8_t)true);
+}
+
+BLI_INLINE void flush_operation_tag(OperationDepsNode *op_node)
+{
+	if ((op_node->flag & DEPSOP_FLAG_NEEDS_UPDATE) == 0) {
+		atomic_fetch_and_or_uint32((uint32_t *)&op_node->flag,
+		                           DEPSOP_FLAG_NEEDS_UPDATE);
 	}
 }
 
-BLI_INLINE void flush_schedule_entrypoints(Depsgraph *graph, FlushQueue *queue)
+BLI_INLINE void flush_stack_push(FlushTaskStack *stack,
+                                 OperationDepsNode *op_node)
 {
-	GSET_FOREACH_BEGIN(OperationDepsNode *, op_node, graph->entry_tags)
-	{
-		queue->push_back(op_node);
-		op_node->scheduled = true;
+	if (stack->num_operations < FLUSH_LOCAL_STACK_SIZE) {
+		stack->operations[stack->num_operations++] = op_node;
+	}
+	else {
+		BLI_task_pool_push_from_thread(stack->pool,
+		                               flush_task_run,
+		                               op_node,
+		                               false,
+		                               TASK_PRIORITY_HIGH,
+		                               stack->thread_id);
+	}
+}
+
+BLI_INLINE void flush_handle_id_node(IDDepsNode *id_node,
+                                     ComponentDepsNode *comp_node)
+{
+	const uint32_t type_bit = COMPONENT_TYPE_BIT(comp_node->type);
+	if ((id_node->flushed_components & type_bit) == 0) {
+		atomic_fetch_and_or_uint32(&id_node->flushed_components, type_bit);
 	}
-	GSET_FOREACH_END();
 }
 
-BLI_INLINE void flush_handle_id_node(IDDepsNode *id_node)
+/* Returns true when this is the first time the component is reached by the
+ * flush, only one thread gets to handle it then.
+ */
+BLI_INLINE bool flush_component_try_claim(const FlushState *state,
+                                          ComponentDepsNode *comp_node)
 {
-	id_node->done = ID_STATE_MODIFIED;
+	const uint32_t generation = comp_node->flush_generation;
+	if (generation == state->generation) {
+		return false;
+	}
+	return atomic_cas_uint32(&comp_node->flush_generation,
+	                         generation,
+	                         state->generation) == generation;
 }
 
-/* TODO(sergey): We can reduce number of arguments here. */
-BLI_INLINE void flush_handle_component_node(Depsgraph * /*graph*/,
+BLI_INLINE void flush_handle_component_node(const FlushState *state,
                                             IDDepsNode *id_node,
                                             ComponentDepsNode *comp_node,
-                                            FlushQueue *queue)
+                                            FlushTaskStack *stack)
 {
 	/* We only handle component once. */
-	if (comp_node->done == COMPONENT_STATE_DONE) {
+	if (!flush_component_try_claim(state, comp_node)) {
 		return;
 	}
-	comp_node->done = COMPONENT_STATE_DONE;
 	/* Tag all required operations in component for update.  */
 	foreach (OperationDepsNode *op, comp_node->operations) {
-		op->flag |= DEPSOP_FLAG_NEEDS_UPDATE;
-	}
-	if (GS(id_node->id->name) == ID_OB) {
-		Object *object = (Object *)id_node->id;
-		/* This code is used to preserve those areas which does
-		 * direct object update,
-		 *
-		 * Plus it ensures visibility changes and relations and
-		 * layers visibility update has proper flags to work with.
-		 */
-		switch (comp_node->type) {
-			case DEG_NODE_TYPE_UNDEFINED:
-			case DEG_NODE_TYPE_OPERATION:
-			case DEG_NODE_TYPE_TIMESOURCE:
-			case DEG_NODE_TYPE_ID_REF:
-			case DEG_NODE_TYPE_SEQUENCER:
-			case NUM_DEG_NODE_TYPES:
-				/* Ignore, does not translate to object component. */
-				BLI_assert(!"This should never happen!");
-				break;
-			case DEG_NODE_TYPE_ANIMATION:
-				object->recalc |= OB_RECALC_TIME;
-				break;
-			case DEG_NODE_TYPE_TRANSFORM:
-				object->recalc |= OB_RECALC_OB;
-				break;
-			case DEG_NODE_TYPE_GEOMETRY:
-			case DEG_NODE_TYPE_EVAL_POSE:
-			case DEG_NODE_TYPE_BONE:
-			case DEG_NODE_TYPE_EVAL_PARTICLES:
-			case DEG_NODE_TYPE_SHADING:
-			case DEG_NODE_TYPE_CACHE:
-			case DEG_NODE_TYPE_PROXY:
-				object->recalc |= OB_RECALC_DATA;
-				break;
-			case DEG_NODE_TYPE_PARAMETERS:
-				break;
-		}
+		flush_operation_tag(op);
 	}
 	/* When some target changes bone, we might need to re-run the
 	 * whole IK solver, otherwise result might be unpredictable.
@@ -204,22 +206,23 @@ BLI_INLINE void flush_handle_component_node(Depsgraph * /*graph*/,
 		ComponentDepsNode *pose_comp =
 		        id_node->find_component(DEG_NODE_TYPE_EVAL_POSE);
 		BLI_assert(pose_comp != NULL);
-		if (pose_comp->done == COMPONENT_STATE_NONE) {
-			queue->push_front(pose_comp->get_entry_operation());
-			pose_comp->done = COMPONENT_STATE_SCHEDULED;
+		OperationDepsNode *pose_entry = pose_comp->get_entry_operation();
+		if (pose_comp->flush_generation != state->generation &&
+		    flush_operation_try_schedule(pose_entry))
+		{
+			flush_stack_push(stack, pose_entry);
 		}
 	}
 }
 
 /* Schedule children of the given operation node for traversal.
  *
- * One of the children will by-pass the queue and will be returned as a function
- * return value, so it can start being handled right away, without building too
- * much of a queue.
+ * One of the children will by-pass the stack and will be returned as a
+ * function return value, so it can start being handled right away.
  */
 BLI_INLINE OperationDepsNode *flush_schedule_children(
         OperationDepsNode *op_node,
-        FlushQueue *queue)
+        FlushTaskStack *stack)
 {
 	OperationDepsNode *result = NULL;
 	foreach (DepsRelation *rel, op_node->outlinks) {
@@ -227,32 +230,142 @@ BLI_INLINE OperationDepsNode *flush_schedule_children(
 			continue;
 		}
 		OperationDepsNode *to_node = (OperationDepsNode *)rel->to;
-		if (to_node->scheduled == false) {
+		if (flush_operation_try_schedule(to_node)) {
 			if (result != NULL) {
-				queue->push_front(to_node);
+				flush_stack_push(stack, to_node);
 			}
 			else {
 				result = to_node;
 			}
-			to_node->scheduled = true;
 		}
 	}
 	return result;
 }
 
+BLI_INLINE void flush_operation_chain(const FlushState *state,
+                                     OperationDepsNode *op_node,
+                                     FlushTaskStack *stack)
+{
+	while (op_node != NULL) {
+		/* Tag operation as required for update. */
+		flush_operation_tag(op_node);
+		/* Inform corresponding ID and component nodes about the change. */
+		ComponentDepsNode *comp_node = op_node->owner;
+		IDDepsNode *id_node = comp_node->owner;
+		flush_handle_id_node(id_node, comp_node);
+		flush_handle_component_node(state, id_node, comp_node, stack);
+		/* Flush to nodes along links. */
+		op_node = flush_schedule_children(op_node, stack);
+	}
+}
+
+BLI_INLINE void flush_stack_run(const FlushState *state, FlushTaskStack *stack)
+{
+	while (stack->num_operations != 0) {
+		OperationDepsNode *op_node = stack->operations[--stack->num_operations];
+		flush_operation_chain(state, op_node, stack);
+	}
+}
+
+/* Flush from a single operation, pushed by a task which had too much to do. */
+void flush_task_run(TaskPool *__restrict pool, void *taskdata, int thread_id)
+{
+	const FlushState *state = (const FlushState *)BLI_task_pool_userdata(pool);
+	FlushTaskStack stack;
+	stack.pool = pool;
+	stack.thread_id = thread_id;
+	stack.num_operations = 0;
+	flush_operation_chain(state, (OperationDepsNode *)taskdata, &stack);
+	flush_stack_run(state, &stack);
+}
+
+/* Flush from a chunk of the entry operations. */
+void flush_entry_task_run(TaskPool *__restrict pool, void *taskdata, int thread_id)
+{
+	const FlushState *state = (const FlushState *)BLI_task_pool_userdata(pool);
+	const int start = GET_INT_FROM_POINTER(taskdata);
+	const int end = std::min((int)state->entry_operations.size(),
+	                         start + FLUSH_ENTRY_CHUNK_SIZE);
+	FlushTaskStack stack;
+	stack.pool = pool;
+	stack.thread_id = thread_id;
+	stack.num_operations = 0;
+	for (int i = start; i < end; ++i) {
+		flush_operation_chain(state, state->entry_operations[i], &stack);
+		flush_stack_run(state, &stack);
+	}
+}
+
+BLI_INLINE void flush_schedule_entrypoints(FlushState *state, TaskPool *pool)
+{
+	const int thread_id = BLI_task_pool_creator_thread_id(pool);
+	Depsgraph *graph = state->graph;
+	state->entry_operations.reserve(BLI_gset_len(graph->entry_tags));
+	GSET_FOREACH_BEGIN(OperationDepsNode *, op_node, graph->entry_tags)
+	{
+		op_node->scheduled = true;
+		state->entry_operations.push_back(op_node);
+	}
+	GSET_FOREACH_END();
+	const int num_entries = state->entry_operations.size();
+	for (int i = 0; i < num_entries; i += FLUSH_ENTRY_CHUNK_SIZE) {
+		BLI_task_pool_push_from_thread(pool,
+		                               flush_entry_task_run,
+		                               SET_INT_IN_POINTER(i),
+		                               false,
+		                               TASK_PRIORITY_HIGH,
+		                               thread_id);
+	}
+}
+
+/* Translate flushed components to the recalc flags of the object. This is
+ * used to preserve those areas which does direct object update.
+ *
+ * Plus it ensures visibility changes and relations and layers visibility
+ * update has proper flags to work with.
+ */
+BLI_INLINE void flush_object_recalc(Object *object,
+                                    const uint32_t flushed_components)
+{
+	if (flushed_components & COMPONENT_TYPE_BIT(DEG_NODE_TYPE_ANIMATION)) {
+		object->recalc |= OB_RECALC_TIME;
+	}
+	if (flushed_components & COMPONENT_TYPE_BIT(DEG_NODE_TYPE_TRANSFORM)) {
+		object->recalc |= OB_RECALC_OB;
+	}
+	if (flushed_components & ~OBJECT_NON_DATA_COMPONENTS) {
+		object->recalc |= OB_RECALC_DATA;
+	}
+}
+
 BLI_INLINE void flush_editors_id_update(Main *bmain,
                                         Depsgraph *graph)
 {
 	foreach (IDDepsNode *id_node, graph->id_nodes) {
-		if (id_node->done != ID_STATE_MODIFIED) {
+		const uint32_t flushed_components = id_node->flushed_components;
+		if (flushed_components == 0) {
 			continue;
 		}
+		id_node->flushed_components = 0;
 		/* TODO(sergey): Do we need to pass original or evaluated ID here? */
 		ID *id = id_node->id;
 		deg_editors_id_update(bmain, id);
 		lib_id_recalc_tag(bmain, id);
-		/* TODO(sergey): For until we've got proper data nodes in the graph. */
-		lib_id_recalc_data_tag(bmain, id);
+		if (GS(id->name) == ID_OB) {
+			/* Only tag object data when its data components changed, same
+			 * as the legacy depsgraph does.
+			 */
+			flush_object_recalc((Object *)id, flushed_components);
+			if (flushed_components & ~OBJECT_NON_DATA_COMPONENTS) {
+				lib_id_recalc_data_tag(bmain, id);
+			}
+		}
+		else {
+			/* TODO(sergey): For until we've got proper data nodes in the
+			 * graph.
+			 */
+			lib_id_recalc_data_tag(bmain, id);
+		}
 	}
 }
 
@@ -260,6 +373,10 @@ BLI_INLINE void flush_editors_id_update(Main *bmain,
 
 /* Flush updates from tagged nodes outwards until all affected nodes
  * are tagged.
+ *
+ * Flush is done in parallel, every task follows a chain of operations and
+ * hands over branches to other threads. Operations, components and IDs are
+ * claimed atomically, so each of them is only handled once.
  */
 void deg_graph_flush_updates(Main *bmain, Depsgraph *graph)
 {
@@ -272,28 +389,20 @@ void deg_graph_flush_updates(Main *bmain, Depsgraph *graph)
 	}
 	/* Reset all flags, get ready for the flush. */
 	flush_prepare(graph);
+	FlushState state;
+	state.graph = graph;
+	state.generation = ++graph->flush_generation;
+	if (state.generation == 0) {
+		/* Zero is the generation of components which were never flushed. */
+		state.generation = ++graph->flush_generation;
+	}
 	/* Starting from the tagged "entry" nodes, flush outwards. */
-	FlushQueue queue;
-	flush_schedule_entrypoints(graph, &queue);
+	TaskScheduler *task_scheduler = BLI_task_scheduler_get();
+	TaskPool *task_pool = BLI_task_pool_create_suspended(task_scheduler, &state);
+	flush_schedule_entrypoints(&state, task_pool);
 	/* Do actual flush. */
-	while (!queue.empty()) {
-		OperationDepsNode *op_node = queue.front();
-		queue.pop_front();
-		while (op_node != NULL) {
-			/* Tag operation as required for update. */
-			op_node->flag |= DEPSOP_FLAG_NEEDS_UPDATE;
-			/* Inform corresponding ID and component nodes about the change. */
-			ComponentDepsNode *comp_node = op_node->owner;
-			IDDepsNode *id_node = comp_node->owner;
-			flush_handle_id_node(id_node);
-			flush_handle_component_node(graph,
-			                            id_node,
-			                            comp_node,
-			                            &queue);
-			/* Flush to nodes along links. */
-			op_node = flush_schedule_children(op_node, &queue);
-		}
-	}
+	BLI_task_pool_work_and_wait(task_pool);
+	BLI_task_pool_free(task_pool);
 	/* Inform editors about all changes. */
 	flush_editors_id_update(bmain, graph);
 }
@@ -44,6 +44,17 @@
 
 namespace DEG {
 
+/* Cost of operations which were never evaluated yet. */
+#define OPERATION_DEFAULT_COST 1e-5f
+/* Scheduling overhead of an operation, so long chains of cheap operations are
+ * not considered to be free.
+ */
+#define OPERATION_OVERHEAD_COST 1e-6f
+/* Weight of the latest timing in the running average once it is warmed up,
+ * lower values are more stable, higher values adapt faster to changes.
+ */
+#define AVERAGE_TIME_WEIGHT 0.2
+
 void deg_eval_stats_aggregate(Depsgraph *graph)
 {
 	/* Reset current evaluation stats for ID and component nodes.
@@ -67,4 +78,84 @@ void deg_eval_stats_aggregate(Depsgraph *graph)
 	}
 }
 
+float deg_eval_stats_operation_cost(const OperationDepsNode *node)
+{
+	if (node->is_noop()) {
+		return 0.0f;
+	}
+	if (node->stats.num_evaluations == 0) {
+		return OPERATION_DEFAULT_COST;
+	}
+	return (float)node->stats.average_time + OPERATION_OVERHEAD_COST;
+}
+
+void deg_eval_stats_update_costs(OperationDepsNode **operations,
+                                 const int num_operations)
+{
+	for (int i = 0; i < num_operations; ++i) {
+		OperationDepsNode *node = operations[i];
+		DepsNode::Stats *stats = &node->stats;
+		if (node->is_noop()) {
+			continue;
+		}
+		/* Plain average for the first evaluations, so the estimate settles
+		 * quickly, then a running one to follow changes in the scene.
+		 */
+		const double weight = std::max(1.0 / (stats->num_evaluations + 1),
+		                               AVERAGE_TIME_WEIGHT);
+		stats->average_time += (stats->current_time - stats->average_time) * weight;
+		stats->num_evaluations++;
+	}
+}
+
+void deg_eval_stats_evaluation(Depsgraph *graph,
+                               OperationDepsNode **operations,
+                               const int num_operations,
+                               const double total_time,
+                               const int num_threads)
+{
+	DepsgraphEvalStats *stats = &graph->eval_stats;
+	stats->total_time = total_time;
+	stats->operations_time = 0.0;
+	stats->critical_path_time = 0.0;
+	stats->num_threads = num_threads;
+	stats->num_operations = num_operations;
+	/* Parents always finish before their children, so the longest path ending
+	 * at every parent is known by the time its child is visited. The done tag
+	 * is expected to be cleared by the evaluation.
+	 */
+	vector<double> path_time(num_operations);
+	for (int i = 0; i < num_operations; ++i) {
+		OperationDepsNode *node = operations[i];
+		double parent_path_time = 0.0;
+		foreach (DepsRelation *rel, node->inlinks) {
+			if (rel->from->type != DEG_NODE_TYPE_OPERATION ||
+			    (rel->flag & DEPSREL_FLAG_CYCLIC) != 0)
+			{
+				continue;
+			}
+			/* Index of evaluated parents is stored with an offset of one,
+			 * parents which were not evaluated have zero.
+			 */
+			const int parent_index = rel->from->done;
+			if (parent_index != 0) {
+				parent_path_time = std::max(parent_path_time,
+				                            path_time[parent_index - 1]);
+			}
+		}
+		path_time[i] = parent_path_time + node->stats.current_time;
+		stats->critical_path_time = std::max(stats->critical_path_time,
+		                                     path_time[i]);
+		stats->operations_time += node->stats.current_time;
+		node->done = i + 1;
+	}
+	if (total_time > 0.0 && num_threads > 0) {
+		stats->utilization = (float)(stats->operations_time /
+		                             (total_time * num_threads));
+	}
+	else {
+		stats->utilization = 0.0f;
+	}
+}
+
 }  // namespace DEG
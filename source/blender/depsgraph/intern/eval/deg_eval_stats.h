@@ -33,8 +33,30 @@
 namespace DEG {
 
 struct Depsgraph;
+struct OperationDepsNode;
 
 /* Aggregate operation timings to overall component and ID nodes timing. */
 void deg_eval_stats_aggregate(Depsgraph *graph);
 
+/* Estimated time needed to evaluate the operation, in seconds, based on the
+ * timing of its previous evaluations.
+ */
+float deg_eval_stats_operation_cost(const OperationDepsNode *node);
+
+/* Add timing of the evaluated operations to their average time, which is used
+ * to estimate their cost in the next evaluations.
+ */
+void deg_eval_stats_update_costs(OperationDepsNode **operations,
+                                 const int num_operations);
+
+/* Fill in the evaluation stats of the graph: time spent in operations, the
+ * critical path and utilization of threads. Operations are expected in the
+ * order they finished evaluating in.
+ */
+void deg_eval_stats_evaluation(Depsgraph *graph,
+                               OperationDepsNode **operations,
+                               const int num_operations,
+                               const double total_time,
+                               const int num_threads);
+
 }  // namespace DEG
@@ -69,6 +69,8 @@ DepsNode::Stats::Stats()
 void DepsNode::Stats::reset()
 {
 	current_time = 0.0;
+	average_time = 0.0;
+	num_evaluations = 0;
 }
 
 void DepsNode::Stats::reset_current()
@@ -68,6 +68,12 @@ struct DepsNode {
 		void reset_current();
 		/* Time spend on this node during current graph evaluation. */
 		double current_time;
+		/* Running average of the time spent on this node, over the
+		 * evaluations it took part in.
+		 */
+		double average_time;
+		/* Number of evaluations which contributed to the average time. */
+		int num_evaluations;
 	};
 	/* Relationships between nodes
 	 * The reason why all depsgraph nodes are descended from this type (apart
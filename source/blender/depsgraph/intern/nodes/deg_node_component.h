@@ -150,6 +150,11 @@ struct ComponentDepsNode : public DepsNode {
 
 	/* Temporary bitmask, used during graph construction. */
 	unsigned int layers;
+
+	/* Generation of the last flush of updates which reached this component,
+	 * see Depsgraph::flush_generation.
+	 */
+	uint32_t flush_generation;
 };
 
 /* ---------------------------------------- */
@@ -100,6 +100,7 @@ void IDDepsNode::init(const ID *id, const char *UNUSED(subdata))
 	this->id = (ID *)id;
 	this->layers = (1 << 20) - 1;
 	this->eval_flags = 0;
+	this->flushed_components = 0;
 
 	/* For object we initialize layers to layer from base. */
 	if (GS(id->name) == ID_OB) {
@@ -73,6 +73,11 @@ struct IDDepsNode : public DepsNode {
 	 */
 	int eval_flags;
 
+	/* Bitmask of component types reached by the current flush of updates,
+	 * cleared once the changes of this ID are handled.
+	 */
+	uint32_t flushed_components;
+
 	DEG_DEPSNODE_DECLARE;
 };
 
@@ -45,6 +45,8 @@ namespace DEG {
 /* Inner Nodes */
 
 OperationDepsNode::OperationDepsNode() :
+    priority(0.0f),
+    parallel_fraction(0.0f),
     flag(0),
     customdata_mask(0)
 {
@@ -78,6 +78,19 @@ struct OperationDepsNode : public DepsNode {
 	uint32_t num_links_pending;
 	bool scheduled;
 
+	/* Estimated time needed to evaluate this operation and the longest chain
+	 * of operations depending on it, in seconds. Operations with the highest
+	 * priority are evaluated first.
+	 */
+	float priority;
+
+	/* Fraction of the operation which evaluates in parallel on its own, in
+	 * the 0..1 range. Used to start operations which keep a single thread
+	 * busy before the ones which can use idle threads at the end.
+	 * Updated after each evaluation of the operation, see update_priorities().
+	 */
+	float parallel_fraction;
+
 	/* Identifier for the operation being performed. */
 	eDepsOperation_Code opcode;
 
@@ -2767,6 +2767,10 @@ void init_userdef_do_versions(Main *bmain)
 		U.uiflag |= USER_LOCK_CURSOR_ADJUST;
 	}
 
+	if (!USER_VERSION_ATLEAST(279, 7)) {
+		U.modcachelimit = 256;
+	}
+
 	/**
 	 * Include next version bump.
 	 */
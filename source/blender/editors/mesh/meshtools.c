@@ -359,6 +359,7 @@ int join_mesh_exec(bContext *C, wmOperator *op)
 
 		/* for all keys in old block, clear data-arrays */
 		for (kb = key->block.first; kb; kb = kb->next) {
+			BKE_keyblock_sparse_free(kb);
 			if (kb->data) MEM_freeN(kb->data);
 			kb->data = MEM_callocN(sizeof(float) * 3 * totvert, "join_shapekey");
 			kb->totelem = totvert;
@@ -424,6 +424,7 @@ static int data_transfer_exec(bContext *C, wmOperator *op)
 		}
 
 		DAG_id_tag_update(&ob_dst->id, OB_RECALC_DATA);
+		DAG_id_tag_update(ob_dst->data, 0);
 
 		if (reverse_transfer) {
 			SWAP(Object *, ob_src, ob_dst);
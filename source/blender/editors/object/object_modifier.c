@@ -172,7 +172,13 @@ ModifierData *ED_object_modifier_add(ReportList *reports, Main *bmain, Scene *sc
 	}
 
 	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
-	DAG_relations_tag_update(bmain);
+	if (ELEM(type, eModifierType_Collision, eModifierType_Smoke, eModifierType_DynamicPaint)) {
+		/* Other objects look for colliders, smoke flows and paint brushes in the whole scene. */
+		DAG_relations_tag_update(bmain);
+	}
+	else {
+		DAG_relations_tag_update_id(bmain, &ob->id);
+	}
 
 	return new_md;
 }
@@ -342,7 +348,7 @@ bool ED_object_modifier_remove(ReportList *reports, Main *bmain, Object *ob, Mod
 	}
 
 	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
-	DAG_relations_tag_update(bmain);
+	DAG_relations_tag_update_id(bmain, &ob->id);
 
 	return 1;
 }
@@ -366,7 +372,7 @@ void ED_object_modifier_clear(Main *bmain, Object *ob)
 	}
 
 	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
-	DAG_relations_tag_update(bmain);
+	DAG_relations_tag_update_id(bmain, &ob->id);
 }
 
 int ED_object_modifier_move_up(ReportList *reports, Object *ob, ModifierData *md)
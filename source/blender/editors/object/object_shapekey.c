@@ -124,6 +124,8 @@ static bool object_shape_key_mirror(bContext *C, Object *ob,
 	if (kb) {
 		char *tag_elem = MEM_callocN(sizeof(char) * kb->totelem, "shape_key_mirror");
 
+		BKE_key_sparse_free(key);
+
 
 		if (ob->type == OB_MESH) {
 			Mesh *me = ob->data;
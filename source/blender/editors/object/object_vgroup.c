@@ -836,6 +836,14 @@ static void ED_vgroup_nr_vert_add(
 	}
 }
 
+/* Weights are changed in place in the object data, tag it too so caches of them
+ * (e.g. the armature modifier's) are rebuilt, also for other users of the data. */
+static void vgroup_tag_update(Object *ob)
+{
+	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+	DAG_id_tag_update(ob->data, OB_RECALC_DATA);
+}
+
 /* called while not in editmode */
 void ED_vgroup_vert_add(Object *ob, bDeformGroup *dg, int vertnum, float weight, int assignmode)
 {
@@ -860,6 +868,8 @@ void ED_vgroup_vert_add(Object *ob, bDeformGroup *dg, int vertnum, float weight,
 		/* call another function to do the work
 		 */
 		ED_vgroup_nr_vert_add(ob, def_nr, vertnum, weight, assignmode);
+
+		vgroup_tag_update(ob);
 	}
 }
 
@@ -888,6 +898,8 @@ void ED_vgroup_vert_remove(Object *ob, bDeformGroup *dg, int vertnum)
 
 			dw = defvert_find_index(dv, def_nr);
 			defvert_remove_group(dv, dw); /* dw can be NULL */
+
+			vgroup_tag_update(ob);
 		}
 	}
 }
@@ -2635,7 +2647,7 @@ static int vertex_group_add_exec(bContext *C, wmOperator *UNUSED(op))
 	Object *ob = ED_object_context(C);
 
 	BKE_object_defgroup_add(ob);
-	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+	vgroup_tag_update(ob);
 	WM_event_add_notifier(C, NC_GEOM | ND_VERTEX_GROUP, ob->data);
 	WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, ob);
 
@@ -2668,7 +2680,7 @@ static int vertex_group_remove_exec(bContext *C, wmOperator *op)
 	else
 		vgroup_delete_active(ob);
 
-	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+	vgroup_tag_update(ob);
 	WM_event_add_notifier(C, NC_GEOM | ND_VERTEX_GROUP, ob->data);
 	WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, ob);
 
@@ -2703,7 +2715,7 @@ static int vertex_group_assign_exec(bContext *C, wmOperator *UNUSED(op))
 	Object *ob = ED_object_context(C);
 
 	vgroup_assign_verts(ob, ts->vgroup_weight);
-	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+	vgroup_tag_update(ob);
 	WM_event_add_notifier(C, NC_GEOM | ND_DATA, ob->data);
 
 	return OPERATOR_FINISHED;
@@ -2776,7 +2788,7 @@ static int vertex_group_remove_from_exec(bContext *C, wmOperator *op)
 		}
 	}
 
-	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+	vgroup_tag_update(ob);
 	WM_event_add_notifier(C, NC_GEOM | ND_DATA, ob->data);
 
 	return OPERATOR_FINISHED;
@@ -2865,7 +2877,7 @@ static int vertex_group_copy_exec(bContext *C, wmOperator *UNUSED(op))
 	Object *ob = ED_object_context(C);
 
 	vgroup_duplicate(ob);
-	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+	vgroup_tag_update(ob);
 	WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, ob);
 	WM_event_add_notifier(C, NC_GEOM | ND_VERTEX_GROUP, ob->data);
 
@@ -2901,7 +2913,7 @@ static int vertex_group_levels_exec(bContext *C, wmOperator *op)
 	vgroup_levels_subset(ob, vgroup_validmap, vgroup_tot, subset_count, offset, gain);
 	MEM_freeN((void *)vgroup_validmap);
 
-	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+	vgroup_tag_update(ob);
 	WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, ob);
 	WM_event_add_notifier(C, NC_GEOM | ND_DATA, ob->data);
 
@@ -2935,7 +2947,7 @@ static int vertex_group_normalize_exec(bContext *C, wmOperator *UNUSED(op))
 	changed = vgroup_normalize(ob);
 
 	if (changed) {
-		DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+		vgroup_tag_update(ob);
 		WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, ob);
 		WM_event_add_notifier(C, NC_GEOM | ND_DATA, ob->data);
 
@@ -2974,7 +2986,7 @@ static int vertex_group_normalize_all_exec(bContext *C, wmOperator *op)
 	MEM_freeN((void *)vgroup_validmap);
 
 	if (changed) {
-		DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+		vgroup_tag_update(ob);
 		WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, ob);
 		WM_event_add_notifier(C, NC_GEOM | ND_DATA, ob->data);
 
@@ -3029,7 +3041,7 @@ static int vertex_group_fix_exec(bContext *C, wmOperator *op)
 	}
 	vgroup_fix(scene, ob, distToBe, strength, cp);
 
-	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+	vgroup_tag_update(ob);
 	WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, ob);
 	WM_event_add_notifier(C, NC_GEOM | ND_DATA, ob->data);
 
@@ -3101,7 +3113,7 @@ static int vertex_group_invert_exec(bContext *C, wmOperator *op)
 	vgroup_invert_subset(ob, vgroup_validmap, vgroup_tot, subset_count, auto_assign, auto_remove);
 	MEM_freeN((void *)vgroup_validmap);
 
-	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+	vgroup_tag_update(ob);
 	WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, ob);
 	WM_event_add_notifier(C, NC_GEOM | ND_DATA, ob->data);
 
@@ -3143,7 +3155,7 @@ static int vertex_group_smooth_exec(bContext *C, wmOperator *op)
 	vgroup_smooth_subset(ob, vgroup_validmap, vgroup_tot, subset_count, fac, repeat, fac_expand);
 	MEM_freeN((void *)vgroup_validmap);
 
-	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+	vgroup_tag_update(ob);
 	WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, ob);
 	WM_event_add_notifier(C, NC_GEOM | ND_DATA, ob->data);
 
@@ -3185,7 +3197,7 @@ static int vertex_group_clean_exec(bContext *C, wmOperator *op)
 	vgroup_clean_subset(ob, vgroup_validmap, vgroup_tot, subset_count, limit, keep_single);
 	MEM_freeN((void *)vgroup_validmap);
 
-	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+	vgroup_tag_update(ob);
 	WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, ob);
 	WM_event_add_notifier(C, NC_GEOM | ND_DATA, ob->data);
 
@@ -3226,7 +3238,7 @@ static int vertex_group_quantize_exec(bContext *C, wmOperator *op)
 	vgroup_quantize_subset(ob, vgroup_validmap, vgroup_tot, subset_count, steps);
 	MEM_freeN((void *)vgroup_validmap);
 
-	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+	vgroup_tag_update(ob);
 	WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, ob);
 	WM_event_add_notifier(C, NC_GEOM | ND_DATA, ob->data);
 
@@ -3267,7 +3279,7 @@ static int vertex_group_limit_total_exec(bContext *C, wmOperator *op)
 	BKE_reportf(op->reports, remove_tot ? RPT_INFO : RPT_WARNING, "%d vertex weights limited", remove_tot);
 
 	if (remove_tot) {
-		DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+		vgroup_tag_update(ob);
 		WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, ob);
 		WM_event_add_notifier(C, NC_GEOM | ND_DATA, ob->data);
 
@@ -3313,7 +3325,7 @@ static int vertex_group_mirror_exec(bContext *C, wmOperator *op)
 
 	ED_mesh_report_mirror(op, totmirr, totfail);
 
-	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+	vgroup_tag_update(ob);
 	WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, ob);
 	WM_event_add_notifier(C, NC_GEOM | ND_DATA, ob->data);
 
@@ -3394,7 +3406,7 @@ static int vertex_group_copy_to_selected_exec(bContext *C, wmOperator *op)
 	{
 		if (obact != ob) {
 			if (ED_vgroup_array_copy(ob, obact)) {
-				DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+				vgroup_tag_update(ob);
 				WM_event_add_notifier(C, NC_GEOM | ND_VERTEX_GROUP, ob);
 				changed_tot++;
 			}
@@ -3437,7 +3449,7 @@ static int set_active_group_exec(bContext *C, wmOperator *op)
 	BLI_assert(nr + 1 >= 0);
 	ob->actdef = nr + 1;
 
-	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+	vgroup_tag_update(ob);
 	WM_event_add_notifier(C, NC_GEOM | ND_VERTEX_GROUP, ob);
 
 	return OPERATOR_FINISHED;
@@ -3651,7 +3663,7 @@ static int vertex_group_sort_exec(bContext *C, wmOperator *op)
 	ret = vgroup_do_remap(ob, name_array, op);
 
 	if (ret != OPERATOR_CANCELLED) {
-		DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+		vgroup_tag_update(ob);
 		WM_event_add_notifier(C, NC_GEOM | ND_VERTEX_GROUP, ob);
 	}
 
@@ -3701,7 +3713,7 @@ static int vgroup_move_exec(bContext *C, wmOperator *op)
 		ret = vgroup_do_remap(ob, name_array, op);
 
 		if (ret != OPERATOR_CANCELLED) {
-			DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+			vgroup_tag_update(ob);
 			WM_event_add_notifier(C, NC_GEOM | ND_VERTEX_GROUP, ob);
 		}
 	}
@@ -3830,7 +3842,7 @@ static int vertex_weight_paste_exec(bContext *C, wmOperator *op)
 
 	vgroup_copy_active_to_sel_single(ob, def_nr);
 
-	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+	vgroup_tag_update(ob);
 	WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, ob);
 
 	return OPERATOR_FINISHED;
@@ -3867,7 +3879,7 @@ static int vertex_weight_delete_exec(bContext *C, wmOperator *op)
 
 	vgroup_remove_weight(ob, def_nr);
 
-	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+	vgroup_tag_update(ob);
 	WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, ob);
 
 	return OPERATOR_FINISHED;
@@ -3900,7 +3912,7 @@ static int vertex_weight_set_active_exec(bContext *C, wmOperator *op)
 
 	if (wg_index != -1) {
 		ob->actdef = wg_index + 1;
-		DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+		vgroup_tag_update(ob);
 		WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, ob);
 	}
 
@@ -3937,7 +3949,7 @@ static int vertex_weight_normalize_active_vertex_exec(bContext *C, wmOperator *U
 	changed = vgroup_normalize_active_vertex(ob, subset_type);
 
 	if (changed) {
-		DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+		vgroup_tag_update(ob);
 		WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, ob);
 
 		return OPERATOR_FINISHED;
@@ -3970,7 +3982,7 @@ static int vertex_weight_copy_exec(bContext *C, wmOperator *UNUSED(op))
 
 	vgroup_copy_active_to_sel(ob, subset_type);
 
-	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+	vgroup_tag_update(ob);
 	WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, ob);
 
 	return OPERATOR_FINISHED;
@@ -696,6 +696,7 @@ static int paint_weight_gradient_modal(bContext *C, wmOperator *op, const wmEven
 		MEM_freeN(vert_cache);
 
 		DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+		DAG_id_tag_update(ob->data, 0);
 		WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, ob);
 	}
 	else if (ret & OPERATOR_FINISHED) {
@@ -794,6 +795,7 @@ static int paint_weight_gradient_exec(bContext *C, wmOperator *op)
 	}
 
 	DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+	DAG_id_tag_update(ob->data, 0);
 	WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, ob);
 
 	if (is_interactive == false) {
@@ -5755,6 +5755,9 @@ void ED_object_sculptmode_exit_ex(
 		DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
 	}
 
+	/* The mesh was changed in place, update caches of it for all its users. */
+	DAG_id_tag_update(&me->id, OB_RECALC_DATA);
+
 	if (me->flag & ME_SCULPT_DYNAMIC_TOPOLOGY) {
 		/* Dynamic topology must be disabled before exiting sculpt
 		 * mode to ensure the undo stack stays in a consistent
@@ -780,6 +780,8 @@ static void do_view3d_vgroup_buttons(bContext *C, void *UNUSED(arg), int event)
 		Object *ob = scene->basact->object;
 		ED_vgroup_vert_active_mirror(ob, event - B_VGRP_PNL_EDIT_SINGLE);
 		DAG_id_tag_update(&ob->id, OB_RECALC_DATA);
+		/* the weight is edited in place, also update other users of the data */
+		DAG_id_tag_update(ob->data, OB_RECALC_DATA);
 		WM_event_add_notifier(C, NC_GEOM | ND_DATA, ob->data);
 	}
 }
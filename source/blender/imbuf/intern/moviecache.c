@@ -60,6 +60,8 @@
 
 static MEM_CacheLimiterC *limitor = NULL;
 static pthread_mutex_t limitor_lock = BLI_MUTEX_INITIALIZER;
+/* Set when the memory domain of the cache goes over its budget. */
+static bool limitor_over_budget = false;
 
 typedef struct MovieCache {
 	char name[64];
@@ -121,6 +123,17 @@ static void moviecache_keyfree(void *val)
 	BLI_mempool_free(key->cache_owner->keys_pool, key);
 }
 
+/* Account the pixel buffers of cached images to the movie cache memory domain. */
+static void moviecache_ibuf_set_domain(ImBuf *ibuf, int domain)
+{
+	if (ibuf->rect && (ibuf->mall & IB_rect)) {
+		MEM_set_block_domain(ibuf->rect, domain);
+	}
+	if (ibuf->rect_float && (ibuf->mall & IB_rectfloat)) {
+		MEM_set_block_domain(ibuf->rect_float, domain);
+	}
+}
+
 static void moviecache_valfree(void *val)
 {
 	MovieCacheItem *item = (MovieCacheItem *)val;
@@ -130,6 +143,7 @@ static void moviecache_valfree(void *val)
 
 	if (item->ibuf) {
 		MEM_CacheLimiter_unmanage(item->c_handle);
+		moviecache_ibuf_set_domain(item->ibuf, MEM_DOMAIN_DEFAULT);
 		IMB_freeImBuf(item->ibuf);
 	}
 
@@ -180,6 +194,7 @@ static void IMB_moviecache_destructor(void *p)
 
 		PRINT("%s: cache '%s' destroy item %p buffer %p\n", __func__, cache->name, item, item->ibuf);
 
+		moviecache_ibuf_set_domain(item->ibuf, MEM_DOMAIN_DEFAULT);
 		IMB_freeImBuf(item->ibuf);
 
 		item->ibuf = NULL;
@@ -281,18 +296,28 @@ static bool get_item_destroyable(void *item_v)
 	return true;
 }
 
+static void moviecache_budget_cb(int UNUSED(domain), size_t UNUSED(mem_in_use), void *UNUSED(userdata))
+{
+	/* May be called from any allocating thread, the limits are enforced on the next put. */
+	limitor_over_budget = true;
+}
+
 void IMB_moviecache_init(void)
 {
 	limitor = new_MEM_CacheLimiter(IMB_moviecache_destructor, get_item_size);
 
 	MEM_CacheLimiter_ItemPriority_Func_set(limitor, get_item_priority);
 	MEM_CacheLimiter_ItemDestroyable_Func_set(limitor, get_item_destroyable);
+
+	MEM_domain_budget_callback_add(MEM_DOMAIN_MOVIECACHE, moviecache_budget_cb, NULL);
 }
 
 void IMB_moviecache_destruct(void)
 {
-	if (limitor)
+	if (limitor) {
+		MEM_domain_budget_callback_remove(MEM_DOMAIN_MOVIECACHE, moviecache_budget_cb, NULL);
 		delete_MEM_CacheLimiter(limitor);
+	}
 }
 
 MovieCache *IMB_moviecache_create(const char *name, int keysize, GHashHashFP hashfp, GHashCmpFP cmpfp)
@@ -364,6 +389,9 @@ static void do_moviecache_put(MovieCache *cache, void *userkey, ImBuf *ibuf, boo
 
 	BLI_ghash_reinsert(cache->hash, key, item, moviecache_keyfree, moviecache_valfree);
 
+	/* After replacing any previous item, which may hold the same buffer. */
+	moviecache_ibuf_set_domain(ibuf, MEM_DOMAIN_MOVIECACHE);
+
 	if (cache->last_userkey) {
 		memcpy(cache->last_userkey, userkey, cache->keysize);
 	}
@@ -375,6 +403,12 @@ static void do_moviecache_put(MovieCache *cache, void *userkey, ImBuf *ibuf, boo
 
 	MEM_CacheLimiter_ref(item->c_handle);
 	MEM_CacheLimiter_enforce_limits(limitor);
+	if (limitor_over_budget) {
+		MEM_CacheLimiter_enforce_limits_ex(limitor, MEM_domain_get_budget(MEM_DOMAIN_MOVIECACHE));
+		if (!MEM_domain_is_over_budget(MEM_DOMAIN_MOVIECACHE)) {
+			limitor_over_budget = false;
+		}
+	}
 	MEM_CacheLimiter_unref(item->c_handle);
 
 	if (need_lock)
@@ -41,6 +41,7 @@
 
 struct AnimData;
 struct Ipo;
+struct KeyBlockSparse;
 
 typedef struct KeyBlock {
 	struct KeyBlock *next, *prev;
@@ -67,6 +68,10 @@ typedef struct KeyBlock {
 	float slidermin;
 	float slidermax;
 
+	int totsparse;     /* in files only, number of elements in 'data' when flag has KEYBLOCK_SPARSE */
+	int pad2;
+
+	struct KeyBlockSparse *sparse;  /* runtime, elements which differ from the reference key */
 } KeyBlock;
 
 
@@ -132,7 +137,10 @@ enum {
 enum {
 	KEYBLOCK_MUTE       = (1 << 0),
 	KEYBLOCK_SEL        = (1 << 1),
-	KEYBLOCK_LOCKED     = (1 << 2)
+	KEYBLOCK_LOCKED     = (1 << 2),
+	/* In files only, 'data' holds the (index, value) pairs of the elements which
+	 * differ from the reference key, see #KeyBlockSparseElem. */
+	KEYBLOCK_SPARSE     = (1 << 3),
 };
 
 #endif /* __DNA_KEY_TYPES_H__  */
@@ -551,6 +551,9 @@ typedef struct ArmatureModifierData {
 	struct Object *object;
 	float *prevCos;           /* stored input of previous modifier, for vertexgroup blending */
 	char defgrp_name[64];     /* MAX_VGROUP_NAME */
+
+	/* runtime-only cache, vertex weights gathered from the vertex groups */
+	struct ArmatureDeformCache *deform_cache;
 } ArmatureModifierData;
 
 enum {
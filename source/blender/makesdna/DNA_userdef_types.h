@@ -496,7 +496,7 @@ typedef struct UserDef {
 	short undosteps;
 	short pad1;
 	int undomemory;
-	int pad3;
+	int modcachelimit;  /* memory budget of the modifier stack cache in megabytes, 0 disables it */
 	short gp_manhattendist, gp_euclideandist, gp_eraser;
 	short gp_settings;  /* eGP_UserdefSettings */
 	short tb_leftmouse, tb_rightmouse;
@@ -82,6 +82,31 @@ static void rna_Depsgraph_debug_stats(Depsgraph *depsgraph, char *result)
 	            ops, rels, outer);
 }
 
+static void rna_Depsgraph_debug_build_stats(Depsgraph *depsgraph, char *result)
+{
+	DepsgraphBuildStats stats;
+	DEG_stats_build(depsgraph, &stats);
+	BLI_snprintf(result, STATS_MAX_SIZE,
+	             "Built in %f seconds: nodes %f, relations %f (%d threads), "
+	             "cycles %f, transitive reduction %f, finalize %f, %d IDs rebuilt",
+	             stats.total_time, stats.nodes_time,
+	             stats.relations_time, stats.relations_num_threads,
+	             stats.cycles_time, stats.transitive_reduction_time,
+	             stats.finalize_time, stats.num_rebuilt_ids);
+}
+
+static void rna_Depsgraph_debug_eval_stats(Depsgraph *depsgraph, char *result)
+{
+	DepsgraphEvalStats stats;
+	DEG_stats_eval(depsgraph, &stats);
+	BLI_snprintf(result, STATS_MAX_SIZE,
+	             "Evaluated %d operations in %f seconds: operations %f, "
+	             "critical path %f, utilization %.1f%% of %d threads",
+	             stats.num_operations, stats.total_time,
+	             stats.operations_time, stats.critical_path_time,
+	             stats.utilization * 100.0f, stats.num_threads);
+}
+
 #else
 
 static void rna_def_depsgraph(BlenderRNA *brna)
@@ -114,6 +139,19 @@ static void rna_def_depsgraph(BlenderRNA *brna)
 	parm = RNA_def_string(func, "result", NULL, STATS_MAX_SIZE, "result", "");
 	RNA_def_parameter_flags(parm, PROP_THICK_WRAP, 0); /* needed for string return value */
 	RNA_def_function_output(func, parm);
+
+	func = RNA_def_function(srna, "debug_build_stats", "rna_Depsgraph_debug_build_stats");
+	RNA_def_function_ui_description(func, "Report the time spent in each phase of the last build of the Dependency Graph");
+	parm = RNA_def_string(func, "result", NULL, STATS_MAX_SIZE, "result", "");
+	RNA_def_parameter_flags(parm, PROP_THICK_WRAP, 0); /* needed for string return value */
+	RNA_def_function_output(func, parm);
+
+	func = RNA_def_function(srna, "debug_eval_stats", "rna_Depsgraph_debug_eval_stats");
+	RNA_def_function_ui_description(func, "Report the critical path and thread utilization of the last evaluation "
+	                                "of the Dependency Graph");
+	parm = RNA_def_string(func, "result", NULL, STATS_MAX_SIZE, "result", "");
+	RNA_def_parameter_flags(parm, PROP_THICK_WRAP, 0); /* needed for string return value */
+	RNA_def_function_output(func, parm);
 }
 
 void RNA_def_depsgraph(BlenderRNA *brna)
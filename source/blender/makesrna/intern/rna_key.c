@@ -318,6 +318,9 @@ static void rna_ShapeKeyPoint_co_set(PointerRNA *ptr, const float *values)
 {
 	float *vec = (float *)ptr->data;
 
+	/* changes the key data in place */
+	BKE_key_sparse_free(ptr->id.data);
+
 	vec[0] = values[0];
 	vec[1] = values[1];
 	vec[2] = values[2];
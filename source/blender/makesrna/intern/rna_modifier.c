@@ -460,7 +460,7 @@ static void rna_Modifier_update(Main *UNUSED(bmain), Scene *UNUSED(scene), Point
 static void rna_Modifier_dependency_update(Main *bmain, Scene *scene, PointerRNA *ptr)
 {
 	rna_Modifier_update(bmain, scene, ptr);
-	DAG_relations_tag_update(bmain);
+	DAG_relations_tag_update_id(bmain, ptr->id.data);
 }
 
 /* Vertex Groups */
@@ -629,8 +629,10 @@ static void rna_Smoke_set_type(Main *bmain, Scene *scene, PointerRNA *ptr)
 			break;
 	}
 
-	/* update dependency since a domain - other type switch could have happened */
-	rna_Modifier_dependency_update(bmain, scene, ptr);
+	/* update dependency since a domain - other type switch could have happened,
+	 * domains look for flows and colliders in the whole scene so rebuild all relations */
+	rna_Modifier_update(bmain, scene, ptr);
+	DAG_relations_tag_update(bmain);
 }
 
 static void rna_MultiresModifier_type_set(PointerRNA *ptr, int value)
@@ -775,7 +777,7 @@ static void rna_CurveModifier_dependency_update(Main *bmain, Scene *scene, Point
 {
 	CurveModifierData *cmd = (CurveModifierData *)ptr->data;
 	rna_Modifier_update(bmain, scene, ptr);
-	DAG_relations_tag_update(bmain);
+	DAG_relations_tag_update_id(bmain, ptr->id.data);
 	if (cmd->object != NULL) {
 		Curve *curve = cmd->object->data;
 		if ((curve->flag & CU_PATH) == 0) {
@@ -788,7 +790,7 @@ static void rna_ArrayModifier_dependency_update(Main *bmain, Scene *scene, Point
 {
 	ArrayModifierData *amd = (ArrayModifierData *)ptr->data;
 	rna_Modifier_update(bmain, scene, ptr);
-	DAG_relations_tag_update(bmain);
+	DAG_relations_tag_update_id(bmain, ptr->id.data);
 	if (amd->curve_ob != NULL) {
 		Curve *curve = amd->curve_ob->data;
 		if ((curve->flag & CU_PATH) == 0) {
@@ -362,6 +362,18 @@ static void rna_Userdef_memcache_update(Main *UNUSED(bmain), Scene *UNUSED(scene
 	MEM_CacheLimiter_set_maximum(((size_t) U.memcachelimit) * 1024 * 1024);
 }
 
+static void rna_Userdef_modcache_update(Main *bmain, Scene *UNUSED(scene), PointerRNA *UNUSED(ptr))
+{
+	Object *ob;
+
+	MEM_domain_set_budget(MEM_DOMAIN_MODIFIER_CACHE, ((size_t) U.modcachelimit) * 1024 * 1024);
+
+	/* Start over within the new budget. */
+	for (ob = bmain->object.first; ob; ob = ob->id.next) {
+		mesh_free_modifier_stack_cache(ob);
+	}
+}
+
 static void rna_UserDef_weight_color_update(Main *bmain, Scene *scene, PointerRNA *ptr)
 {
 	Object *ob;
@@ -4108,6 +4120,14 @@ static void rna_def_userdef_system(BlenderRNA *brna)
 	RNA_def_property_ui_text(prop, "Memory Cache Limit", "Memory cache limit (in megabytes)");
 	RNA_def_property_update(prop, 0, "rna_Userdef_memcache_update");
 
+	prop = RNA_def_property(srna, "modifier_cache_limit", PROP_INT, PROP_NONE);
+	RNA_def_property_int_sdna(prop, NULL, "modcachelimit");
+	RNA_def_property_range(prop, 0, max_memory_in_megabytes_int());
+	RNA_def_property_ui_text(prop, "Modifier Cache Limit",
+	                         "Memory used to keep results of modifiers which don't change between updates "
+	                         "(in megabytes, 0 disables caching)");
+	RNA_def_property_update(prop, 0, "rna_Userdef_modcache_update");
+
 	prop = RNA_def_property(srna, "frame_server_port", PROP_INT, PROP_NONE);
 	RNA_def_property_int_sdna(prop, NULL, "frameserverport");
 	RNA_def_property_range(prop, 0, 32727);
@@ -71,6 +71,17 @@ static void copyData(const ModifierData *md, ModifierData *target)
 
 	modifier_copyData_generic(md, target);
 	tamd->prevCos = NULL;
+	tamd->deform_cache = NULL;
+}
+
+static void freeData(ModifierData *md)
+{
+	ArmatureModifierData *amd = (ArmatureModifierData *) md;
+
+	if (amd->deform_cache) {
+		armature_deform_cache_free(amd->deform_cache);
+		amd->deform_cache = NULL;
+	}
 }
 
 static CustomDataMask requiredDataMask(Object *UNUSED(ob), ModifierData *UNUSED(md))
@@ -133,7 +144,8 @@ static void deformVerts(
 	modifier_vgroup_cache(md, vertexCos); /* if next modifier needs original vertices */
 
 	armature_deform_verts(amd->object, ob, derivedData, vertexCos, NULL,
-	                      numVerts, amd->deformflag, (float(*)[3])amd->prevCos, amd->defgrp_name);
+	                      numVerts, amd->deformflag, (float(*)[3])amd->prevCos, amd->defgrp_name,
+	                      &amd->deform_cache);
 
 	/* free cache */
 	if (amd->prevCos) {
@@ -154,7 +166,7 @@ static void deformVertsEM(
 	modifier_vgroup_cache(md, vertexCos); /* if next modifier needs original vertices */
 
 	armature_deform_verts(amd->object, ob, dm, vertexCos, NULL,
-	                      numVerts, amd->deformflag, (float(*)[3])amd->prevCos, amd->defgrp_name);
+	                      numVerts, amd->deformflag, (float(*)[3])amd->prevCos, amd->defgrp_name, NULL);
 
 	/* free cache */
 	if (amd->prevCos) {
@@ -176,7 +188,7 @@ static void deformMatricesEM(
 	if (!derivedData) dm = CDDM_from_editbmesh(em, false, false);
 
 	armature_deform_verts(amd->object, ob, dm, vertexCos, defMats, numVerts,
-	                      amd->deformflag, NULL, amd->defgrp_name);
+	                      amd->deformflag, NULL, amd->defgrp_name, NULL);
 
 	if (!derivedData) dm->release(dm);
 }
@@ -191,7 +203,7 @@ static void deformMatrices(
 	if (!derivedData) dm = CDDM_from_mesh((Mesh *)ob->data);
 
 	armature_deform_verts(amd->object, ob, dm, vertexCos, defMats, numVerts,
-	                      amd->deformflag, NULL, amd->defgrp_name);
+	                      amd->deformflag, NULL, amd->defgrp_name, &amd->deform_cache);
 
 	if (!derivedData) dm->release(dm);
 }
@@ -203,7 +215,8 @@ ModifierTypeInfo modifierType_Armature = {
 	/* type */              eModifierTypeType_OnlyDeform,
 	/* flags */             eModifierTypeFlag_AcceptsCVs |
 	                        eModifierTypeFlag_AcceptsLattice |
-	                        eModifierTypeFlag_SupportsEditmode,
+	                        eModifierTypeFlag_SupportsEditmode |
+	                        eModifierTypeFlag_UsesThreads,
 
 	/* copyData */          copyData,
 	/* deformVerts */       deformVerts,
@@ -214,7 +227,7 @@ ModifierTypeInfo modifierType_Armature = {
 	/* applyModifierEM */   NULL,
 	/* initData */          initData,
 	/* requiredDataMask */  requiredDataMask,
-	/* freeData */          NULL,
+	/* freeData */          freeData,
 	/* isDisabled */        isDisabled,
 	/* updateDepgraph */    updateDepgraph,
 	/* updateDepsgraph */   updateDepsgraph,
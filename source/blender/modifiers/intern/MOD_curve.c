@@ -150,7 +150,8 @@ ModifierTypeInfo modifierType_Curve = {
 	/* type */              eModifierTypeType_OnlyDeform,
 	/* flags */             eModifierTypeFlag_AcceptsCVs |
 	                        eModifierTypeFlag_AcceptsLattice |
-	                        eModifierTypeFlag_SupportsEditmode,
+	                        eModifierTypeFlag_SupportsEditmode |
+	                        eModifierTypeFlag_UsesThreads,
 
 	/* copyData */          modifier_copyData_generic,
 	/* deformVerts */       deformVerts,
@@ -419,7 +419,9 @@ ModifierTypeInfo modifierType_Displace = {
 	/* structSize */        sizeof(DisplaceModifierData),
 	/* type */              eModifierTypeType_OnlyDeform,
 	/* flags */             eModifierTypeFlag_AcceptsMesh |
-	                        eModifierTypeFlag_SupportsEditmode,
+	                        eModifierTypeFlag_SupportsEditmode |
+	                        eModifierTypeFlag_UsesImplicitInputs |
+	                        eModifierTypeFlag_UsesThreads,
 
 	/* copyData */          modifier_copyData_generic,
 	/* deformVerts */       deformVerts,
@@ -204,7 +204,8 @@ ModifierTypeInfo modifierType_DynamicPaint = {
 /*	                        eModifierTypeFlag_SupportsMapping |*/
 	                        eModifierTypeFlag_UsesPointCache |
 	                        eModifierTypeFlag_Single |
-	                        eModifierTypeFlag_UsesPreview,
+	                        eModifierTypeFlag_UsesPreview |
+	                        eModifierTypeFlag_UsesThreads,
 
 	/* copyData */          copyData,
 	/* deformVerts */       NULL,
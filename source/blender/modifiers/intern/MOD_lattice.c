@@ -140,7 +140,8 @@ ModifierTypeInfo modifierType_Lattice = {
 	/* type */              eModifierTypeType_OnlyDeform,
 	/* flags */             eModifierTypeFlag_AcceptsCVs |
 	                        eModifierTypeFlag_AcceptsLattice |
-	                        eModifierTypeFlag_SupportsEditmode,
+	                        eModifierTypeFlag_SupportsEditmode |
+	                        eModifierTypeFlag_UsesThreads,
 	/* copyData */          modifier_copyData_generic,
 	/* deformVerts */       deformVerts,
 	/* deformMatrices */    NULL,
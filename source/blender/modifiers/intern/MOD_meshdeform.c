@@ -524,7 +524,8 @@ ModifierTypeInfo modifierType_MeshDeform = {
 	/* type */              eModifierTypeType_OnlyDeform,
 	/* flags */             eModifierTypeFlag_AcceptsCVs |
 	                        eModifierTypeFlag_AcceptsLattice |
-	                        eModifierTypeFlag_SupportsEditmode,
+	                        eModifierTypeFlag_SupportsEditmode |
+	                        eModifierTypeFlag_UsesThreads,
 
 	/* copyData */          copyData,
 	/* deformVerts */       deformVerts,
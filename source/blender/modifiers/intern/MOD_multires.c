@@ -142,7 +142,9 @@ ModifierTypeInfo modifierType_Multires = {
 	/* type */              eModifierTypeType_Constructive,
 	/* flags */             eModifierTypeFlag_AcceptsMesh |
 	                        eModifierTypeFlag_SupportsMapping |
-	                        eModifierTypeFlag_RequiresOriginalData,
+	                        eModifierTypeFlag_RequiresOriginalData |
+	                        eModifierTypeFlag_UsesImplicitInputs |
+	                        eModifierTypeFlag_UsesThreads,
 
 	/* copyData */          modifier_copyData_generic,
 	/* deformVerts */       NULL,
@@ -578,7 +578,9 @@ ModifierTypeInfo modifierType_Ocean = {
 	/* type */              eModifierTypeType_Constructive,
 	/* flags */             eModifierTypeFlag_AcceptsMesh |
 	                        eModifierTypeFlag_SupportsEditmode |
-	                        eModifierTypeFlag_EnableInEditmode,
+	                        eModifierTypeFlag_EnableInEditmode |
+	                        eModifierTypeFlag_UsesImplicitInputs |
+	                        eModifierTypeFlag_UsesThreads,
 
 	/* copyData */          copyData,
 	/* deformMatrices */    NULL,
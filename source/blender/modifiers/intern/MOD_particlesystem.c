@@ -220,7 +220,8 @@ ModifierTypeInfo modifierType_ParticleSystem = {
 	/* type */              eModifierTypeType_OnlyDeform,
 	/* flags */             eModifierTypeFlag_AcceptsMesh |
 	                        eModifierTypeFlag_SupportsMapping |
-	                        eModifierTypeFlag_UsesPointCache /* |
+	                        eModifierTypeFlag_UsesPointCache |
+	                        eModifierTypeFlag_UsesImplicitInputs /* |
 	                        eModifierTypeFlag_SupportsEditmode |
 	                        eModifierTypeFlag_EnableInEditmode */,
 
@@ -129,7 +129,8 @@ ModifierTypeInfo modifierType_ShapeKey = {
 	/* type */              eModifierTypeType_OnlyDeform,
 	/* flags */             eModifierTypeFlag_AcceptsCVs |
 	                        eModifierTypeFlag_AcceptsLattice |
-	                        eModifierTypeFlag_SupportsEditmode,
+	                        eModifierTypeFlag_SupportsEditmode |
+	                        eModifierTypeFlag_UsesImplicitInputs,
 
 	/* copyData */          NULL,
 	/* deformVerts */       deformVerts,
@@ -201,7 +201,8 @@ ModifierTypeInfo modifierType_Subsurf = {
 	                        eModifierTypeFlag_SupportsMapping |
 	                        eModifierTypeFlag_SupportsEditmode |
 	                        eModifierTypeFlag_EnableInEditmode |
-	                        eModifierTypeFlag_AcceptsCVs,
+	                        eModifierTypeFlag_AcceptsCVs |
+	                        eModifierTypeFlag_UsesThreads,
 
 	/* copyData */          copyData,
 	/* deformVerts */       NULL,
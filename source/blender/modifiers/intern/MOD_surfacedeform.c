@@ -1219,7 +1219,8 @@ ModifierTypeInfo modifierType_SurfaceDeform = {
 	/* structSize */        sizeof(SurfaceDeformModifierData),
 	/* type */              eModifierTypeType_OnlyDeform,
 	/* flags */             eModifierTypeFlag_AcceptsMesh |
-	                        eModifierTypeFlag_SupportsEditmode,
+	                        eModifierTypeFlag_SupportsEditmode |
+	                        eModifierTypeFlag_UsesThreads,
 
 	/* copyData */          copyData,
 	/* deformVerts */       deformVerts,
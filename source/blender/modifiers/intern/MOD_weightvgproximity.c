@@ -590,7 +590,8 @@ ModifierTypeInfo modifierType_WeightVGProximity = {
 	/* flags */             eModifierTypeFlag_AcceptsMesh |
 	                        eModifierTypeFlag_SupportsMapping |
 	                        eModifierTypeFlag_SupportsEditmode |
-	                        eModifierTypeFlag_UsesPreview,
+	                        eModifierTypeFlag_UsesPreview |
+	                        eModifierTypeFlag_UsesThreads,
 
 	/* copyData */          modifier_copyData_generic,
 	/* deformVerts */       NULL,
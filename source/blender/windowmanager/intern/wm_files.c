@@ -88,6 +88,7 @@
 #include "BKE_screen.h"
 #include "BKE_undo_system.h"
 
+#include "BLO_blend_defs.h"
 #include "BLO_readfile.h"
 #include "BLO_writefile.h"
 #include "BLO_undofile.h"  /* to save from an undo memfile */
@@ -104,7 +105,6 @@
 #include "ED_screen.h"
 #include "ED_view3d.h"
 #include "ED_util.h"
-#include "ED_undo.h"
 
 #include "GHOST_C-api.h"
 #include "GHOST_Path-api.h"
@@ -325,6 +325,7 @@ static void wm_init_userdef(Main *bmain, const bool read_userdef_from_memory)
 	UI_init_userdef(bmain);
 
 	MEM_CacheLimiter_set_maximum(((size_t)U.memcachelimit) * 1024 * 1024);
+	MEM_domain_set_budget(MEM_DOMAIN_MODIFIER_CACHE, ((size_t)U.modcachelimit) * 1024 * 1024);
 	BKE_sound_init(bmain);
 
 	/* needed so loading a file from the command line respects user-pref [#26156] */
@@ -364,7 +365,7 @@ static int wm_read_exotic(const char *name)
 {
 	int len;
 	gzFile gzfile;
-	char header[7];
+	char header[BLEND_FRAMES_MAGIC_LEN];
 	int retval;
 
 	/* make sure we're not trying to read a directory.... */
@@ -381,7 +382,9 @@ static int wm_read_exotic(const char *name)
 		else {
 			len = gzread(gzfile, header, sizeof(header));
 			gzclose(gzfile);
-			if (len == sizeof(header) && STREQLEN(header, "BLENDER", 7)) {
+			if ((len >= 7 && STREQLEN(header, "BLENDER", 7)) ||
+			    (len == BLEND_FRAMES_MAGIC_LEN && STREQLEN(header, BLEND_FRAMES_MAGIC, BLEND_FRAMES_MAGIC_LEN)))
+			{
 				retval = BKE_READ_EXOTIC_OK_BLEND;
 			}
 			else {
@@ -1183,6 +1186,8 @@ static int wm_file_write(bContext *C, const char *filepath, int fileflags, Repor
 		}
 
 		SET_FLAG_FROM_TEST(G.fileflags, fileflags & G_FILE_COMPRESS, G_FILE_COMPRESS);
+		SET_FLAG_FROM_TEST(G.fileflags, fileflags & G_FILE_COMPRESS_FRAMES, G_FILE_COMPRESS_FRAMES);
+		SET_FLAG_FROM_TEST(G.fileflags, fileflags & G_FILE_SPARSE_KEYS, G_FILE_SPARSE_KEYS);
 		SET_FLAG_FROM_TEST(G.fileflags, fileflags & G_FILE_AUTOPLAY, G_FILE_AUTOPLAY);
 
 		/* prevent background mode scripts from clobbering history */
@@ -1259,6 +1264,54 @@ void WM_autosave_init(wmWindowManager *wm)
 		wm->autosavetimer = WM_event_add_timer(wm, NULL, TIMERAUTOSAVE, U.savetime * 60.0);
 }
 
+/* The state to save is snapshot into a memfile (like undo does, without touching the disk),
+ * which a job then writes out, so the UI isn't blocked for as long as writing takes. */
+typedef struct AutoSaveJob {
+	struct MemFile *memfile;
+	char filepath[FILE_MAX];
+} AutoSaveJob;
+
+static void wm_autosave_job_startjob(void *customdata, short *stop, short *UNUSED(do_update), float *progress)
+{
+	AutoSaveJob *asj = customdata;
+
+	BLO_memfile_write_file_atomic(asj->memfile, asj->filepath, stop, progress);
+}
+
+static void wm_autosave_job_free(void *customdata)
+{
+	AutoSaveJob *asj = customdata;
+
+	BLO_memfile_free(asj->memfile);
+	MEM_freeN(asj->memfile);
+	MEM_freeN(asj);
+}
+
+static void wm_autosave_write(const bContext *C, wmWindowManager *wm, const char *filepath)
+{
+	const int fileflags = G.fileflags & ~(G_FILE_COMPRESS | G_FILE_COMPRESS_FRAMES | G_FILE_SPARSE_KEYS | G_FILE_AUTOPLAY | G_FILE_HISTORY);
+	AutoSaveJob *asj;
+	wmJob *wm_job;
+
+	ED_editors_flush_edits(C, false);
+
+	asj = MEM_callocN(sizeof(*asj), __func__);
+	asj->memfile = MEM_callocN(sizeof(*asj->memfile), __func__);
+	BLI_strncpy(asj->filepath, filepath, sizeof(asj->filepath));
+
+	if (!BLO_write_file_mem(CTX_data_main(C), NULL, asj->memfile, fileflags)) {
+		wm_autosave_job_free(asj);
+		return;
+	}
+
+	wm_job = WM_jobs_get(wm, NULL, wm, "Auto Saving", 0, WM_JOB_TYPE_AUTOSAVE);
+	WM_jobs_customdata_set(wm_job, asj, wm_autosave_job_free);
+	WM_jobs_timer(wm_job, 0.5, 0, 0);
+	WM_jobs_callbacks(wm_job, wm_autosave_job_startjob, NULL, NULL, NULL);
+
+	WM_jobs_start(wm, wm_job);
+}
+
 void wm_autosave_timer(const bContext *C, wmWindowManager *wm, wmTimer *UNUSED(wt))
 {
 	wmWindow *win;
@@ -1280,25 +1333,20 @@ void wm_autosave_timer(const bContext *C, wmWindowManager *wm, wmTimer *UNUSED(w
 		}
 	}
 
-	wm_autosave_location(filepath);
-
-	if (U.uiflag & USER_GLOBALUNDO) {
-		/* fast save of last undobuffer, now with UI */
-		struct MemFile *memfile = ED_undosys_stack_memfile_get_active(wm->undo_stack);
-		if (memfile) {
-			BLO_memfile_write_file(memfile, filepath);
+	/* the previous auto-save is still being written, try again in 10 seconds */
+	if (WM_jobs_test(wm, wm, WM_JOB_TYPE_AUTOSAVE)) {
+		wm->autosavetimer = WM_event_add_timer(wm, NULL, TIMERAUTOSAVE, 10.0);
+		if (G.debug) {
+			printf("Skipping auto-save, previous auto-save still running, retrying in ten seconds...\n");
 		}
+		return;
 	}
-	else {
-		/*  save as regular blend file */
-		int fileflags = G.fileflags & ~(G_FILE_COMPRESS | G_FILE_AUTOPLAY | G_FILE_HISTORY);
 
-		ED_editors_flush_edits(C, false);
+	wm_autosave_location(filepath);
+
+	/* Error reporting into console */
+	wm_autosave_write(C, wm, filepath);
 
-		/* Error reporting into console */
-		BLO_write_file(CTX_data_main(C), filepath, fileflags, NULL, NULL);
-	}
-	/* do timer after file write, just in case file write takes a long time */
 	wm->autosavetimer = WM_event_add_timer(wm, NULL, TIMERAUTOSAVE, U.savetime * 60.0);
 }
 
@@ -1419,7 +1467,7 @@ static int wm_homefile_write_exec(bContext *C, wmOperator *op)
 	ED_editors_flush_edits(C, false);
 
 	/*  force save as regular blend file */
-	fileflags = G.fileflags & ~(G_FILE_COMPRESS | G_FILE_AUTOPLAY | G_FILE_HISTORY);
+	fileflags = G.fileflags & ~(G_FILE_COMPRESS | G_FILE_COMPRESS_FRAMES | G_FILE_SPARSE_KEYS | G_FILE_AUTOPLAY | G_FILE_HISTORY);
 
 	if (BLO_write_file(bmain, filepath, fileflags | G_FILE_USERPREFS, op->reports, NULL) == 0) {
 		printf("fail\n");
@@ -2020,6 +2068,18 @@ static void save_set_compress(wmOperator *op)
 			RNA_property_boolean_set(op->ptr, prop, (U.flag & USER_FILECOMPRESS) != 0);
 		}
 	}
+
+	prop = RNA_struct_find_property(op->ptr, "compress_frames");
+	if (!RNA_property_is_set(op->ptr, prop)) {
+		/* keep flag for existing file */
+		RNA_property_boolean_set(op->ptr, prop, G.save_over && (G.fileflags & G_FILE_COMPRESS_FRAMES) != 0);
+	}
+
+	prop = RNA_struct_find_property(op->ptr, "sparse_shape_keys");
+	if (!RNA_property_is_set(op->ptr, prop)) {
+		/* keep flag for existing file */
+		RNA_property_boolean_set(op->ptr, prop, G.save_over && (G.fileflags & G_FILE_SPARSE_KEYS) != 0);
+	}
 }
 
 static void save_set_filepath(bContext *C, wmOperator *op)
@@ -2078,6 +2138,12 @@ static int wm_save_as_mainfile_exec(bContext *C, wmOperator *op)
 	SET_FLAG_FROM_TEST(
 	        fileflags, RNA_boolean_get(op->ptr, "compress"),
 	        G_FILE_COMPRESS);
+	SET_FLAG_FROM_TEST(
+	        fileflags, RNA_boolean_get(op->ptr, "compress_frames"),
+	        G_FILE_COMPRESS_FRAMES);
+	SET_FLAG_FROM_TEST(
+	        fileflags, RNA_boolean_get(op->ptr, "sparse_shape_keys"),
+	        G_FILE_SPARSE_KEYS);
 	SET_FLAG_FROM_TEST(
 	        fileflags, RNA_boolean_get(op->ptr, "relative_remap"),
 	        G_FILE_RELATIVE_REMAP);
@@ -2131,6 +2197,10 @@ void WM_OT_save_as_mainfile(wmOperatorType *ot)
 	        ot, FILE_TYPE_FOLDER | FILE_TYPE_BLENDER, FILE_BLENDER, FILE_SAVE,
 	        WM_FILESEL_FILEPATH, FILE_DEFAULTDISPLAY, FILE_SORT_ALPHA);
 	RNA_def_boolean(ot->srna, "compress", false, "Compress", "Write compressed .blend file");
+	RNA_def_boolean(ot->srna, "compress_frames", false, "Compress Frames",
+	                "Compress in independent blocks which are decompressed in parallel on load");
+	RNA_def_boolean(ot->srna, "sparse_shape_keys", false, "Sparse Shape Keys",
+	                "Only store the points shape keys move (can't be read by older versions of Blender)");
 	RNA_def_boolean(ot->srna, "relative_remap", true, "Remap Relative",
 	                "Remap relative paths when saving in a different directory");
 	prop = RNA_def_boolean(ot->srna, "copy", false, "Save Copy",
@@ -2195,6 +2265,10 @@ void WM_OT_save_mainfile(wmOperatorType *ot)
 	        ot, FILE_TYPE_FOLDER | FILE_TYPE_BLENDER, FILE_BLENDER, FILE_SAVE,
 	        WM_FILESEL_FILEPATH, FILE_DEFAULTDISPLAY, FILE_SORT_ALPHA);
 	RNA_def_boolean(ot->srna, "compress", false, "Compress", "Write compressed .blend file");
+	RNA_def_boolean(ot->srna, "compress_frames", false, "Compress Frames",
+	                "Compress in independent blocks which are decompressed in parallel on load");
+	RNA_def_boolean(ot->srna, "sparse_shape_keys", false, "Sparse Shape Keys",
+	                "Only store the points shape keys move (can't be read by older versions of Blender)");
 	RNA_def_boolean(ot->srna, "relative_remap", false, "Remap Relative",
 	                "Remap relative paths when saving in a different directory");
 
@@ -274,22 +274,31 @@ int main(
 
 	/* NOTE: Special exception for guarded allocator type switch:
 	 *       we need to perform switch from lock-free to fully
-	 *       guarded allocator before any allocation happened.
+	 *       guarded (or thread caching) allocator before any allocation happened.
 	 */
 	{
 		int i;
+		bool use_tcache = false;
 		for (i = 0; i < argc; i++) {
 			if (STREQ(argv[i], "--debug") || STREQ(argv[i], "-d") ||
 			    STREQ(argv[i], "--debug-memory") || STREQ(argv[i], "--debug-all"))
 			{
 				printf("Switching to fully guarded memory allocator.\n");
 				MEM_use_guarded_allocator();
+				/* Guarded allocator takes precedence. */
+				use_tcache = false;
 				break;
 			}
+			else if (STREQ(argv[i], "--enable-memory-thread-cache")) {
+				use_tcache = true;
+			}
 			else if (STREQ(argv[i], "--")) {
 				break;
 			}
 		}
+		if (use_tcache) {
+			MEM_use_tcache_allocator();
+		}
 	}
 
 #ifdef BUILD_DATE
@@ -497,6 +497,7 @@ static int arg_handle_print_help(int UNUSED(argc), const char **UNUSED(argv), vo
 	BLI_argsPrintArgDoc(ba, "--render-output");
 	BLI_argsPrintArgDoc(ba, "--engine");
 	BLI_argsPrintArgDoc(ba, "--threads");
+	BLI_argsPrintArgDoc(ba, "--threads-numa");
 
 	printf("\n");
 	printf("Format Options:\n");
@@ -567,6 +568,7 @@ static int arg_handle_print_help(int UNUSED(argc), const char **UNUSED(argv), vo
 	BLI_argsPrintArgDoc(ba, "--debug-depsgraph-build");
 	BLI_argsPrintArgDoc(ba, "--debug-depsgraph-tag");
 	BLI_argsPrintArgDoc(ba, "--debug-depsgraph-no-threads");
+	BLI_argsPrintArgDoc(ba, "--debug-depsgraph-no-incremental");
 
 	BLI_argsPrintArgDoc(ba, "--debug-gpumem");
 	BLI_argsPrintArgDoc(ba, "--debug-gpu-shaders");
@@ -607,6 +609,7 @@ static int arg_handle_print_help(int UNUSED(argc), const char **UNUSED(argv), vo
 	printf("Experimental Features:\n");
 	BLI_argsPrintArgDoc(ba, "--enable-new-depsgraph");
 	BLI_argsPrintArgDoc(ba, "--enable-new-basic-shader-glsl");
+	BLI_argsPrintArgDoc(ba, "--enable-memory-thread-cache");
 
 	/* Other options _must_ be last (anything not handled will show here) */
 	printf("\n");
@@ -894,6 +897,8 @@ static const char arg_handle_debug_mode_generic_set_doc_depsgraph_eval[] =
 "\n\tEnable debug messages from dependency graph related on evaluation.";
 static const char arg_handle_debug_mode_generic_set_doc_depsgraph_no_threads[] =
 "\n\tSwitch dependency graph to a single threaded evaluation.";
+static const char arg_handle_debug_mode_generic_set_doc_depsgraph_no_incremental[] =
+"\n\tAlways rebuild the whole dependency graph when relations change.";
 static const char arg_handle_debug_mode_generic_set_doc_depsgraph_pretty[] =
 "\n\tEnable colors for dependency graph debug messages.";
 static const char arg_handle_debug_mode_generic_set_doc_gpumem[] =
@@ -1339,6 +1344,15 @@ static int arg_handle_threads_set(int argc, const char **argv, void *UNUSED(data
 	}
 }
 
+static const char arg_handle_threads_numa_set_doc[] =
+"\n\tDistribute task scheduler threads across NUMA nodes and pin them to their nodes."
+;
+static int arg_handle_threads_numa_set(int UNUSED(argc), const char **UNUSED(argv), void *UNUSED(data))
+{
+	BLI_system_numa_scheduling_set(true);
+	return 0;
+}
+
 static const char arg_handle_depsgraph_use_new_doc[] =
 "\n\tUse new dependency graph."
 ;
@@ -1359,6 +1373,16 @@ static int arg_handle_basic_shader_glsl_use_new(int UNUSED(argc), const char **U
 	return 0;
 }
 
+static const char arg_handle_memory_thread_cache_set_doc[] =
+"\n\tUse a memory allocator with per-thread caches, for faster allocation from many threads.\n"
+"\t(only has an effect when memory debugging is not enabled)."
+;
+static int arg_handle_memory_thread_cache_set(int UNUSED(argc), const char **UNUSED(argv), void *UNUSED(data))
+{
+	/* Handled in main(), before any allocation happens. */
+	return 0;
+}
+
 static const char arg_handle_verbosity_set_doc[] =
 "<verbose>\n"
 "\tSet logging verbosity level."
@@ -2031,6 +2055,9 @@ void main_args_setup(bContext *C, bArgs *ba, SYS_SystemHandle *syshandle)
 	            CB_EX(arg_handle_debug_mode_generic_set, depsgraph_time), (void *)G_DEBUG_DEPSGRAPH_TIME);
 	BLI_argsAdd(ba, 1, NULL, "--debug-depsgraph-no-threads",
 	            CB_EX(arg_handle_debug_mode_generic_set, depsgraph_no_threads), (void *)G_DEBUG_DEPSGRAPH_NO_THREADS);
+	BLI_argsAdd(ba, 1, NULL, "--debug-depsgraph-no-incremental",
+	            CB_EX(arg_handle_debug_mode_generic_set, depsgraph_no_incremental),
+	            (void *)G_DEBUG_DEPSGRAPH_NO_INCREMENTAL);
 	BLI_argsAdd(ba, 1, NULL, "--debug-depsgraph-pretty",
 	            CB_EX(arg_handle_debug_mode_generic_set, depsgraph_pretty), (void *)G_DEBUG_DEPSGRAPH_PRETTY);
 	BLI_argsAdd(ba, 1, NULL, "--debug-gpumem",
@@ -2040,6 +2067,7 @@ void main_args_setup(bContext *C, bArgs *ba, SYS_SystemHandle *syshandle)
 
 	BLI_argsAdd(ba, 1, NULL, "--enable-new-depsgraph", CB(arg_handle_depsgraph_use_new), NULL);
 	BLI_argsAdd(ba, 1, NULL, "--enable-new-basic-shader-glsl", CB(arg_handle_basic_shader_glsl_use_new), NULL);
+	BLI_argsAdd(ba, 1, NULL, "--enable-memory-thread-cache", CB(arg_handle_memory_thread_cache_set), NULL);
 
 	BLI_argsAdd(ba, 1, NULL, "--verbose", CB(arg_handle_verbosity_set), NULL);
 
@@ -2085,6 +2113,7 @@ void main_args_setup(bContext *C, bArgs *ba, SYS_SystemHandle *syshandle)
 
 	BLI_argsAdd(ba, 4, "-F", "--render-format", CB(arg_handle_image_type_set), C);
 	BLI_argsAdd(ba, 1, "-t", "--threads", CB(arg_handle_threads_set), NULL);
+	BLI_argsAdd(ba, 1, NULL, "--threads-numa", CB(arg_handle_threads_numa_set), NULL);
 	BLI_argsAdd(ba, 4, "-x", "--use-extension", CB(arg_handle_extension_set), C);
 
 #undef CB
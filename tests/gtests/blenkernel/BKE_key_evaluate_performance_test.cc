@@ -0,0 +1,110 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_math.h"
+#include "BLI_rand.h"
+#include "BLI_threads.h"
+#include "DNA_key_types.h"
+#include "DNA_mesh_types.h"
+#include "DNA_object_types.h"
+#include "BKE_key.h"
+#include "BKE_library.h"
+#include "BKE_main.h"
+#include "BKE_mesh.h"
+#include "BKE_object.h"
+#include "PIL_time_utildefines.h"
+}
+
+/* Blending of 200 relative shape keys on a 100k vertices mesh, against a plain loop
+ * over all keys and vertices. Half of the keys have no influence. */
+
+#define NUM_VERTS 100000
+#define NUM_KEYS 200
+#define NUM_EVALUATIONS 10
+
+static Object *key_object_create(Main *bmain, RNG *rng)
+{
+	Object *ob = BKE_object_add_only_object(bmain, OB_MESH, "Mesh");
+	Mesh *me = BKE_mesh_add(bmain, "Mesh");
+	Key *key = BKE_key_add(bmain, &me->id);
+
+	ob->data = me;
+	me->key = key;
+	me->totvert = NUM_VERTS;
+	key->type = KEY_RELATIVE;
+
+	for (int i = 0; i < NUM_KEYS + 1; i++) {
+		KeyBlock *kb = BKE_keyblock_add(key, NULL);
+		float (*cos)[3] = (float (*)[3])MEM_mallocN(sizeof(*cos) * NUM_VERTS, __func__);
+		for (int v = 0; v < NUM_VERTS; v++) {
+			for (int k = 0; k < 3; k++) {
+				cos[v][k] = BLI_rng_get_float(rng);
+			}
+		}
+		kb->data = cos;
+		kb->totelem = NUM_VERTS;
+		kb->curval = (i % 2) ? BLI_rng_get_float(rng) : 0.0f;
+	}
+
+	return ob;
+}
+
+static void key_evaluate_reference(Key *key, float (*r_cos)[3])
+{
+	memcpy(r_cos, key->refkey->data, sizeof(*r_cos) * NUM_VERTS);
+
+	for (KeyBlock *kb = key->refkey->next; kb; kb = kb->next) {
+		const float (*cos)[3] = (const float (*)[3])kb->data;
+		const float (*refcos)[3] = (const float (*)[3])key->refkey->data;
+		for (int v = 0; v < NUM_VERTS; v++) {
+			for (int k = 0; k < 3; k++) {
+				r_cos[v][k] -= kb->curval * (refcos[v][k] - cos[v][k]);
+			}
+		}
+	}
+}
+
+TEST(key_evaluate, PerfRelative)
+{
+	BLI_threadapi_init();
+
+	Main *bmain = BKE_main_new();
+	RNG *rng = BLI_rng_new(0);
+	Object *ob = key_object_create(bmain, rng);
+	Key *key = ((Mesh *)ob->data)->key;
+
+	float (*cos)[3] = NULL;
+	float (*cos_ref)[3] = (float (*)[3])MEM_mallocN(sizeof(*cos_ref) * NUM_VERTS, __func__);
+
+	{
+		TIMEIT_START(key_evaluate_serial);
+		for (int i = 0; i < NUM_EVALUATIONS; i++) {
+			key_evaluate_reference(key, cos_ref);
+		}
+		TIMEIT_END(key_evaluate_serial);
+	}
+
+	{
+		TIMEIT_START(key_evaluate_object);
+		for (int i = 0; i < NUM_EVALUATIONS; i++) {
+			int totelem;
+			if (cos) {
+				MEM_freeN(cos);
+			}
+			cos = (float (*)[3])BKE_key_evaluate_object(ob, &totelem);
+			EXPECT_EQ(totelem, NUM_VERTS);
+		}
+		TIMEIT_END(key_evaluate_object);
+	}
+
+	EXPECT_EQ(memcmp(cos, cos_ref, sizeof(*cos) * NUM_VERTS), 0);
+
+	MEM_freeN(cos);
+	MEM_freeN(cos_ref);
+	BLI_rng_free(rng);
+	BKE_main_free(bmain);
+}
@@ -0,0 +1,268 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_listbase.h"
+#include "BLI_math.h"
+#include "BLI_rand.h"
+#include "BLI_string.h"
+#include "BLI_threads.h"
+#include "DNA_key_types.h"
+#include "DNA_lattice_types.h"
+#include "DNA_mesh_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_object_types.h"
+#include "BKE_deform.h"
+#include "BKE_key.h"
+#include "BKE_lattice.h"
+#include "BKE_library.h"
+#include "BKE_main.h"
+#include "BKE_mesh.h"
+#include "BKE_object.h"
+}
+
+/* Blending of relative keys on meshes and lattices, against a plain loop over all keys and
+ * elements. The element counts span several blocks and enough keys are used for the
+ * blending to run threaded. */
+
+#define NUM_VERTS 3000
+#define NUM_KEYS 30
+#define LATTICE_RES 16
+
+#define EPS 1e-5f
+
+/* Private to key.c, the mode used for meshes and lattices. */
+#define KEY_MODE_DUMMY 0
+
+static float (*key_cos_create(RNG *rng, const int tot))[3]
+{
+	float (*cos)[3] = (float (*)[3])MEM_mallocN(sizeof(*cos) * tot, __func__);
+	for (int i = 0; i < tot; i++) {
+		for (int k = 0; k < 3; k++) {
+			cos[i][k] = BLI_rng_get_float(rng);
+		}
+	}
+	return cos;
+}
+
+/* Adds a reference key with \a reftot elements and NUM_KEYS keys with \a tot elements,
+ * with a mix of muted keys, keys without influence and keys relative to other keys. */
+static void key_blocks_add(Key *key, RNG *rng, const int reftot, const int tot)
+{
+	key->type = KEY_RELATIVE;
+
+	for (int i = 0; i < NUM_KEYS + 1; i++) {
+		KeyBlock *kb = BKE_keyblock_add(key, NULL);
+		kb->totelem = (i == 0) ? reftot : tot;
+		kb->data = key_cos_create(rng, kb->totelem);
+		kb->curval = (i % 3) ? BLI_rng_get_float(rng) : 0.0f;
+		if (i % 7 == 0) {
+			kb->flag |= KEYBLOCK_MUTE;
+		}
+		/* Some keys are relative to an earlier key, or to themselves. */
+		kb->relative = (i % 4 == 0) ? (i % 5 ? i - 1 : i) : 0;
+	}
+}
+
+static void key_blend_reference(
+        Key *key, const float (*basis)[3], float **per_keyblock_weights, const int tot, float (*r_cos)[3])
+{
+	memcpy(r_cos, basis, sizeof(*r_cos) * tot);
+
+	int keyblock_index = 0;
+	for (KeyBlock *kb = (KeyBlock *)key->block.first; kb; kb = kb->next, keyblock_index++) {
+		if (kb == key->refkey || (kb->flag & KEYBLOCK_MUTE) || kb->curval == 0.0f || kb->totelem != tot) {
+			continue;
+		}
+		KeyBlock *refb = (KeyBlock *)BLI_findlink(&key->block, kb->relative);
+		if (refb == NULL) {
+			continue;
+		}
+		const float (*cos)[3] = (const float (*)[3])kb->data;
+		const float (*refcos)[3] = (const float (*)[3])refb->data;
+		const float *weights = per_keyblock_weights ? per_keyblock_weights[keyblock_index] : NULL;
+		for (int v = 0; v < tot; v++) {
+			const float fac = weights ? weights[v] * kb->curval : kb->curval;
+			for (int k = 0; k < 3; k++) {
+				r_cos[v][k] -= fac * (refcos[v][k] - cos[v][k]);
+			}
+		}
+	}
+}
+
+static void expect_cos_near(const float (*cos)[3], const float (*cos_ref)[3], const int tot)
+{
+	for (int v = 0; v < tot; v++) {
+		EXPECT_V3_NEAR(cos[v], cos_ref[v], EPS);
+	}
+}
+
+TEST(key_evaluate, MeshRelative)
+{
+	BLI_threadapi_init();
+
+	Main *bmain = BKE_main_new();
+	RNG *rng = BLI_rng_new(0);
+	Object *ob = BKE_object_add_only_object(bmain, OB_MESH, "Mesh");
+	Mesh *me = BKE_mesh_add(bmain, "Mesh");
+	Key *key = BKE_key_add(bmain, &me->id);
+
+	ob->data = me;
+	me->key = key;
+	me->totvert = NUM_VERTS;
+	key_blocks_add(key, rng, NUM_VERTS, NUM_VERTS);
+
+	float (*cos_ref)[3] = (float (*)[3])MEM_mallocN(sizeof(*cos_ref) * NUM_VERTS, __func__);
+	key_blend_reference(key, (const float (*)[3])key->refkey->data, NULL, NUM_VERTS, cos_ref);
+
+	int totelem;
+	float (*cos)[3] = (float (*)[3])BKE_key_evaluate_object(ob, &totelem);
+	EXPECT_EQ(totelem, NUM_VERTS);
+	expect_cos_near(cos, cos_ref, NUM_VERTS);
+
+	MEM_freeN(cos);
+	MEM_freeN(cos_ref);
+	BLI_rng_free(rng);
+	BKE_main_free(bmain);
+}
+
+TEST(key_evaluate, MeshRelativeWeights)
+{
+	BLI_threadapi_init();
+
+	Main *bmain = BKE_main_new();
+	RNG *rng = BLI_rng_new(1);
+	Mesh *me = BKE_mesh_add(bmain, "Mesh");
+	Key *key = BKE_key_add(bmain, &me->id);
+
+	me->key = key;
+	me->totvert = NUM_VERTS;
+	key_blocks_add(key, rng, NUM_VERTS, NUM_VERTS);
+
+	/* Every other key is limited by weights, including zero weights. */
+	float **per_keyblock_weights = (float **)MEM_callocN(sizeof(float *) * key->totkey, __func__);
+	for (int i = 0; i < key->totkey; i += 2) {
+		per_keyblock_weights[i] = (float *)MEM_mallocN(sizeof(float) * NUM_VERTS, __func__);
+		for (int v = 0; v < NUM_VERTS; v++) {
+			per_keyblock_weights[i][v] = (v % 5) ? BLI_rng_get_float(rng) : 0.0f;
+		}
+	}
+
+	float (*cos_ref)[3] = (float (*)[3])MEM_mallocN(sizeof(*cos_ref) * NUM_VERTS, __func__);
+	key_blend_reference(key, (const float (*)[3])key->refkey->data, per_keyblock_weights, NUM_VERTS, cos_ref);
+
+	float (*cos)[3] = (float (*)[3])MEM_mallocN(sizeof(*cos) * NUM_VERTS, __func__);
+	BKE_key_evaluate_relative(0, NUM_VERTS, NUM_VERTS, (char *)cos, key, NULL, per_keyblock_weights, KEY_MODE_DUMMY);
+	expect_cos_near(cos, cos_ref, NUM_VERTS);
+
+	/* A sub-range only writes its own elements. */
+	const int start = NUM_VERTS / 3, end = NUM_VERTS - 100;
+	memset(cos, 0, sizeof(*cos) * NUM_VERTS);
+	BKE_key_evaluate_relative(start, end, NUM_VERTS, (char *)cos, key, NULL, per_keyblock_weights, KEY_MODE_DUMMY);
+	for (int v = 0; v < NUM_VERTS; v++) {
+		if (v >= start && v < end) {
+			EXPECT_V3_NEAR(cos[v], cos_ref[v], EPS);
+		}
+		else {
+			EXPECT_TRUE(is_zero_v3(cos[v]));
+		}
+	}
+
+	for (int i = 0; i < key->totkey; i++) {
+		MEM_SAFE_FREE(per_keyblock_weights[i]);
+	}
+	MEM_freeN(per_keyblock_weights);
+	MEM_freeN(cos);
+	MEM_freeN(cos_ref);
+	BLI_rng_free(rng);
+	BKE_main_free(bmain);
+}
+
+TEST(key_evaluate, MeshRelativeRefkeyTotelem)
+{
+	BLI_threadapi_init();
+
+	Main *bmain = BKE_main_new();
+	RNG *rng = BLI_rng_new(2);
+	Object *ob = BKE_object_add_only_object(bmain, OB_MESH, "Mesh");
+	Mesh *me = BKE_mesh_add(bmain, "Mesh");
+	Key *key = BKE_key_add(bmain, &me->id);
+
+	ob->data = me;
+	me->key = key;
+	me->totvert = NUM_VERTS;
+	/* The reference key has twice the elements, so its every other element is the basis. */
+	key_blocks_add(key, rng, NUM_VERTS * 2, NUM_VERTS);
+
+	float (*basis)[3] = (float (*)[3])MEM_mallocN(sizeof(*basis) * NUM_VERTS, __func__);
+	for (int v = 0; v < NUM_VERTS; v++) {
+		copy_v3_v3(basis[v], ((float (*)[3])key->refkey->data)[v * 2]);
+	}
+
+	float (*cos_ref)[3] = (float (*)[3])MEM_mallocN(sizeof(*cos_ref) * NUM_VERTS, __func__);
+	key_blend_reference(key, basis, NULL, NUM_VERTS, cos_ref);
+
+	int totelem;
+	float (*cos)[3] = (float (*)[3])BKE_key_evaluate_object(ob, &totelem);
+	EXPECT_EQ(totelem, NUM_VERTS);
+	expect_cos_near(cos, cos_ref, NUM_VERTS);
+
+	MEM_freeN(cos);
+	MEM_freeN(cos_ref);
+	MEM_freeN(basis);
+	BLI_rng_free(rng);
+	BKE_main_free(bmain);
+}
+
+TEST(key_evaluate, LatticeRelativeWeights)
+{
+	BLI_threadapi_init();
+
+	Main *bmain = BKE_main_new();
+	RNG *rng = BLI_rng_new(3);
+	Object *ob = BKE_object_add_only_object(bmain, OB_LATTICE, "Lattice");
+	Lattice *lt = BKE_lattice_add(bmain, "Lattice");
+	const int tot = LATTICE_RES * LATTICE_RES * LATTICE_RES;
+
+	ob->data = lt;
+	BKE_lattice_resize(lt, LATTICE_RES, LATTICE_RES, LATTICE_RES, NULL);
+
+	Key *key = BKE_key_add(bmain, &lt->id);
+	lt->key = key;
+	key_blocks_add(key, rng, tot, tot);
+
+	/* One key limited by a vertex group on the lattice. */
+	bDeformGroup *dg = BKE_defgroup_new(ob, "Group");
+	const int def_nr = BLI_findindex(&ob->defbase, dg);
+	float *weights = (float *)MEM_mallocN(sizeof(float) * tot, __func__);
+	lt->dvert = (MDeformVert *)MEM_callocN(sizeof(MDeformVert) * tot, __func__);
+	for (int i = 0; i < tot; i++) {
+		weights[i] = (i % 3) ? BLI_rng_get_float(rng) : 0.0f;
+		if (weights[i] != 0.0f) {
+			defvert_add_index_notest(&lt->dvert[i], def_nr, weights[i]);
+		}
+	}
+
+	float **per_keyblock_weights = (float **)MEM_callocN(sizeof(float *) * key->totkey, __func__);
+	KeyBlock *kb = (KeyBlock *)BLI_findlink(&key->block, 2);
+	STRNCPY(kb->vgroup, dg->name);
+	per_keyblock_weights[2] = weights;
+
+	float (*cos_ref)[3] = (float (*)[3])MEM_mallocN(sizeof(*cos_ref) * tot, __func__);
+	key_blend_reference(key, (const float (*)[3])key->refkey->data, per_keyblock_weights, tot, cos_ref);
+
+	int totelem;
+	float (*cos)[3] = (float (*)[3])BKE_key_evaluate_object(ob, &totelem);
+	EXPECT_EQ(totelem, tot);
+	expect_cos_near(cos, cos_ref, tot);
+
+	MEM_freeN(cos);
+	MEM_freeN(cos_ref);
+	MEM_freeN(weights);
+	MEM_freeN(per_keyblock_weights);
+	BLI_rng_free(rng);
+	BKE_main_free(bmain);
+}
@@ -0,0 +1,107 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_math.h"
+#include "BLI_rand.h"
+#include "BLI_string.h"
+#include "BLI_threads.h"
+#include "DNA_curve_types.h"
+#include "DNA_lattice_types.h"
+#include "DNA_meshdata_types.h"
+#include "DNA_object_types.h"
+#include "BKE_deform.h"
+#include "BKE_lattice.h"
+#include "BKE_library.h"
+#include "BKE_main.h"
+#include "BKE_object.h"
+#include "PIL_time_utildefines.h"
+}
+
+/* Deformation of 1M vertices through a 16^3 lattice, threaded against a plain loop
+ * over calc_latt_deform(), with and without a vertex group on the lattice. */
+
+#define NUM_VERTS 1000000
+#define LATTICE_RES 16
+
+static Object *lattice_object_create(Main *bmain, RNG *rng, const bool use_vgroup)
+{
+	Object *ob = BKE_object_add_only_object(bmain, OB_LATTICE, "Lattice");
+	Lattice *lt = BKE_lattice_add(bmain, "Lattice");
+	const int tot = LATTICE_RES * LATTICE_RES * LATTICE_RES;
+
+	ob->data = lt;
+	unit_m4(ob->obmat);
+	BKE_lattice_resize(lt, LATTICE_RES, LATTICE_RES, LATTICE_RES, NULL);
+
+	for (int i = 0; i < tot; i++) {
+		for (int k = 0; k < 3; k++) {
+			lt->def[i].vec[k] += (BLI_rng_get_float(rng) - 0.5f) * 0.05f;
+		}
+	}
+
+	if (use_vgroup) {
+		BKE_defgroup_new(ob, "Group");
+		BLI_strncpy(lt->vgroup, "Group", sizeof(lt->vgroup));
+		lt->dvert = (MDeformVert *)MEM_callocN(sizeof(MDeformVert) * tot, __func__);
+		for (int i = 0; i < tot; i++) {
+			defvert_add_index_notest(&lt->dvert[i], 0, BLI_rng_get_float(rng));
+		}
+	}
+
+	return ob;
+}
+
+static void lattice_deform_perf(const bool use_vgroup)
+{
+	BLI_threadapi_init();
+
+	Main *bmain = BKE_main_new();
+	RNG *rng = BLI_rng_new(0);
+	Object *ob = lattice_object_create(bmain, rng, use_vgroup);
+
+	float (*cos)[3] = (float (*)[3])MEM_mallocN(sizeof(*cos) * NUM_VERTS, __func__);
+	float (*cos_ref)[3] = (float (*)[3])MEM_mallocN(sizeof(*cos_ref) * NUM_VERTS, __func__);
+	for (int i = 0; i < NUM_VERTS; i++) {
+		for (int k = 0; k < 3; k++) {
+			cos[i][k] = (BLI_rng_get_float(rng) - 0.5f) * 1.2f;
+		}
+	}
+	memcpy(cos_ref, cos, sizeof(*cos) * NUM_VERTS);
+
+	{
+		TIMEIT_START(lattice_deform_serial);
+		LatticeDeformData *lattice_deform_data = init_latt_deform(ob, NULL);
+		for (int i = 0; i < NUM_VERTS; i++) {
+			calc_latt_deform(lattice_deform_data, cos_ref[i], 1.0f);
+		}
+		end_latt_deform(lattice_deform_data);
+		TIMEIT_END(lattice_deform_serial);
+	}
+
+	{
+		TIMEIT_START(lattice_deform_verts);
+		lattice_deform_verts(ob, NULL, NULL, cos, NUM_VERTS, NULL, 1.0f);
+		TIMEIT_END(lattice_deform_verts);
+	}
+
+	EXPECT_EQ(memcmp(cos, cos_ref, sizeof(*cos) * NUM_VERTS), 0);
+
+	MEM_freeN(cos);
+	MEM_freeN(cos_ref);
+	BLI_rng_free(rng);
+	BKE_main_free(bmain);
+}
+
+TEST(lattice_deform, PerfLattice)
+{
+	lattice_deform_perf(false);
+}
+
+TEST(lattice_deform, PerfLatticeVertexGroup)
+{
+	lattice_deform_perf(true);
+}
@@ -0,0 +1,137 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_concurrent_hash.h"
+#include "BLI_ghash.h"
+#include "BLI_rand.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+#include "PIL_time_utildefines.h"
+}
+
+/* Scaling of ConcurrentHash against a mutex protected GHash, from 1 to 64 threads.
+ * Every thread inserts its share of random keys and looks all of them up afterwards,
+ * with a mix of keys being inserted by more than one thread. */
+
+#define NUM_KEYS 2000000
+#define NUM_LOOKUP_ROUNDS 4
+
+typedef struct PerfData {
+	unsigned int *keys;
+	int num_threads;
+
+	ConcurrentHash *chash;
+
+	GHash *ghash;
+	ThreadMutex ghash_lock;
+} PerfData;
+
+BLI_INLINE void perf_thread_range(const PerfData *data, const int thread, int *r_start, int *r_end)
+{
+	/* Ranges overlap by a half, so half of the insertions find an existing key. */
+	const int chunk = NUM_KEYS / data->num_threads;
+	*r_start = thread * chunk;
+	*r_end = MIN2(*r_start + chunk + chunk / 2, NUM_KEYS);
+}
+
+static void perf_concurrent_task(TaskPool *__restrict pool, void *taskdata, int UNUSED(threadid))
+{
+	PerfData *data = (PerfData *)BLI_task_pool_userdata(pool);
+	int start, end;
+	perf_thread_range(data, GET_INT_FROM_POINTER(taskdata), &start, &end);
+
+	for (int i = start; i < end; i++) {
+		BLI_concurrent_hash_add(data->chash, SET_UINT_IN_POINTER(data->keys[i]), SET_UINT_IN_POINTER(data->keys[i]));
+	}
+	for (int round = 0; round < NUM_LOOKUP_ROUNDS; round++) {
+		for (int i = start; i < end; i++) {
+			void *v = BLI_concurrent_hash_lookup(data->chash, SET_UINT_IN_POINTER(data->keys[i]));
+			BLI_assert(GET_UINT_FROM_POINTER(v) == data->keys[i]);
+			UNUSED_VARS_NDEBUG(v);
+		}
+	}
+}
+
+static void perf_ghash_task(TaskPool *__restrict pool, void *taskdata, int UNUSED(threadid))
+{
+	PerfData *data = (PerfData *)BLI_task_pool_userdata(pool);
+	int start, end;
+	perf_thread_range(data, GET_INT_FROM_POINTER(taskdata), &start, &end);
+
+	for (int i = start; i < end; i++) {
+		void **val_p;
+		BLI_mutex_lock(&data->ghash_lock);
+		if (!BLI_ghash_ensure_p(data->ghash, SET_UINT_IN_POINTER(data->keys[i]), &val_p)) {
+			*val_p = SET_UINT_IN_POINTER(data->keys[i]);
+		}
+		BLI_mutex_unlock(&data->ghash_lock);
+	}
+	for (int round = 0; round < NUM_LOOKUP_ROUNDS; round++) {
+		for (int i = start; i < end; i++) {
+			BLI_mutex_lock(&data->ghash_lock);
+			void *v = BLI_ghash_lookup(data->ghash, SET_UINT_IN_POINTER(data->keys[i]));
+			BLI_mutex_unlock(&data->ghash_lock);
+			BLI_assert(GET_UINT_FROM_POINTER(v) == data->keys[i]);
+			UNUSED_VARS_NDEBUG(v);
+		}
+	}
+}
+
+static void perf_run(PerfData *data, TaskRunFunction run)
+{
+	TaskScheduler *scheduler = BLI_task_scheduler_create(data->num_threads);
+	TaskPool *pool = BLI_task_pool_create(scheduler, data);
+
+	for (int i = 0; i < data->num_threads; i++) {
+		BLI_task_pool_push(pool, run, SET_INT_IN_POINTER(i), false, TASK_PRIORITY_HIGH);
+	}
+	BLI_task_pool_work_and_wait(pool);
+
+	BLI_task_pool_free(pool);
+	BLI_task_scheduler_free(scheduler);
+}
+
+TEST(concurrent_hash, PerfScaling)
+{
+	BLI_threadapi_init();
+
+	PerfData data;
+	data.keys = (unsigned int *)MEM_mallocN(sizeof(*data.keys) * NUM_KEYS, __func__);
+	{
+		RNG *rng = BLI_rng_new(0);
+		for (int i = 0; i < NUM_KEYS; i++) {
+			data.keys[i] = BLI_rng_get_uint(rng);
+		}
+		BLI_rng_free(rng);
+	}
+
+	for (data.num_threads = 1; data.num_threads <= 64; data.num_threads *= 2) {
+		printf("\n========== STARTING %d threads ==========\n", data.num_threads);
+
+		data.chash = BLI_concurrent_hash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+		{
+			TIMEIT_START(concurrent_hash);
+			perf_run(&data, perf_concurrent_task);
+			TIMEIT_END(concurrent_hash);
+		}
+		BLI_concurrent_hash_free(data.chash, NULL, NULL);
+
+		data.ghash = BLI_ghash_int_new(__func__);
+		BLI_mutex_init(&data.ghash_lock);
+		{
+			TIMEIT_START(ghash_mutex);
+			perf_run(&data, perf_ghash_task);
+			TIMEIT_END(ghash_mutex);
+		}
+		BLI_mutex_end(&data.ghash_lock);
+		BLI_ghash_free(data.ghash, NULL, NULL);
+
+		printf("========== ENDED %d threads ==========\n\n", data.num_threads);
+	}
+
+	MEM_freeN(data.keys);
+}
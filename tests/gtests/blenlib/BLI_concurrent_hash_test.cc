@@ -0,0 +1,123 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_concurrent_hash.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+
+#include "atomic_ops.h"
+}
+
+#define NUM_THREADS 8
+#define NUM_KEYS 20000
+
+typedef struct StressData {
+	ConcurrentHash *chash;
+	/* Number of times each key was reported as added/created. */
+	unsigned int *num_added;
+} StressData;
+
+/* All threads insert the same keys, in a different order, checking every key they can see. */
+static void stress_add_task(TaskPool *__restrict pool, void *taskdata, int UNUSED(threadid))
+{
+	StressData *data = (StressData *)BLI_task_pool_userdata(pool);
+	const int offset = GET_INT_FROM_POINTER(taskdata) * (NUM_KEYS / NUM_THREADS);
+
+	for (int i = 0; i < NUM_KEYS; i++) {
+		const unsigned int key = (unsigned int)((i + offset) % NUM_KEYS);
+		bool added;
+		void *val = BLI_concurrent_hash_lookup_or_add(
+		        data->chash, SET_UINT_IN_POINTER(key), SET_UINT_IN_POINTER(key + 1), &added);
+		EXPECT_EQ(GET_UINT_FROM_POINTER(val), key + 1);
+		if (added) {
+			atomic_add_and_fetch_u(&data->num_added[key], 1);
+		}
+
+		/* Some earlier key, which must be visible by now. */
+		const unsigned int key_prev = (unsigned int)((i / 2 + offset) % NUM_KEYS);
+		EXPECT_EQ(GET_UINT_FROM_POINTER(BLI_concurrent_hash_lookup(data->chash, SET_UINT_IN_POINTER(key_prev))),
+		          key_prev + 1);
+	}
+}
+
+static void *stress_create_cb(const void *key, void *userdata)
+{
+	StressData *data = (StressData *)userdata;
+	atomic_add_and_fetch_u(&data->num_added[GET_UINT_FROM_POINTER(key)], 1);
+	return SET_UINT_IN_POINTER(GET_UINT_FROM_POINTER(key) + 1);
+}
+
+static void stress_create_task(TaskPool *__restrict pool, void *taskdata, int UNUSED(threadid))
+{
+	StressData *data = (StressData *)BLI_task_pool_userdata(pool);
+	const int offset = GET_INT_FROM_POINTER(taskdata) * (NUM_KEYS / NUM_THREADS);
+
+	for (int i = NUM_KEYS; i--; ) {
+		const unsigned int key = (unsigned int)((i + offset) % NUM_KEYS);
+		void *val = BLI_concurrent_hash_lookup_or_create(
+		        data->chash, SET_UINT_IN_POINTER(key), stress_create_cb, data);
+		EXPECT_EQ(GET_UINT_FROM_POINTER(val), key + 1);
+	}
+}
+
+static void concurrent_hash_stress(TaskRunFunction run)
+{
+	BLI_threadapi_init();
+
+	TaskScheduler *scheduler = BLI_task_scheduler_create(NUM_THREADS);
+	StressData data;
+	/* No reserve, so segments grow while other threads are reading. */
+	data.chash = BLI_concurrent_hash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+	data.num_added = (unsigned int *)MEM_callocN(sizeof(*data.num_added) * NUM_KEYS, __func__);
+
+	TaskPool *pool = BLI_task_pool_create(scheduler, &data);
+	for (int i = 0; i < NUM_THREADS; i++) {
+		BLI_task_pool_push(pool, run, SET_INT_IN_POINTER(i), false, TASK_PRIORITY_HIGH);
+	}
+	BLI_task_pool_work_and_wait(pool);
+	BLI_task_pool_free(pool);
+
+	EXPECT_EQ(BLI_concurrent_hash_len(data.chash), NUM_KEYS);
+	for (unsigned int key = 0; key < NUM_KEYS; key++) {
+		EXPECT_EQ(data.num_added[key], 1);
+		EXPECT_TRUE(BLI_concurrent_hash_haskey(data.chash, SET_UINT_IN_POINTER(key)));
+	}
+
+	MEM_freeN(data.num_added);
+	BLI_concurrent_hash_free(data.chash, NULL, NULL);
+	BLI_task_scheduler_free(scheduler);
+}
+
+TEST(concurrent_hash, StressAdd)
+{
+	concurrent_hash_stress(stress_add_task);
+}
+
+TEST(concurrent_hash, StressCreate)
+{
+	concurrent_hash_stress(stress_create_task);
+}
+
+TEST(concurrent_hash, Clear)
+{
+	ConcurrentHash *chash = BLI_concurrent_hash_new_ex(
+	        BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__, NUM_KEYS);
+
+	for (unsigned int key = 0; key < NUM_KEYS; key++) {
+		EXPECT_TRUE(BLI_concurrent_hash_add(chash, SET_UINT_IN_POINTER(key), NULL));
+		EXPECT_FALSE(BLI_concurrent_hash_add(chash, SET_UINT_IN_POINTER(key), NULL));
+	}
+	EXPECT_EQ(BLI_concurrent_hash_len(chash), NUM_KEYS);
+
+	BLI_concurrent_hash_clear(chash, NULL, NULL);
+	EXPECT_EQ(BLI_concurrent_hash_len(chash), 0);
+	EXPECT_FALSE(BLI_concurrent_hash_haskey(chash, SET_UINT_IN_POINTER(1)));
+	EXPECT_EQ(BLI_concurrent_hash_lookup_default(chash, SET_UINT_IN_POINTER(1), SET_INT_IN_POINTER(-1)),
+	          SET_INT_IN_POINTER(-1));
+
+	BLI_concurrent_hash_free(chash, NULL, NULL);
+}
@@ -9,6 +9,7 @@ extern "C" {
 #include "MEM_guardedalloc.h"
 #include "BLI_utildefines.h"
 #include "BLI_ghash.h"
+#include "BLI_hashmap.h"
 #include "BLI_rand.h"
 #include "BLI_string.h"
 #include "PIL_time_utildefines.h"
@@ -303,6 +304,13 @@ static void randint_ghash_tests(GHash *ghash, const char *id, const unsigned int
 	printf("========== ENDED %s ==========\n\n", id);
 }
 
+TEST(ghash, IntRandGHash1000)
+{
+	GHash *ghash = BLI_ghash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+
+	randint_ghash_tests(ghash, "RandIntGHash - GHash - 1000", 1000);
+}
+
 TEST(ghash, IntRandGHash12000)
 {
 	GHash *ghash = BLI_ghash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
@@ -310,6 +318,13 @@ TEST(ghash, IntRandGHash12000)
 	randint_ghash_tests(ghash, "RandIntGHash - GHash - 12000", 12000);
 }
 
+TEST(ghash, IntRandGHash1000000)
+{
+	GHash *ghash = BLI_ghash_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+
+	randint_ghash_tests(ghash, "RandIntGHash - GHash - 1000000", 1000000);
+}
+
 #ifdef GHASH_RUN_BIG
 TEST(ghash, IntRandGHash50000000)
 {
@@ -534,3 +549,225 @@ TEST(ghash, MultiRandIntMurmur2a200000)
 
 	multi_small_ghash_tests(ghash, "MultiSmall RandIntGHash - Murmur2a - 200000", 200000);
 }
+
+
+/* HashMap: same int cases as above, using the open-addressing table instead of GHash. */
+
+static void int_hashmap_tests(HashMap *hashmap, const char *id, const unsigned int nbr)
+{
+	printf("\n========== STARTING %s ==========\n", id);
+
+	{
+		unsigned int i = nbr;
+
+		TIMEIT_START(int_insert);
+
+#ifdef GHASH_RESERVE
+		BLI_hashmap_reserve(hashmap, nbr);
+#endif
+
+		while (i--) {
+			BLI_hashmap_insert(hashmap, i, SET_UINT_IN_POINTER(i));
+		}
+
+		TIMEIT_END(int_insert);
+	}
+
+	{
+		unsigned int i = nbr;
+
+		TIMEIT_START(int_lookup);
+
+		while (i--) {
+			void *v = BLI_hashmap_lookup(hashmap, i);
+			EXPECT_EQ(GET_UINT_FROM_POINTER(v), i);
+		}
+
+		TIMEIT_END(int_lookup);
+	}
+
+	{
+		uintptr_t k;
+		void *v;
+
+		TIMEIT_START(int_pop);
+
+		HashMapIterState pop_state = {0};
+
+		while (BLI_hashmap_pop(hashmap, &pop_state, &k, &v)) {
+			EXPECT_EQ(k, (uintptr_t)v);
+		}
+
+		TIMEIT_END(int_pop);
+	}
+	EXPECT_EQ(BLI_hashmap_len(hashmap), 0);
+
+	BLI_hashmap_free(hashmap, NULL);
+
+	printf("========== ENDED %s ==========\n\n", id);
+}
+
+TEST(hashmap, IntHashMap12000)
+{
+	HashMap *hashmap = BLI_hashmap_new(__func__);
+
+	int_hashmap_tests(hashmap, "IntHashMap - HashMap - 12000", 12000);
+}
+
+#ifdef GHASH_RUN_BIG
+TEST(hashmap, IntHashMap100000000)
+{
+	HashMap *hashmap = BLI_hashmap_new(__func__);
+
+	int_hashmap_tests(hashmap, "IntHashMap - HashMap - 100000000", 100000000);
+}
+#endif
+
+static void randint_hashmap_tests(HashMap *hashmap, const char *id, const unsigned int nbr)
+{
+	printf("\n========== STARTING %s ==========\n", id);
+
+	unsigned int *data = (unsigned int *)MEM_mallocN(sizeof(*data) * (size_t)nbr, __func__);
+	unsigned int *dt;
+	unsigned int i;
+
+	{
+		RNG *rng = BLI_rng_new(0);
+		for (i = nbr, dt = data; i--; dt++) {
+			*dt = BLI_rng_get_uint(rng);
+		}
+		BLI_rng_free(rng);
+	}
+
+	{
+		TIMEIT_START(int_insert);
+
+#ifdef GHASH_RESERVE
+		BLI_hashmap_reserve(hashmap, nbr);
+#endif
+
+		/* Random data may contain duplicates, which #BLI_hashmap_insert doesn't allow. */
+		for (i = nbr, dt = data; i--; dt++) {
+			void **val_p;
+			if (!BLI_hashmap_ensure_p(hashmap, *dt, &val_p)) {
+				*val_p = SET_UINT_IN_POINTER(*dt);
+			}
+		}
+
+		TIMEIT_END(int_insert);
+	}
+
+	{
+		TIMEIT_START(int_lookup);
+
+		for (i = nbr, dt = data; i--; dt++) {
+			void *v = BLI_hashmap_lookup(hashmap, *dt);
+			EXPECT_EQ(GET_UINT_FROM_POINTER(v), *dt);
+		}
+
+		TIMEIT_END(int_lookup);
+	}
+
+	BLI_hashmap_free(hashmap, NULL);
+	MEM_freeN(data);
+
+	printf("========== ENDED %s ==========\n\n", id);
+}
+
+TEST(hashmap, IntRandHashMap1000)
+{
+	HashMap *hashmap = BLI_hashmap_new(__func__);
+
+	randint_hashmap_tests(hashmap, "RandIntHashMap - HashMap - 1000", 1000);
+}
+
+TEST(hashmap, IntRandHashMap12000)
+{
+	HashMap *hashmap = BLI_hashmap_new(__func__);
+
+	randint_hashmap_tests(hashmap, "RandIntHashMap - HashMap - 12000", 12000);
+}
+
+TEST(hashmap, IntRandHashMap1000000)
+{
+	HashMap *hashmap = BLI_hashmap_new(__func__);
+
+	randint_hashmap_tests(hashmap, "RandIntHashMap - HashMap - 1000000", 1000000);
+}
+
+#ifdef GHASH_RUN_BIG
+TEST(hashmap, IntRandHashMap50000000)
+{
+	HashMap *hashmap = BLI_hashmap_new(__func__);
+
+	randint_hashmap_tests(hashmap, "RandIntHashMap - HashMap - 50000000", 50000000);
+}
+#endif
+
+/* MultiSmall: same as the GHash version above. */
+
+static void multi_small_hashmap_tests_one(HashMap *hashmap, RNG *rng, const unsigned int nbr)
+{
+	unsigned int *data = (unsigned int *)MEM_mallocN(sizeof(*data) * (size_t)nbr, __func__);
+	unsigned int *dt;
+	unsigned int i;
+
+	for (i = nbr, dt = data; i--; dt++) {
+		*dt = BLI_rng_get_uint(rng);
+	}
+
+#ifdef GHASH_RESERVE
+	BLI_hashmap_reserve(hashmap, nbr);
+#endif
+
+	for (i = nbr, dt = data; i--; dt++) {
+		void **val_p;
+		if (!BLI_hashmap_ensure_p(hashmap, *dt, &val_p)) {
+			*val_p = SET_UINT_IN_POINTER(*dt);
+		}
+	}
+
+	for (i = nbr, dt = data; i--; dt++) {
+		void *v = BLI_hashmap_lookup(hashmap, *dt);
+		EXPECT_EQ(GET_UINT_FROM_POINTER(v), *dt);
+	}
+
+	BLI_hashmap_clear(hashmap, NULL);
+	MEM_freeN(data);
+}
+
+static void multi_small_hashmap_tests(HashMap *hashmap, const char *id, const unsigned int nbr)
+{
+	printf("\n========== STARTING %s ==========\n", id);
+
+	RNG *rng = BLI_rng_new(0);
+
+	TIMEIT_START(multi_small_hashmap);
+
+	unsigned int i = nbr;
+	while (i--) {
+		const int nbr = 1 + (BLI_rng_get_int(rng) % TESTCASE_SIZE_SMALL) * (!(i % 100) ? 100 : (!(i % 10) ? 10 : 1));
+		multi_small_hashmap_tests_one(hashmap, rng, nbr);
+	}
+
+	TIMEIT_END(multi_small_hashmap);
+
+	BLI_hashmap_free(hashmap, NULL);
+	BLI_rng_free(rng);
+
+	printf("========== ENDED %s ==========\n\n", id);
+}
+
+TEST(hashmap, MultiRandIntHashMap2000)
+{
+	HashMap *hashmap = BLI_hashmap_new(__func__);
+
+	multi_small_hashmap_tests(hashmap, "MultiSmall RandIntHashMap - HashMap - 2000", 2000);
+}
+
+TEST(hashmap, MultiRandIntHashMap200000)
+{
+	HashMap *hashmap = BLI_hashmap_new(__func__);
+
+	multi_small_hashmap_tests(hashmap, "MultiSmall RandIntHashMap - HashMap - 200000", 200000);
+}
@@ -0,0 +1,252 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "BLI_utildefines.h"
+#include "BLI_ghash.h"
+#include "BLI_hashmap.h"
+#include "BLI_rand.h"
+}
+
+#define TESTCASE_SIZE 10000
+
+static void init_keys(unsigned int keys[TESTCASE_SIZE], const int seed)
+{
+	RNG *rng = BLI_rng_new(seed);
+	GSet *used = BLI_gset_new(BLI_ghashutil_inthash_p, BLI_ghashutil_intcmp, __func__);
+	unsigned int *k;
+	int i;
+
+	for (i = 0, k = keys; i < TESTCASE_SIZE; ) {
+		unsigned int t = BLI_rng_get_uint(rng);
+		if (BLI_gset_add(used, SET_UINT_IN_POINTER(t))) {
+			*k = t;
+			i++;
+			k++;
+		}
+	}
+	BLI_gset_free(used, NULL);
+	BLI_rng_free(rng);
+}
+
+/* Insert and then lookup all keys, ensuring we do get back the expected stored 'data'. */
+TEST(hashmap, InsertLookup)
+{
+	HashMap *hashmap = BLI_hashmap_new(__func__);
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i;
+
+	init_keys(keys, 0);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		BLI_hashmap_insert(hashmap, *k, SET_UINT_IN_POINTER(*k));
+	}
+
+	EXPECT_EQ(BLI_hashmap_len(hashmap), TESTCASE_SIZE);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		void *v = BLI_hashmap_lookup(hashmap, *k);
+		EXPECT_EQ(GET_UINT_FROM_POINTER(v), *k);
+	}
+
+	EXPECT_FALSE(BLI_hashmap_haskey(hashmap, (uintptr_t)-1));
+	EXPECT_EQ(BLI_hashmap_lookup_default(hashmap, (uintptr_t)-1, SET_INT_IN_POINTER(-1)), SET_INT_IN_POINTER(-1));
+
+	BLI_hashmap_free(hashmap, NULL);
+}
+
+/* Pointer keys, most of which only differ in their upper bits. */
+TEST(hashmap, PointerKeys)
+{
+	HashMap *hashmap = BLI_hashmap_new_ex(__func__, TESTCASE_SIZE);
+	int i;
+
+	for (i = 0; i < TESTCASE_SIZE; i++) {
+		BLI_hashmap_insert(hashmap, (uintptr_t)i << 20, SET_INT_IN_POINTER(i));
+	}
+
+	for (i = 0; i < TESTCASE_SIZE; i++) {
+		void **v = BLI_hashmap_lookup_p(hashmap, (uintptr_t)i << 20);
+		ASSERT_TRUE(v != NULL);
+		EXPECT_EQ(GET_INT_FROM_POINTER(*v), i);
+	}
+	EXPECT_TRUE(BLI_hashmap_lookup_p(hashmap, 1) == NULL);
+
+	BLI_hashmap_free(hashmap, NULL);
+}
+
+TEST(hashmap, EnsureP)
+{
+	HashMap *hashmap = BLI_hashmap_new(__func__);
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i;
+
+	init_keys(keys, 5);
+
+	/* Count every key twice. */
+	for (int pass = 0; pass < 2; pass++) {
+		for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+			void **val_p;
+			if (!BLI_hashmap_ensure_p(hashmap, *k, &val_p)) {
+				EXPECT_EQ(pass, 0);
+				*val_p = SET_INT_IN_POINTER(0);
+			}
+			*val_p = SET_INT_IN_POINTER(GET_INT_FROM_POINTER(*val_p) + 1);
+		}
+	}
+
+	EXPECT_EQ(BLI_hashmap_len(hashmap), TESTCASE_SIZE);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		EXPECT_EQ(GET_INT_FROM_POINTER(BLI_hashmap_lookup(hashmap, *k)), 2);
+	}
+
+	EXPECT_FALSE(BLI_hashmap_reinsert(hashmap, keys[0], NULL, NULL));
+	EXPECT_TRUE(BLI_hashmap_reinsert(hashmap, (uintptr_t)-1, NULL, NULL));
+	EXPECT_EQ(BLI_hashmap_len(hashmap), TESTCASE_SIZE + 1);
+
+	BLI_hashmap_free(hashmap, NULL);
+}
+
+/* Insert and remove in interleaved batches, keeping the result in sync with a GHash. */
+TEST(hashmap, InsertRemoveMatchGHash)
+{
+	HashMap *hashmap = BLI_hashmap_new(__func__);
+	GHash *ghash = BLI_ghash_int_new(__func__);
+	RNG *rng = BLI_rng_new(10);
+	int i;
+
+	for (i = 0; i < TESTCASE_SIZE * 20; i++) {
+		/* Small key range, so removals often hit existing keys and buckets get re-used. */
+		const unsigned int key = BLI_rng_get_uint(rng) % (TESTCASE_SIZE / 2);
+		if (BLI_rng_get_uint(rng) % 3) {
+			const bool added = BLI_hashmap_reinsert(hashmap, key, SET_UINT_IN_POINTER(i), NULL);
+			EXPECT_EQ(added, BLI_ghash_reinsert(ghash, SET_UINT_IN_POINTER(key), SET_UINT_IN_POINTER(i), NULL, NULL));
+		}
+		else {
+			const bool removed = BLI_hashmap_remove(hashmap, key, NULL);
+			EXPECT_EQ(removed, BLI_ghash_remove(ghash, SET_UINT_IN_POINTER(key), NULL, NULL));
+		}
+	}
+
+	EXPECT_EQ(BLI_hashmap_len(hashmap), BLI_ghash_len(ghash));
+
+	{
+		HashMapIterator hmi;
+		unsigned int len = 0;
+		HASHMAP_ITER (hmi, hashmap) {
+			void **v = BLI_ghash_lookup_p(ghash, SET_UINT_IN_POINTER(BLI_hashmapIterator_getKey(&hmi)));
+			ASSERT_TRUE(v != NULL);
+			EXPECT_EQ(*v, BLI_hashmapIterator_getValue(&hmi));
+			len++;
+		}
+		EXPECT_EQ(len, BLI_ghash_len(ghash));
+	}
+
+	BLI_rng_free(rng);
+	BLI_ghash_free(ghash, NULL, NULL);
+	BLI_hashmap_free(hashmap, NULL);
+}
+
+/* Check copy. */
+TEST(hashmap, Copy)
+{
+	HashMap *hashmap = BLI_hashmap_new(__func__);
+	HashMap *hashmap_copy;
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i;
+
+	init_keys(keys, 30);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		BLI_hashmap_insert(hashmap, *k, SET_UINT_IN_POINTER(*k));
+	}
+
+	hashmap_copy = BLI_hashmap_copy(hashmap);
+	BLI_hashmap_clear(hashmap, NULL);
+
+	EXPECT_EQ(BLI_hashmap_len(hashmap), 0);
+	EXPECT_EQ(BLI_hashmap_len(hashmap_copy), TESTCASE_SIZE);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		void *v = BLI_hashmap_lookup(hashmap_copy, *k);
+		EXPECT_EQ(GET_UINT_FROM_POINTER(v), *k);
+		EXPECT_FALSE(BLI_hashmap_haskey(hashmap, *k));
+	}
+
+	BLI_hashmap_free(hashmap, NULL);
+	BLI_hashmap_free(hashmap_copy, NULL);
+}
+
+/* Check pop. */
+TEST(hashmap, Pop)
+{
+	HashMap *hashmap = BLI_hashmap_new(__func__);
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i;
+
+	init_keys(keys, 30);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		BLI_hashmap_insert(hashmap, *k, SET_UINT_IN_POINTER(*k));
+	}
+
+	HashMapIterState pop_state = {0};
+
+	for (i = TESTCASE_SIZE / 2; i--; ) {
+		uintptr_t k;
+		void *v;
+		bool success = BLI_hashmap_pop(hashmap, &pop_state, &k, &v);
+		EXPECT_EQ(k, (uintptr_t)v);
+		EXPECT_TRUE(success);
+
+		if (i % 2) {
+			BLI_hashmap_reinsert(hashmap, (uintptr_t)(i * 4), SET_UINT_IN_POINTER(i * 4), NULL);
+		}
+	}
+
+	{
+		uintptr_t k;
+		void *v;
+		while (BLI_hashmap_pop(hashmap, &pop_state, &k, &v)) {
+			EXPECT_EQ(k, (uintptr_t)v);
+		}
+	}
+	EXPECT_EQ(BLI_hashmap_len(hashmap), 0);
+
+	BLI_hashmap_free(hashmap, NULL);
+}
+
+TEST(hashset, AddRemove)
+{
+	HashSet *hashset = BLI_hashset_new(__func__);
+	unsigned int keys[TESTCASE_SIZE], *k;
+	int i;
+
+	init_keys(keys, 40);
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		EXPECT_TRUE(BLI_hashset_add(hashset, *k));
+		EXPECT_FALSE(BLI_hashset_add(hashset, *k));
+	}
+	EXPECT_EQ(BLI_hashset_len(hashset), TESTCASE_SIZE);
+
+	{
+		HashSetIterator hsi;
+		unsigned int len = 0;
+		HASHSET_ITER (hsi, hashset) {
+			len++;
+		}
+		EXPECT_EQ(len, TESTCASE_SIZE);
+	}
+
+	for (i = TESTCASE_SIZE, k = keys; i--; k++) {
+		EXPECT_TRUE(BLI_hashset_haskey(hashset, *k));
+		EXPECT_TRUE(BLI_hashset_remove(hashset, *k));
+		EXPECT_FALSE(BLI_hashset_haskey(hashset, *k));
+	}
+	EXPECT_EQ(BLI_hashset_len(hashset), 0);
+
+	BLI_hashset_free(hashset);
+}
@@ -0,0 +1,147 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_utildefines.h"
+#include "BLI_mempool.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+}
+
+#define NUM_THREADS 8
+#define NUM_ELEMS 20000
+
+typedef struct Elem {
+	/* with BLI_MEMPOOL_ALLOW_ITER, the second pointer is the 'freeword' */
+	void *pad;
+	int thread;
+	int index;
+} Elem;
+
+TEST(mempool, AllocFreeIter)
+{
+	BLI_mempool *pool = BLI_mempool_create(sizeof(Elem), 0, 64, BLI_MEMPOOL_ALLOW_ITER);
+	Elem **elems = (Elem **)MEM_mallocN(sizeof(*elems) * NUM_ELEMS, __func__);
+
+	for (int i = 0; i < NUM_ELEMS; i++) {
+		elems[i] = (Elem *)BLI_mempool_calloc(pool);
+		elems[i]->index = i;
+	}
+	/* free every odd element */
+	for (int i = 1; i < NUM_ELEMS; i += 2) {
+		BLI_mempool_free(pool, elems[i]);
+	}
+	EXPECT_EQ(BLI_mempool_len(pool), NUM_ELEMS / 2);
+
+	{
+		BLI_mempool_iter iter;
+		Elem *elem;
+		int len = 0;
+		BLI_mempool_iternew(pool, &iter);
+		while ((elem = (Elem *)BLI_mempool_iterstep(&iter))) {
+			EXPECT_EQ(elem->index % 2, 0);
+			len++;
+		}
+		EXPECT_EQ(len, NUM_ELEMS / 2);
+	}
+
+	MEM_freeN(elems);
+	BLI_mempool_destroy(pool);
+}
+
+typedef struct ThreadData {
+	BLI_mempool *pool;
+	/* elements every thread keeps allocated at the end */
+	Elem *elems[NUM_THREADS][NUM_ELEMS];
+} ThreadData;
+
+/* Every thread allocates its elements, frees half of them and allocates them again,
+ * so elements move between the thread caches and the pool. */
+static void threaded_alloc_task(TaskPool *__restrict pool, void *taskdata, int UNUSED(threadid))
+{
+	ThreadData *data = (ThreadData *)BLI_task_pool_userdata(pool);
+	const int thread = GET_INT_FROM_POINTER(taskdata);
+	Elem **elems = data->elems[thread];
+	BLI_mempool_thread_cache *cache = BLI_mempool_thread_cache_create(data->pool);
+
+	for (int i = 0; i < NUM_ELEMS; i++) {
+		elems[i] = (Elem *)BLI_mempool_thread_cache_alloc(cache);
+		elems[i]->thread = thread;
+		elems[i]->index = i;
+	}
+	for (int i = 0; i < NUM_ELEMS; i += 2) {
+		EXPECT_EQ(elems[i]->thread, thread);
+		EXPECT_EQ(elems[i]->index, i);
+		BLI_mempool_thread_cache_free(cache, elems[i]);
+	}
+	/* allow other threads to use the freed elements */
+	BLI_mempool_thread_cache_flush(cache);
+	for (int i = 0; i < NUM_ELEMS; i += 2) {
+		elems[i] = (Elem *)BLI_mempool_thread_cache_calloc(cache);
+		elems[i]->thread = thread;
+		elems[i]->index = i;
+	}
+
+	BLI_mempool_thread_cache_destroy(cache);
+}
+
+TEST(mempool, ThreadCache)
+{
+	BLI_threadapi_init();
+
+	TaskScheduler *scheduler = BLI_task_scheduler_create(NUM_THREADS);
+	ThreadData *data = (ThreadData *)MEM_mallocN(sizeof(*data), __func__);
+	data->pool = BLI_mempool_create(sizeof(Elem), 0, 512, BLI_MEMPOOL_ALLOW_ITER | BLI_MEMPOOL_THREADSAFE);
+
+	TaskPool *pool = BLI_task_pool_create(scheduler, data);
+	for (int i = 0; i < NUM_THREADS; i++) {
+		BLI_task_pool_push(pool, threaded_alloc_task, SET_INT_IN_POINTER(i), false, TASK_PRIORITY_HIGH);
+	}
+	BLI_task_pool_work_and_wait(pool);
+	BLI_task_pool_free(pool);
+
+	EXPECT_EQ(BLI_mempool_len(data->pool), NUM_THREADS * NUM_ELEMS);
+
+	/* all elements are still intact, and iteration finds each of them once */
+	for (int thread = 0; thread < NUM_THREADS; thread++) {
+		for (int i = 0; i < NUM_ELEMS; i++) {
+			EXPECT_EQ(data->elems[thread][i]->thread, thread);
+			EXPECT_EQ(data->elems[thread][i]->index, i);
+		}
+	}
+	{
+		BLI_mempool_iter iter;
+		Elem *elem;
+		int len = 0;
+		BLI_mempool_iternew(data->pool, &iter);
+		while ((elem = (Elem *)BLI_mempool_iterstep(&iter))) {
+			EXPECT_EQ(data->elems[elem->thread][elem->index], elem);
+			len++;
+		}
+		EXPECT_EQ(len, NUM_THREADS * NUM_ELEMS);
+	}
+
+	/* elements held by a cache are not counted as used */
+	{
+		BLI_mempool_thread_cache *cache = BLI_mempool_thread_cache_create(data->pool);
+		for (int i = 0; i < 10; i++) {
+			BLI_mempool_thread_cache_free(cache, data->elems[0][i]);
+		}
+		EXPECT_EQ(BLI_mempool_len(data->pool), NUM_THREADS * NUM_ELEMS - 10);
+		BLI_mempool_free(data->pool, data->elems[0][10]);
+		EXPECT_EQ(BLI_mempool_len(data->pool), NUM_THREADS * NUM_ELEMS - 11);
+
+		BLI_mempool_clear(data->pool);
+		EXPECT_EQ(BLI_mempool_len(data->pool), 0);
+		void *elem = BLI_mempool_thread_cache_alloc(cache);
+		EXPECT_TRUE(elem != NULL);
+		EXPECT_EQ(BLI_mempool_len(data->pool), 1);
+		BLI_mempool_thread_cache_destroy(cache);
+	}
+
+	BLI_mempool_destroy(data->pool);
+	MEM_freeN(data);
+	BLI_task_scheduler_free(scheduler);
+}
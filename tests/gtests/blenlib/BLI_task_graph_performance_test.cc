@@ -0,0 +1,122 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+#include "BLI_utildefines.h"
+#include "PIL_time_utildefines.h"
+};
+
+/* Measures per-execution overhead of the task graph: nodes are doing almost
+ * no work, so timing is dominated by scheduling. */
+
+#define NUM_NODES 100000
+#define NUM_RUNS 10
+
+static void graph_perf_run_func(void *__restrict taskdata, int UNUSED(thread_id))
+{
+	int *value = (int *)taskdata;
+	*value += 1;
+}
+
+static void graph_perf_test(const char *id, TaskGraph *graph, int *values)
+{
+	TaskScheduler *scheduler = BLI_task_scheduler_get();
+
+	printf("\n========== STARTING %s (%d nodes, %d threads) ==========\n",
+	       id, BLI_task_graph_num_nodes(graph), BLI_task_scheduler_num_threads(scheduler));
+
+	TIMEIT_START(work_and_wait);
+	for (int run = 0; run < NUM_RUNS; run++) {
+		BLI_task_graph_work_and_wait(scheduler, graph);
+	}
+	TIMEIT_END(work_and_wait);
+
+	for (int i = 0; i < NUM_NODES; i++) {
+		EXPECT_EQ(values[i], NUM_RUNS);
+	}
+
+	printf("========== ENDED %s ==========\n\n", id);
+}
+
+/* All nodes are independent. */
+TEST(task_graph, PerfIndependent)
+{
+	BLI_threadapi_init();
+	int *values = (int *)MEM_callocN(sizeof(int) * NUM_NODES, __func__);
+	TaskGraph *graph = BLI_task_graph_create();
+
+	TIMEIT_START(build);
+	for (int i = 0; i < NUM_NODES; i++) {
+		BLI_task_graph_node_create(graph, graph_perf_run_func, &values[i], NULL);
+	}
+	TIMEIT_END(build);
+
+	graph_perf_test("Independent nodes", graph, values);
+
+	BLI_task_graph_free(graph);
+	MEM_freeN(values);
+}
+
+/* Single chain, no parallelism at all. */
+TEST(task_graph, PerfChain)
+{
+	BLI_threadapi_init();
+	int *values = (int *)MEM_callocN(sizeof(int) * NUM_NODES, __func__);
+	TaskGraph *graph = BLI_task_graph_create();
+	TaskGraphNode *prev_node = NULL;
+
+	TIMEIT_START(build);
+	for (int i = 0; i < NUM_NODES; i++) {
+		TaskGraphNode *node = BLI_task_graph_node_create(graph, graph_perf_run_func, &values[i], NULL);
+		if (prev_node != NULL) {
+			BLI_task_graph_edge_create(graph, prev_node, node);
+		}
+		prev_node = node;
+	}
+	TIMEIT_END(build);
+
+	graph_perf_test("Chain", graph, values);
+
+	BLI_task_graph_free(graph);
+	MEM_freeN(values);
+}
+
+/* Layers of nodes, every node depends on two nodes of the previous layer,
+ * similar to what dependency graph of a rig looks like. */
+static void graph_perf_layers(const int width)
+{
+	int *values = (int *)MEM_callocN(sizeof(int) * NUM_NODES, __func__);
+	TaskGraphNode **nodes = (TaskGraphNode **)MEM_mallocN(sizeof(*nodes) * NUM_NODES, __func__);
+	TaskGraph *graph = BLI_task_graph_create();
+	char id[64];
+
+	TIMEIT_START(build);
+	for (int i = 0; i < NUM_NODES; i++) {
+		nodes[i] = BLI_task_graph_node_create(graph, graph_perf_run_func, &values[i], NULL);
+		if (i >= width) {
+			const int layer_start = (i / width - 1) * width;
+			BLI_task_graph_edge_create(graph, nodes[i - width], nodes[i]);
+			BLI_task_graph_edge_create(graph, nodes[layer_start + (i + 1) % width], nodes[i]);
+		}
+	}
+	TIMEIT_END(build);
+
+	snprintf(id, sizeof(id), "Layers of width %d", width);
+	graph_perf_test(id, graph, values);
+
+	BLI_task_graph_free(graph);
+	MEM_freeN(nodes);
+	MEM_freeN(values);
+}
+
+TEST(task_graph, PerfLayers)
+{
+	BLI_threadapi_init();
+	graph_perf_layers(4);
+	graph_perf_layers(100);
+	graph_perf_layers(10000);
+}
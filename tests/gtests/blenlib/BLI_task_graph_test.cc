@@ -0,0 +1,126 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "atomic_ops.h"
+
+extern "C" {
+#include "MEM_guardedalloc.h"
+#include "BLI_task.h"
+#include "BLI_threads.h"
+#include "BLI_utildefines.h"
+};
+
+#define NUM_NODES 1000
+
+typedef struct GraphTestData {
+	/* Counter used to stamp execution order. */
+	uint32_t *counter;
+	uint32_t order;
+	int num_runs;
+} GraphTestData;
+
+static void graph_test_run_func(void *__restrict taskdata, int UNUSED(thread_id))
+{
+	GraphTestData *data = (GraphTestData *)taskdata;
+	data->order = atomic_add_and_fetch_uint32(data->counter, 1);
+	data->num_runs++;
+}
+
+TEST(task_graph, Chain)
+{
+	BLI_threadapi_init();
+	TaskScheduler *scheduler = BLI_task_scheduler_create(4);
+	TaskGraph *graph = BLI_task_graph_create();
+	GraphTestData data[NUM_NODES];
+	TaskGraphNode *nodes[NUM_NODES];
+	uint32_t counter = 0;
+
+	for (int i = 0; i < NUM_NODES; i++) {
+		data[i].counter = &counter;
+		data[i].num_runs = 0;
+		nodes[i] = BLI_task_graph_node_create(graph, graph_test_run_func, &data[i], NULL);
+		if (i > 0) {
+			BLI_task_graph_edge_create(graph, nodes[i - 1], nodes[i]);
+		}
+	}
+
+	BLI_task_graph_work_and_wait(scheduler, graph);
+
+	for (int i = 0; i < NUM_NODES; i++) {
+		EXPECT_EQ(data[i].num_runs, 1);
+		EXPECT_EQ(data[i].order, (uint32_t)i + 1);
+	}
+
+	BLI_task_graph_free(graph);
+	BLI_task_scheduler_free(scheduler);
+}
+
+/* Every node depends on two nodes of the previous layer, graph is executed
+ * several times. */
+TEST(task_graph, LayersMultipleRuns)
+{
+	const int width = 10, depth = NUM_NODES / 10, num_runs = 5;
+	BLI_threadapi_init();
+	TaskScheduler *scheduler = BLI_task_scheduler_create(4);
+	TaskGraph *graph = BLI_task_graph_create();
+	GraphTestData data[NUM_NODES];
+	TaskGraphNode *nodes[NUM_NODES];
+	uint32_t counter = 0;
+
+	for (int i = 0; i < NUM_NODES; i++) {
+		data[i].counter = &counter;
+		data[i].num_runs = 0;
+		nodes[i] = BLI_task_graph_node_create(graph, graph_test_run_func, &data[i], NULL);
+	}
+	for (int layer = 1; layer < depth; layer++) {
+		for (int i = 0; i < width; i++) {
+			TaskGraphNode *node = nodes[layer * width + i];
+			BLI_task_graph_edge_create(graph, nodes[(layer - 1) * width + i], node);
+			BLI_task_graph_edge_create(graph, nodes[(layer - 1) * width + (i + 1) % width], node);
+		}
+	}
+	EXPECT_EQ(BLI_task_graph_num_nodes(graph), NUM_NODES);
+
+	for (int run = 0; run < num_runs; run++) {
+		counter = 0;
+		BLI_task_graph_work_and_wait(scheduler, graph);
+		for (int layer = 1; layer < depth; layer++) {
+			for (int i = 0; i < width; i++) {
+				const uint32_t order = data[layer * width + i].order;
+				EXPECT_GT(order, data[(layer - 1) * width + i].order);
+				EXPECT_GT(order, data[(layer - 1) * width + (i + 1) % width].order);
+			}
+		}
+	}
+
+	for (int i = 0; i < NUM_NODES; i++) {
+		EXPECT_EQ(data[i].num_runs, num_runs);
+	}
+
+	BLI_task_graph_free(graph);
+	BLI_task_scheduler_free(scheduler);
+}
+
+static int num_freed = 0;
+
+static void graph_test_free_func(void *taskdata)
+{
+	MEM_freeN(taskdata);
+	num_freed++;
+}
+
+static void graph_test_noop_func(void *__restrict UNUSED(taskdata), int UNUSED(thread_id))
+{
+}
+
+TEST(task_graph, FreeTaskData)
+{
+	TaskGraph *graph = BLI_task_graph_create();
+	num_freed = 0;
+	for (int i = 0; i < 10; i++) {
+		BLI_task_graph_node_create(graph, graph_test_noop_func, MEM_mallocN(16, __func__), graph_test_free_func);
+	}
+	BLI_task_graph_free(graph);
+	EXPECT_EQ(num_freed, 10);
+}
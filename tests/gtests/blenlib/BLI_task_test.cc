@@ -2,13 +2,18 @@
 
 #include "testing/testing.h"
 #include <string.h>
+#include <thread>
 
 #include "atomic_ops.h"
 
 extern "C" {
+#include "MEM_guardedalloc.h"
 #include "BLI_mempool.h"
+#include "BLI_system.h"
 #include "BLI_task.h"
+#include "BLI_threads.h"
 #include "BLI_utildefines.h"
+#include "PIL_time_utildefines.h"
 };
 
 #define NUM_ITEMS 10000
@@ -74,3 +79,282 @@ TEST(task, MempoolIter)
 
 	BLI_mempool_destroy(mempool);
 }
+
+/* Task pool with nested task spawning, exercises work stealing between deques. */
+
+#define NUM_TASKS_PER_LEVEL 4
+#define NUM_LEVELS 7
+
+static void task_spawn_func(TaskPool *__restrict pool, void *taskdata, int thread_id)
+{
+	int level = GET_INT_FROM_POINTER(taskdata);
+	int *num_done = (int *)BLI_task_pool_userdata(pool);
+
+	atomic_add_and_fetch_uint32((uint32_t *)num_done, 1);
+
+	if (level < NUM_LEVELS) {
+		BLI_task_pool_delayed_push_begin(pool, thread_id);
+		for (int i = 0; i < NUM_TASKS_PER_LEVEL; i++) {
+			BLI_task_pool_push_from_thread(
+			        pool, task_spawn_func, SET_INT_IN_POINTER(level + 1), false, TASK_PRIORITY_HIGH, thread_id);
+		}
+		BLI_task_pool_delayed_push_end(pool, thread_id);
+	}
+}
+
+static int task_spawn_expected_num(void)
+{
+	int num = 0, num_level = 1;
+	for (int level = 0; level <= NUM_LEVELS; level++) {
+		num += num_level;
+		num_level *= NUM_TASKS_PER_LEVEL;
+	}
+	return num;
+}
+
+TEST(task, PoolNestedSpawn)
+{
+	BLI_threadapi_init();
+	for (int num_threads = 1; num_threads <= 8; num_threads *= 2) {
+		TaskScheduler *scheduler = BLI_task_scheduler_create(num_threads);
+		int num_done = 0;
+		TaskPool *pool = BLI_task_pool_create(scheduler, &num_done);
+
+		BLI_task_pool_push_from_thread(
+		        pool, task_spawn_func, SET_INT_IN_POINTER(0), false, TASK_PRIORITY_HIGH, 0);
+		BLI_task_pool_work_and_wait(pool);
+
+		EXPECT_EQ(num_done, task_spawn_expected_num());
+
+		BLI_task_pool_free(pool);
+		BLI_task_scheduler_free(scheduler);
+	}
+}
+
+/* Task waiting for a nested pool from a worker thread. */
+
+static void task_nested_pool_func(TaskPool *__restrict pool, void *UNUSED(taskdata), int UNUSED(thread_id))
+{
+	TaskScheduler *scheduler = (TaskScheduler *)BLI_task_pool_userdata(pool);
+	int num_done = 0;
+	TaskPool *nested_pool = BLI_task_pool_create(scheduler, &num_done);
+
+	for (int i = 0; i < NUM_TASKS_PER_LEVEL; i++) {
+		BLI_task_pool_push(nested_pool, task_spawn_func, SET_INT_IN_POINTER(NUM_LEVELS - 2), false, TASK_PRIORITY_HIGH);
+	}
+	BLI_task_pool_work_and_wait(nested_pool);
+	BLI_task_pool_free(nested_pool);
+
+	EXPECT_EQ(num_done, NUM_TASKS_PER_LEVEL * (1 + NUM_TASKS_PER_LEVEL + NUM_TASKS_PER_LEVEL * NUM_TASKS_PER_LEVEL));
+}
+
+TEST(task, PoolNestedWait)
+{
+	BLI_threadapi_init();
+	TaskScheduler *scheduler = BLI_task_scheduler_create(4);
+	TaskPool *pool = BLI_task_pool_create(scheduler, scheduler);
+
+	for (int i = 0; i < 64; i++) {
+		BLI_task_pool_push_from_thread(pool, task_nested_pool_func, NULL, false, TASK_PRIORITY_HIGH, 0);
+	}
+	BLI_task_pool_work_and_wait(pool);
+
+	BLI_task_pool_free(pool);
+	BLI_task_scheduler_free(scheduler);
+}
+
+/* Parallel range reduction and nested parallel ranges. */
+
+static void task_range_sum_func(void *__restrict userdata,
+                                const int iter,
+                                const ParallelRangeTLS *__restrict tls)
+{
+	const int *data = (const int *)userdata;
+	int64_t *sum = (int64_t *)tls->userdata_chunk;
+	*sum += data[iter];
+}
+
+static void task_range_sum_reduce(const void *__restrict UNUSED(userdata),
+                                  void *__restrict chunk_join,
+                                  void *__restrict userdata_chunk)
+{
+	*(int64_t *)chunk_join += *(int64_t *)userdata_chunk;
+}
+
+static int64_t task_range_sum(const int *data, const int num, const bool use_threading)
+{
+	int64_t sum = 0;
+	ParallelRangeSettings settings;
+	BLI_parallel_range_settings_defaults(&settings);
+	settings.use_threading = use_threading;
+	settings.userdata_chunk = &sum;
+	settings.userdata_chunk_size = sizeof(sum);
+	settings.func_reduce = task_range_sum_reduce;
+	BLI_task_parallel_range(0, num, (void *)data, task_range_sum_func, &settings);
+	return sum;
+}
+
+TEST(task, ParallelRangeReduce)
+{
+	int *data = (int *)MEM_mallocN(sizeof(int) * NUM_ITEMS, __func__);
+	for (int i = 0; i < NUM_ITEMS; i++) {
+		data[i] = i;
+	}
+	const int64_t expected = (int64_t)NUM_ITEMS * (NUM_ITEMS - 1) / 2;
+	EXPECT_EQ(task_range_sum(data, NUM_ITEMS, true), expected);
+	EXPECT_EQ(task_range_sum(data, NUM_ITEMS, false), expected);
+	MEM_freeN(data);
+}
+
+typedef struct NestedRangeData {
+	int *data;
+	int64_t *sums;
+} NestedRangeData;
+
+static void task_range_nested_func(void *__restrict userdata,
+                                   const int iter,
+                                   const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	NestedRangeData *nested_data = (NestedRangeData *)userdata;
+	nested_data->sums[iter] = task_range_sum(nested_data->data, NUM_ITEMS, true);
+}
+
+TEST(task, ParallelRangeNested)
+{
+	const int num_outer = 64;
+	NestedRangeData nested_data;
+	nested_data.data = (int *)MEM_mallocN(sizeof(int) * NUM_ITEMS, __func__);
+	nested_data.sums = (int64_t *)MEM_callocN(sizeof(int64_t) * num_outer, __func__);
+	for (int i = 0; i < NUM_ITEMS; i++) {
+		nested_data.data[i] = 1;
+	}
+
+	ParallelRangeSettings settings;
+	BLI_parallel_range_settings_defaults(&settings);
+	BLI_task_parallel_range(0, num_outer, &nested_data, task_range_nested_func, &settings);
+
+	for (int i = 0; i < num_outer; i++) {
+		EXPECT_EQ(nested_data.sums[i], NUM_ITEMS);
+	}
+	MEM_freeN(nested_data.data);
+	MEM_freeN(nested_data.sums);
+}
+
+/* Scheduler in NUMA mode, using fake topology. */
+
+TEST(task, SchedulerNuma)
+{
+	BLI_threadapi_init();
+	BLI_system_numa_num_nodes_override_set(2);
+	EXPECT_EQ(BLI_system_numa_num_nodes(), 2);
+	EXPECT_EQ(BLI_system_numa_node_of_cpu(0), 0);
+
+	TaskScheduler *scheduler = BLI_task_scheduler_create_ex(8, TASK_SCHEDULER_USE_NUMA);
+	EXPECT_EQ(BLI_task_scheduler_num_numa_nodes(scheduler), 2);
+
+	int num_done = 0;
+	TaskPool *pool = BLI_task_pool_create(scheduler, &num_done);
+	BLI_task_pool_push_from_thread(
+	        pool, task_spawn_func, SET_INT_IN_POINTER(0), false, TASK_PRIORITY_HIGH, 0);
+	BLI_task_pool_work_and_wait(pool);
+	EXPECT_EQ(num_done, task_spawn_expected_num());
+	BLI_task_pool_free(pool);
+
+	BLI_task_scheduler_free(scheduler);
+	BLI_system_numa_num_nodes_override_set(0);
+}
+
+/* Parallel range with a NUMA node hint, so its tasks go through the per-node queue. */
+
+TEST(task, ParallelRangeNuma)
+{
+	int *data = (int *)MEM_mallocN(sizeof(int) * NUM_ITEMS, __func__);
+	int64_t expected = 0;
+	for (int i = 0; i < NUM_ITEMS; i++) {
+		data[i] = i;
+		expected += i;
+	}
+
+	/* Recreate the global scheduler with a fake topology. */
+	BLI_threadapi_exit();
+	BLI_system_numa_num_nodes_override_set(2);
+	BLI_system_num_threads_override_set(8);
+	BLI_system_numa_scheduling_set(true);
+	BLI_threadapi_init();
+	EXPECT_EQ(BLI_task_scheduler_num_numa_nodes(BLI_task_scheduler_get()), 2);
+
+	for (int node = 0; node < 2; node++) {
+		int64_t sum = 0;
+		ParallelRangeSettings settings;
+		BLI_parallel_range_settings_defaults(&settings);
+		settings.scheduling_mode = TASK_SCHEDULING_DYNAMIC;
+		settings.numa_node = node;
+		settings.userdata_chunk = &sum;
+		settings.userdata_chunk_size = sizeof(sum);
+		settings.func_reduce = task_range_sum_reduce;
+		BLI_task_parallel_range(0, NUM_ITEMS, data, task_range_sum_func, &settings);
+		EXPECT_EQ(sum, expected);
+	}
+
+#ifdef __linux__
+	/* CPU 0 always belongs to node 0, bind a separate thread to not restrict the test itself. */
+	bool is_bound = false;
+	std::thread bind_thread([&is_bound]() { is_bound = BLI_system_thread_bind_numa_node(0); });
+	bind_thread.join();
+	EXPECT_TRUE(is_bound);
+#endif
+
+	BLI_threadapi_exit();
+	BLI_system_numa_scheduling_set(false);
+	BLI_system_num_threads_override_set(0);
+	BLI_system_numa_num_nodes_override_set(0);
+	BLI_threadapi_init();
+
+	MEM_freeN(data);
+}
+
+/* Throughput of tiny tasks, mainly measures scheduling overhead. */
+
+static void task_parallel_range_func(void *__restrict userdata,
+                                     const int iter,
+                                     const ParallelRangeTLS *__restrict UNUSED(tls))
+{
+	int *data = (int *)userdata;
+	data[iter] += 1;
+}
+
+TEST(task, SchedulerThroughput)
+{
+	BLI_threadapi_init();
+	TaskScheduler *scheduler = BLI_task_scheduler_create(0);
+	const int num_rounds = 4;
+	int num_done = 0;
+
+	TIMEIT_START(task_pool_spawn);
+	for (int round = 0; round < num_rounds; round++) {
+		TaskPool *pool = BLI_task_pool_create(scheduler, &num_done);
+		BLI_task_pool_push_from_thread(
+		        pool, task_spawn_func, SET_INT_IN_POINTER(0), false, TASK_PRIORITY_HIGH, 0);
+		BLI_task_pool_work_and_wait(pool);
+		BLI_task_pool_free(pool);
+	}
+	TIMEIT_END(task_pool_spawn);
+	EXPECT_EQ(num_done, task_spawn_expected_num() * num_rounds);
+
+	int *data = (int *)MEM_callocN(sizeof(int) * NUM_ITEMS, __func__);
+	ParallelRangeSettings settings;
+	BLI_parallel_range_settings_defaults(&settings);
+	settings.scheduling_mode = TASK_SCHEDULING_DYNAMIC;
+	settings.numa_node = 0;
+	TIMEIT_START(task_parallel_range);
+	for (int round = 0; round < 1000; round++) {
+		BLI_task_parallel_range(0, NUM_ITEMS, data, task_parallel_range_func, &settings);
+	}
+	TIMEIT_END(task_parallel_range);
+	for (int i = 0; i < NUM_ITEMS; i++) {
+		EXPECT_EQ(data[i], 1000);
+	}
+	MEM_freeN(data);
+
+	BLI_task_scheduler_free(scheduler);
+}
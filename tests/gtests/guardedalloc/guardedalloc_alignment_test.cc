@@ -55,3 +55,9 @@ TEST(guardedalloc, GuardedAlignedAlloc32)
 	DoBasicAlignmentChecks(32);
 }
 #endif
+
+TEST(guardedalloc, TcacheAlignedAlloc16)
+{
+	MEM_use_tcache_allocator();
+	DoBasicAlignmentChecks(16);
+}
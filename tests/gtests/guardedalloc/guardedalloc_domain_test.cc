@@ -0,0 +1,103 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "MEM_guardedalloc.h"
+
+#define BLOCK_SIZE (1024 * 1024)
+
+namespace {
+
+/* Domains are only stored in the block header of the lockfree allocators on 64 bit. */
+const bool domains_in_header = sizeof(void *) == 8;
+
+void DomainAccounting()
+{
+	const size_t undo_prev = MEM_domain_get_memory_in_use(MEM_DOMAIN_UNDO);
+	const size_t bvh_prev = MEM_domain_get_memory_in_use(MEM_DOMAIN_BVH);
+
+	const int domain_prev = MEM_domain_thread_set(MEM_DOMAIN_UNDO);
+	EXPECT_EQ(MEM_domain_thread_get(), MEM_DOMAIN_UNDO);
+	void *block = MEM_mallocN(BLOCK_SIZE, __func__);
+	MEM_domain_thread_set(domain_prev);
+
+	EXPECT_EQ(MEM_domain_get_memory_in_use(MEM_DOMAIN_UNDO), undo_prev + BLOCK_SIZE);
+	EXPECT_GE(MEM_domain_get_peak_memory(MEM_DOMAIN_UNDO), undo_prev + BLOCK_SIZE);
+
+	/* Reallocation keeps the domain of the block. */
+	block = MEM_reallocN(block, BLOCK_SIZE * 2);
+	EXPECT_EQ(MEM_domain_get_memory_in_use(MEM_DOMAIN_UNDO), undo_prev + BLOCK_SIZE * 2);
+
+	MEM_set_block_domain(block, MEM_DOMAIN_BVH);
+	EXPECT_EQ(MEM_domain_get_memory_in_use(MEM_DOMAIN_UNDO), undo_prev);
+	EXPECT_EQ(MEM_domain_get_memory_in_use(MEM_DOMAIN_BVH), bvh_prev + BLOCK_SIZE * 2);
+
+	MEM_freeN(block);
+	EXPECT_EQ(MEM_domain_get_memory_in_use(MEM_DOMAIN_BVH), bvh_prev);
+}
+
+void BudgetCallback(int domain, size_t mem_in_use, void *userdata)
+{
+	EXPECT_EQ(domain, MEM_DOMAIN_MOVIECACHE);
+	EXPECT_GT(mem_in_use, MEM_domain_get_budget(domain));
+	(*(int *)userdata)++;
+}
+
+void DomainBudget()
+{
+	int num_calls = 0;
+	void *blocks[4];
+
+	MEM_domain_set_budget(MEM_DOMAIN_MOVIECACHE, BLOCK_SIZE * 2 + BLOCK_SIZE / 2);
+	MEM_domain_budget_callback_add(MEM_DOMAIN_MOVIECACHE, BudgetCallback, &num_calls);
+
+	const int domain_prev = MEM_domain_thread_set(MEM_DOMAIN_MOVIECACHE);
+	for (int i = 0; i < 4; i++) {
+		blocks[i] = MEM_mallocN(BLOCK_SIZE, __func__);
+	}
+	MEM_domain_thread_set(domain_prev);
+
+	/* Only notified once when going over the budget. */
+	EXPECT_EQ(num_calls, 1);
+	EXPECT_TRUE(MEM_domain_is_over_budget(MEM_DOMAIN_MOVIECACHE));
+
+	for (int i = 0; i < 4; i++) {
+		MEM_freeN(blocks[i]);
+	}
+	EXPECT_FALSE(MEM_domain_is_over_budget(MEM_DOMAIN_MOVIECACHE));
+
+	/* Going over the budget again notifies again. */
+	blocks[0] = MEM_mallocN(BLOCK_SIZE * 4, __func__);
+	MEM_set_block_domain(blocks[0], MEM_DOMAIN_MOVIECACHE);
+	MEM_freeN(blocks[0]);
+	EXPECT_EQ(num_calls, 2);
+
+	MEM_domain_budget_callback_remove(MEM_DOMAIN_MOVIECACHE, BudgetCallback, &num_calls);
+	MEM_domain_set_budget(MEM_DOMAIN_MOVIECACHE, 0);
+}
+
+}  // namespace
+
+TEST(guardedalloc, LockfreeDomain)
+{
+	if (domains_in_header) {
+		DomainAccounting();
+		DomainBudget();
+	}
+}
+
+TEST(guardedalloc, GuardedDomain)
+{
+	MEM_use_guarded_allocator();
+	DomainAccounting();
+	DomainBudget();
+}
+
+TEST(guardedalloc, TcacheDomain)
+{
+	MEM_use_tcache_allocator();
+	if (domains_in_header) {
+		DomainAccounting();
+		DomainBudget();
+	}
+}
@@ -0,0 +1,70 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <pthread.h>
+
+#include "MEM_guardedalloc.h"
+
+extern "C" {
+#include "PIL_time.h"
+}
+
+/* Many small allocations from 1 to 64 threads, as done by modifier evaluation,
+ * with the default lock-free allocator and the thread caching one. */
+
+#define NUM_BLOCKS 1000
+#define NUM_ROUNDS 1000
+#define MAX_THREADS 64
+
+namespace {
+
+void *AllocFreeThread(void * /*data*/)
+{
+	void *blocks[NUM_BLOCKS];
+	unsigned int seed = 1;
+
+	for (int round = 0; round < NUM_ROUNDS; round++) {
+		for (int i = 0; i < NUM_BLOCKS; i++) {
+			seed = seed * 1103515245u + 12345u;
+			blocks[i] = MEM_mallocN(16 + (seed >> 16) % 512, __func__);
+		}
+		/* Free in a different order than allocated. */
+		for (int i = 0; i < NUM_BLOCKS; i += 2) {
+			MEM_freeN(blocks[i]);
+		}
+		for (int i = 1; i < NUM_BLOCKS; i += 2) {
+			MEM_freeN(blocks[i]);
+		}
+	}
+	return NULL;
+}
+
+void RunScaling(const char *allocator)
+{
+	for (int num_threads = 1; num_threads <= MAX_THREADS; num_threads *= 2) {
+		pthread_t threads[MAX_THREADS];
+		const double time_start = PIL_check_seconds_timer();
+
+		for (int i = 0; i < num_threads; i++) {
+			pthread_create(&threads[i], NULL, AllocFreeThread, NULL);
+		}
+		for (int i = 0; i < num_threads; i++) {
+			pthread_join(threads[i], NULL);
+		}
+
+		const double time = PIL_check_seconds_timer() - time_start;
+		printf("%s, %d threads: %.3f s\n", allocator, num_threads, time);
+	}
+}
+
+}  // namespace
+
+TEST(guardedalloc, TcachePerfScaling)
+{
+	RunScaling("lockfree");
+
+	/* All blocks of the lock-free allocator are freed at this point. */
+	MEM_use_tcache_allocator();
+	RunScaling("tcache");
+}
@@ -0,0 +1,111 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#include "MEM_guardedalloc.h"
+
+#define NUM_THREADS 8
+#define NUM_BLOCKS 4000
+
+namespace {
+
+struct ThreadData {
+	/* Blocks allocated by this thread, freed by the next one. */
+	void *blocks[NUM_BLOCKS];
+	size_t sizes[NUM_BLOCKS];
+	int thread;
+};
+
+size_t BlockSize(int thread, int i)
+{
+	/* Mostly small sizes from all classes, with some above the largest class. */
+	return (i % 50 == 0) ? (size_t)(8192 + i) : (size_t)((i * 7 + thread * 13) % 3000);
+}
+
+void *AllocThread(void *data_v)
+{
+	ThreadData *data = (ThreadData *)data_v;
+
+	for (int i = 0; i < NUM_BLOCKS; i++) {
+		data->sizes[i] = BlockSize(data->thread, i);
+		data->blocks[i] = (i % 3) ?
+		        MEM_mallocN(data->sizes[i], __func__) :
+		        MEM_callocN(data->sizes[i], __func__);
+		memset(data->blocks[i], data->thread, data->sizes[i]);
+	}
+	/* Free and allocate again, so blocks go through the thread cache. */
+	for (int i = 0; i < NUM_BLOCKS; i += 2) {
+		MEM_freeN(data->blocks[i]);
+	}
+	for (int i = 0; i < NUM_BLOCKS; i += 2) {
+		data->blocks[i] = MEM_mallocN(data->sizes[i], __func__);
+		memset(data->blocks[i], data->thread, data->sizes[i]);
+	}
+	return NULL;
+}
+
+void *FreeThread(void *data_v)
+{
+	ThreadData *data = (ThreadData *)data_v;
+
+	for (int i = 0; i < NUM_BLOCKS; i++) {
+		const unsigned char *mem = (const unsigned char *)data->blocks[i];
+		EXPECT_GE(MEM_allocN_len(mem), data->sizes[i]);
+		for (size_t j = 0; j < data->sizes[i]; j++) {
+			if (mem[j] != data->thread) {
+				ADD_FAILURE() << "block " << i << " of thread " << data->thread << " overwritten";
+				break;
+			}
+		}
+		MEM_freeN(data->blocks[i]);
+	}
+	return NULL;
+}
+
+void RunThreads(void *(*func)(void *), ThreadData *data)
+{
+	pthread_t threads[NUM_THREADS];
+	for (int i = 0; i < NUM_THREADS; i++) {
+		pthread_create(&threads[i], NULL, func, &data[i]);
+	}
+	for (int i = 0; i < NUM_THREADS; i++) {
+		pthread_join(threads[i], NULL);
+	}
+}
+
+}  // namespace
+
+/* Allocate from many threads and free from other threads after they finished,
+ * the statistics of finished threads must still add up. */
+TEST(guardedalloc, TcacheThreads)
+{
+	MEM_use_tcache_allocator();
+
+	const unsigned int blocks_init = MEM_get_memory_blocks_in_use();
+	const size_t mem_init = MEM_get_memory_in_use();
+
+	ThreadData *data = (ThreadData *)MEM_callocN(sizeof(ThreadData) * NUM_THREADS, __func__);
+	for (int i = 0; i < NUM_THREADS; i++) {
+		data[i].thread = i;
+	}
+
+	RunThreads(AllocThread, data);
+	EXPECT_EQ(MEM_get_memory_blocks_in_use(), blocks_init + 1 + NUM_THREADS * NUM_BLOCKS);
+
+	/* Free the blocks of the next thread. */
+	ThreadData *data_shift = (ThreadData *)MEM_mallocN(sizeof(ThreadData) * NUM_THREADS, __func__);
+	for (int i = 0; i < NUM_THREADS; i++) {
+		data_shift[i] = data[(i + 1) % NUM_THREADS];
+	}
+	RunThreads(FreeThread, data_shift);
+
+	MEM_freeN(data_shift);
+	MEM_freeN(data);
+
+	EXPECT_EQ(MEM_get_memory_blocks_in_use(), blocks_init);
+	EXPECT_EQ(MEM_get_memory_in_use(), mem_init);
+	EXPECT_GE(MEM_get_peak_memory(), mem_init);
+}
@@ -0,0 +1,280 @@
+# ##### BEGIN GPL LICENSE BLOCK #####
+#
+#  This program is free software; you can redistribute it and/or
+#  modify it under the terms of the GNU General Public License
+#  as published by the Free Software Foundation; either version 2
+#  of the License, or (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software Foundation,
+#  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+#
+# ##### END GPL LICENSE BLOCK #####
+
+# <pep8 compliant>
+
+# Round trip of block framed files (saved with "compress_frames"):
+#
+# - Files written by Blender (LZO frames, or zlib ones in builds without LZO).
+# - Files written here from a regular file, with zlib and stored frames.
+# - Files with a truncated or corrupt index, or corrupt frames, which must fail to load.
+# - Partial reads (appending from a library), which seek over unused blocks with the index.
+#
+# Frames are decompressed in parallel, or streamed one at a time with a single thread:
+#
+# ./blender.bin --background --factory-startup --threads 4 \
+#     --python tests/python/bl_blendfile_frames.py
+# ./blender.bin --background --factory-startup --threads 1 \
+#     --python tests/python/bl_blendfile_frames.py -- --streaming
+
+import os
+import struct
+import sys
+import tempfile
+import unittest
+import zlib
+from array import array
+
+import bpy
+
+USE_STREAMING = False
+
+FRAMES_MAGIC = b"BLENDFRM"
+FRAME_HEADER = struct.Struct("<III")
+FRAME_INDEX = struct.Struct("<QQ")
+FRAMES_FOOTER = struct.Struct("<QII8s")
+
+CODEC_NONE = 0
+CODEC_ZLIB = 1
+CODEC_LZO = 2
+
+
+def frames_parse(data):
+    """Return the (header offset, codec, compressed data, uncompressed length) of each frame."""
+    index_offset, frames_num, _pad, magic = FRAMES_FOOTER.unpack_from(data, len(data) - FRAMES_FOOTER.size)
+    assert magic == FRAMES_MAGIC
+    assert len(data) - FRAMES_FOOTER.size - index_offset == frames_num * FRAME_INDEX.size
+
+    frames = []
+    uncompressed_offset_expect = 0
+    for i in range(frames_num):
+        offset, uncompressed_offset = FRAME_INDEX.unpack_from(data, index_offset + i * FRAME_INDEX.size)
+        assert uncompressed_offset == uncompressed_offset_expect
+        compressed_len, uncompressed_len, codec = FRAME_HEADER.unpack_from(data, offset)
+        start = offset + FRAME_HEADER.size
+        frames.append((offset, codec, data[start:start + compressed_len], uncompressed_len))
+        uncompressed_offset_expect += uncompressed_len
+
+    # End marker after the last frame.
+    offset, _codec, compressed, _uncompressed_len = frames[-1]
+    end = offset + FRAME_HEADER.size + len(compressed)
+    assert data[end:end + FRAME_HEADER.size] == bytes(FRAME_HEADER.size)
+    return frames
+
+
+def frames_write(filepath, data, frame_size):
+    """Write the contents of a regular file as frames, alternating zlib and stored frames."""
+    out = bytearray(FRAMES_MAGIC)
+    index = []
+    for i, start in enumerate(range(0, len(data), frame_size)):
+        chunk = data[start:start + frame_size]
+        compressed = zlib.compress(chunk, 1) if (i % 2) == 0 else chunk
+        # Same as Blender, frames which don't get smaller are stored.
+        codec = CODEC_ZLIB if len(compressed) < len(chunk) else CODEC_NONE
+        if codec == CODEC_NONE:
+            compressed = chunk
+        index.append((len(out), start))
+        out += FRAME_HEADER.pack(len(compressed), len(chunk), codec)
+        out += compressed
+    out += bytes(FRAME_HEADER.size)
+    index_offset = len(out)
+    for offset, uncompressed_offset in index:
+        out += FRAME_INDEX.pack(offset, uncompressed_offset)
+    out += FRAMES_FOOTER.pack(index_offset, len(index), 0, FRAMES_MAGIC)
+
+    with open(filepath, "wb") as fh:
+        fh.write(out)
+    return bytes(out)
+
+
+def scene_create():
+    for ob in bpy.data.objects:
+        bpy.data.objects.remove(ob)
+    for i in range(3):
+        bpy.ops.mesh.primitive_grid_add(x_subdivisions=150 + i, y_subdivisions=150, radius=i + 1.0)
+        ob = bpy.context.object
+        ob.name = "Grid%d" % i
+        ob.location = (i * 2.0, 0.0, 0.0)
+        for v in ob.data.vertices:
+            v.co.z = (v.index % 13) * 0.01
+
+
+def scene_state():
+    state = []
+    for ob in sorted(bpy.data.objects, key=lambda ob: ob.name):
+        if ob.type != 'MESH':
+            continue
+        me = ob.data
+        cos = array('f', [0.0]) * (len(me.vertices) * 3)
+        me.vertices.foreach_get("co", cos)
+        state.append((ob.name, tuple(ob.location), len(me.polygons), cos.tobytes()))
+    return state
+
+
+class BlendFileFramesTest(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        cls.tempdir = tempfile.TemporaryDirectory()
+        scene_create()
+        cls.state = scene_state()
+
+        cls.filepath_plain = cls.path("plain.blend")
+        cls.filepath_frames = cls.path("frames.blend")
+        bpy.ops.wm.save_as_mainfile(filepath=cls.filepath_plain, compress=False, compress_frames=False)
+        bpy.ops.wm.save_as_mainfile(filepath=cls.filepath_frames, compress=True, compress_frames=True)
+
+        with open(cls.filepath_plain, "rb") as fh:
+            cls.data_plain = fh.read()
+        with open(cls.filepath_frames, "rb") as fh:
+            cls.data_frames = fh.read()
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.tempdir.cleanup()
+
+    @classmethod
+    def path(cls, name):
+        return os.path.join(cls.tempdir.name, name)
+
+    def assertLoads(self, filepath):
+        bpy.ops.wm.open_mainfile(filepath=filepath)
+        self.assertEqual(scene_state(), self.state)
+
+    def assertLoadFails(self, filepath):
+        with self.assertRaises(RuntimeError):
+            bpy.ops.wm.open_mainfile(filepath=filepath)
+
+    def assertAppends(self, filepath):
+        bpy.ops.wm.read_factory_settings(use_empty=True)
+        with bpy.data.libraries.load(filepath) as (data_from, data_to):
+            data_to.objects = data_from.objects
+        self.assertEqual(scene_state(), self.state)
+
+    def frames_variant(self, name, data):
+        filepath = self.path(name)
+        with open(filepath, "wb") as fh:
+            fh.write(data)
+        return filepath
+
+    def test_written(self):
+        frames = frames_parse(self.data_frames)
+        self.assertGreater(len(frames), 1)
+
+        codecs = {codec for _offset, codec, _compressed, _uncompressed_len in frames}
+        self.assertTrue(codecs <= {CODEC_NONE, CODEC_ZLIB, CODEC_LZO})
+        self.assertTrue(codecs & {CODEC_ZLIB, CODEC_LZO})
+        for _offset, codec, compressed, uncompressed_len in frames:
+            if codec == CODEC_ZLIB:
+                self.assertEqual(len(zlib.decompress(compressed)), uncompressed_len)
+            elif codec == CODEC_NONE:
+                self.assertEqual(len(compressed), uncompressed_len)
+
+        self.assertLoads(self.filepath_frames)
+
+    def test_partial(self):
+        self.assertAppends(self.filepath_frames)
+
+        # Many small frames, so blocks span several frames and seeking skips some of them.
+        filepath = self.path("partial.blend")
+        frames_write(filepath, self.data_plain, 20000)
+        self.assertAppends(filepath)
+
+    def test_zlib_and_stored(self):
+        # Frames smaller than Blender's, with a partial last one.
+        filepath = self.path("zlib_none.blend")
+        data = frames_write(filepath, self.data_plain, 100000)
+        codecs = [codec for _offset, codec, _compressed, _uncompressed_len in frames_parse(data)]
+        self.assertIn(CODEC_ZLIB, codecs)
+        self.assertIn(CODEC_NONE, codecs)
+
+        self.assertLoads(filepath)
+
+    def test_corrupt_frames(self):
+        data = frames_write(self.path("corrupt_base.blend"), self.data_plain, 100000)
+        frames = frames_parse(data)
+
+        # Corrupt zlib data in the first frame.
+        offset = frames[0][0] + FRAME_HEADER.size
+        corrupt = bytearray(data)
+        corrupt[offset:offset + 16] = bytes(range(16))
+        self.assertLoadFails(self.frames_variant("corrupt_data.blend", corrupt))
+
+        # Compressed length larger than the uncompressed one.
+        corrupt = bytearray(data)
+        compressed_len, uncompressed_len, codec = FRAME_HEADER.unpack_from(data, frames[0][0])
+        FRAME_HEADER.pack_into(corrupt, frames[0][0], uncompressed_len + 1, uncompressed_len, codec)
+        self.assertLoadFails(self.frames_variant("corrupt_header.blend", corrupt))
+
+        # Unknown codec.
+        corrupt = bytearray(data)
+        FRAME_HEADER.pack_into(corrupt, frames[0][0], compressed_len, uncompressed_len, 7)
+        self.assertLoadFails(self.frames_variant("corrupt_codec.blend", corrupt))
+
+        # Corrupt data in the first frame written by Blender (LZO in builds with LZO).
+        offset = frames_parse(self.data_frames)[0][0] + FRAME_HEADER.size
+        corrupt = bytearray(self.data_frames)
+        corrupt[offset:offset + 16] = bytes(range(16))
+        self.assertLoadFails(self.frames_variant("corrupt_written.blend", corrupt))
+
+    def test_corrupt_index(self):
+        data = frames_write(self.path("index_base.blend"), self.data_plain, 100000)
+        index_offset, frames_num, _pad, _magic = FRAMES_FOOTER.unpack_from(data, len(data) - FRAMES_FOOTER.size)
+        entry = index_offset + FRAME_INDEX.size * (frames_num // 2)
+        offset, uncompressed_offset = FRAME_INDEX.unpack_from(data, entry)
+
+        variants = {}
+
+        variants["truncated"] = data[:-(FRAME_INDEX.size + 3)]
+
+        corrupt = bytearray(data)
+        FRAME_INDEX.pack_into(corrupt, entry, offset, uncompressed_offset + 1)
+        variants["uncompressed_offset"] = corrupt
+
+        corrupt = bytearray(data)
+        FRAME_INDEX.pack_into(corrupt, entry, index_offset, uncompressed_offset)
+        variants["offset"] = corrupt
+
+        corrupt = bytearray(data)
+        FRAMES_FOOTER.pack_into(corrupt, len(data) - FRAMES_FOOTER.size, index_offset, frames_num + 1, 0, FRAMES_MAGIC)
+        variants["frames_num"] = corrupt
+
+        for name, corrupt in sorted(variants.items()):
+            with self.subTest(name=name):
+                filepath = self.frames_variant("index_%s.blend" % name, corrupt)
+                if USE_STREAMING:
+                    # Streaming reads the frames in order and doesn't use the index.
+                    self.assertLoads(filepath)
+                else:
+                    self.assertLoadFails(filepath)
+
+                # Partial reads stream the frames without an invalid index,
+                # or fail when the frames don't match it.
+                try:
+                    self.assertAppends(filepath)
+                except OSError:
+                    self.assertEqual(name, "uncompressed_offset")
+
+
+if __name__ == '__main__':
+    argv = sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else []
+    if "--streaming" in argv:
+        USE_STREAMING = True
+        argv.remove("--streaming")
+    sys.argv = [__file__] + argv
+    unittest.main()
@@ -0,0 +1,86 @@
+# ##### BEGIN GPL LICENSE BLOCK #####
+#
+#  This program is free software; you can redistribute it and/or
+#  modify it under the terms of the GNU General Public License
+#  as published by the Free Software Foundation; either version 2
+#  of the License, or (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software Foundation,
+#  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+#
+# ##### END GPL LICENSE BLOCK #####
+
+# <pep8 compliant>
+
+# Times saving and loading a large file uncompressed (memory mapped),
+# compressed (read through zlib) and compressed in frames (decompressed in parallel).
+#
+# Meshes with many vertices make up most of the file, so the time is
+# dominated by reading blocks rather than by linking and versioning them.
+
+
+# ./blender.bin --background --factory-startup \
+#     --python tests/python/bl_blendfile_load_benchmark.py -- /tmp
+#
+
+import os
+import sys
+import time
+
+import bpy
+
+NUM_MESHES = 400
+NUM_VERTS = 100000
+NUM_LOADS = 3
+
+
+def setup_data():
+    for i in range(NUM_MESHES):
+        mesh = bpy.data.meshes.new("Mesh")
+        mesh.vertices.add(NUM_VERTS)
+        mesh.vertices.foreach_set("co", [float(i)] * (NUM_VERTS * 3))
+        mesh.use_fake_user = True
+
+
+def load(filepath):
+    size = os.path.getsize(filepath) / (1024 * 1024)
+    time_total = 0.0
+    for _ in range(NUM_LOADS):
+        time_start = time.time()
+        bpy.ops.wm.open_mainfile(filepath=filepath, load_ui=False)
+        time_total += time.time() - time_start
+    print("Loaded %s (%.1f MB) in %.3f seconds" %
+          (os.path.basename(filepath), size, time_total / NUM_LOADS))
+
+
+def main():
+    argv = sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else []
+    directory = argv[0] if argv else bpy.app.tempdir
+
+    setup_data()
+
+    filepaths = []
+    for name, compress, compress_frames in (
+            ("plain", False, False),
+            ("compressed", True, False),
+            ("frames", True, True),
+    ):
+        filepath = os.path.join(directory, "load_benchmark_%s.blend" % name)
+        time_start = time.time()
+        bpy.ops.wm.save_as_mainfile(filepath=filepath, compress=compress, compress_frames=compress_frames, copy=True)
+        print("Saved %s in %.3f seconds" % (os.path.basename(filepath), time.time() - time_start))
+        filepaths.append(filepath)
+
+    for filepath in filepaths:
+        load(filepath)
+        os.remove(filepath)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,112 @@
+# ##### BEGIN GPL LICENSE BLOCK #####
+#
+#  This program is free software; you can redistribute it and/or
+#  modify it under the terms of the GNU General Public License
+#  as published by the Free Software Foundation; either version 2
+#  of the License, or (at your option) any later version.
+#
+#  This program is distributed in the hope that it will be useful,
+#  but WITHOUT ANY WARRANTY; without even the implied warranty of
+#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+#  GNU General Public License for more details.
+#
+#  You should have received a copy of the GNU General Public License
+#  along with this program; if not, write to the Free Software Foundation,
+#  Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+#
+# ##### END GPL LICENSE BLOCK #####
+
+# <pep8 compliant>
+
+# Times playback of a scene mixing objects with modifiers which evaluate in
+# parallel on their own (subsurf, displace) and objects with single threaded
+# ones (bevel, array), all animated so they are evaluated on every frame.
+#
+# Reports the time per frame, along with the critical path and the thread
+# utilization of the dependency graph evaluation of the last frame.
+
+
+# ./blender.bin --background --factory-startup --enable-new-depsgraph \
+#     --debug-depsgraph-time -t 8 --python tests/python/bl_depsgraph_playback_benchmark.py
+#
+
+import time
+
+import bmesh
+import bpy
+
+NUM_OBJECTS = 16
+NUM_FRAMES = 50
+
+
+def setup_scene(scene):
+    for ob in list(scene.objects):
+        scene.objects.unlink(ob)
+
+    texture = bpy.data.textures.new("Noise", 'CLOUDS')
+
+    for i in range(NUM_OBJECTS):
+        mesh = bpy.data.meshes.new("Mesh")
+        ob = bpy.data.objects.new("Object", mesh)
+        scene.objects.link(ob)
+        ob.location.x = (i % 4) * 4.0
+        ob.location.y = (i // 4) * 4.0
+
+        # Build some geometry to work on, with a subdivision applied.
+        subsurf = ob.modifiers.new("Subsurf", 'SUBSURF')
+        subsurf.levels = 3
+
+        if i % 2 == 0:
+            # Single threaded stack.
+            bevel = ob.modifiers.new("Bevel", 'BEVEL')
+            bevel.segments = 2
+            array = ob.modifiers.new("Array", 'ARRAY')
+            array.count = 4
+        else:
+            # Stack which evaluates in parallel itself.
+            displace = ob.modifiers.new("Displace", 'DISPLACE')
+            displace.texture = texture
+            subsurf = ob.modifiers.new("Subsurf", 'SUBSURF')
+            subsurf.levels = 2
+
+        # Animate the second modifier, so the stack is evaluated every frame.
+        md = ob.modifiers[1]
+        prop = "width" if md.type == 'BEVEL' else "strength"
+        setattr(md, prop, 0.05)
+        md.keyframe_insert(prop, frame=1)
+        setattr(md, prop, 0.1)
+        md.keyframe_insert(prop, frame=NUM_FRAMES)
+
+        bm = bmesh.new()
+        bmesh.ops.create_cube(bm, size=2.0)
+        bm.to_mesh(mesh)
+        bm.free()
+
+    scene.frame_start = 1
+    scene.frame_end = NUM_FRAMES
+
+
+def playback(scene):
+    # First frames settle the cost estimates of the scheduler.
+    scene.frame_set(scene.frame_start)
+    scene.frame_set(scene.frame_start + 1)
+
+    time_start = time.time()
+    for frame in range(scene.frame_start, scene.frame_end + 1):
+        scene.frame_set(frame)
+    time_total = time.time() - time_start
+
+    num_frames = scene.frame_end - scene.frame_start + 1
+    print("Played %d frames in %.3f seconds, %.2f fps" %
+          (num_frames, time_total, num_frames / time_total))
+    print(scene.depsgraph.debug_eval_stats())
+
+
+def main():
+    scene = bpy.context.scene
+    setup_scene(scene)
+    playback(scene)
+
+
+if __name__ == "__main__":
+    main()